@@ -0,0 +1,170 @@
+/* mpi-scan.c
+ * Search for BTL headers in a byte stream, e.g. after a capture started
+ * in the middle of a connection or lost segments
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Most bytes of a stream fail the cheap tests already: the base byte in
+ * 65..77, the same byte again as common header type 8 bytes later and the
+ * type 1..3. With SSE2 these are done for 16 offsets at once, the few
+ * offsets left are checked completely (flags, base_size) and followed to
+ * the next header. The scalar loop does the same one offset at a time.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "mpi-scan.h"
+
+/* MPI_PML_OB1_HDR_TYPE_MATCH .. MPI_PML_BFO_HDR_TYPE_RECVERRNOTIFY */
+#define MPI_SCAN_BASE_MIN 65
+#define MPI_SCAN_BASE_MAX 77
+/* Send, Put, Get */
+#define MPI_SCAN_TYPE_MIN 1
+#define MPI_SCAN_TYPE_MAX 3
+/* ack, nbo, pin, contig, nordma, restart */
+#define MPI_SCAN_FLAGS 0x3f
+
+gboolean
+mpi_scan_btl_valid(const guint8 *p, gboolean little_endian, guint32 *size)
+{
+    guint32 base_size;
+
+    if (MPI_SCAN_BASE_MIN > p[0] || MPI_SCAN_BASE_MAX < p[0] ||
+            MPI_SCAN_TYPE_MIN > p[1] || MPI_SCAN_TYPE_MAX < p[1] ||
+            p[8] != p[0] || (p[9] & ~MPI_SCAN_FLAGS)) {
+        return FALSE;
+    }
+    if (little_endian) {
+        base_size = (guint32)p[4] | (guint32)p[5] << 8 |
+            (guint32)p[6] << 16 | (guint32)p[7] << 24;
+    } else {
+        base_size = (guint32)p[4] << 24 | (guint32)p[5] << 16 |
+            (guint32)p[6] << 8 | (guint32)p[7];
+    }
+    /* at least the common header */
+    if (2 > base_size || MPI_SCAN_MAX_SIZE < base_size) {
+        return FALSE;
+    }
+    if (size) {
+        *size = base_size;
+    }
+    return TRUE;
+}
+
+/* a header at "offset" and its successor */
+static gboolean
+mpi_scan_btl_chain(const guint8 *buf, gsize len, gsize offset,
+        gboolean little_endian, gboolean chained)
+{
+    guint32 size;
+    gsize next;
+
+    if (!mpi_scan_btl_valid(buf + offset, little_endian, &size)) {
+        return FALSE;
+    }
+    next = offset + 8 + size;
+    if (next + MPI_SCAN_HDR_LEN > len) {
+        return !chained;
+    }
+    return mpi_scan_btl_valid(buf + next, little_endian, NULL);
+}
+
+gsize
+mpi_scan_btl_scalar(const guint8 *buf, gsize len, gsize from,
+        gboolean little_endian, gboolean chained)
+{
+    gsize i;
+
+    for (i = from; i + MPI_SCAN_HDR_LEN <= len; i++) {
+        if (mpi_scan_btl_chain(buf, len, i, little_endian, chained)) {
+            return i;
+        }
+    }
+    return len;
+}
+
+gsize
+mpi_scan_btl(const guint8 *buf, gsize len, gsize from,
+        gboolean little_endian, gboolean chained)
+{
+    gsize i = from;
+#ifdef __SSE2__
+    const __m128i base_min = _mm_set1_epi8((char)MPI_SCAN_BASE_MIN);
+    const __m128i base_span = _mm_set1_epi8(
+            (char)(MPI_SCAN_BASE_MAX - MPI_SCAN_BASE_MIN));
+    const __m128i type_min = _mm_set1_epi8((char)MPI_SCAN_TYPE_MIN);
+    const __m128i type_span = _mm_set1_epi8(
+            (char)(MPI_SCAN_TYPE_MAX - MPI_SCAN_TYPE_MIN));
+    __m128i base;
+    __m128i common;
+    __m128i type;
+    __m128i ok;
+    gint mask;
+    gint bit;
+
+    /* 16 offsets, their bytes 0, 1 and 8 */
+    for (; i + 16 + MPI_SCAN_HDR_LEN <= len; i += 16) {
+        base = _mm_loadu_si128((const __m128i *)(buf + i));
+        type = _mm_loadu_si128((const __m128i *)(buf + i + 1));
+        common = _mm_loadu_si128((const __m128i *)(buf + i + 8));
+
+        /* unsigned x - min <= span */
+        base = _mm_sub_epi8(base, base_min);
+        ok = _mm_cmpeq_epi8(_mm_min_epu8(base, base_span), base);
+        common = _mm_sub_epi8(common, base_min);
+        ok = _mm_and_si128(ok, _mm_cmpeq_epi8(common, base));
+        type = _mm_sub_epi8(type, type_min);
+        ok = _mm_and_si128(ok,
+                _mm_cmpeq_epi8(_mm_min_epu8(type, type_span), type));
+
+        /* mostly none */
+        mask = _mm_movemask_epi8(ok);
+        for (bit = 0; mask; bit++, mask >>= 1) {
+            if ((mask & 1) &&
+                    mpi_scan_btl_chain(buf, len, i + bit, little_endian, chained)) {
+                return i + bit;
+            }
+        }
+    }
+#endif
+
+    return mpi_scan_btl_scalar(buf, len, i, little_endian, chained);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
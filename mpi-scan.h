@@ -0,0 +1,55 @@
+/* mpi-scan.h
+ * Search for BTL headers in a byte stream
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __MPI_SCAN_H__
+#define __MPI_SCAN_H__
+
+#include <glib.h>
+
+/* BTL header (8) and the type and flags of the PML common header (2) */
+#define MPI_SCAN_HDR_LEN 10
+
+/* base_size limit of a plausible header */
+#define MPI_SCAN_MAX_SIZE (64 * 1024 * 1024)
+
+/*
+ * A plausible BTL header at "p": base in MATCH..RECVERRNOTIFY, type Send,
+ * Put or Get, the common header type equal to the base, only known flags
+ * and a base_size below MPI_SCAN_MAX_SIZE. Sets the base_size (may be NULL).
+ */
+gboolean mpi_scan_btl_valid(const guint8 *p, gboolean little_endian, guint32 *size);
+
+/*
+ * The offset of the first plausible BTL header in buf[from..len) whose
+ * successor (base_size later) is plausible as well or lies beyond the
+ * buffer, len if there is none. With "chained" the successor has to be
+ * in the buffer. Uses SSE2 if the compiler has it, needs no epan.
+ */
+gsize mpi_scan_btl(const guint8 *buf, gsize len, gsize from,
+        gboolean little_endian, gboolean chained);
+
+/* The same one offset at a time, without SSE2 (tests/mpi-scan-test.c) */
+gsize mpi_scan_btl_scalar(const guint8 *buf, gsize len, gsize from,
+        gboolean little_endian, gboolean chained);
+
+#endif /* __MPI_SCAN_H__ */
@@ -27,17 +27,35 @@
 
 #include "config.h"
 
+#include <string.h>
+
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifdef HAVE_ARPA_INET_H
+#include <arpa/inet.h>
+#endif
+
 #include <epan/packet.h>
+#include <epan/epan.h>
 #include <epan/conversation.h>
+#include <epan/expert.h>
 #include <epan/prefs.h>
+#include <epan/tap.h>
+#include <epan/dissectors/packet-tcp.h>
+#include <wsutil/inet_v6defs.h>
 
 #include "packet-mpi.h"
+#include "mpi-scan.h"
 
 #define MPI_DEBUG 0
 
 /* Initialize the protocol and registered fields */
 static int proto_mpi = -1;
 
+/* Initialize the tap */
+static int mpi_tap = -1;
+
 /* Global sample preference ("controls" display of numbers) */
 static gboolean pref_little_endian = TRUE;
 /*
@@ -47,6 +65,23 @@ static gboolean pref_little_endian = TRUE;
 #define DEFAULT_MPI_PORT_RANGE "1024-65535"
 static range_t *global_mpi_tcp_port_range;
 
+/* XCAST relay correlation (milliseconds) */
+static guint pref_xcast_window = 1000;
+static guint pref_xcast_slow_relay = 10;
+
+/* heartbeat monitoring, rate in milliseconds (0: learn it per daemon) */
+static guint pref_heartbeat_rate = 0;
+static guint pref_heartbeat_jitter = 50;
+
+/* rendezvous pipeline, a longer gap between two fragments is a stall (ms) */
+static guint pref_pipe_stall = 1;
+
+/* first pass lookup state idle for longer is dropped (s, 0: keep it) */
+static guint pref_state_horizon = 0;
+
+/* every frame is dissected once (tshark without -2) */
+static gboolean pref_single_pass = FALSE;
+
 /* mpi_abort with 5 bytes */
 #define MPI_MIN_LENGTH 5 
 
@@ -65,6 +100,11 @@ static gint ett_mpi_ack = -1;
 static gint ett_mpi_rdma = -1;
 static gint ett_mpi_fin = -1;
 static gint ett_mpi_rndvrestartnotify = -1;
+static gint ett_mpi_xcast = -1;
+static gint ett_mpi_hb = -1;
+static gint ett_mpi_xfer = -1;
+static gint ett_mpi_channel = -1;
+static gint ett_mpi_tcp = -1;
 
 /* variables declaration */
 static int hf_mpi_jobid = -1;
@@ -108,6 +148,62 @@ static int hf_mpi_oob_orte_data_type = -1;
 static int hf_mpi_oob_uri = -1;
 static int hf_mpi_oob_nodename = -1;
 
+/* XCAST fan-out (generated) */
+static int hf_mpi_xcast_id = -1;
+static int hf_mpi_xcast_hop = -1;
+static int hf_mpi_xcast_first_in = -1;
+static int hf_mpi_xcast_parent_in = -1;
+static int hf_mpi_xcast_relay_time = -1;
+static int hf_mpi_xcast_time = -1;
+
+/* heartbeat (generated) */
+static int hf_mpi_hb_prev_in = -1;
+static int hf_mpi_hb_interval = -1;
+static int hf_mpi_hb_expected = -1;
+static int hf_mpi_hb_missed = -1;
+static int hf_mpi_hb_silent_vpid = -1;
+static int hf_mpi_hb_silent_last_in = -1;
+static int hf_mpi_hb_silence = -1;
+
+/* rendezvous transfer (generated) */
+static int hf_mpi_xfer_rndv_in = -1;
+static int hf_mpi_xfer_ack_in = -1;
+static int hf_mpi_xfer_end_in = -1;
+static int hf_mpi_xfer_bytes = -1;
+static int hf_mpi_xfer_frags = -1;
+static int hf_mpi_xfer_duration = -1;
+static int hf_mpi_xfer_bandwidth = -1;
+static int hf_mpi_xfer_index = -1;
+static int hf_mpi_xfer_depth = -1;
+static int hf_mpi_xfer_gap = -1;
+
+/* rank pair channel (generated) */
+static int hf_mpi_channel = -1;
+static int hf_mpi_channel_link = -1;
+static int hf_mpi_channel_links = -1;
+static int hf_mpi_channel_reordered = -1;
+
+/* TCP events (generated) */
+static int hf_mpi_tcp_retrans = -1;
+static int hf_mpi_tcp_dupacks = -1;
+static int hf_mpi_tcp_zero_windows = -1;
+static int hf_mpi_tcp_delay = -1;
+
+/* OOB stream loss (generated) */
+static int hf_mpi_oob_lost = -1;
+static int hf_mpi_oob_skipped = -1;
+static int hf_mpi_btl_skipped = -1;
+
+static expert_field ei_mpi_xcast_slow_relay = EI_INIT;
+static expert_field ei_mpi_hb_late = EI_INIT;
+static expert_field ei_mpi_xfer_stall = EI_INIT;
+static expert_field ei_mpi_channel_reordered = EI_INIT;
+static expert_field ei_mpi_hb_missing = EI_INIT;
+static expert_field ei_mpi_hb_failure = EI_INIT;
+static expert_field ei_mpi_oob_lost = EI_INIT;
+static expert_field ei_mpi_oob_resync = EI_INIT;
+static expert_field ei_mpi_btl_resync = EI_INIT;
+
 /* BTL base header */
 static int hf_mpi_base_hdr_base = -1;
 static int hf_mpi_base_hdr_type = -1;
@@ -174,77 +270,6 @@ static const value_string msgtypenames[] = {
     { 0, NULL }
 };
 
-/* rml_types.h */
-#define ORTE_RML_TAG_INVALID                 0
-#define ORTE_RML_TAG_DAEMON                  1
-#define ORTE_RML_TAG_IOF_HNP                 2
-#define ORTE_RML_TAG_IOF_PROXY               3
-#define ORTE_RML_TAG_XCAST_BARRIER           4
-#define ORTE_RML_TAG_PLM                     5
-#define ORTE_RML_TAG_PLM_PROXY               6
-#define ORTE_RML_TAG_ERRMGR                  7
-#define ORTE_RML_TAG_WIREUP                  8
-#define ORTE_RML_TAG_RML_INFO_UPDATE         9
-#define ORTE_RML_TAG_ORTED_CALLBACK         10
-#define ORTE_RML_TAG_ROLLUP                 11
-#define ORTE_RML_TAG_REPORT_REMOTE_LAUNCH   12
-#define ORTE_RML_TAG_CKPT                   13
-#define ORTE_RML_TAG_RML_ROUTE              14
-#define ORTE_RML_TAG_XCAST                  15
-
-#define ORTE_RML_TAG_UPDATE_ROUTE_ACK       19
-#define ORTE_RML_TAG_SYNC                   20
-/* For FileM Base */
-#define ORTE_RML_TAG_FILEM_BASE             21
-#define ORTE_RML_TAG_FILEM_BASE_RESP        22
-/* For FileM RSH Component */
-#define ORTE_RML_TAG_FILEM_RSH              23
-/* For SnapC Framework */
-#define ORTE_RML_TAG_SNAPC                  24
-#define ORTE_RML_TAG_SNAPC_FULL             25
-/* For tools */
-#define ORTE_RML_TAG_TOOL                   26
-/* support data store/lookup */
-#define ORTE_RML_TAG_DATA_SERVER            27
-#define ORTE_RML_TAG_DATA_CLIENT            28
-/* timing related */
-#define ORTE_RML_TAG_COLLECTIVE_TIMER       29
-/* collectives */
-#define ORTE_RML_TAG_COLLECTIVE             30
-#define ORTE_RML_TAG_COLL_ID                31
-#define ORTE_RML_TAG_DAEMON_COLL            32
-#define ORTE_RML_TAG_COLL_ID_REQ            33
-/* show help */
-#define ORTE_RML_TAG_SHOW_HELP              34
-/* debugger release */
-#define ORTE_RML_TAG_DEBUGGER_RELEASE       35
-/* bootstrap */
-#define ORTE_RML_TAG_BOOTSTRAP              36
-/* report a missed msg */
-#define ORTE_RML_TAG_MISSED_MSG             37
-/* tag for receiving ack of abort msg */
-#define ORTE_RML_TAG_ABORT                  38
-/* tag for receiving heartbeats */
-#define ORTE_RML_TAG_HEARTBEAT              39
-/* Process Migration Tool Tag */
-#define ORTE_RML_TAG_MIGRATE                40
-/* For SStore Framework */
-#define ORTE_RML_TAG_SSTORE                 41
-#define ORTE_RML_TAG_SSTORE_INTERNAL        42
-#define ORTE_RML_TAG_SUBSCRIBE              43
-/* Notify of failed processes */
-#define ORTE_RML_TAG_FAILURE_NOTICE         44
-/* distributed file system */
-#define ORTE_RML_TAG_DFS_CMD                45
-#define ORTE_RML_TAG_DFS_DATA               46
-/* sensor data */
-#define ORTE_RML_TAG_SENSOR_DATA            47
-/* direct modex support */
-#define ORTE_RML_TAG_DIRECT_MODEX           48
-#define ORTE_RML_TAG_DIRECT_MODEX_RESP      49
-
-#define ORTE_RML_TAG_MAX                   100
-
 static const value_string rmltagnames[] = {
     { ORTE_RML_TAG_INVALID, "Invalid" },
     { ORTE_RML_TAG_DAEMON, "Daemon" },
@@ -297,21 +322,6 @@ static const value_string rmltagnames[] = {
     { 0, NULL }
 };
 
-/* pml_ob1_hdr.h pml_bfo_hdr.h */
-#define MPI_PML_OB1_HDR_TYPE_MATCH 65
-#define MPI_PML_BFO_HDR_TYPE_RNDV 66
-#define MPI_PML_OB1_HDR_TYPE_RGET 67
-#define MPI_PML_OB1_HDR_TYPE_ACK 68
-#define MPI_PML_OB1_HDR_TYPE_NACK 69
-#define MPI_PML_OB1_HDR_TYPE_FRAG 70
-#define MPI_PML_OB1_HDR_TYPE_GET 71
-#define MPI_PML_OB1_HDR_TYPE_PUT 72
-#define MPI_PML_OB1_HDR_TYPE_FIN 73
-#define MPI_PML_BFO_HDR_TYPE_RNDVRESTARTNOTIFY 74
-#define MPI_PML_BFO_HDR_TYPE_RNDVRESTARTACK 75
-#define MPI_PML_BFO_HDR_TYPE_RNDVRESTARTNACK 76
-#define MPI_PML_BFO_HDR_TYPE_RECVERRNOTIFY 77
-
 static const value_string packetbasenames[] = {
     { MPI_PML_OB1_HDR_TYPE_MATCH, "MATCH" },
     { MPI_PML_BFO_HDR_TYPE_RNDV, "RNDV" },
@@ -344,43 +354,43 @@ static const value_string communicatornames[] = {
     { 0, NULL }
 };
 
-/* coll_tags.h */
+/* coll_tags.h, sorted by the unsigned value for the binary search */
 static const value_string colltagnames[] = {
-    { -10, "Allgather" },
-    { -11, "Allgetherv" },
-    { -12, "AllReduce" },
-    { -13, "Alltoall" },
-    { -14, "Alltoallv" },
-    { -15, "Alltoallw" },
-    { -16, "Barrier" },
-    { -17, "Bcast" },
-    { -18, "Exscan" },
-    { -19, "Gather" },
-    { -20, "Gatherv" },
-    { -21, "Reduce" },
-    { -22, "Reduce_scatter" },
-    { -23, "Scan" },
-    { -24, "Scatter" },
-    { -25, "Scatterv" },
-    { -26, "Nonblocking_base" },
-    { -32767, "Nonblocking_end" }, /* ((-1 * INT_MAX/2) + 1) */
-    { -32768, "Hcoll_base" }, /* (-1 * INT_MAX/2) */
     { -65535, "Hcoll_end" }, /* (-1 * INT_MAX) */
+    { -32768, "Hcoll_base" }, /* (-1 * INT_MAX/2) */
+    { -32767, "Nonblocking_end" }, /* ((-1 * INT_MAX/2) + 1) */
+    { -26, "Nonblocking_base" },
+    { -25, "Scatterv" },
+    { -24, "Scatter" },
+    { -23, "Scan" },
+    { -22, "Reduce_scatter" },
+    { -21, "Reduce" },
+    { -20, "Gatherv" },
+    { -19, "Gather" },
+    { -18, "Exscan" },
+    { -17, "Bcast" },
+    { -16, "Barrier" },
+    { -15, "Alltoallw" },
+    { -14, "Alltoallv" },
+    { -13, "Alltoall" },
+    { -12, "AllReduce" },
+    { -11, "Allgetherv" },
+    { -10, "Allgather" },
     { 0, NULL }
 };
 
+/* tables looked up for every frame, by index or by binary search */
+static value_string_ext rmltagnames_ext = VALUE_STRING_EXT_INIT(rmltagnames);
+static value_string_ext packetbasenames_ext = VALUE_STRING_EXT_INIT(packetbasenames);
+static value_string_ext packettypenames_ext = VALUE_STRING_EXT_INIT(packettypenames);
+static value_string_ext communicatornames_ext = VALUE_STRING_EXT_INIT(communicatornames);
+value_string_ext colltagnames_ext = VALUE_STRING_EXT_INIT(colltagnames);
+
 static const value_string paddingnames[] = {
     { 0, "heterogeneous support (maybe wrong!!)" },
     { 0, NULL }
 };
 
-/* iof_types.h */
-#define ORTE_IOF_STDIN      0x01
-#define ORTE_IOF_STDOUT     0x02
-#define ORTE_IOF_STDERR     0x04
-#define ORTE_IOF_STDDIAG    0x08
-#define ORTE_IOF_STDOUTALL  0x0e
-
 static const value_string ioftypenames[] = {
     { ORTE_IOF_STDIN, "STDIN" },
     { ORTE_IOF_STDOUT, "STDOUT" },
@@ -446,37 +456,6 @@ static const value_string ortedatatypenames[] = {
     { 0, NULL }
 };
 
-/* odls_types.h */
-#define ORTE_DAEMON_CONTACT_QUERY_CMD     1
-#define ORTE_DAEMON_KILL_LOCAL_PROCS      2
-#define ORTE_DAEMON_SIGNAL_LOCAL_PROCS    3
-#define ORTE_DAEMON_ADD_LOCAL_PROCS       4
-#define ORTE_DAEMON_TREE_SPAWN            5
-#define ORTE_DAEMON_HEARTBEAT_CMD         6
-#define ORTE_DAEMON_EXIT_CMD              7
-#define ORTE_DAEMON_PROCESS_AND_RELAY_CMD 9
-#define ORTE_DAEMON_MESSAGE_LOCAL_PROCS   10
-#define ORTE_DAEMON_NULL_CMD              11
-#define ORTE_DAEMON_SYNC_BY_PROC          12
-#define ORTE_DAEMON_SYNC_WANT_NIDMAP      13
-/* commands for use by tools */
-#define ORTE_DAEMON_REPORT_JOB_INFO_CMD   14
-#define ORTE_DAEMON_REPORT_NODE_INFO_CMD  15
-#define ORTE_DAEMON_REPORT_PROC_INFO_CMD  16
-#define ORTE_DAEMON_SPAWN_JOB_CMD         17
-#define ORTE_DAEMON_TERMINATE_JOB_CMD     18
-#define ORTE_DAEMON_HALT_VM_CMD           19
-/* request proc resource usage */
-#define ORTE_DAEMON_TOP_CMD               22
-/* bootstrap */
-#define ORTE_DAEMON_NAME_REQ_CMD          23
-#define ORTE_DAEMON_CHECKIN_CMD           24
-#define ORTE_TOOL_CHECKIN_CMD             25
-/* process msg command */
-#define ORTE_DAEMON_PROCESS_CMD           26
-/* process called "errmgr.abort_procs" */
-#define ORTE_DAEMON_ABORT_PROCS_CALLED    28
-
 static const value_string odlesdatatypenames[] = {
     { ORTE_DAEMON_CONTACT_QUERY_CMD, "Contact Query CMD" },
     { ORTE_DAEMON_KILL_LOCAL_PROCS, "Kill Local Procs" },
@@ -507,9 +486,28 @@ static const value_string odlesdatatypenames[] = {
 
 
 typedef struct _mpi_info_t {
-    wmem_tree_t *pdus;
+    conversation_t *conversation;
+    GPtrArray *syncs;       /* mpi_sync_trans_t in the order of the requests */
+    guint32 req_jobid;      /* process name of the sync request */
+    guint32 req_vpid;
+    guint32 req_port;       /* its tcp port */
+    struct _mpi_channel_t *channel; /* set with the sync response */
+    guint32 link;           /* number of this connection in the channel */
+    guint32 tcp_scanned;    /* frames up to this checked for TCP events */
+    nstime_t tcp_prev_time; /* the previous BTL PDU */
+    nstime_t last_time;     /* the previous sync or BTL PDU */
 } mpi_info_t;
 
+/* TCP trouble on the connection of a BTL PDU */
+typedef struct _mpi_tcp_events_t {
+    guint32 retrans;
+    guint32 dupacks;
+    guint32 zero_windows;
+    nstime_t delay;
+} mpi_tcp_events_t;
+
+#define MPI_TCP_EVENTS(ev) ((ev)->retrans + (ev)->dupacks + (ev)->zero_windows)
+
 typedef struct _mpi_sync_trans_t {
     guint32 jobid;
     guint32 vpid;
@@ -518,33 +516,420 @@ typedef struct _mpi_sync_trans_t {
     nstime_t req_time;
 } mpi_sync_trans_t;
 
+typedef struct _mpi_oob_name_t {
+    guint32 jobid;
+    guint32 vpid;
+} mpi_oob_name_t;
+
+/*
+ * The BTL TCP connections (btl_tcp_links) between one pair of processes.
+ * Every connection starts with a sync handshake naming both processes.
+ */
+typedef struct _mpi_channel_t {
+    guint32 id;
+    mpi_oob_name_t names[2];    /* the lower name first, hash key */
+    guint32 links;
+    GHashTable *seqs[2];        /* per sender: ctx -> mpi_channel_seq_t */
+    nstime_t last_time;         /* the previous PDU on any of the links */
+} mpi_channel_t;
+
+/* MATCH sequence numbers of one communicator and direction */
+typedef struct _mpi_channel_seq_t {
+    guint16 next;
+    guint32 frame;              /* of the highest number */
+    guint32 link;
+} mpi_channel_seq_t;
+
+/* the channel of a BTL PDU */
+typedef struct _mpi_channel_pdu_t {
+    mpi_channel_t *channel;
+    guint32 link;
+    guint32 links;              /* of the channel when the PDU was first seen */
+    guint8 sender;              /* index of the sending process in names */
+    guint32 reordered_after;    /* frame of a higher sequence number, or 0 */
+    guint16 reordered_seq;
+    guint32 reordered_link;
+} mpi_channel_pdu_t;
+
 typedef struct _mpi_oob_trans_t {
     guint32 rml_tag_1;
     guint32 nbytes_1;
+    guint32 msglen_1;
+    mpi_oob_name_t origin_1;
+    mpi_oob_name_t dst_1;
     guint32 rml_tag_2;
     guint32 nbytes_2;
+    guint32 msglen_2;
+    mpi_oob_name_t origin_2;
+    mpi_oob_name_t dst_2;
+    guint32 nextseq_1;      /* TCP sequence number after the last frame */
+    gboolean seq_known_1;
+    gboolean resync_1;      /* header boundary lost, search the next one */
+    guint32 nextseq_2;
+    gboolean seq_known_2;
+    gboolean resync_2;
     GHashTable *old;
+    conversation_t *conversation;
+    nstime_t last_time;
 } mpi_oob_trans_t;
 
 typedef struct _mpi_oob_old_t {
     guint32 rml_tag;
     guint32 nbytes;
+    guint32 msglen;
+    mpi_oob_name_t origin;
+    mpi_oob_name_t dst;
+    gboolean resync;
+    guint32 lost;           /* bytes missing before the frame */
 } mpi_oob_old_t;
 
+/* bytes searched for an OOB header after a loss, per frame */
+#define MPI_OOB_RESYNC_WINDOW 4096
+/* sanity limits of an OOB header, the RML tags from ORTE_RML_TAG_MAX on
+ * are handed out at run time */
+#define MPI_OOB_MAX_TAG 0xffff
+#define MPI_OOB_MAX_NBYTES (64 * 1024 * 1024)
+#define MPI_OOB_MAX_VPID (1 << 24)
+#define MPI_OOB_HDR_LEN 28
+
+/* a process, not an invalid or wildcard name: the upper 16 bits of an ORTE
+ * jobid are the job family, a hash that is not 0 */
+#define MPI_OOB_NAME_VALID(jobid, vpid) \
+    (0 != ((jobid) >> 16) && 0xfffffffe > (jobid) && MPI_OOB_MAX_VPID > (vpid))
+
+/* One XCAST, i.e. the same buffer relayed down the routing tree. The
+ * daemons are identified by their vpid, all of them share the jobid. */
+typedef struct _mpi_xcast_t {
+    guint64 key;            /* leading bytes hash << 32 | length */
+    guint32 id;
+    guint32 first_frame;
+    nstime_t first_time;    /* the root sent it */
+    nstime_t last_time;     /* latest relay */
+    mpi_oob_name_t root;
+    GHashTable *reached;    /* vpid -> mpi_xcast_hop_t it was received with */
+    struct _mpi_xcast_t *prev;  /* replaced by this one, two passes only */
+} mpi_xcast_t;
+
+/* One delivery of a XCAST from a daemon to its child */
+typedef struct _mpi_xcast_hop_t {
+    mpi_xcast_t *xcast;
+    guint32 frame;
+    nstime_t abs_ts;
+    guint32 hop;            /* 1 for the children of the root */
+    guint32 parent_in;      /* the relaying daemon received it, 0 for the root */
+    nstime_t relay_time;    /* parent_in until this delivery */
+    nstime_t time;          /* root until this delivery */
+} mpi_xcast_hop_t;
+
+/* Heartbeats of a daemon */
+typedef struct _mpi_hb_daemon_t {
+    guint64 key;            /* jobid << 32 | vpid */
+    mpi_oob_name_t name;
+    guint32 last_frame;
+    nstime_t last_time;
+    guint32 intervals;      /* regular ones, used to learn the rate */
+    gdouble mean;           /* learned interval (ms) */
+} mpi_hb_daemon_t;
+
+/* One heartbeat */
+typedef struct _mpi_hb_t {
+    guint32 prev_in;        /* 0 for the first one of the daemon */
+    nstime_t interval;
+    gdouble expected;       /* ms, 0 while unknown */
+    guint32 missed;         /* beats missing before this one */
+    gboolean late;          /* later than the jitter allows */
+} mpi_hb_t;
+
+/* A failure notice or abort and the daemon silent for the longest time */
+typedef struct _mpi_hb_failure_t {
+    mpi_oob_name_t silent;
+    guint32 last_in;        /* 0 if no heartbeat was seen at all */
+    nstime_t silence;
+    gdouble expected;
+} mpi_hb_failure_t;
+
+/* A rendezvous transfer: RNDV (or RGET), an ACK, FRAGs or PUTs and a FIN */
+typedef struct _mpi_xfer_key_t {
+    guint64 ptr;            /* send request or descriptor */
+    guint32 owner;          /* hash of the name or TCP endpoint of the owner */
+} mpi_xfer_key_t;
+
+typedef struct _mpi_xfer_t {
+    mpi_xfer_key_t req;     /* the send request */
+    guint64 msg_len;
+    guint32 rndv_frame;
+    nstime_t rndv_time;
+    guint32 ack_frame;      /* 0 if no ACK was seen */
+    guint64 done;           /* bytes of the RNDV, the FRAGs and the finished PUTs */
+    guint32 frags;
+    guint32 dess;           /* descriptors in mpi_xfer_dess */
+    guint32 depth;          /* PUTs without FIN */
+    nstime_t last_time;     /* the previous FRAG, PUT or FIN */
+    guint32 end_frame;      /* 0 while not finished */
+    nstime_t duration;
+    mpi_tcp_events_t tcp;   /* on the links of the PDUs after the RNDV */
+} mpi_xfer_t;
+
+/* a descriptor handed out by a PUT or RGET, returned by the FIN */
+typedef struct _mpi_xfer_des_t {
+    mpi_xfer_t *xfer;
+    guint64 len;            /* bytes finished by the FIN */
+    gboolean put;
+} mpi_xfer_des_t;
+
+/* the pipeline state at one PDU of a transfer */
+typedef struct _mpi_xfer_frame_t {
+    mpi_xfer_t *xfer;
+    guint32 index;          /* number of the FRAG or PUT, else 0 */
+    guint32 depth;          /* PUTs in flight after this PDU */
+    nstime_t gap;           /* since the previous PDU of the transfer */
+    gboolean stall;         /* gap too long or the PUT pipeline drained */
+} mpi_xfer_frame_t;
+
+/* per frame data (p_add_proto_data), a frame can hold a few PDUs */
+#define MPI_PDATA_XCAST             1
+#define MPI_PDATA_HEARTBEAT         2
+#define MPI_PDATA_FAILURE           3
+#define MPI_PDATA_XFER              4
+#define MPI_PDATA_CHANNEL           5
+#define MPI_PDATA_TCP               6
+#define MPI_PDATA_KEY(kind, offset) (((guint32)(offset) << 4) | (kind))
+
+/* leading message bytes to identify the relays of a XCAST */
+#define MPI_XCAST_HASH_LEN 64
+
+/* (hash, length) -> latest mpi_xcast_t, reset for every capture file */
+static GHashTable *mpi_xcasts = NULL;
+static guint32 mpi_xcast_count = 0;
+
+/* (jobid, vpid) -> mpi_hb_daemon_t, reset for every capture file */
+static GHashTable *mpi_hb_daemons = NULL;
+
+/* (jobid, vpid, jobid, vpid) -> mpi_channel_t, reset for every capture file */
+static GHashTable *mpi_channels = NULL;
+static guint32 mpi_channel_count = 0;
+
+/* BTL connections: mpi_info_t -> its conversation_t, reset for every
+ * capture file */
+static GHashTable *mpi_infos = NULL;
+
+/* open rendezvous transfers, reset for every capture file */
+static GHashTable *mpi_xfer_reqs = NULL;    /* send request -> mpi_xfer_t */
+static GHashTable *mpi_xfer_dess = NULL;    /* descriptor -> mpi_xfer_des_t */
+
+/* message keys -> frames, filled in the first pass, sorted for a lookup */
+typedef struct _mpi_msg_key_t {
+    guint16 ctx;
+    guint16 seq;
+    gint32 src;
+    gint32 tag;
+    guint32 jobid;          /* of the sender, 0 if the channel is unknown */
+    gint32 dst;             /* vpid of the receiver, -1 if unknown */
+    guint32 frame;
+} mpi_msg_key_t;
+
+typedef struct _mpi_req_key_t {
+    guint64 req;
+    guint32 jobid;          /* owner of the send request, 0 if unknown */
+    gint32 vpid;            /* -1 if unknown */
+    guint32 frame;
+} mpi_req_key_t;
+
+/* reset for every capture file */
+static GArray *mpi_msg_keys = NULL;     /* mpi_msg_key_t */
+static gboolean mpi_msg_keys_sorted = TRUE;
+static GArray *mpi_req_keys = NULL;     /* mpi_req_key_t */
+static gboolean mpi_req_keys_sorted = TRUE;
+
+/* OOB conversations: mpi_oob_trans_t -> its conversation_t, reset for
+ * every capture file */
+static GHashTable *mpi_oob_transs = NULL;
+
+/* a listening OOB endpoint, IPv4 addresses use the first 4 bytes */
+typedef struct _mpi_oob_ep_t {
+    guint8 addr[16];
+    guint16 port;
+    guint16 len;
+} mpi_oob_ep_t;
+
+/* learned from the ORTED callbacks and the IDENTs (mpi_oob_ep_t -> frame),
+ * reset for every capture file */
+static GHashTable *mpi_oob_eps = NULL;
+static guint32 mpi_oob_eps_frame = 0;   /* of the first callback */
+
+/* eviction (pref_state_horizon), reset for every capture file */
+static gboolean mpi_evict_started = FALSE;
+static nstime_t mpi_evict_time;         /* of the previous sweep */
+static guint32 mpi_evict_frame = 0;     /* first frame after it */
+static mpi_state_stats_t mpi_evict_stats;
+
+/* a learned rate needs a few intervals */
+#define MPI_HB_LEARN_MIN 3
+#define MPI_HB_LEARN_MAX 16
+
 /* data handler */
 /* static dissector_handle_t data_handle; */
 /* static dissector_handle_t mpi_sync_handler; */
 
+/*
+ * The per frame data is read back when a frame is dissected again. A single
+ * pass (mpi.single_pass) does not come back, the data of a frame is used by
+ * its dissection only and is not attached to it.
+ */
+static void *
+mpi_frame_alloc(size_t size)
+{
+    return pref_single_pass ? wmem_alloc0(wmem_packet_scope(), size) :
+        wmem_alloc0(wmem_file_scope(), size);
+}
+
+static void
+mpi_frame_add(packet_info *pinfo, guint32 key, void *data)
+{
+    if (!pref_single_pass) {
+        p_add_proto_data(wmem_file_scope(), pinfo, proto_mpi, key, data);
+    }
+}
+
+/* the name of a value, unknown values are printed into the caller's
+ * buffer instead of the packet scope like val_to_str() does */
+#define MPI_NAME_LEN 32
+
+static const gchar *
+mpi_val_to_str(guint32 val, value_string_ext *vse, const char *fmt,
+        gchar *buf)
+{
+    const gchar *name;
+
+    name = try_val_to_str_ext(val, vse);
+    if (name) {
+        return name;
+    }
+    g_snprintf(buf, MPI_NAME_LEN, fmt, val);
+    return buf;
+}
+
+/* FNV-1a */
+static guint32
+mpi_fnv1a(const guint8 *data, guint32 len)
+{
+    guint32 hash = 2166136261U;
+    guint32 i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/* the state of a BTL connection, kept with its conversation */
+static mpi_info_t *
+mpi_info_new(conversation_t *conversation)
+{
+    mpi_info_t *mpi_info;
+
+    mpi_info = g_new0(mpi_info_t, 1);
+    mpi_info->conversation = conversation;
+    mpi_info->syncs = g_ptr_array_new_with_free_func(g_free);
+    conversation_add_proto_data(conversation, proto_mpi, mpi_info);
+    g_hash_table_insert(mpi_infos, mpi_info, mpi_info);
+    return mpi_info;
+}
+
+static void
+mpi_info_free(gpointer data)
+{
+    mpi_info_t *mpi_info = (mpi_info_t *)data;
+
+    g_ptr_array_free(mpi_info->syncs, TRUE);
+    g_free(mpi_info);
+}
+
+/* a channel is in use as long as one of its links is */
+static void
+mpi_info_touch(mpi_info_t *mpi_info, const nstime_t *ts)
+{
+    mpi_info->last_time = *ts;
+    if (mpi_info->channel) {
+        mpi_info->channel->last_time = *ts;
+    }
+}
+
+/* the latest sync request of the process up to the frame */
+static mpi_sync_trans_t *
+mpi_sync_lookup(const mpi_info_t *mpi_info, guint32 jobid, guint32 frame)
+{
+    mpi_sync_trans_t *mpi_sync_trans;
+    guint i;
+
+    for (i = mpi_info->syncs->len; i > 0; i--) {
+        mpi_sync_trans = (mpi_sync_trans_t *)
+            g_ptr_array_index(mpi_info->syncs, i - 1);
+        if (mpi_sync_trans->req_frame <= frame &&
+                mpi_sync_trans->jobid == jobid) {
+            return mpi_sync_trans;
+        }
+    }
+    return NULL;
+}
+
 static guint
-address_hash_func(gconstpointer v)
+mpi_channel_hash(gconstpointer v)
 {
-  return GPOINTER_TO_UINT(v);
+    return mpi_fnv1a((const guint8 *)v, 2 * sizeof(mpi_oob_name_t));
 }
 
-static gint
-address_equal_func(gconstpointer v, gconstpointer v2)
+static gboolean
+mpi_channel_equal(gconstpointer v, gconstpointer v2)
+{
+    return 0 == memcmp(v, v2, 2 * sizeof(mpi_oob_name_t));
+}
+
+static void
+mpi_channel_free(gpointer data)
+{
+    mpi_channel_t *channel = (mpi_channel_t *)data;
+
+    g_hash_table_destroy(channel->seqs[0]);
+    g_hash_table_destroy(channel->seqs[1]);
+    g_free(channel);
+}
+
+/* add the connection of a finished sync handshake to its channel */
+static void
+mpi_channel_join(mpi_info_t *mpi_info, guint32 jobid, guint32 vpid)
 {
-  return v == v2;
+    mpi_channel_t *channel;
+    mpi_oob_name_t names[2];
+
+    if (jobid < mpi_info->req_jobid ||
+            (jobid == mpi_info->req_jobid && vpid < mpi_info->req_vpid)) {
+        names[0].jobid = jobid;
+        names[0].vpid = vpid;
+        names[1].jobid = mpi_info->req_jobid;
+        names[1].vpid = mpi_info->req_vpid;
+    } else {
+        names[0].jobid = mpi_info->req_jobid;
+        names[0].vpid = mpi_info->req_vpid;
+        names[1].jobid = jobid;
+        names[1].vpid = vpid;
+    }
+
+    channel = (mpi_channel_t *)g_hash_table_lookup(mpi_channels, names);
+    if (!channel) {
+        channel = g_new0(mpi_channel_t, 1);
+        channel->id = ++mpi_channel_count;
+        channel->names[0] = names[0];
+        channel->names[1] = names[1];
+        channel->seqs[0] = g_hash_table_new_full(g_direct_hash,
+                g_direct_equal, NULL, g_free);
+        channel->seqs[1] = g_hash_table_new_full(g_direct_hash,
+                g_direct_equal, NULL, g_free);
+        g_hash_table_insert(mpi_channels, channel->names, channel);
+    }
+    mpi_info->channel = channel;
+    mpi_info->link = ++channel->links;
 }
 
 static int
@@ -557,8 +942,9 @@ dissect_mpi_sync(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
     conversation_t *conversation;
     mpi_info_t *mpi_info;
     mpi_sync_trans_t *mpi_sync_trans;
+    mpi_tap_info_t *mpi_tap_info;
+    struct tcp_analysis *tcpd;
     gboolean is_request;
-    wmem_tree_key_t key[3];
 
     if (8 != tvb_captured_length(tvb) - the_offset) {
         return the_offset;
@@ -582,46 +968,42 @@ dissect_mpi_sync(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
         conversation_get_proto_data(conversation, proto_mpi);
     /* create conversation data if this not exist */
     if (!mpi_info) {
-        mpi_info = wmem_new(wmem_file_scope(), mpi_info_t);
-        mpi_info->pdus = wmem_tree_new(wmem_file_scope());
-        conversation_add_proto_data(conversation, proto_mpi, mpi_info);
+        mpi_info = mpi_info_new(conversation);
         is_request = TRUE; /* determine the request temporairily */
     } else {
         is_request = FALSE;
     }
 
-    key[0].length = 1;
-    key[0].key = &jobid;
-    key[1].length = 1;
-    key[1].key = &pinfo->fd->num;
-    key[2].length = 0;
-    key[2].key = NULL;
-
     /* fill the mpi_sync_trans struct only the first time */
     if (!pinfo->fd->flags.visited) {
+        mpi_info_touch(mpi_info, &pinfo->fd->abs_ts);
         if (is_request) {
-            mpi_sync_trans = wmem_new(wmem_file_scope(), mpi_sync_trans_t);
+            mpi_sync_trans = g_new(mpi_sync_trans_t, 1);
             mpi_sync_trans->jobid = jobid;
             mpi_sync_trans->vpid = vpid;
             mpi_sync_trans->req_frame = pinfo->fd->num;
             mpi_sync_trans->rep_frame = 0;
             mpi_sync_trans->req_time = pinfo->fd->abs_ts;
-            wmem_tree_insert32_array(mpi_info->pdus, key,
-                    (void *)mpi_sync_trans);
+            g_ptr_array_add(mpi_info->syncs, mpi_sync_trans);
+            mpi_info->req_jobid = jobid;
+            mpi_info->req_vpid = vpid;
+            mpi_info->req_port = pinfo->srcport;
         } else {
-            mpi_sync_trans = (mpi_sync_trans_t *)
-                wmem_tree_lookup32_array_le(mpi_info->pdus, key);
+            mpi_sync_trans = mpi_sync_lookup(mpi_info, jobid, pinfo->fd->num);
             if (mpi_sync_trans) {
                 if (mpi_sync_trans->jobid != jobid) {
                     mpi_sync_trans = NULL;
                 } else {
                     mpi_sync_trans->rep_frame = pinfo->fd->num;
+                    if (!mpi_info->channel) {
+                        mpi_channel_join(mpi_info, jobid, vpid);
+                        mpi_info_touch(mpi_info, &pinfo->fd->abs_ts);
+                    }
                 }
             }
         }
     } else {
-        mpi_sync_trans = (mpi_sync_trans_t *)
-                wmem_tree_lookup32_array_le(mpi_info->pdus, key);
+        mpi_sync_trans = mpi_sync_lookup(mpi_info, jobid, pinfo->fd->num);
         if (mpi_sync_trans) {
             if (mpi_sync_trans->jobid != jobid) {
                 mpi_sync_trans = NULL;
@@ -689,6 +1071,20 @@ dissect_mpi_sync(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
         proto_tree_add_item(mpi_tree, hf_mpi_vpid, tvb, 4, 4, ENC_BIG_ENDIAN);
     }
 
+    /* tap the handshake, the connection setup statistic needs the time
+     * of the first tcp segment (normally the SYN) too */
+    tcpd = get_tcp_conversation_data(conversation, pinfo);
+    mpi_tap_info = wmem_new0(wmem_packet_scope(), mpi_tap_info_t);
+    mpi_tap_info->kind = MPI_PDU_SYNC;
+    mpi_tap_info->stream = tcpd->stream;
+    mpi_tap_info->jobid = jobid;
+    mpi_tap_info->vpid = vpid;
+    mpi_tap_info->is_request = is_request;
+    mpi_tap_info->req_frame = mpi_sync_trans->req_frame;
+    mpi_tap_info->req_time = mpi_sync_trans->req_time;
+    mpi_tap_info->conn_start = tcpd->ts_first;
+    tap_queue_packet(mpi_tap, pinfo, mpi_tap_info);
+
     return tvb_captured_length(tvb);
 }
 
@@ -758,144 +1154,707 @@ dissect_mpi_oob_name(tvbuff_t *tvb, proto_tree *tree, guint offset, gboolean deb
     return offset;
 }
 
-
-static int
-dissect_mpi_oob(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset)
+static guint
+mpi_oob_ep_hash(gconstpointer v)
 {
-    proto_item *ti = NULL;
-    proto_tree *mpi_tree = NULL;
-    proto_tree *mpi_oob_tree = NULL;
-    conversation_t *conversation;
-    void *conv_data;
-    mpi_oob_trans_t *mpi_oob_trans;
-    guint offset;
-    guint32 jobid_origin;
-    guint32 vpid_origin;
-    guint32 jobid_dst;
-    guint32 vpid_dst;
-    guint32 msg_type;
-    guint32 rml_tag;
-    guint32 nbytes;
-    mpi_oob_old_t *value = NULL;
-    /* invalid */
-    int vers_len;
-    int cred_len;
-    const guint8 *version;
-    const guint8 *credential;
-    /* iof */
-    guint8 fully_des;
-    guint8 iof_type;
-    guint32 jobid;
-    guint32 vpid;
-    /* orte callback */
-    int uri_len;
-    int nodename_len;
-    const guint8 *uri;
-    const guint8 *nodename;
-    guint32 hwloc_len;
-    /* xcast */
-    guint8 odles;
+    return mpi_fnv1a((const guint8 *)v, sizeof(mpi_oob_ep_t));
+}
 
-    offset = 0;
+static gboolean
+mpi_oob_ep_equal(gconstpointer v, gconstpointer v2)
+{
+    return 0 == memcmp(v, v2, sizeof(mpi_oob_ep_t));
+}
 
-    if (!(32768 <= pinfo->srcport && MAX_TCP_PORT >= pinfo->srcport &&
-            32768 <= pinfo->destport && MAX_TCP_PORT >= pinfo->destport)) {
-        return the_offset;
+static gboolean
+mpi_oob_ep_set(mpi_oob_ep_t *ep, const address *addr, guint32 port)
+{
+    memset(ep, 0, sizeof(*ep));
+    if ((AT_IPv4 != addr->type && AT_IPv6 != addr->type) ||
+            (int)sizeof(ep->addr) < addr->len) {
+        return FALSE;
     }
+    memcpy(ep->addr, addr->data, addr->len);
+    ep->len = (guint16)addr->len;
+    ep->port = (guint16)port;
+    return TRUE;
+}
 
-    if (MPI_DEBUG)
-        g_print("%d dissect_mpi_oob, reported_length: %d, offset: %d, tree: %s\n",
-                pinfo->fd->num, tvb_reported_length(tvb), the_offset,
-                tree ? "true":"false");
+static void
+mpi_oob_ep_add(const mpi_oob_ep_t *ep, guint32 frame)
+{
+    if (!g_hash_table_lookup(mpi_oob_eps, ep)) {
+        g_hash_table_insert(mpi_oob_eps, g_memdup(ep, sizeof(*ep)),
+                GUINT_TO_POINTER(frame));
+    }
+}
 
-    col_set_str(pinfo->cinfo, COL_PROTOCOL, "MPI");
-    col_clear(pinfo->cinfo,COL_INFO);
+/* a listener learned before "frame" */
+static gboolean
+mpi_oob_ep_known(const address *addr, guint32 port, guint32 frame)
+{
+    mpi_oob_ep_t ep;
+    guint32 learned;
 
-    col_add_fstr(pinfo->cinfo, COL_INFO, "%d\xe2\x86\x92%d [OOB]",
-            pinfo->srcport, pinfo->destport);
-    if (tree) {
-        ti = proto_tree_add_item(tree, proto_mpi, tvb, 0, -1, ENC_NA);
-        mpi_tree = proto_item_add_subtree(ti, ett_mpi);
+    if (!mpi_oob_ep_set(&ep, addr, port)) {
+        return FALSE;
     }
+    learned = GPOINTER_TO_UINT(g_hash_table_lookup(mpi_oob_eps, &ep));
+    return learned && learned < frame;
+}
 
-    conversation = find_conversation(pinfo->fd->num, &pinfo->src, &pinfo->dst,
-            pinfo->ptype, pinfo->srcport, pinfo->destport, 0);
+/*
+ * The RML URI of a daemon lists its OOB listeners:
+ * "jobid.vpid;tcp://addr,addr:port;tcp6://[addr]:port". The callback is
+ * sent to the listener of the HNP, the receiver is added as well. Only
+ * address literals are taken, a name lookup may block the dissection.
+ */
+static void
+mpi_oob_learn(packet_info *pinfo, const guint8 *uri)
+{
+    mpi_oob_ep_t ep;
+    gchar **parts;
+    gchar **hosts;
+    gchar *contact;
+    gchar *colon;
+    gchar *host;
+    guint port;
+    guint i;
+    guint j;
 
-    if (!conversation) {
-        conversation = conversation_new(pinfo->fd->num, &pinfo->src,
-                &pinfo->dst, pinfo->ptype, pinfo->srcport, pinfo->destport, 0);
+    if (pinfo->fd->flags.visited) {
+        return;
     }
-    conv_data = conversation_get_proto_data(conversation, proto_mpi);
-    if (conv_data) {
-        mpi_oob_trans = (mpi_oob_trans_t *)conv_data;
-    } else {
-        if (28 > tvb_captured_length(tvb) - the_offset) {
-            g_print("%d start new conversation without a header?\n",
-                    pinfo->fd->num);
-            return the_offset;
+    if (!mpi_oob_eps_frame) {
+        mpi_oob_eps_frame = pinfo->fd->num;
+    }
+    if (mpi_oob_ep_set(&ep, &pinfo->dst, pinfo->destport)) {
+        mpi_oob_ep_add(&ep, pinfo->fd->num);
+    }
+    if (!uri) {
+        return;
+    }
+
+    parts = g_strsplit((const gchar *)uri, ";", 0);
+    for (i = 0; parts[i]; i++) {
+        if (g_str_has_prefix(parts[i], "tcp://")) {
+            contact = parts[i] + 6;
+        } else if (g_str_has_prefix(parts[i], "tcp6://")) {
+            contact = parts[i] + 7;
+        } else {
+            continue;
+        }
+        colon = strrchr(contact, ':');
+        if (!colon || 1 != sscanf(colon + 1, "%u", &port) ||
+                MAX_TCP_PORT < port) {
+            continue;
+        }
+        *colon = '\0';
+        hosts = g_strsplit(contact, ",", 0);
+        for (j = 0; hosts[j]; j++) {
+            host = g_strstrip(hosts[j]);
+            memset(&ep, 0, sizeof(ep));
+            if ('[' == host[0]) {
+                host++;
+                if (strchr(host, ']')) {
+                    *strchr(host, ']') = '\0';
+                }
+            }
+            if (strchr(host, ':')) {
+                if (1 != inet_pton(AF_INET6, host, ep.addr)) {
+                    continue;
+                }
+                ep.len = 16;
+            } else {
+                if (1 != inet_pton(AF_INET, host, ep.addr)) {
+                    continue;
+                }
+                ep.len = 4;
+            }
+            ep.port = (guint16)port;
+            mpi_oob_ep_add(&ep, pinfo->fd->num);
         }
-        mpi_oob_trans = (mpi_oob_trans_t *)
-                wmem_alloc0(wmem_file_scope(), sizeof(mpi_oob_trans_t));
+        g_strfreev(hosts);
+    }
+    g_strfreev(parts);
+}
 
-        mpi_oob_trans->rml_tag_1 = 0;
-        mpi_oob_trans->nbytes_1 = 0;
-        mpi_oob_trans->rml_tag_2 = 0;
-        mpi_oob_trans->nbytes_2 = 0;
-        mpi_oob_trans->old = g_hash_table_new(address_hash_func,
-                address_equal_func);
+/* a XCAST, its hops and the XCASTs it replaced */
+static void
+mpi_xcast_free(gpointer data)
+{
+    mpi_xcast_t *xcast = (mpi_xcast_t *)data;
+    mpi_xcast_t *prev;
+
+    while (xcast) {
+        prev = xcast->prev;
+        g_hash_table_destroy(xcast->reached);
+        g_free(xcast);
+        xcast = prev;
+    }
+}
 
-        conversation_add_proto_data(conversation, proto_mpi,
-                (void *)mpi_oob_trans);
+/*
+ * A XCAST is relayed daemon by daemon down the routing tree with the
+ * same buffer, so the leading message bytes and the length identify it.
+ * A delivery belongs to the latest XCAST with these bytes if the sender
+ * is its root or received it itself before, otherwise a new XCAST starts.
+ */
+static mpi_xcast_hop_t *
+mpi_xcast_correlate(tvbuff_t *tvb, packet_info *pinfo, guint offset,
+        guint32 msglen, mpi_oob_name_t *origin, mpi_oob_name_t *dst)
+{
+    mpi_xcast_t *xcast;
+    mpi_xcast_t *replaced = NULL;
+    mpi_xcast_hop_t *hop;
+    mpi_xcast_hop_t *parent = NULL;
+    guint64 key;
+    guint32 len;
+    nstime_t age;
+
+    if (pinfo->fd->flags.visited) {
+        return (mpi_xcast_hop_t *)p_get_proto_data(wmem_file_scope(), pinfo,
+                proto_mpi, MPI_PDATA_KEY(MPI_PDATA_XCAST, offset));
     }
 
-    value = (mpi_oob_old_t *)
-            g_hash_table_lookup(mpi_oob_trans->old, &pinfo->fd->num);
-    if (NULL == value) {
-        value = (mpi_oob_old_t *)
-                wmem_alloc0(wmem_file_scope(), sizeof(mpi_oob_old_t));
-        value->rml_tag = 0;
-        value->nbytes = 0;
-        g_hash_table_insert(mpi_oob_trans->old, &pinfo->fd->num, value);
+    len = MIN(msglen, MPI_XCAST_HASH_LEN);
+    if (0 == len || tvb_captured_length_remaining(tvb, offset) < (gint)len) {
+        return NULL;
     }
 
-    /* (re)store the old values */
-    if (pinfo->fd->flags.visited) {
-        if (pinfo->srcport > pinfo->destport) {
-            mpi_oob_trans->rml_tag_1 = value->rml_tag;
-            mpi_oob_trans->nbytes_1 = value->nbytes;
-        } else {
-            mpi_oob_trans->rml_tag_2 = value->rml_tag;
-            mpi_oob_trans->nbytes_2 = value->nbytes;
+    key = ((guint64)mpi_fnv1a(tvb_get_ptr(tvb, offset, len), len) << 32) |
+        msglen;
+
+    xcast = (mpi_xcast_t *)g_hash_table_lookup(mpi_xcasts, &key);
+    if (xcast) {
+        parent = (mpi_xcast_hop_t *)g_hash_table_lookup(xcast->reached,
+                GUINT_TO_POINTER(origin->vpid));
+        nstime_delta(&age, &pinfo->fd->abs_ts, &xcast->last_time);
+        if (nstime_to_msec(&age) > pref_xcast_window ||
+                g_hash_table_lookup(xcast->reached,
+                    GUINT_TO_POINTER(dst->vpid)) ||
+                (!parent && origin->vpid != xcast->root.vpid)) {
+            /* the same command once more */
+            replaced = xcast;
+            xcast = NULL;
+            parent = NULL;
         }
-        /* g_print("%d reload rml_tag: %d, nbytes: %d\n", pinfo->fd->num, value->rml_tag, value->nbytes); */
-    } else {
-        if (pinfo->srcport > pinfo->destport) {
-            value->rml_tag = mpi_oob_trans->rml_tag_1;
-            value->nbytes = mpi_oob_trans->nbytes_1;
-        } else {
-            value->rml_tag = mpi_oob_trans->rml_tag_2;
-            value->nbytes = mpi_oob_trans->nbytes_2;
+    }
+    if (!xcast) {
+        xcast = g_new(mpi_xcast_t, 1);
+        xcast->key = key;
+        xcast->id = ++mpi_xcast_count;
+        xcast->first_frame = pinfo->fd->num;
+        xcast->first_time = pinfo->fd->abs_ts;
+        xcast->root = *origin;
+        xcast->reached = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                NULL, g_free);
+        xcast->prev = NULL;
+        if (replaced) {
+            /* the hops of the frames point to the replaced one */
+            g_hash_table_steal(mpi_xcasts, &key);
+            if (pref_single_pass) {
+                mpi_xcast_free(replaced);
+            } else {
+                xcast->prev = replaced;
+            }
         }
-        /* g_print("%d store rml_tag: %d, nbytes: %d\n", pinfo->fd->num, value->rml_tag, value->nbytes); */
+        g_hash_table_insert(mpi_xcasts, &xcast->key, xcast);
     }
+    xcast->last_time = pinfo->fd->abs_ts;
+
+    hop = g_new(mpi_xcast_hop_t, 1);
+    hop->xcast = xcast;
+    hop->frame = pinfo->fd->num;
+    hop->abs_ts = pinfo->fd->abs_ts;
+    if (parent) {
+        hop->hop = parent->hop + 1;
+        hop->parent_in = parent->frame;
+        nstime_delta(&hop->relay_time, &pinfo->fd->abs_ts, &parent->abs_ts);
+    } else {
+        hop->hop = 1;
+        hop->parent_in = 0;
+        nstime_set_zero(&hop->relay_time);
+    }
+    nstime_delta(&hop->time, &pinfo->fd->abs_ts, &xcast->first_time);
+    g_hash_table_insert(xcast->reached, GUINT_TO_POINTER(dst->vpid), hop);
 
+    mpi_frame_add(pinfo, MPI_PDATA_KEY(MPI_PDATA_XCAST, offset), hop);
 
-    while (tvb_captured_length(tvb) > the_offset) {
-
-        offset = the_offset;
+    return hop;
+}
+
+static gdouble
+mpi_hb_expected(const mpi_hb_daemon_t *daemon)
+{
+    if (pref_heartbeat_rate) {
+        return pref_heartbeat_rate;
+    }
+    return MPI_HB_LEARN_MIN <= daemon->intervals ? daemon->mean : 0;
+}
+
+/*
+ * Heartbeats are sent by every daemon in a fixed rate. The interval to the
+ * previous beat is compared with the rate (the preference or the mean of
+ * the regular intervals seen so far): a multiple of it means missing beats,
+ * more than the jitter allows a late one.
+ */
+static mpi_hb_t *
+mpi_heartbeat(packet_info *pinfo, guint offset, mpi_oob_name_t *origin)
+{
+    mpi_hb_daemon_t *daemon;
+    mpi_hb_t *hb;
+    guint64 key;
+    gdouble interval;
+
+    if (pinfo->fd->flags.visited) {
+        return (mpi_hb_t *)p_get_proto_data(wmem_file_scope(), pinfo,
+                proto_mpi, MPI_PDATA_KEY(MPI_PDATA_HEARTBEAT, offset));
+    }
+
+    key = ((guint64)origin->jobid << 32) | origin->vpid;
+
+    hb = (mpi_hb_t *)mpi_frame_alloc(sizeof(mpi_hb_t));
+    daemon = (mpi_hb_daemon_t *)g_hash_table_lookup(mpi_hb_daemons, &key);
+    if (!daemon) {
+        daemon = g_new0(mpi_hb_daemon_t, 1);
+        daemon->key = key;
+        daemon->name = *origin;
+        g_hash_table_insert(mpi_hb_daemons, &daemon->key, daemon);
+    } else {
+        hb->prev_in = daemon->last_frame;
+        nstime_delta(&hb->interval, &pinfo->fd->abs_ts, &daemon->last_time);
+        interval = nstime_to_msec(&hb->interval);
+        hb->expected = mpi_hb_expected(daemon);
+        if (0 < hb->expected) {
+            if (1.5 * hb->expected <= interval) {
+                hb->missed = (guint32)(interval / hb->expected + 0.5) - 1;
+            } else if ((1 + pref_heartbeat_jitter / 100.0) * hb->expected
+                    < interval) {
+                hb->late = TRUE;
+            }
+        }
+        /* learn only from the regular intervals */
+        if (0 == hb->missed) {
+            if (MPI_HB_LEARN_MAX > daemon->intervals) {
+                daemon->intervals++;
+            }
+            daemon->mean += (interval - daemon->mean) / daemon->intervals;
+        }
+    }
+    daemon->last_frame = pinfo->fd->num;
+    daemon->last_time = pinfo->fd->abs_ts;
+
+    mpi_frame_add(pinfo, MPI_PDATA_KEY(MPI_PDATA_HEARTBEAT, offset), hb);
+
+    return hb;
+}
+
+/* the lower name of two daemons silent since the same frame, the order of
+ * the table is arbitrary */
+static void
+mpi_hb_most_silent(gpointer key _U_, gpointer value, gpointer userdata)
+{
+    mpi_hb_daemon_t *daemon = (mpi_hb_daemon_t *)value;
+    mpi_hb_failure_t *failure = (mpi_hb_failure_t *)userdata;
+
+    if (0 == failure->last_in ||
+            daemon->last_frame < failure->last_in ||
+            (daemon->last_frame == failure->last_in &&
+             (daemon->name.jobid < failure->silent.jobid ||
+              (daemon->name.jobid == failure->silent.jobid &&
+               daemon->name.vpid < failure->silent.vpid)))) {
+        failure->silent = daemon->name;
+        failure->last_in = daemon->last_frame;
+        failure->expected = mpi_hb_expected(daemon);
+    }
+}
+
+/* relate a failure notice or abort to the daemon silent for the longest time */
+static mpi_hb_failure_t *
+mpi_hb_failure(packet_info *pinfo, guint offset)
+{
+    mpi_hb_failure_t *failure;
+    mpi_hb_daemon_t *daemon;
+    guint64 key;
+
+    if (pinfo->fd->flags.visited) {
+        return (mpi_hb_failure_t *)p_get_proto_data(wmem_file_scope(), pinfo,
+                proto_mpi, MPI_PDATA_KEY(MPI_PDATA_FAILURE, offset));
+    }
+
+    failure = (mpi_hb_failure_t *)mpi_frame_alloc(sizeof(mpi_hb_failure_t));
+    g_hash_table_foreach(mpi_hb_daemons, mpi_hb_most_silent, failure);
+    if (failure->last_in) {
+        key = ((guint64)failure->silent.jobid << 32) | failure->silent.vpid;
+        daemon = (mpi_hb_daemon_t *)g_hash_table_lookup(mpi_hb_daemons, &key);
+        nstime_delta(&failure->silence, &pinfo->fd->abs_ts,
+                &daemon->last_time);
+    }
+
+    mpi_frame_add(pinfo, MPI_PDATA_KEY(MPI_PDATA_FAILURE, offset), failure);
+
+    return failure;
+}
+
+/*
+ * A plausible OOB header: the origin and the destination are processes,
+ * the message type is known, an IDENT has tag 0, other messages a known
+ * or a run time RML tag, and a body follows.
+ */
+static gboolean
+mpi_oob_hdr_valid(tvbuff_t *tvb, guint offset)
+{
+    guint32 msg_type = tvb_get_ntohl(tvb, offset + 16);
+    guint32 rml_tag = tvb_get_ntohl(tvb, offset + 20);
+    guint32 nbytes = tvb_get_ntohl(tvb, offset + 24);
+
+    if (!MPI_OOB_NAME_VALID(tvb_get_ntohl(tvb, offset),
+                tvb_get_ntohl(tvb, offset + 4)) ||
+            !MPI_OOB_NAME_VALID(tvb_get_ntohl(tvb, offset + 8),
+                tvb_get_ntohl(tvb, offset + 12))) {
+        return FALSE;
+    }
+    if (!try_val_to_str(msg_type, msgtypenames) || 0 == nbytes ||
+            MPI_OOB_MAX_NBYTES < nbytes) {
+        return FALSE;
+    }
+    if (0 == msg_type) {
+        /* IDENT */
+        return ORTE_RML_TAG_INVALID == rml_tag;
+    }
+    return ORTE_RML_TAG_INVALID != rml_tag && MPI_OOB_MAX_TAG >= rml_tag &&
+        (ORTE_RML_TAG_MAX <= rml_tag ||
+         try_val_to_str_ext(rml_tag, &rmltagnames_ext));
+}
+
+/*
+ * OOB or BTL: an endpoint of a listener learned before the frame makes it
+ * OOB. A process opening an OOB connection sends an IDENT first, the
+ * listener it connects to is learned from it, so a connection to a static
+ * port is OOB from its start even if the URI with the port follows later.
+ * Without these, both ports have to be in 32768..65535 (the OOB ports of
+ * ORTE by default) until the first callback. The listeners keep the frame
+ * they were learned in, so a frame dissected again is classified the same
+ * without per frame data.
+ */
+static gboolean
+mpi_is_oob(tvbuff_t *tvb, packet_info *pinfo)
+{
+    mpi_oob_ep_t ep;
+
+    if (mpi_oob_ep_known(&pinfo->src, pinfo->srcport, pinfo->fd->num) ||
+            mpi_oob_ep_known(&pinfo->dst, pinfo->destport, pinfo->fd->num)) {
+        return TRUE;
+    }
+    if (MPI_OOB_HDR_LEN <= tvb_captured_length(tvb) &&
+            mpi_oob_hdr_valid(tvb, 0) && 0 == tvb_get_ntohl(tvb, 16)) {
+        /* IDENT */
+        if (!pinfo->fd->flags.visited &&
+                mpi_oob_ep_set(&ep, &pinfo->dst, pinfo->destport)) {
+            mpi_oob_ep_add(&ep, pinfo->fd->num);
+        }
+        return TRUE;
+    }
+    if (mpi_oob_eps_frame && mpi_oob_eps_frame < pinfo->fd->num) {
+        return FALSE;
+    }
+    return 32768 <= pinfo->srcport && MAX_TCP_PORT >= pinfo->srcport &&
+        32768 <= pinfo->destport && MAX_TCP_PORT >= pinfo->destport;
+}
+
+/* the next plausible OOB header within MPI_OOB_RESYNC_WINDOW bytes, or the
+ * captured length */
+static guint
+mpi_oob_resync(tvbuff_t *tvb, guint offset)
+{
+    guint end;
+
+    end = tvb_captured_length(tvb);
+    if (end < MPI_OOB_HDR_LEN) {
+        return end;
+    }
+    end = MIN(end - MPI_OOB_HDR_LEN, offset + MPI_OOB_RESYNC_WINDOW);
+    for (; offset <= end; offset++) {
+        if (mpi_oob_hdr_valid(tvb, offset)) {
+            return offset;
+        }
+    }
+    return tvb_captured_length(tvb);
+}
+
+/*
+ * The bytes of a direction missing between two frames (TCP sequence gap,
+ * the first pass only). A gap inside the current message shortens it,
+ * else the next header has to be searched.
+ */
+static guint32
+mpi_oob_gap(packet_info *pinfo, const struct tcpinfo *tcpinfo,
+        guint32 *nextseq, gboolean *seq_known, guint32 *nbytes,
+        gboolean *resync)
+{
+    guint32 lost = 0;
+
+    if (pinfo->fd->flags.visited || !tcpinfo || tcpinfo->is_reassembled) {
+        return 0;
+    }
+    if (*seq_known && 0 < (gint32)(tcpinfo->seq - *nextseq)) {
+        lost = tcpinfo->seq - *nextseq;
+        if (lost <= *nbytes) {
+            *nbytes -= lost;
+        } else {
+            *nbytes = 0;
+            *resync = TRUE;
+        }
+    }
+    if (!*seq_known || 0 < (gint32)(tcpinfo->nxtseq - *nextseq)) {
+        *nextseq = tcpinfo->nxtseq;
+        *seq_known = TRUE;
+    }
+    return lost;
+}
+
+static int
+dissect_mpi_oob(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset,
+        const struct tcpinfo *tcpinfo)
+{
+    proto_item *ti = NULL;
+    proto_tree *mpi_tree = NULL;
+    proto_tree *mpi_oob_tree = NULL;
+    conversation_t *conversation;
+    void *conv_data;
+    mpi_oob_trans_t *mpi_oob_trans;
+    guint offset;
+    guint32 jobid_origin;
+    guint32 vpid_origin;
+    guint32 jobid_dst;
+    guint32 vpid_dst;
+    guint32 msg_type;
+    guint32 rml_tag;
+    const gchar *msg_name;
+    const gchar *rml_name;
+    gchar rml_buf[MPI_NAME_LEN];
+    guint32 nbytes;
+    guint32 msglen;
+    mpi_oob_old_t *value = NULL;
+    mpi_oob_old_t one_pass_value;
+    mpi_oob_name_t *origin;
+    mpi_oob_name_t *dst;
+    gboolean *resync;
+    guint32 lost = 0;
+    guint skipped;
+    proto_item *it;
+    mpi_tap_info_t *mpi_tap_info;
+    guint32 stream;
+    /* invalid */
+    int vers_len;
+    int cred_len;
+    const guint8 *version;
+    const guint8 *credential;
+    /* iof */
+    guint8 fully_des;
+    guint8 iof_type;
+    guint32 jobid;
+    guint32 vpid;
+    /* orte callback */
+    int uri_len;
+    int nodename_len;
+    const guint8 *uri;
+    const guint8 *nodename;
+    guint32 hwloc_len;
+    /* xcast */
+    guint8 odles;
+    mpi_xcast_hop_t *xcast_hop;
+    /* heartbeat */
+    mpi_hb_t *hb;
+    mpi_hb_failure_t *hb_failure;
+
+    offset = 0;
+
+    if (!mpi_is_oob(tvb, pinfo)) {
+        return the_offset;
+    }
+
+    if (MPI_DEBUG)
+        g_print("%d dissect_mpi_oob, reported_length: %d, offset: %d, tree: %s\n",
+                pinfo->fd->num, tvb_reported_length(tvb), the_offset,
+                tree ? "true":"false");
+
+    col_set_str(pinfo->cinfo, COL_PROTOCOL, "MPI");
+    col_clear(pinfo->cinfo,COL_INFO);
+
+    col_add_fstr(pinfo->cinfo, COL_INFO, "%d\xe2\x86\x92%d [OOB]",
+            pinfo->srcport, pinfo->destport);
+    if (tree) {
+        ti = proto_tree_add_item(tree, proto_mpi, tvb, 0, -1, ENC_NA);
+        mpi_tree = proto_item_add_subtree(ti, ett_mpi);
+    }
+
+    conversation = find_conversation(pinfo->fd->num, &pinfo->src, &pinfo->dst,
+            pinfo->ptype, pinfo->srcport, pinfo->destport, 0);
+
+    if (!conversation) {
+        conversation = conversation_new(pinfo->fd->num, &pinfo->src,
+                &pinfo->dst, pinfo->ptype, pinfo->srcport, pinfo->destport, 0);
+    }
+    stream = get_tcp_conversation_data(conversation, pinfo)->stream;
+    conv_data = conversation_get_proto_data(conversation, proto_mpi);
+    if (conv_data) {
+        mpi_oob_trans = (mpi_oob_trans_t *)conv_data;
+    } else {
+        if (28 > tvb_captured_length(tvb) - the_offset) {
+            g_print("%d start new conversation without a header?\n",
+                    pinfo->fd->num);
+            return the_offset;
+        }
+        mpi_oob_trans = g_new0(mpi_oob_trans_t, 1);
+
+        mpi_oob_trans->rml_tag_1 = 0;
+        mpi_oob_trans->nbytes_1 = 0;
+        mpi_oob_trans->msglen_1 = 0;
+        mpi_oob_trans->rml_tag_2 = 0;
+        mpi_oob_trans->nbytes_2 = 0;
+        mpi_oob_trans->msglen_2 = 0;
+        mpi_oob_trans->old = g_hash_table_new(g_direct_hash, g_direct_equal);
+        mpi_oob_trans->conversation = conversation;
+        g_hash_table_insert(mpi_oob_transs, mpi_oob_trans, mpi_oob_trans);
+
+        conversation_add_proto_data(conversation, proto_mpi,
+                (void *)mpi_oob_trans);
+    }
+    if (!pinfo->fd->flags.visited) {
+        mpi_oob_trans->last_time = pinfo->fd->abs_ts;
+    }
+
+    /* by frame number, the frame data of tshark is reused for every frame.
+     * A single pass does not come back, the values of the frame will do. */
+    if (pref_single_pass) {
+        memset(&one_pass_value, 0, sizeof(one_pass_value));
+        value = &one_pass_value;
+    } else {
+        value = (mpi_oob_old_t *)g_hash_table_lookup(mpi_oob_trans->old,
+                GUINT_TO_POINTER(pinfo->fd->num));
+    }
+    if (NULL == value) {
+        value = (mpi_oob_old_t *)
+                wmem_alloc0(wmem_file_scope(), sizeof(mpi_oob_old_t));
+        value->rml_tag = 0;
+        value->nbytes = 0;
+        g_hash_table_insert(mpi_oob_trans->old,
+                GUINT_TO_POINTER(pinfo->fd->num), value);
+    }
+
+    /* segments lost in the capture, the first pass only */
+    if (!pinfo->fd->flags.visited) {
+        if (pinfo->srcport > pinfo->destport) {
+            lost = mpi_oob_gap(pinfo, tcpinfo, &mpi_oob_trans->nextseq_1,
+                    &mpi_oob_trans->seq_known_1, &mpi_oob_trans->nbytes_1,
+                    &mpi_oob_trans->resync_1);
+        } else {
+            lost = mpi_oob_gap(pinfo, tcpinfo, &mpi_oob_trans->nextseq_2,
+                    &mpi_oob_trans->seq_known_2, &mpi_oob_trans->nbytes_2,
+                    &mpi_oob_trans->resync_2);
+        }
+    }
+
+    /* (re)store the old values */
+    if (pinfo->fd->flags.visited) {
+        if (pinfo->srcport > pinfo->destport) {
+            mpi_oob_trans->rml_tag_1 = value->rml_tag;
+            mpi_oob_trans->nbytes_1 = value->nbytes;
+            mpi_oob_trans->msglen_1 = value->msglen;
+            mpi_oob_trans->origin_1 = value->origin;
+            mpi_oob_trans->dst_1 = value->dst;
+            mpi_oob_trans->resync_1 = value->resync;
+        } else {
+            mpi_oob_trans->rml_tag_2 = value->rml_tag;
+            mpi_oob_trans->nbytes_2 = value->nbytes;
+            mpi_oob_trans->msglen_2 = value->msglen;
+            mpi_oob_trans->origin_2 = value->origin;
+            mpi_oob_trans->dst_2 = value->dst;
+            mpi_oob_trans->resync_2 = value->resync;
+        }
+        /* g_print("%d reload rml_tag: %d, nbytes: %d\n", pinfo->fd->num, value->rml_tag, value->nbytes); */
+    } else {
+        if (pinfo->srcport > pinfo->destport) {
+            value->rml_tag = mpi_oob_trans->rml_tag_1;
+            value->nbytes = mpi_oob_trans->nbytes_1;
+            value->msglen = mpi_oob_trans->msglen_1;
+            value->origin = mpi_oob_trans->origin_1;
+            value->dst = mpi_oob_trans->dst_1;
+            value->resync = mpi_oob_trans->resync_1;
+        } else {
+            value->rml_tag = mpi_oob_trans->rml_tag_2;
+            value->nbytes = mpi_oob_trans->nbytes_2;
+            value->msglen = mpi_oob_trans->msglen_2;
+            value->origin = mpi_oob_trans->origin_2;
+            value->dst = mpi_oob_trans->dst_2;
+            value->resync = mpi_oob_trans->resync_2;
+        }
+        if (lost) {
+            value->lost = lost;
+        }
+        /* g_print("%d store rml_tag: %d, nbytes: %d\n", pinfo->fd->num, value->rml_tag, value->nbytes); */
+    }
+
+    if (value->lost) {
+        it = proto_tree_add_uint(mpi_tree, hf_mpi_oob_lost, tvb, 0, 0,
+                value->lost);
+        PROTO_ITEM_SET_GENERATED(it);
+        expert_add_info_format(pinfo, it, &ei_mpi_oob_lost,
+                "%u bytes of the OOB stream are not in the capture%s",
+                value->lost, value->resync ? ", searching the next header" : "");
+    }
+
+
+    while (tvb_captured_length(tvb) > the_offset) {
+
+        offset = the_offset;
 
         if (pinfo->srcport > pinfo->destport) {
             nbytes = mpi_oob_trans->nbytes_1;
             rml_tag = mpi_oob_trans->rml_tag_1;
+            msglen = mpi_oob_trans->msglen_1;
+            origin = &mpi_oob_trans->origin_1;
+            dst = &mpi_oob_trans->dst_1;
+            resync = &mpi_oob_trans->resync_1;
         } else {
             nbytes = mpi_oob_trans->nbytes_2;
             rml_tag = mpi_oob_trans->rml_tag_2;
+            msglen = mpi_oob_trans->msglen_2;
+            origin = &mpi_oob_trans->origin_2;
+            dst = &mpi_oob_trans->dst_2;
+            resync = &mpi_oob_trans->resync_2;
         }
 
+        mpi_tap_info = wmem_new0(wmem_packet_scope(), mpi_tap_info_t);
+        mpi_tap_info->kind = MPI_PDU_OOB;
+        mpi_tap_info->stream = stream;
+
         if (0 == nbytes){ /* header */
             if (28 > tvb_captured_length(tvb) - offset) {
                 return offset;
             }
+            /* after a loss or a bogus header skip to the next good one */
+            if (*resync || !mpi_oob_hdr_valid(tvb, offset)) {
+                skipped = mpi_oob_resync(tvb, offset) - offset;
+                if (skipped) {
+                    it = proto_tree_add_uint(mpi_tree, hf_mpi_oob_skipped,
+                            tvb, offset, skipped, skipped);
+                    expert_add_info_format(pinfo, it, &ei_mpi_oob_resync,
+                            "%u bytes without an OOB header skipped", skipped);
+                    col_append_fstr(pinfo->cinfo, COL_INFO,
+                            " [%u bytes skipped]", skipped);
+                }
+                offset += skipped;
+                the_offset = offset;
+                if (tvb_captured_length(tvb) == offset) {
+                    /* the following frame searches on */
+                    *resync = TRUE;
+                    return offset;
+                }
+                *resync = FALSE;
+            }
             jobid_origin = tvb_get_ntohl(tvb, offset);
             offset += 4;
             vpid_origin = tvb_get_ntohl(tvb, offset);
@@ -906,8 +1865,12 @@ dissect_mpi_oob(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_o
             offset += 4;
             msg_type = tvb_get_ntohl(tvb, offset);
             offset += 4;
+            /* a header is checked for a known type (mpi_oob_hdr_valid) */
+            msg_name = val_to_str_const(msg_type, msgtypenames, "Unknown");
             rml_tag = tvb_get_ntohl(tvb, offset);
             offset += 4;
+            rml_name = mpi_val_to_str(rml_tag, &rmltagnames_ext, "%d",
+                    rml_buf);
             nbytes = tvb_get_ntohl(tvb, offset);
             offset += 4;
 
@@ -915,8 +1878,7 @@ dissect_mpi_oob(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_o
                     "Jobid-Origin=%d Vpid-Origin=%d Jobid-Dst=%d Vpid-Dst=%d "
                     "Type=%s Tag=%s Length=%d",
                     jobid_origin, vpid_origin, jobid_dst, vpid_dst,
-                    val_to_str(msg_type, msgtypenames, "%d"),
-                    val_to_str(rml_tag, rmltagnames, "%d"), nbytes);
+                    msg_name, rml_name, nbytes);
 
             if (tree) {
                 offset = the_offset; //reset offset
@@ -949,22 +1911,56 @@ dissect_mpi_oob(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_o
                         "jobid_dst: %d, vpid_dst: %d, "
                         "type: %s, tag: %s, length: %d",
                         jobid_origin, vpid_origin, jobid_dst, vpid_dst,
-                        val_to_str(msg_type, msgtypenames, "%d"),
-                        val_to_str(rml_tag, rmltagnames, "%d"), nbytes);
+                        msg_name, rml_name, nbytes);
             }
 
             if (pinfo->srcport > pinfo->destport) {
                 mpi_oob_trans->rml_tag_1 = rml_tag;
                 mpi_oob_trans->nbytes_1 = nbytes;
+                mpi_oob_trans->msglen_1 = nbytes;
             } else {
                 mpi_oob_trans->rml_tag_2 = rml_tag;
                 mpi_oob_trans->nbytes_2 = nbytes;
+                mpi_oob_trans->msglen_2 = nbytes;
             }
+            /* remember the peers for the following message */
+            origin->jobid = jobid_origin;
+            origin->vpid = vpid_origin;
+            dst->jobid = jobid_dst;
+            dst->vpid = vpid_dst;
+
+            mpi_tap_info->oob_header = TRUE;
+            mpi_tap_info->jobid_origin = jobid_origin;
+            mpi_tap_info->vpid_origin = vpid_origin;
+            mpi_tap_info->jobid_dst = jobid_dst;
+            mpi_tap_info->vpid_dst = vpid_dst;
+            mpi_tap_info->msg_type = msg_type;
+            mpi_tap_info->rml_tag = rml_tag;
+            mpi_tap_info->nbytes = nbytes;
+            tap_queue_packet(mpi_tap, pinfo, mpi_tap_info);
 
             the_offset = offset;
 
         } else { /* message */
 
+            /* only the beginning of a XCAST identifies it */
+            xcast_hop = NULL;
+            if (ORTE_RML_TAG_XCAST == rml_tag && nbytes == msglen) {
+                xcast_hop = mpi_xcast_correlate(tvb, pinfo, offset, msglen,
+                        origin, dst);
+            }
+            hb = NULL;
+            hb_failure = NULL;
+            mpi_tap_info->msg_start = (nbytes == msglen);
+            if (nbytes == msglen) {
+                if (ORTE_RML_TAG_HEARTBEAT == rml_tag) {
+                    hb = mpi_heartbeat(pinfo, offset, origin);
+                } else if (ORTE_RML_TAG_FAILURE_NOTICE == rml_tag ||
+                        ORTE_RML_TAG_ABORT == rml_tag) {
+                    hb_failure = mpi_hb_failure(pinfo, offset);
+                }
+            }
+
             if (tvb_captured_length(tvb) - offset < nbytes) {
                 if (pinfo->srcport > pinfo->destport) {
                     mpi_oob_trans->nbytes_1 = nbytes - 
@@ -982,21 +1978,163 @@ dissect_mpi_oob(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_o
                 }
             }
 
+            rml_name = mpi_val_to_str(rml_tag, &rmltagnames_ext, "%d",
+                    rml_buf);
             col_append_fstr(pinfo->cinfo, COL_INFO, " Message: RML-Tag=%s",
-                    val_to_str(rml_tag, rmltagnames, "%d"));
+                    rml_name);
+
+            mpi_tap_info->jobid_origin = origin->jobid;
+            mpi_tap_info->vpid_origin = origin->vpid;
+            mpi_tap_info->jobid_dst = dst->jobid;
+            mpi_tap_info->vpid_dst = dst->vpid;
+            mpi_tap_info->rml_tag = rml_tag;
+            mpi_tap_info->nbytes = nbytes;
 
             if (tree) {
                 mpi_oob_tree = proto_tree_add_subtree(mpi_tree, tvb, 0, 0,
                         ett_mpi_oob_msg, &ti, "OOB Message: ");
 
                 proto_item_append_text(ti, "rml-tag: %s (%d)",
-                        val_to_str(rml_tag, rmltagnames, "%d"), rml_tag);
+                        rml_name, rml_tag);
+            }
+
+            if (xcast_hop) {
+                proto_item *it;
+                proto_tree *mpi_xcast_tree;
+
+                mpi_xcast_tree = proto_tree_add_subtree_format(mpi_oob_tree,
+                        tvb, offset, 0, ett_mpi_xcast, &it,
+                        "XCAST %u, hop %u", xcast_hop->xcast->id,
+                        xcast_hop->hop);
+                PROTO_ITEM_SET_GENERATED(it);
+
+                it = proto_tree_add_uint(mpi_xcast_tree, hf_mpi_xcast_id, tvb,
+                        offset, 0, xcast_hop->xcast->id);
+                PROTO_ITEM_SET_GENERATED(it);
+                it = proto_tree_add_uint(mpi_xcast_tree, hf_mpi_xcast_hop, tvb,
+                        offset, 0, xcast_hop->hop);
+                PROTO_ITEM_SET_GENERATED(it);
+                it = proto_tree_add_uint(mpi_xcast_tree, hf_mpi_xcast_first_in,
+                        tvb, offset, 0, xcast_hop->xcast->first_frame);
+                PROTO_ITEM_SET_GENERATED(it);
+                it = proto_tree_add_time(mpi_xcast_tree, hf_mpi_xcast_time,
+                        tvb, offset, 0, &xcast_hop->time);
+                PROTO_ITEM_SET_GENERATED(it);
+                if (xcast_hop->parent_in) {
+                    it = proto_tree_add_uint(mpi_xcast_tree,
+                            hf_mpi_xcast_parent_in, tvb, offset, 0,
+                            xcast_hop->parent_in);
+                    PROTO_ITEM_SET_GENERATED(it);
+                    it = proto_tree_add_time(mpi_xcast_tree,
+                            hf_mpi_xcast_relay_time, tvb, offset, 0,
+                            &xcast_hop->relay_time);
+                    PROTO_ITEM_SET_GENERATED(it);
+                    if (nstime_to_msec(&xcast_hop->relay_time) >
+                            pref_xcast_slow_relay) {
+                        expert_add_info_format(pinfo, it,
+                                &ei_mpi_xcast_slow_relay,
+                                "Daemon %u relayed XCAST %u after %.3f ms",
+                                origin->vpid, xcast_hop->xcast->id,
+                                nstime_to_msec(&xcast_hop->relay_time));
+                    }
+                }
+
+                col_append_fstr(pinfo->cinfo, COL_INFO, " XCAST=%u Hop=%u",
+                        xcast_hop->xcast->id, xcast_hop->hop);
+
+                mpi_tap_info->xcast_id = xcast_hop->xcast->id;
+                mpi_tap_info->xcast_hop = xcast_hop->hop;
+                mpi_tap_info->xcast_parent_in = xcast_hop->parent_in;
+                mpi_tap_info->xcast_relay_time = xcast_hop->relay_time;
+                mpi_tap_info->xcast_time = xcast_hop->time;
+            }
+
+            if (hb) {
+                proto_item *it;
+                proto_tree *mpi_hb_tree;
+
+                mpi_hb_tree = proto_tree_add_subtree_format(mpi_oob_tree,
+                        tvb, offset, 0, ett_mpi_hb, &it,
+                        "Heartbeat of %u.%u", origin->jobid, origin->vpid);
+                PROTO_ITEM_SET_GENERATED(it);
+
+                if (hb->prev_in) {
+                    it = proto_tree_add_uint(mpi_hb_tree, hf_mpi_hb_prev_in,
+                            tvb, offset, 0, hb->prev_in);
+                    PROTO_ITEM_SET_GENERATED(it);
+                    it = proto_tree_add_time(mpi_hb_tree, hf_mpi_hb_interval,
+                            tvb, offset, 0, &hb->interval);
+                    PROTO_ITEM_SET_GENERATED(it);
+                    if (hb->missed) {
+                        expert_add_info_format(pinfo, it, &ei_mpi_hb_missing,
+                                "%u heartbeat(s) of daemon %u.%u missing "
+                                "(interval %.3f ms, expected %.3f ms)",
+                                hb->missed, origin->jobid, origin->vpid,
+                                nstime_to_msec(&hb->interval), hb->expected);
+                    } else if (hb->late) {
+                        expert_add_info_format(pinfo, it, &ei_mpi_hb_late,
+                                "Heartbeat of daemon %u.%u late "
+                                "(interval %.3f ms, expected %.3f ms)",
+                                origin->jobid, origin->vpid,
+                                nstime_to_msec(&hb->interval), hb->expected);
+                    }
+                }
+                if (0 < hb->expected) {
+                    it = proto_tree_add_double(mpi_hb_tree, hf_mpi_hb_expected,
+                            tvb, offset, 0, hb->expected);
+                    PROTO_ITEM_SET_GENERATED(it);
+                    it = proto_tree_add_uint(mpi_hb_tree, hf_mpi_hb_missed,
+                            tvb, offset, 0, hb->missed);
+                    PROTO_ITEM_SET_GENERATED(it);
+                }
+
+                mpi_tap_info->hb_prev_in = hb->prev_in;
+                mpi_tap_info->hb_interval = hb->interval;
+                mpi_tap_info->hb_expected = hb->expected;
+                mpi_tap_info->hb_missed = hb->missed;
+                mpi_tap_info->hb_late = hb->late;
+            }
+
+            if (hb_failure && hb_failure->last_in) {
+                proto_item *it;
+                proto_tree *mpi_hb_tree;
+
+                mpi_hb_tree = proto_tree_add_subtree_format(mpi_oob_tree,
+                        tvb, offset, 0, ett_mpi_hb, &it,
+                        "Longest without heartbeat: %u.%u",
+                        hb_failure->silent.jobid, hb_failure->silent.vpid);
+                PROTO_ITEM_SET_GENERATED(it);
+
+                it = proto_tree_add_uint(mpi_hb_tree, hf_mpi_hb_silent_vpid,
+                        tvb, offset, 0, hb_failure->silent.vpid);
+                PROTO_ITEM_SET_GENERATED(it);
+                it = proto_tree_add_uint(mpi_hb_tree, hf_mpi_hb_silent_last_in,
+                        tvb, offset, 0, hb_failure->last_in);
+                PROTO_ITEM_SET_GENERATED(it);
+                it = proto_tree_add_time(mpi_hb_tree, hf_mpi_hb_silence,
+                        tvb, offset, 0, &hb_failure->silence);
+                PROTO_ITEM_SET_GENERATED(it);
+                if (0 < hb_failure->expected) {
+                    expert_add_info_format(pinfo, it, &ei_mpi_hb_failure,
+                            "%s, daemon %u.%u without heartbeat for %.3f ms "
+                            "(%.1f intervals)",
+                            rml_name,
+                            hb_failure->silent.jobid, hb_failure->silent.vpid,
+                            nstime_to_msec(&hb_failure->silence),
+                            nstime_to_msec(&hb_failure->silence) /
+                            hb_failure->expected);
+                }
+
+                mpi_tap_info->hb_silent_jobid = hb_failure->silent.jobid;
+                mpi_tap_info->hb_silent_vpid = hb_failure->silent.vpid;
+                mpi_tap_info->hb_silence = hb_failure->silence;
+                mpi_tap_info->hb_expected = hb_failure->expected;
             }
 
             if (MPI_DEBUG)
                 g_print("%d dissect_mpi_oob_msg, rml_tag: %s (%d), offset: %d, "
                         "tree: %s\n",
-                        pinfo->fd->num, val_to_str(rml_tag, rmltagnames, "%d"),
+                        pinfo->fd->num, rml_name,
                         rml_tag, offset, tree ? "true":"false");
             switch(rml_tag) {
                 case ORTE_RML_TAG_INVALID:
@@ -1108,6 +2246,10 @@ dissect_mpi_oob(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_o
                             (9 == fully_des) ? "True" : "False",
                             val_to_str(iof_type, ioftypenames, "%d"),
                             jobid, vpid);
+
+                    mpi_tap_info->iof_type = iof_type;
+                    mpi_tap_info->iof_jobid = jobid;
+                    mpi_tap_info->iof_vpid = vpid;
                     break;
                 case ORTE_RML_TAG_ORTED_CALLBACK:
                     /*
@@ -1210,6 +2352,10 @@ dissect_mpi_oob(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_o
                         }
                     }
 
+                    mpi_tap_info->nodename = nodename;
+                    mpi_tap_info->uri = uri;
+                    mpi_oob_learn(pinfo, uri);
+
                     col_append_fstr(pinfo->cinfo, COL_INFO, " Jobid=%d Vpid=%d, "
                             "Nodename=%s URI=%s hwloc-len=%d",
                             jobid, vpid, nodename, uri, hwloc_len);
@@ -1265,6 +2411,7 @@ dissect_mpi_oob(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_o
 
                     col_append_fstr(pinfo->cinfo, COL_INFO, " Daemon-CMD=%s",
                             val_to_str(odles, odlesdatatypenames, "%d"));
+                    mpi_tap_info->daemon_cmd = odles;
 
                     proto_item_append_text(ti, ", daemon-cmd: %s",
                             val_to_str(odles, odlesdatatypenames, "%d"));
@@ -1278,8 +2425,11 @@ dissect_mpi_oob(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_o
             if (tvb_captured_length(tvb) > offset) {
                 proto_tree_add_item(mpi_oob_tree, hf_mpi_oob_data, tvb,
                         offset, nbytes, ENC_BIG_ENDIAN);
+                mpi_tap_info->data = tvb_get_ptr(tvb, offset, nbytes);
+                mpi_tap_info->data_len = nbytes;
                 offset += nbytes;
             }
+            tap_queue_packet(mpi_tap, pinfo, mpi_tap_info);
             the_offset = offset;
         }
     }
@@ -1287,27 +2437,230 @@ dissect_mpi_oob(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_o
     return the_offset;
 }
 
-static int
-dissect_mpi_match(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset)
+static gint
+mpi_msg_key_cmp(gconstpointer a, gconstpointer b)
 {
-    proto_item *ti = NULL;
-    proto_tree *mpi_match_tree = NULL;
-    guint32 byte_order;
-    guint offset;
-    guint16 match_ctx;
-    gint32 match_src;
-    gint32 match_tag;
-    guint16 match_seq;
-    guint16 match_padding;
+    const mpi_msg_key_t *ka = (const mpi_msg_key_t *)a;
+    const mpi_msg_key_t *kb = (const mpi_msg_key_t *)b;
 
-    if (12 > tvb_reported_length(tvb) - the_offset) {
-        return the_offset;
+    if (ka->ctx != kb->ctx) {
+        return ka->ctx < kb->ctx ? -1 : 1;
+    }
+    if (ka->src != kb->src) {
+        return ka->src < kb->src ? -1 : 1;
+    }
+    if (ka->tag != kb->tag) {
+        return ka->tag < kb->tag ? -1 : 1;
+    }
+    if (ka->seq != kb->seq) {
+        return ka->seq < kb->seq ? -1 : 1;
+    }
+    if (ka->jobid != kb->jobid) {
+        return ka->jobid < kb->jobid ? -1 : 1;
+    }
+    if (ka->dst != kb->dst) {
+        return ka->dst < kb->dst ? -1 : 1;
     }
+    if (ka->frame != kb->frame) {
+        return ka->frame < kb->frame ? -1 : 1;
+    }
+    return 0;
+}
 
-    if (MPI_DEBUG)
-        g_print("%d dissect_mpi_match, reported_length: %d offset: %d, tree: %s\n",
-                pinfo->fd->num, tvb_reported_length(tvb), the_offset,
-                tree ? "true":"false");
+static gint
+mpi_req_key_cmp(gconstpointer a, gconstpointer b)
+{
+    const mpi_req_key_t *ka = (const mpi_req_key_t *)a;
+    const mpi_req_key_t *kb = (const mpi_req_key_t *)b;
+
+    if (ka->req != kb->req) {
+        return ka->req < kb->req ? -1 : 1;
+    }
+    if (ka->jobid != kb->jobid) {
+        return ka->jobid < kb->jobid ? -1 : 1;
+    }
+    if (ka->vpid != kb->vpid) {
+        return ka->vpid < kb->vpid ? -1 : 1;
+    }
+    if (ka->frame != kb->frame) {
+        return ka->frame < kb->frame ? -1 : 1;
+    }
+    return 0;
+}
+
+/* first element not below "key" */
+static guint
+mpi_lower_bound(GArray *keys, guint size, gconstpointer key, GCompareFunc cmp)
+{
+    guint low = 0;
+    guint high = keys->len;
+    guint mid;
+
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (0 > cmp(keys->data + mid * size, key)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/*
+ * The first pass only, with a tap listener (-z mpi,find) only. A key can
+ * repeat: seq wraps, a frame holds PDUs. The processes are known with the
+ * channel of the PDU, the send request of an ACK belongs to its receiver.
+ */
+static void
+mpi_index_add(packet_info *pinfo, const mpi_tap_info_t *mpi_tap_info)
+{
+    mpi_msg_key_t msg_key;
+    mpi_req_key_t req_key;
+    gboolean ack = MPI_PML_OB1_HDR_TYPE_ACK == mpi_tap_info->base;
+
+    if (pinfo->fd->flags.visited || !mpi_msg_keys ||
+            !have_tap_listener(mpi_tap)) {
+        return;
+    }
+    if (mpi_tap_info->matched) {
+        memset(&msg_key, 0, sizeof(msg_key));
+        msg_key.ctx = mpi_tap_info->match_ctx;
+        msg_key.seq = mpi_tap_info->match_seq;
+        msg_key.src = mpi_tap_info->match_src;
+        msg_key.tag = mpi_tap_info->match_tag;
+        msg_key.jobid = mpi_tap_info->channel ? mpi_tap_info->jobid : 0;
+        msg_key.dst = mpi_tap_info->channel ?
+            (gint32)mpi_tap_info->vpid_dst : -1;
+        msg_key.frame = pinfo->fd->num;
+        g_array_append_val(mpi_msg_keys, msg_key);
+        mpi_msg_keys_sorted = FALSE;
+    }
+    if (mpi_tap_info->src_req) {
+        memset(&req_key, 0, sizeof(req_key));
+        req_key.req = mpi_tap_info->src_req;
+        if (mpi_tap_info->channel) {
+            req_key.jobid = ack ? mpi_tap_info->jobid_dst : mpi_tap_info->jobid;
+            req_key.vpid = ack ? mpi_tap_info->vpid_dst : mpi_tap_info->vpid;
+        } else {
+            req_key.vpid = -1;
+        }
+        req_key.frame = pinfo->fd->num;
+        g_array_append_val(mpi_req_keys, req_key);
+        mpi_req_keys_sorted = FALSE;
+    }
+}
+
+guint
+mpi_find_msg(guint32 jobid, guint16 ctx, gint32 src, gint32 dst, gint32 tag,
+        gint32 seq, GArray *hits)
+{
+    mpi_msg_key_t key;
+    const mpi_msg_key_t *found;
+    mpi_find_hit_t hit;
+    guint i;
+    guint n = 0;
+
+    if (!mpi_msg_keys) {
+        return 0;
+    }
+    if (!mpi_msg_keys_sorted) {
+        g_array_sort(mpi_msg_keys, mpi_msg_key_cmp);
+        mpi_msg_keys_sorted = TRUE;
+    }
+    memset(&key, 0, sizeof(key));
+    key.ctx = ctx;
+    key.seq = 0 > seq ? 0 : (guint16)seq;
+    key.src = src;
+    key.tag = tag;
+    key.dst = G_MININT32;
+    for (i = mpi_lower_bound(mpi_msg_keys, sizeof(key), &key, mpi_msg_key_cmp);
+            i < mpi_msg_keys->len; i++) {
+        found = &g_array_index(mpi_msg_keys, mpi_msg_key_t, i);
+        if (found->ctx != ctx || found->src != src || found->tag != tag ||
+                (0 <= seq && found->seq != (guint16)seq)) {
+            break;
+        }
+        if ((jobid && found->jobid != jobid) || (0 <= dst && found->dst != dst)) {
+            continue;
+        }
+        if (hits) {
+            hit.frame = found->frame;
+            hit.jobid = found->jobid;
+            hit.vpid = found->dst;
+            g_array_append_val(hits, hit);
+        }
+        n++;
+    }
+    return n;
+}
+
+guint
+mpi_find_req(guint32 jobid, gint32 vpid, guint64 req, GArray *hits)
+{
+    mpi_req_key_t key;
+    const mpi_req_key_t *found;
+    mpi_find_hit_t hit;
+    guint i;
+    guint n = 0;
+
+    if (!mpi_req_keys) {
+        return 0;
+    }
+    if (!mpi_req_keys_sorted) {
+        g_array_sort(mpi_req_keys, mpi_req_key_cmp);
+        mpi_req_keys_sorted = TRUE;
+    }
+    memset(&key, 0, sizeof(key));
+    key.req = req;
+    key.vpid = G_MININT32;
+    for (i = mpi_lower_bound(mpi_req_keys, sizeof(key), &key, mpi_req_key_cmp);
+            i < mpi_req_keys->len; i++) {
+        found = &g_array_index(mpi_req_keys, mpi_req_key_t, i);
+        if (found->req != req) {
+            break;
+        }
+        if ((jobid && found->jobid != jobid) ||
+                (0 <= vpid && found->vpid != vpid)) {
+            continue;
+        }
+        if (hits) {
+            hit.frame = found->frame;
+            hit.jobid = found->jobid;
+            hit.vpid = found->vpid;
+            g_array_append_val(hits, hit);
+        }
+        n++;
+    }
+    return n;
+}
+
+static int
+dissect_mpi_match(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset,
+        mpi_tap_info_t *mpi_tap_info)
+{
+    proto_item *ti = NULL;
+    proto_tree *mpi_match_tree = NULL;
+    guint32 byte_order;
+    guint offset;
+    guint16 match_ctx;
+    gint32 match_src;
+    gint32 match_tag;
+    guint16 match_seq;
+    guint16 match_padding;
+    const gchar *tag_name;
+    const gchar *ctx_name;
+    gchar tag_buf[MPI_NAME_LEN];
+    gchar ctx_buf[MPI_NAME_LEN];
+
+    if (12 > tvb_reported_length(tvb) - the_offset) {
+        return the_offset;
+    }
+
+    if (MPI_DEBUG)
+        g_print("%d dissect_mpi_match, reported_length: %d offset: %d, tree: %s\n",
+                pinfo->fd->num, tvb_reported_length(tvb), the_offset,
+                tree ? "true":"false");
 
     match_padding = 1;
     offset = the_offset;
@@ -1350,10 +2703,21 @@ dissect_mpi_match(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the
         }
     }
 
-    col_append_fstr(pinfo->cinfo, COL_INFO, " %s (%s) Src-Vpid=%d Seq=%d",
-            val_to_str(match_tag, colltagnames, "Msg-Tag=%d"),
-            val_to_str(match_ctx, communicatornames, "ctx=%d"),
+    tag_name = mpi_val_to_str(match_tag, &colltagnames_ext, "%d", tag_buf);
+    ctx_name = mpi_val_to_str(match_ctx, &communicatornames_ext, "%d",
+            ctx_buf);
+    col_append_fstr(pinfo->cinfo, COL_INFO, " %s%s (%s%s) Src-Vpid=%d Seq=%d",
+            tag_name == tag_buf ? "Msg-Tag=" : "", tag_name,
+            ctx_name == ctx_buf ? "ctx=" : "", ctx_name,
             match_src, match_seq);
+    /* NULL if the match header does not start a message */
+    if (mpi_tap_info) {
+        mpi_tap_info->matched = TRUE;
+        mpi_tap_info->match_ctx = match_ctx;
+        mpi_tap_info->match_seq = match_seq;
+        mpi_tap_info->match_src = match_src;
+        mpi_tap_info->match_tag = match_tag;
+    }
 
     if (tree) {
         /* match header */
@@ -1378,16 +2742,17 @@ dissect_mpi_match(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the
                     offset, 2, byte_order);
             offset += 2;
         }
-        proto_item_append_text(ti, "%s, src: %d, tag: %s, seq: %d%s",
-                val_to_str(match_ctx, communicatornames, "ctx: %d"), match_src,
-                val_to_str(match_tag, colltagnames, "%d"), match_seq,
+        proto_item_append_text(ti, "%s%s, src: %d, tag: %s, seq: %d%s",
+                ctx_name == ctx_buf ? "ctx: " : "", ctx_name, match_src,
+                tag_name, match_seq,
                 (0 == match_padding ? ", padding: 2 Bytes":""));
     }
     return offset;
 }
 
 static int
-dissect_mpi_rndv(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset)
+dissect_mpi_rndv(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset,
+        mpi_tap_info_t *mpi_tap_info)
 {
     proto_item *ti = NULL;
     proto_tree *mpi_rndv_tree = NULL;
@@ -1409,7 +2774,8 @@ dissect_mpi_rndv(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
                 pinfo->fd->num, tvb_reported_length(tvb), the_offset,
                 tree ? "true":"false");
 
-    the_offset = dissect_mpi_match(tvb, pinfo, tree, the_offset);
+    the_offset = dissect_mpi_match(tvb, pinfo, tree, the_offset,
+            mpi_tap_info);
 
     /* we need 16 bytes for the minimum rendezvous header */
     if (16 > tvb_reported_length(tvb) - the_offset) {
@@ -1452,6 +2818,8 @@ dissect_mpi_rndv(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
         col_append_fstr(pinfo->cinfo, COL_INFO,
                 " Msg-Len=%" G_GINT64_MODIFIER "u", rndv_msg_len);
     }
+    mpi_tap_info->msg_len = rndv_msg_len;
+    mpi_tap_info->src_req = rndv_src_req64;
 
     if (tree) {
         /* rendezvous header */
@@ -1508,7 +2876,8 @@ dissect_mpi_rndv(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
 }
 
 static int
-dissect_mpi_rget(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset)
+dissect_mpi_rget(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset,
+        mpi_tap_info_t *mpi_tap_info)
 {
     proto_item *ti = NULL;
     proto_tree *mpi_rget_tree = NULL;
@@ -1528,7 +2897,7 @@ dissect_mpi_rget(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
                 pinfo->fd->num, tvb_reported_length(tvb), the_offset,
                 tree ? "true":"false");
 
-    the_offset = dissect_mpi_rndv(tvb, pinfo, tree, the_offset);
+    the_offset = dissect_mpi_rndv(tvb, pinfo, tree, the_offset, mpi_tap_info);
 
     /* we need minimum 12 bytes for the rendezvous/get header */
     if (12 > tvb_reported_length(tvb) - the_offset) {
@@ -1564,6 +2933,7 @@ dissect_mpi_rget(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
     col_append_fstr(pinfo->cinfo, COL_INFO,
             " Num-Seg=%d Src-Des=0x%016" G_GINT64_MODIFIER "x",
             rget_seg_cnt, rget_src_des64);
+    mpi_tap_info->des = rget_src_des64;
 
     if (tree) {
         offset = the_offset;
@@ -1591,7 +2961,8 @@ dissect_mpi_rget(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
 }
 
 static int
-dissect_mpi_frag(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset)
+dissect_mpi_frag(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset,
+        mpi_tap_info_t *mpi_tap_info)
 {
     proto_item *ti = NULL;
     proto_tree *mpi_frag_tree = NULL;
@@ -1648,6 +3019,9 @@ dissect_mpi_frag(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
             " Src-Req=0x%016" G_GINT64_MODIFIER "x"
             " Des-Req=0x%016" G_GINT64_MODIFIER "x",
             frag_frag_offset, frag_src_req64, frag_des_req64);
+    mpi_tap_info->src_req = frag_src_req64;
+    mpi_tap_info->dst_req = frag_des_req64;
+    mpi_tap_info->frag_offset = frag_frag_offset;
 
     if (tree) {
         offset = the_offset;
@@ -1688,7 +3062,8 @@ dissect_mpi_frag(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
 }
 
 static int
-dissect_mpi_ack(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset)
+dissect_mpi_ack(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset,
+        mpi_tap_info_t *mpi_tap_info)
 {
     proto_item *ti = NULL;
     proto_tree *mpi_ack_tree = NULL;
@@ -1745,6 +3120,9 @@ dissect_mpi_ack(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_o
             " Dst-Req=0x%016" G_GINT64_MODIFIER "x"
             " Send-Offset=%" G_GINT64_MODIFIER "u",
             ack_src_req64, ack_dst_req64, ack_send_offset);
+    mpi_tap_info->src_req = ack_src_req64;
+    mpi_tap_info->dst_req = ack_dst_req64;
+    mpi_tap_info->frag_offset = ack_send_offset;
 
     if (tree) {
         offset = the_offset;
@@ -1785,7 +3163,8 @@ dissect_mpi_ack(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_o
 }
 
 static int
-dissect_mpi_rdma(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset)
+dissect_mpi_rdma(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset,
+        mpi_tap_info_t *mpi_tap_info)
 {
     proto_item *ti = NULL;
     proto_tree *mpi_rdma_tree = NULL;
@@ -1796,6 +3175,8 @@ dissect_mpi_rdma(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
     guint64 rdma_rdma_offset;
     guint64 rdma_seg_addr64;
     guint64 rdma_seg_len;
+    guint64 rdma_dst_req64;
+    guint64 rdma_src_des64;
 
     /* we need minimum 52 bytes for the rdma header */
     if (52 > tvb_reported_length(tvb) - the_offset) {
@@ -1819,7 +3200,10 @@ dissect_mpi_rdma(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
         }
         rdma_seg_cnt = tvb_get_letohl(tvb, offset);
         offset += 4;
-        offset += 24; /* destination request, source descriptor, source descriptor */
+        rdma_dst_req64 = tvb_get_letoh64(tvb, offset);
+        offset += 8;
+        rdma_src_des64 = tvb_get_letoh64(tvb, offset);
+        offset += 16; /* source descriptor, receive request */
         rdma_rdma_offset = tvb_get_letoh64(tvb, offset);
         offset += 8;
         rdma_seg_addr64 = tvb_get_letoh64(tvb, offset);
@@ -1835,7 +3219,10 @@ dissect_mpi_rdma(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
         }
         rdma_seg_cnt = tvb_get_ntohl(tvb, offset);
         offset += 4;
-        offset += 24; /* destination request, source descriptor, source descriptor */
+        rdma_dst_req64 = tvb_get_ntoh64(tvb, offset);
+        offset += 8;
+        rdma_src_des64 = tvb_get_ntoh64(tvb, offset);
+        offset += 16; /* source descriptor, receive request */
         rdma_rdma_offset = tvb_get_ntoh64(tvb, offset);
         offset += 8;
         rdma_seg_addr64 = tvb_get_ntoh64(tvb, offset);
@@ -1849,6 +3236,10 @@ dissect_mpi_rdma(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
             " Seg-Addr=0x%016" G_GINT64_MODIFIER "x"
             " Seg-Len=%" G_GINT64_MODIFIER "u",
             rdma_seg_cnt, rdma_rdma_offset, rdma_seg_addr64, rdma_seg_len);
+    mpi_tap_info->dst_req = rdma_dst_req64;
+    mpi_tap_info->des = rdma_src_des64;
+    mpi_tap_info->frag_offset = rdma_rdma_offset;
+    mpi_tap_info->seg_len = rdma_seg_len;
 
     if (tree) {
         offset = the_offset;
@@ -1912,7 +3303,8 @@ dissect_mpi_rdma(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_
 }
 
 static int
-dissect_mpi_fin(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset)
+dissect_mpi_fin(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset,
+        mpi_tap_info_t *mpi_tap_info)
 {
     proto_item *ti = NULL;
     proto_tree *mpi_fin_tree = NULL;
@@ -1949,7 +3341,7 @@ dissect_mpi_fin(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_o
         /* space for match header 12 bytes (14 with padding) + 12 fin header */
         if (26 == tvb_reported_length(tvb) - offset ||
                 24 == tvb_reported_length(tvb) - offset) {
-            offset = dissect_mpi_match(tvb, pinfo, tree, offset);
+            offset = dissect_mpi_match(tvb, pinfo, tree, offset, NULL);
         }
         fin_fail = tvb_get_letohl(tvb, offset);
         offset += 4;
@@ -1969,7 +3361,7 @@ dissect_mpi_fin(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_o
         /* space for match header 12 bytes (14 with padding) + 12 fin header */
         if (26 == tvb_reported_length(tvb) - offset ||
                 24 == tvb_reported_length(tvb) - offset) {
-            offset = dissect_mpi_match(tvb, pinfo, tree, offset);
+            offset = dissect_mpi_match(tvb, pinfo, tree, offset, NULL);
         }
         fin_fail = tvb_get_ntohl(tvb, offset);
         offset += 4;
@@ -1982,6 +3374,7 @@ dissect_mpi_fin(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_o
     col_append_fstr(pinfo->cinfo, COL_INFO,
             " Failed=%d Descriptor=0x%016" G_GINT64_MODIFIER "x",
             fin_fail, fin_des64);
+    mpi_tap_info->des = fin_des64;
 
     if (tree) {
         offset = the_offset;
@@ -2010,137 +3403,958 @@ dissect_mpi_fin(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_o
                 "descriptor: 0x%016" G_GINT64_MODIFIER "x, ",
                 fin_fail, fin_des32_1, fin_des32_2, fin_des64);
     }
-    return offset;
+    return offset;
+}
+
+static int
+dissect_mpi_rndvrestartnotify(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset)
+{
+    proto_item *ti = NULL;
+    proto_tree *mpi_rndvrestartnotify_tree = NULL;
+    guint32 byte_order;
+    guint offset;
+    guint64 rndvrestartnotify_padding;
+    guint8 rndvrestartnotify_restartseq;
+    guint64 rndvrestartnotify_src_req64;
+    guint64 rndvrestartnotify_dst_req64;
+    guint32 rndvrestartnotify_dst_rank;
+    guint32 rndvrestartnotify_jobid;
+    guint32 rndvrestartnotify_vpid;
+
+    /* too small for the minimum match header (12 bytes)
+     * + restart header (29 bytes)*/
+    if (41 > tvb_reported_length(tvb) - the_offset) {
+        return the_offset;
+    }
+
+    if (MPI_DEBUG)
+        g_print("%d dissect_mpi_rndvrestartnotify, reported_length: %d, "
+                "offset: %d, tree: %s\n",
+                pinfo->fd->num, tvb_reported_length(tvb), the_offset,
+                tree ? "true":"false");
+
+    the_offset = dissect_mpi_match(tvb, pinfo, tree, the_offset, NULL);
+
+    offset = the_offset;
+    rndvrestartnotify_padding = 1;
+
+    rndvrestartnotify_restartseq = tvb_get_guint8(tvb, offset);
+    offset += 1;
+
+    if (pref_little_endian) {
+        byte_order = ENC_LITTLE_ENDIAN;
+        if (31 <= tvb_reported_length(tvb) - offset) {
+            rndvrestartnotify_padding = tvb_get_letoh48(tvb, offset);
+            if (0 == rndvrestartnotify_padding) {
+                offset += 3;
+            }
+        }
+        rndvrestartnotify_src_req64 = tvb_get_letoh64(tvb, offset);
+        offset += 8;
+        rndvrestartnotify_dst_req64 = tvb_get_letoh64(tvb, offset);
+        offset += 8;
+        rndvrestartnotify_dst_rank = tvb_get_letohl(tvb, offset);
+        offset += 4;
+        rndvrestartnotify_jobid = tvb_get_letohl(tvb, offset);
+        offset += 4;
+        rndvrestartnotify_vpid = tvb_get_letohl(tvb, offset);
+        offset += 4;
+    } else {
+        byte_order = ENC_BIG_ENDIAN;
+        if (31 <= tvb_reported_length(tvb) - offset) {
+            rndvrestartnotify_padding = tvb_get_ntoh48(tvb, offset);
+            if (0 == rndvrestartnotify_padding) {
+                offset += 3;
+            }
+        }
+        rndvrestartnotify_src_req64 = tvb_get_ntoh64(tvb, offset);
+        offset += 8;
+        rndvrestartnotify_dst_req64 = tvb_get_ntoh64(tvb, offset);
+        offset += 8;
+        rndvrestartnotify_dst_rank = tvb_get_ntohl(tvb, offset);
+        offset += 4;
+        rndvrestartnotify_jobid = tvb_get_ntohl(tvb, offset);
+        offset += 4;
+        rndvrestartnotify_vpid = tvb_get_ntohl(tvb, offset);
+        offset += 4;
+    }
+
+    col_append_fstr(pinfo->cinfo, COL_INFO,
+            " Restart-Seq=%d Dst-Vpid=%d Jobid=%d Vpid=%d"
+            " Src-Req=0x%016" G_GINT64_MODIFIER "x"
+            " Dst-Req=0x%016" G_GINT64_MODIFIER"x",
+            rndvrestartnotify_restartseq, rndvrestartnotify_dst_rank,
+            rndvrestartnotify_jobid, rndvrestartnotify_vpid,
+            rndvrestartnotify_src_req64, rndvrestartnotify_dst_req64);
+
+    if (tree) {
+        offset = the_offset;
+        mpi_rndvrestartnotify_tree = proto_tree_add_subtree(tree, tvb, 0, 0,
+                ett_mpi_rndvrestartnotify, &ti,
+                "BTL Restart Rendezvous Header: ");
+
+        if (0 == rndvrestartnotify_padding) {
+            proto_tree_add_item(mpi_rndvrestartnotify_tree,
+                    hf_mpi_padding3,
+                    tvb, offset, 3, byte_order);
+            offset += 3;
+        }
+
+        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_src_req32_1, tvb,
+                offset, 4, byte_order);
+        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_src_req32_2, tvb,
+                offset + 4, 4, byte_order);
+        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_src_req64, tvb,
+                offset, 8, byte_order);
+        offset += 8;
+        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_dst_req32_1, tvb,
+                offset, 4, byte_order);
+        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_dst_req32_2, tvb,
+                offset + 4, 4, byte_order);
+        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_dst_req64, tvb,
+                offset, 8, byte_order);
+        offset += 8;
+        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_dst_vpid, tvb,
+                offset, 4, byte_order);
+        offset += 4;
+        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_jobid, tvb,
+                offset, 4, byte_order);
+        offset += 4;
+        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_vpid, tvb,
+                offset, 4, byte_order);
+        offset += 4;
+
+        proto_item_append_text(ti,
+                "restartseq: %d, dst_vpid: %d, jobid: %d, vpid: %d"
+                "src_req: 0x%016" G_GINT64_MODIFIER "x, "
+                "dst_req: 0x%016" G_GINT64_MODIFIER "x, ",
+                rndvrestartnotify_restartseq, rndvrestartnotify_dst_rank,
+                rndvrestartnotify_jobid, rndvrestartnotify_vpid,
+                rndvrestartnotify_src_req64, rndvrestartnotify_dst_req64);
+    }
+    return offset;
+}
+
+/*
+ * The key of the entry ta found at frame, the acked table of the TCP
+ * analysis does not keep it: the first frame after low finding ta again.
+ */
+static guint32
+mpi_tcp_acked_frame(wmem_tree_t *acked_table, const struct tcp_acked *ta,
+        guint32 low, guint32 frame)
+{
+    guint32 mid;
+
+    while (low + 1 < frame) {
+        mid = low + (frame - low) / 2;
+        if (wmem_tree_lookup32_le(acked_table, mid) == ta) {
+            frame = mid;
+        } else {
+            low = mid;
+        }
+    }
+    return frame;
+}
+
+/*
+ * The TCP analysis keeps its flags per frame of the connection, the frames
+ * since the previous BTL PDU are checked for retransmissions, duplicate
+ * ACKs and zero windows: the PDU was queued behind them. Only the frames
+ * of this connection in the acked table are visited, backwards from the
+ * PDU. The delay of a retransmission is the time since the original
+ * segment, a zero window blocked the sender until the next window update
+ * or the next zero window, the PDU at the latest. A single pass knows the
+ * times of the recent frames only, an older zero window counts since the
+ * previous PDU. The delay is limited to the time since the previous PDU.
+ */
+static mpi_tcp_events_t *
+mpi_tcp_scan(packet_info *pinfo)
+{
+    conversation_t *conversation;
+    struct tcp_analysis *tcpd;
+    struct tcp_acked *ta;
+    mpi_info_t *mpi_info;
+    mpi_tcp_events_t ev;
+    mpi_tcp_events_t *tcpev;
+    const nstime_t *ts;
+    nstime_t open;
+    nstime_t since;
+    nstime_t zero;
+    nstime_t gap;
+    guint32 frame;
+
+    if (pinfo->fd->flags.visited) {
+        return (mpi_tcp_events_t *)p_get_proto_data(wmem_file_scope(), pinfo,
+                proto_mpi, MPI_PDATA_KEY(MPI_PDATA_TCP, 0));
+    }
+
+    conversation = find_or_create_conversation(pinfo);
+    tcpd = get_tcp_conversation_data(conversation, pinfo);
+    if (!tcpd || !tcpd->acked_table) {
+        return NULL;
+    }
+    mpi_info = (mpi_info_t *)conversation_get_proto_data(conversation,
+            proto_mpi);
+    if (!mpi_info) {
+        /* the sync handshake was not captured */
+        mpi_info = mpi_info_new(conversation);
+        mpi_info_touch(mpi_info, &pinfo->fd->abs_ts);
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    open = pinfo->fd->abs_ts;
+    frame = pinfo->fd->num;
+    while (frame > mpi_info->tcp_scanned) {
+        ta = (struct tcp_acked *)wmem_tree_lookup32_le(tcpd->acked_table,
+                frame);
+        if (!ta || ta == wmem_tree_lookup32_le(tcpd->acked_table,
+                    mpi_info->tcp_scanned)) {
+            break;
+        }
+        frame = mpi_tcp_acked_frame(tcpd->acked_table, ta,
+                mpi_info->tcp_scanned, frame);
+        /* in a single pass the times of the older frames are gone */
+        ts = epan_get_frame_ts(pinfo->epan, frame);
+        if (ta->flags & (TCP_A_RETRANSMISSION | TCP_A_FAST_RETRANSMISSION)) {
+            ev.retrans++;
+            if (ta->rto_frame) {
+                nstime_add(&ev.delay, &ta->rto_ts);
+            }
+        }
+        if (ta->flags & TCP_A_DUPLICATE_ACK) {
+            ev.dupacks++;
+        }
+        if (ta->flags & TCP_A_ZERO_WINDOW) {
+            ev.zero_windows++;
+            /* without its time since the previous PDU at most */
+            since = ts ? *ts : mpi_info->tcp_prev_time;
+            if (!nstime_is_zero(&since)) {
+                nstime_delta(&zero, &open, &since);
+                nstime_add(&ev.delay, &zero);
+                open = since;
+            }
+        } else if (ts && (ta->flags & TCP_A_WINDOW_UPDATE)) {
+            open = *ts;
+        }
+        frame--;
+    }
+    mpi_info->tcp_scanned = pinfo->fd->num;
+
+    if (!nstime_is_zero(&mpi_info->tcp_prev_time)) {
+        nstime_delta(&gap, &pinfo->fd->abs_ts, &mpi_info->tcp_prev_time);
+        if (nstime_cmp(&ev.delay, &gap) > 0) {
+            ev.delay = gap;
+        }
+    }
+    mpi_info->tcp_prev_time = pinfo->fd->abs_ts;
+
+    if (!MPI_TCP_EVENTS(&ev)) {
+        return NULL;
+    }
+    tcpev = (mpi_tcp_events_t *)mpi_frame_alloc(sizeof(ev));
+    *tcpev = ev;
+    mpi_frame_add(pinfo, MPI_PDATA_KEY(MPI_PDATA_TCP, 0), tcpev);
+
+    return tcpev;
+}
+
+static void
+mpi_tcp_add_tree(proto_tree *tree, tvbuff_t *tvb, const mpi_tcp_events_t *tcpev,
+        const char *during)
+{
+    proto_item *it;
+    proto_tree *mpi_tcp_tree;
+
+    mpi_tcp_tree = proto_tree_add_subtree_format(tree, tvb, 0, 0, ett_mpi_tcp,
+            &it, "TCP events %s: %u retransmissions, %u duplicate ACKs, "
+            "%u zero windows", during, tcpev->retrans, tcpev->dupacks,
+            tcpev->zero_windows);
+    PROTO_ITEM_SET_GENERATED(it);
+    it = proto_tree_add_uint(mpi_tcp_tree, hf_mpi_tcp_retrans, tvb, 0, 0,
+            tcpev->retrans);
+    PROTO_ITEM_SET_GENERATED(it);
+    it = proto_tree_add_uint(mpi_tcp_tree, hf_mpi_tcp_dupacks, tvb, 0, 0,
+            tcpev->dupacks);
+    PROTO_ITEM_SET_GENERATED(it);
+    it = proto_tree_add_uint(mpi_tcp_tree, hf_mpi_tcp_zero_windows, tvb, 0, 0,
+            tcpev->zero_windows);
+    PROTO_ITEM_SET_GENERATED(it);
+    it = proto_tree_add_time(mpi_tcp_tree, hf_mpi_tcp_delay, tvb, 0, 0,
+            &tcpev->delay);
+    PROTO_ITEM_SET_GENERATED(it);
+}
+
+/*
+ * The channel of a BTL PDU is known once the sync handshake of its
+ * connection was seen. The MATCH sequence numbers of a communicator grow
+ * per direction over all links, one behind the highest seen was overtaken
+ * by a message on another link and waits in the unexpected queue.
+ */
+static mpi_channel_pdu_t *
+mpi_channel_correlate(packet_info *pinfo, mpi_tap_info_t *mpi_tap_info)
+{
+    conversation_t *conversation;
+    mpi_info_t *mpi_info;
+    mpi_channel_pdu_t *cpdu;
+    mpi_channel_seq_t *seq;
+    const mpi_oob_name_t *name;
+    GHashTable *seqs;
+
+    if (pinfo->fd->flags.visited) {
+        return (mpi_channel_pdu_t *)p_get_proto_data(wmem_file_scope(), pinfo,
+                proto_mpi, MPI_PDATA_KEY(MPI_PDATA_CHANNEL, 0));
+    }
+
+    conversation = find_conversation(pinfo->fd->num, &pinfo->src, &pinfo->dst,
+            pinfo->ptype, pinfo->srcport, pinfo->destport, 0);
+    if (!conversation) {
+        return NULL;
+    }
+    mpi_info = (mpi_info_t *)conversation_get_proto_data(conversation,
+            proto_mpi);
+    if (!mpi_info) {
+        return NULL;
+    }
+    mpi_info_touch(mpi_info, &pinfo->fd->abs_ts);
+    if (!mpi_info->channel) {
+        return NULL;
+    }
+
+    cpdu = (mpi_channel_pdu_t *)mpi_frame_alloc(sizeof(mpi_channel_pdu_t));
+    cpdu->channel = mpi_info->channel;
+    cpdu->link = mpi_info->link;
+    cpdu->links = mpi_info->channel->links;
+    name = &cpdu->channel->names[0];
+    if (pinfo->srcport == mpi_info->req_port) {
+        cpdu->sender = (name->jobid == mpi_info->req_jobid &&
+                name->vpid == mpi_info->req_vpid) ? 0 : 1;
+    } else {
+        cpdu->sender = (name->jobid == mpi_info->req_jobid &&
+                name->vpid == mpi_info->req_vpid) ? 1 : 0;
+    }
+
+    if (mpi_tap_info->matched) {
+        seqs = cpdu->channel->seqs[cpdu->sender];
+        seq = (mpi_channel_seq_t *)g_hash_table_lookup(seqs,
+                GUINT_TO_POINTER(mpi_tap_info->match_ctx));
+        if (!seq) {
+            seq = g_new0(mpi_channel_seq_t, 1);
+            g_hash_table_insert(seqs,
+                    GUINT_TO_POINTER(mpi_tap_info->match_ctx), seq);
+        } else if (0 > (gint16)(mpi_tap_info->match_seq - seq->next)) {
+            cpdu->reordered_after = seq->frame;
+            cpdu->reordered_seq = seq->next - 1;
+            cpdu->reordered_link = seq->link;
+            seq = NULL;
+        }
+        if (seq) {
+            seq->next = mpi_tap_info->match_seq + 1;
+            seq->frame = pinfo->fd->num;
+            seq->link = cpdu->link;
+        }
+    }
+
+    mpi_frame_add(pinfo, MPI_PDATA_KEY(MPI_PDATA_CHANNEL, 0), cpdu);
+
+    return cpdu;
+}
+
+static guint
+mpi_xfer_hash(gconstpointer v)
+{
+    const mpi_xfer_key_t *key = (const mpi_xfer_key_t *)v;
+
+    return (guint)(key->ptr ^ (key->ptr >> 32)) ^ key->owner;
+}
+
+static gboolean
+mpi_xfer_equal(gconstpointer v, gconstpointer v2)
+{
+    const mpi_xfer_key_t *key1 = (const mpi_xfer_key_t *)v;
+    const mpi_xfer_key_t *key2 = (const mpi_xfer_key_t *)v2;
+
+    return key1->ptr == key2->ptr && key1->owner == key2->owner;
+}
+
+static void
+mpi_xfer_set_key(mpi_xfer_key_t *key, guint64 ptr, guint32 owner)
+{
+    key->ptr = ptr;
+    key->owner = owner;
+}
+
+/*
+ * The process owning the requests or descriptors sent by (or to) the
+ * sender of a BTL PDU. The process name is the same on all links of a
+ * channel. Without the channel a sync request may still name the
+ * connecting process, else its TCP endpoint stands in for it: the address
+ * alone is shared by all processes of a host.
+ */
+static guint32
+mpi_xfer_owner(packet_info *pinfo, const mpi_channel_pdu_t *cpdu,
+        const mpi_info_t *mpi_info, gboolean sender)
+{
+    const mpi_oob_name_t *name;
+    mpi_oob_name_t req;
+    const address *addr;
+    guint32 port;
+    guint8 ep[16 + 2];
+    guint32 len;
+
+    if (cpdu) {
+        name = &cpdu->channel->names[sender ? cpdu->sender : 1 - cpdu->sender];
+        return mpi_fnv1a((const guint8 *)name, sizeof(mpi_oob_name_t));
+    }
+    addr = sender ? &pinfo->src : &pinfo->dst;
+    port = sender ? pinfo->srcport : pinfo->destport;
+    if (mpi_info && mpi_info->req_port && port == mpi_info->req_port) {
+        req.jobid = mpi_info->req_jobid;
+        req.vpid = mpi_info->req_vpid;
+        return mpi_fnv1a((const guint8 *)&req, sizeof(mpi_oob_name_t));
+    }
+    len = MIN((guint32)addr->len, 16);
+    memcpy(ep, addr->data, len);
+    ep[len++] = (guint8)(port >> 8);
+    ep[len++] = (guint8)port;
+    return mpi_fnv1a(ep, len);
+}
+
+static gpointer
+mpi_xfer_lookup(GHashTable *table, guint64 ptr, guint32 owner)
+{
+    mpi_xfer_key_t key;
+
+    mpi_xfer_set_key(&key, ptr, owner);
+    return g_hash_table_lookup(table, &key);
+}
+
+static void
+mpi_xfer_insert(GHashTable *table, guint64 ptr, guint32 owner, gpointer value)
+{
+    mpi_xfer_key_t *key;
+
+    key = wmem_new(wmem_file_scope(), mpi_xfer_key_t);
+    mpi_xfer_set_key(key, ptr, owner);
+    g_hash_table_insert(table, key, value);
+}
+
+/* the key is file scoped, so is the value of a descriptor */
+static void
+mpi_xfer_remove(GHashTable *table, const mpi_xfer_key_t *key, gboolean value)
+{
+    gpointer orig_key;
+    gpointer orig_value;
+
+    if (g_hash_table_lookup_extended(table, key, &orig_key, &orig_value)) {
+        g_hash_table_remove(table, key);
+        wmem_free(wmem_file_scope(), orig_key);
+        if (value) {
+            wmem_free(wmem_file_scope(), orig_value);
+        }
+    }
+}
+
+static void
+mpi_xfer_insert_des(guint64 des, guint32 owner, mpi_xfer_t *xfer,
+        guint64 len, gboolean put)
+{
+    mpi_xfer_des_t *xdes;
+    mpi_xfer_key_t key;
+
+    /* a reused descriptor replaces the one of an unfinished transfer */
+    mpi_xfer_set_key(&key, des, owner);
+    xdes = (mpi_xfer_des_t *)g_hash_table_lookup(mpi_xfer_dess, &key);
+    if (xdes) {
+        xdes->xfer->dess--;
+        mpi_xfer_remove(mpi_xfer_dess, &key, TRUE);
+    }
+    xdes = wmem_new(wmem_file_scope(), mpi_xfer_des_t);
+    xdes->xfer = xfer;
+    xdes->len = len;
+    xdes->put = put;
+    mpi_xfer_insert(mpi_xfer_dess, des, owner, xdes);
+    xfer->dess++;
+}
+
+static gboolean
+mpi_xfer_des_of(gpointer key, gpointer value, gpointer user_data)
+{
+    if (((mpi_xfer_des_t *)value)->xfer != (mpi_xfer_t *)user_data) {
+        return FALSE;
+    }
+    wmem_free(wmem_file_scope(), key);
+    wmem_free(wmem_file_scope(), value);
+    return TRUE;
+}
+
+/* a finished transfer leaves the tables, its PDUs keep it */
+static void
+mpi_xfer_finish(mpi_xfer_t *xfer)
+{
+    if (g_hash_table_lookup(mpi_xfer_reqs, &xfer->req) == xfer) {
+        mpi_xfer_remove(mpi_xfer_reqs, &xfer->req, FALSE);
+    }
+    if (xfer->dess) {
+        g_hash_table_foreach_remove(mpi_xfer_dess, mpi_xfer_des_of, xfer);
+        xfer->dess = 0;
+    }
+}
+
+/*
+ * The send request (src_req) of the RNDV is repeated by the ACK and the
+ * FRAGs, and as destination request by the PUTs from the receiver. A PUT
+ * (or the RGET) hands out a descriptor, the FIN returns it to its owner.
+ * The pml_ob1 pipeline mixes FRAGs and PUTs in one transfer, it is
+ * finished once the eager data, the FRAGs and the PUTs finished by a FIN
+ * add up to the message length. A RGET is finished by its FIN. Requests
+ * and descriptors are pointers of the owning process, so its name (or
+ * address) is a part of the key and a transfer may use all links of a
+ * channel.
+ *
+ * The receiver keeps several PUTs in flight (pml_ob1 pipeline), the depth
+ * is the number of PUTs without FIN. A PUT issued after all earlier ones
+ * were finished found the pipeline drained, this and a gap longer than
+ * pref_pipe_stall between two PDUs of the transfer are stalls. FRAGs are
+ * not acknowledged, only their gaps are known.
+ */
+static mpi_xfer_frame_t *
+mpi_xfer_correlate(packet_info *pinfo, mpi_tap_info_t *mpi_tap_info,
+        const mpi_channel_pdu_t *cpdu, const mpi_tcp_events_t *tcpev)
+{
+    mpi_xfer_frame_t *xframe;
+    mpi_xfer_t *xfer = NULL;
+    mpi_xfer_des_t *xdes = NULL;
+    mpi_xfer_key_t des_key;
+    conversation_t *conversation;
+    const mpi_info_t *mpi_info = NULL;
+    guint32 src;
+    guint32 dst;
+
+    if (!cpdu) {
+        conversation = find_conversation(pinfo->fd->num, &pinfo->src,
+                &pinfo->dst, pinfo->ptype, pinfo->srcport, pinfo->destport, 0);
+        if (conversation) {
+            mpi_info = (const mpi_info_t *)conversation_get_proto_data(
+                    conversation, proto_mpi);
+        }
+    }
+    src = mpi_xfer_owner(pinfo, cpdu, mpi_info, TRUE);
+    dst = mpi_xfer_owner(pinfo, cpdu, mpi_info, FALSE);
+    /* a FIN goes to the process that registered the descriptor */
+    if (mpi_tap_info->des) {
+        mpi_tap_info->des_owner =
+            MPI_PML_OB1_HDR_TYPE_FIN == mpi_tap_info->base ? dst : src;
+    }
+
+    if (pinfo->fd->flags.visited) {
+        return (mpi_xfer_frame_t *)p_get_proto_data(wmem_file_scope(), pinfo,
+                proto_mpi, MPI_PDATA_KEY(MPI_PDATA_XFER, 0));
+    }
+
+    switch (mpi_tap_info->base) {
+        case MPI_PML_BFO_HDR_TYPE_RNDV:
+        case MPI_PML_OB1_HDR_TYPE_RGET:
+            if (0 == mpi_tap_info->src_req || 0 == mpi_tap_info->msg_len) {
+                return NULL;
+            }
+            xfer = wmem_new0(wmem_file_scope(), mpi_xfer_t);
+            mpi_xfer_set_key(&xfer->req, mpi_tap_info->src_req, src);
+            xfer->msg_len = mpi_tap_info->msg_len;
+            xfer->rndv_frame = pinfo->fd->num;
+            xfer->rndv_time = pinfo->fd->abs_ts;
+            xfer->last_time = pinfo->fd->abs_ts;
+            xfer->done = mpi_tap_info->payload; /* eager data */
+            mpi_xfer_insert(mpi_xfer_reqs, mpi_tap_info->src_req, src,
+                    xfer);
+            if (mpi_tap_info->des) {
+                mpi_xfer_insert_des(mpi_tap_info->des, src, xfer,
+                        xfer->msg_len, FALSE);
+            }
+            break;
+        case MPI_PML_OB1_HDR_TYPE_ACK:
+            if (0 == mpi_tap_info->src_req) {
+                return NULL;
+            }
+            /* from the receiver back to the sender of the RNDV */
+            xfer = (mpi_xfer_t *)mpi_xfer_lookup(mpi_xfer_reqs,
+                    mpi_tap_info->src_req, dst);
+            break;
+        case MPI_PML_OB1_HDR_TYPE_FRAG:
+            if (0 == mpi_tap_info->src_req) {
+                return NULL;
+            }
+            xfer = (mpi_xfer_t *)mpi_xfer_lookup(mpi_xfer_reqs,
+                    mpi_tap_info->src_req, src);
+            break;
+        case MPI_PML_OB1_HDR_TYPE_PUT:
+            if (0 == mpi_tap_info->dst_req) {
+                return NULL;
+            }
+            xfer = (mpi_xfer_t *)mpi_xfer_lookup(mpi_xfer_reqs,
+                    mpi_tap_info->dst_req, dst);
+            if (xfer && !xfer->end_frame && mpi_tap_info->des) {
+                mpi_xfer_insert_des(mpi_tap_info->des, src, xfer,
+                        mpi_tap_info->seg_len, TRUE);
+            }
+            break;
+        case MPI_PML_OB1_HDR_TYPE_FIN:
+            if (0 == mpi_tap_info->des) {
+                return NULL;
+            }
+            mpi_xfer_set_key(&des_key, mpi_tap_info->des, dst);
+            xdes = (mpi_xfer_des_t *)g_hash_table_lookup(mpi_xfer_dess,
+                    &des_key);
+            if (xdes) {
+                xfer = xdes->xfer;
+            }
+            break;
+        default:
+            return NULL;
+    }
+    if (!xfer || xfer->end_frame) {
+        return NULL;
+    }
+
+    xframe = (mpi_xfer_frame_t *)mpi_frame_alloc(sizeof(mpi_xfer_frame_t));
+    xframe->xfer = xfer;
+    nstime_delta(&xframe->gap, &pinfo->fd->abs_ts, &xfer->last_time);
+    xfer->last_time = pinfo->fd->abs_ts;
+
+    /* the events before the RNDV held up the transfer before it began */
+    if (tcpev && xfer->rndv_frame != pinfo->fd->num) {
+        xfer->tcp.retrans += tcpev->retrans;
+        xfer->tcp.dupacks += tcpev->dupacks;
+        xfer->tcp.zero_windows += tcpev->zero_windows;
+        nstime_add(&xfer->tcp.delay, &tcpev->delay);
+    }
+    switch (mpi_tap_info->base) {
+        case MPI_PML_OB1_HDR_TYPE_ACK:
+            if (!xfer->ack_frame) {
+                xfer->ack_frame = pinfo->fd->num;
+            }
+            break;
+        case MPI_PML_OB1_HDR_TYPE_FRAG:
+            xframe->index = ++xfer->frags;
+            xframe->stall = 1 < xframe->index &&
+                nstime_to_msec(&xframe->gap) > pref_pipe_stall;
+            xfer->done += mpi_tap_info->payload;
+            if (xfer->done >= xfer->msg_len) {
+                xfer->end_frame = pinfo->fd->num;
+            }
+            break;
+        case MPI_PML_OB1_HDR_TYPE_PUT:
+            xframe->index = ++xfer->frags;
+            xframe->stall = 1 < xframe->index && (0 == xfer->depth ||
+                    nstime_to_msec(&xframe->gap) > pref_pipe_stall);
+            xfer->depth++;
+            break;
+        case MPI_PML_OB1_HDR_TYPE_FIN:
+            if (xdes->put) {
+                if (xfer->depth) {
+                    xfer->depth--;
+                }
+                xfer->done += xdes->len;
+                if (xfer->done >= xfer->msg_len) {
+                    xfer->end_frame = pinfo->fd->num;
+                }
+            } else {
+                xfer->done = MAX(xfer->done, xdes->len);
+                xfer->end_frame = pinfo->fd->num;
+            }
+            /* a FIN is sent once for every descriptor */
+            xfer->dess--;
+            mpi_xfer_remove(mpi_xfer_dess, &des_key, TRUE);
+            break;
+        default:
+            break;
+    }
+    xframe->depth = xfer->depth;
+
+    if (xfer->end_frame) {
+        nstime_delta(&xfer->duration, &pinfo->fd->abs_ts, &xfer->rndv_time);
+        mpi_xfer_finish(xfer);
+    }
+
+    mpi_frame_add(pinfo, MPI_PDATA_KEY(MPI_PDATA_XFER, 0), xframe);
+
+    return xframe;
+}
+
+/*
+ * Eviction of the first pass state (pref_state_horizon) for captures
+ * running for days, in a single pass only (mpi.single_pass), the GUI and
+ * a second pass come back to every frame. Dropped are the items idle for
+ * longer than the horizon: open transfers and descriptors, BTL and OOB
+ * connections (closed ones are idle from their end on) with their sync
+ * requests and message states, channels without a link in use, XCASTs
+ * and the heartbeat state of daemons gone silent. The message keys of the
+ * frames before the previous sweep go as well. The sweeps are a horizon
+ * apart (capture time), so an item goes after one or two horizons.
+ * -z mpi,find finds the recent frames only.
+ */
+static gboolean
+mpi_evict_xfer(gpointer key, gpointer value, gpointer user_data)
+{
+    mpi_xfer_t *xfer = (mpi_xfer_t *)value;
+
+    if (0 <= nstime_cmp(&xfer->last_time, (const nstime_t *)user_data)) {
+        return FALSE;
+    }
+    /* its descriptors went before, no frame comes back to it */
+    wmem_free(wmem_file_scope(), key);
+    wmem_free(wmem_file_scope(), xfer);
+    mpi_evict_stats.xfers_evicted++;
+    return TRUE;
+}
+
+static gboolean
+mpi_evict_des(gpointer key, gpointer value, gpointer user_data)
+{
+    mpi_xfer_des_t *xdes = (mpi_xfer_des_t *)value;
+
+    if (0 <= nstime_cmp(&xdes->xfer->last_time, (const nstime_t *)user_data)) {
+        return FALSE;
+    }
+    xdes->xfer->dess--;
+    wmem_free(wmem_file_scope(), key);
+    wmem_free(wmem_file_scope(), xdes);
+    mpi_evict_stats.dess_evicted++;
+    return TRUE;
+}
+
+static gboolean
+mpi_evict_info(gpointer key, gpointer value _U_, gpointer user_data)
+{
+    mpi_info_t *mpi_info = (mpi_info_t *)key;
+
+    if (0 <= nstime_cmp(&mpi_info->last_time, (const nstime_t *)user_data)) {
+        return FALSE;
+    }
+    /* freed by the table */
+    conversation_delete_proto_data(mpi_info->conversation, proto_mpi);
+    mpi_evict_stats.conns_evicted++;
+    return TRUE;
+}
+
+static gboolean
+mpi_evict_oob_trans(gpointer key, gpointer value _U_, gpointer user_data)
+{
+    mpi_oob_trans_t *mpi_oob_trans = (mpi_oob_trans_t *)key;
+
+    if (0 <= nstime_cmp(&mpi_oob_trans->last_time,
+                (const nstime_t *)user_data)) {
+        return FALSE;
+    }
+    conversation_delete_proto_data(mpi_oob_trans->conversation, proto_mpi);
+    mpi_evict_stats.oob_conns_evicted++;
+    return TRUE;
+}
+
+/* the links of a channel were used before it, they went already */
+static gboolean
+mpi_evict_channel(gpointer key _U_, gpointer value, gpointer user_data)
+{
+    mpi_channel_t *channel = (mpi_channel_t *)value;
+
+    if (0 <= nstime_cmp(&channel->last_time, (const nstime_t *)user_data)) {
+        return FALSE;
+    }
+    mpi_evict_stats.channels_evicted++;
+    return TRUE;
+}
+
+static gboolean
+mpi_evict_xcast(gpointer key _U_, gpointer value, gpointer user_data)
+{
+    mpi_xcast_t *xcast = (mpi_xcast_t *)value;
+
+    if (0 <= nstime_cmp(&xcast->last_time, (const nstime_t *)user_data)) {
+        return FALSE;
+    }
+    mpi_evict_stats.xcasts_evicted++;
+    return TRUE;
+}
+
+static gboolean
+mpi_evict_hb_daemon(gpointer key _U_, gpointer value, gpointer user_data)
+{
+    mpi_hb_daemon_t *daemon = (mpi_hb_daemon_t *)value;
+
+    if (0 <= nstime_cmp(&daemon->last_time, (const nstime_t *)user_data)) {
+        return FALSE;
+    }
+    mpi_evict_stats.hb_daemons_evicted++;
+    return TRUE;
+}
+
+/* drop the keys of frames before "frame", the array keeps its order */
+static guint
+mpi_evict_keys(GArray *keys, guint size, glong frame_offset, guint32 frame)
+{
+    guint i;
+    guint n = 0;
+
+    for (i = 0; i < keys->len; i++) {
+        if (G_STRUCT_MEMBER(guint32, keys->data + i * size, frame_offset) <
+                frame) {
+            continue;
+        }
+        if (n != i) {
+            memcpy(keys->data + n * size, keys->data + i * size, size);
+        }
+        n++;
+    }
+    i = keys->len - n;
+    g_array_set_size(keys, n);
+    return i;
 }
 
-static int
-dissect_mpi_rndvrestartnotify(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint the_offset)
+static void
+mpi_evict(packet_info *pinfo)
 {
-    proto_item *ti = NULL;
-    proto_tree *mpi_rndvrestartnotify_tree = NULL;
-    guint32 byte_order;
-    guint offset;
-    guint64 rndvrestartnotify_padding;
-    guint8 rndvrestartnotify_restartseq;
-    guint64 rndvrestartnotify_src_req64;
-    guint64 rndvrestartnotify_dst_req64;
-    guint32 rndvrestartnotify_dst_rank;
-    guint32 rndvrestartnotify_jobid;
-    guint32 rndvrestartnotify_vpid;
+    nstime_t since;
+    nstime_t horizon;
 
-    /* too small for the minimum match header (12 bytes)
-     * + restart header (29 bytes)*/
-    if (41 > tvb_reported_length(tvb) - the_offset) {
-        return the_offset;
+    if (0 == pref_state_horizon || pinfo->fd->flags.visited ||
+            !pref_single_pass) {
+        return;
+    }
+    if (!mpi_evict_started) {
+        mpi_evict_started = TRUE;
+        mpi_evict_time = pinfo->fd->abs_ts;
+        mpi_evict_frame = pinfo->fd->num;
+        return;
+    }
+    nstime_delta(&since, &pinfo->fd->abs_ts, &mpi_evict_time);
+    if (since.secs < (time_t)pref_state_horizon) {
+        return;
     }
 
-    if (MPI_DEBUG)
-        g_print("%d dissect_mpi_rndvrestartnotify, reported_length: %d, "
-                "offset: %d, tree: %s\n",
-                pinfo->fd->num, tvb_reported_length(tvb), the_offset,
-                tree ? "true":"false");
+    horizon.secs = pref_state_horizon;
+    horizon.nsecs = 0;
+    nstime_delta(&since, &pinfo->fd->abs_ts, &horizon);
+
+    g_hash_table_foreach_remove(mpi_xfer_dess, mpi_evict_des, &since);
+    g_hash_table_foreach_remove(mpi_xfer_reqs, mpi_evict_xfer, &since);
+    g_hash_table_foreach_remove(mpi_infos, mpi_evict_info, &since);
+    g_hash_table_foreach_remove(mpi_channels, mpi_evict_channel, &since);
+    g_hash_table_foreach_remove(mpi_oob_transs, mpi_evict_oob_trans, &since);
+    g_hash_table_foreach_remove(mpi_xcasts, mpi_evict_xcast, &since);
+    g_hash_table_foreach_remove(mpi_hb_daemons, mpi_evict_hb_daemon, &since);
+    mpi_evict_stats.keys_evicted +=
+        mpi_evict_keys(mpi_msg_keys, sizeof(mpi_msg_key_t),
+                G_STRUCT_OFFSET(mpi_msg_key_t, frame), mpi_evict_frame) +
+        mpi_evict_keys(mpi_req_keys, sizeof(mpi_req_key_t),
+                G_STRUCT_OFFSET(mpi_req_key_t, frame), mpi_evict_frame);
+
+    mpi_evict_stats.sweeps++;
+    mpi_evict_time = pinfo->fd->abs_ts;
+    mpi_evict_frame = pinfo->fd->num;
+}
 
-    the_offset = dissect_mpi_match(tvb, pinfo, tree, the_offset);
+static void
+mpi_state_stats_oob(gpointer key, gpointer value _U_, gpointer user_data)
+{
+    *(guint *)user_data += g_hash_table_size(((mpi_oob_trans_t *)key)->old);
+}
 
-    offset = the_offset;
-    rndvrestartnotify_padding = 1;
+void
+mpi_state_stats(mpi_state_stats_t *stats)
+{
+    *stats = mpi_evict_stats;
+    stats->horizon = pref_state_horizon;
+    stats->one_pass = pref_single_pass;
+    stats->xfers = mpi_xfer_reqs ? g_hash_table_size(mpi_xfer_reqs) : 0;
+    stats->dess = mpi_xfer_dess ? g_hash_table_size(mpi_xfer_dess) : 0;
+    stats->conns = mpi_infos ? g_hash_table_size(mpi_infos) : 0;
+    stats->channels = mpi_channels ? g_hash_table_size(mpi_channels) : 0;
+    stats->oob_conns = mpi_oob_transs ? g_hash_table_size(mpi_oob_transs) : 0;
+    stats->xcasts = mpi_xcasts ? g_hash_table_size(mpi_xcasts) : 0;
+    stats->hb_daemons = mpi_hb_daemons ? g_hash_table_size(mpi_hb_daemons) : 0;
+    stats->oob_frames = 0;
+    if (mpi_oob_transs) {
+        g_hash_table_foreach(mpi_oob_transs, mpi_state_stats_oob,
+                &stats->oob_frames);
+    }
+    stats->keys = (mpi_msg_keys ? mpi_msg_keys->len : 0) +
+        (mpi_req_keys ? mpi_req_keys->len : 0);
+}
 
-    rndvrestartnotify_restartseq = tvb_get_guint8(tvb, offset);
-    offset += 1;
+static int
+dissect_mpi(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data);
 
-    if (pref_little_endian) {
-        byte_order = ENC_LITTLE_ENDIAN;
-        if (31 <= tvb_reported_length(tvb) - offset) {
-            rndvrestartnotify_padding = tvb_get_letoh48(tvb, offset);
-            if (0 == rndvrestartnotify_padding) {
-                offset += 3;
-            }
-        }
-        rndvrestartnotify_src_req64 = tvb_get_letoh64(tvb, offset);
-        offset += 8;
-        rndvrestartnotify_dst_req64 = tvb_get_letoh64(tvb, offset);
-        offset += 8;
-        rndvrestartnotify_dst_rank = tvb_get_letohl(tvb, offset);
-        offset += 4;
-        rndvrestartnotify_jobid = tvb_get_letohl(tvb, offset);
-        offset += 4;
-        rndvrestartnotify_vpid = tvb_get_letohl(tvb, offset);
-        offset += 4;
-    } else {
-        byte_order = ENC_BIG_ENDIAN;
-        if (31 <= tvb_reported_length(tvb) - offset) {
-            rndvrestartnotify_padding = tvb_get_ntoh48(tvb, offset);
-            if (0 == rndvrestartnotify_padding) {
-                offset += 3;
-            }
-        }
-        rndvrestartnotify_src_req64 = tvb_get_ntoh64(tvb, offset);
-        offset += 8;
-        rndvrestartnotify_dst_req64 = tvb_get_ntoh64(tvb, offset);
-        offset += 8;
-        rndvrestartnotify_dst_rank = tvb_get_ntohl(tvb, offset);
-        offset += 4;
-        rndvrestartnotify_jobid = tvb_get_ntohl(tvb, offset);
-        offset += 4;
-        rndvrestartnotify_vpid = tvb_get_ntohl(tvb, offset);
-        offset += 4;
+/* TCP saw a gap before the frame (tcp.analysis.lost_segment) */
+static gboolean
+mpi_tcp_lost(packet_info *pinfo, conversation_t *conversation)
+{
+    struct tcp_analysis *tcpd;
+    struct tcp_acked *ta;
+
+    tcpd = get_tcp_conversation_data(conversation, pinfo);
+    if (!tcpd || !tcpd->acked_table) {
+        return FALSE;
     }
+    ta = (struct tcp_acked *)wmem_tree_lookup32(tcpd->acked_table,
+            pinfo->fd->num);
+    return ta && (ta->flags & TCP_A_LOST_PACKET);
+}
 
-    col_append_fstr(pinfo->cinfo, COL_INFO,
-            " Restart-Seq=%d Dst-Vpid=%d Jobid=%d Vpid=%d"
-            " Src-Req=0x%016" G_GINT64_MODIFIER "x"
-            " Dst-Req=0x%016" G_GINT64_MODIFIER"x",
-            rndvrestartnotify_restartseq, rndvrestartnotify_dst_rank,
-            rndvrestartnotify_jobid, rndvrestartnotify_vpid,
-            rndvrestartnotify_src_req64, rndvrestartnotify_dst_req64);
+/*
+ * A segment not starting with a BTL header: the capture began in the
+ * middle of the connection or lost a segment. Else it continues a PDU,
+ * so a connection with a sync handshake is searched after a loss only.
+ * The first plausible header (mpi-scan.c) is dissected, on a connection
+ * without a sync handshake only if the header after it is plausible too.
+ */
+static int
+dissect_mpi_btl_resync(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data)
+{
+    conversation_t *conversation;
+    const mpi_info_t *mpi_info = NULL;
+    gboolean known;
+    guint len;
+    guint skipped;
+    int consumed;
+    proto_item *ti;
+    proto_item *it;
+
+    len = tvb_captured_length(tvb);
+    if (MPI_SCAN_HDR_LEN + 1 > len) {
+        return 0;
+    }
+    conversation = find_conversation(pinfo->fd->num, &pinfo->src, &pinfo->dst,
+            pinfo->ptype, pinfo->srcport, pinfo->destport, 0);
+    if (conversation) {
+        mpi_info = (const mpi_info_t *)conversation_get_proto_data(
+                conversation, proto_mpi);
+    }
+    /* mpi_tcp_scan() creates it without a sync as well */
+    known = mpi_info && (mpi_info->req_port || mpi_info->channel);
+    if (known && !mpi_tcp_lost(pinfo, conversation)) {
+        return 0;
+    }
 
-    if (tree) {
-        offset = the_offset;
-        mpi_rndvrestartnotify_tree = proto_tree_add_subtree(tree, tvb, 0, 0,
-                ett_mpi_rndvrestartnotify, &ti,
-                "BTL Restart Rendezvous Header: ");
+    skipped = (guint)mpi_scan_btl(tvb_get_ptr(tvb, 0, len), len, 1,
+            pref_little_endian, !known);
+    if (skipped >= len) {
+        return 0;
+    }
 
-        if (0 == rndvrestartnotify_padding) {
-            proto_tree_add_item(mpi_rndvrestartnotify_tree,
-                    hf_mpi_padding3,
-                    tvb, offset, 3, byte_order);
-            offset += 3;
-        }
+    /* a plausible header is dissected, the skipped bytes go first */
+    ti = proto_tree_add_item(tree, proto_mpi, tvb, 0, skipped, ENC_NA);
+    proto_item_append_text(ti, ", bytes before the first BTL header");
+    it = proto_tree_add_uint(proto_item_add_subtree(ti, ett_mpi),
+            hf_mpi_btl_skipped, tvb, 0, skipped, skipped);
+    expert_add_info_format(pinfo, it, &ei_mpi_btl_resync,
+            "%u bytes without a BTL header skipped", skipped);
 
-        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_src_req32_1, tvb,
-                offset, 4, byte_order);
-        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_src_req32_2, tvb,
-                offset + 4, 4, byte_order);
-        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_src_req64, tvb,
-                offset, 8, byte_order);
-        offset += 8;
-        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_dst_req32_1, tvb,
-                offset, 4, byte_order);
-        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_dst_req32_2, tvb,
-                offset + 4, 4, byte_order);
-        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_dst_req64, tvb,
-                offset, 8, byte_order);
-        offset += 8;
-        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_dst_vpid, tvb,
-                offset, 4, byte_order);
-        offset += 4;
-        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_jobid, tvb,
-                offset, 4, byte_order);
-        offset += 4;
-        proto_tree_add_item(mpi_rndvrestartnotify_tree, hf_mpi_vpid, tvb,
-                offset, 4, byte_order);
-        offset += 4;
+    consumed = dissect_mpi(tvb_new_subset_remaining(tvb, skipped), pinfo,
+            tree, data);
+    col_append_fstr(pinfo->cinfo, COL_INFO, " [%u bytes skipped]", skipped);
 
-        proto_item_append_text(ti,
-                "restartseq: %d, dst_vpid: %d, jobid: %d, vpid: %d"
-                "src_req: 0x%016" G_GINT64_MODIFIER "x, "
-                "dst_req: 0x%016" G_GINT64_MODIFIER "x, ",
-                rndvrestartnotify_restartseq, rndvrestartnotify_dst_rank,
-                rndvrestartnotify_jobid, rndvrestartnotify_vpid,
-                rndvrestartnotify_src_req64, rndvrestartnotify_dst_req64);
-    }
-    return offset;
+    return skipped + consumed;
 }
+
 /* "tvb" containing the raw data, but not any protocol headers above it
  * "pinfo" Packet info
  * "tree" if the pointer is NULL, then we are being asked for a summary,
@@ -2149,7 +4363,7 @@ dissect_mpi_rndvrestartnotify(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tre
 
 /* Code to actually dissect the packets */
 static int
-dissect_mpi(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
+dissect_mpi(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data)
 {
     /* Set up structures needed to add the protocol subtree and manage it */
     proto_item *ti = NULL;
@@ -2161,26 +4375,36 @@ dissect_mpi(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
     guint offset = 0;
     guint32 byte_order;
     guint8 base_base;
+    const gchar *base_name;
+    gchar base_buf[MPI_NAME_LEN];
     guint8 base_type;
     guint16 base_count;
     guint32 base_size;
     guint8 common_type;
     guint8 common_flags;
+    gchar type_buf[MPI_NAME_LEN];
+    mpi_tap_info_t *mpi_tap_info;
+    mpi_channel_pdu_t *cpdu;
+    mpi_tcp_events_t *tcpev;
+    mpi_xfer_frame_t *xframe;
+    mpi_xfer_t *xfer;
 
     /* Check that the packet is long enough for it to belong to us. */
     if (MPI_MIN_LENGTH > tvb_reported_length(tvb)) {
         return 0;
     }
 
+    mpi_evict(pinfo);
+
     if (MPI_DEBUG)
         g_print("%d dissect_mpi, reported_length: %d, tree: %s\n",
                 pinfo->fd->num, tvb_reported_length(tvb),
                 tree ? "true":"false");
 
-    /* oob packet: src and dst port in range of 2^15 and 2^16 -1 */
-    if (32768 <= pinfo->srcport && MAX_TCP_PORT >= pinfo->srcport &&
-            32768 <= pinfo->destport && MAX_TCP_PORT >= pinfo->destport) {
-        return dissect_mpi_oob(tvb, pinfo, tree, offset);
+    /* oob packet: an endpoint is a learned OOB listener (mpi_is_oob) */
+    if (mpi_is_oob(tvb, pinfo)) {
+        return dissect_mpi_oob(tvb, pinfo, tree, offset,
+                (const struct tcpinfo *)data);
     }
 
     /* sync packet: length == 8 */
@@ -2191,7 +4415,7 @@ dissect_mpi(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
     base_base = tvb_get_guint8(tvb, 0);
 
     if (10 > tvb_reported_length(tvb) || 65 > base_base || 77 < base_base) {
-        return 0;
+        return dissect_mpi_btl_resync(tvb, pinfo, tree, data);
     }
 
     /* set protocol name */
@@ -2200,9 +4424,25 @@ dissect_mpi(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
     col_clear(pinfo->cinfo,COL_INFO);
 
     /* \xe2\x86\x92  UTF8_RIGHTWARDS_ARROW */
-    col_add_fstr(pinfo->cinfo, COL_INFO, "%d\xe2\x86\x92%d [%s]",
-            pinfo->srcport, pinfo->destport,
-            val_to_str(base_base, packetbasenames, "Unknown (0x%02x) o_O"));
+    base_name = mpi_val_to_str(base_base, &packetbasenames_ext,
+            "Unknown (0x%02x)", base_buf);
+    col_add_fstr(pinfo->cinfo, COL_INFO, "%d\xe2\x86\x92%d [%s%s]",
+            pinfo->srcport, pinfo->destport, base_name,
+            base_name == base_buf ? " o_O" : "");
+
+    /* the size of the PML header and the data is needed for the
+     * transfer analysis */
+    if (pref_little_endian) {
+        base_size = tvb_get_letohl(tvb, 4);
+    } else {
+        base_size = tvb_get_ntohl(tvb, 4);
+    }
+
+    mpi_tap_info = wmem_new0(wmem_packet_scope(), mpi_tap_info_t);
+    mpi_tap_info->kind = MPI_PDU_BTL;
+    mpi_tap_info->stream = get_tcp_conversation_data(NULL, pinfo)->stream;
+    mpi_tap_info->base = base_base;
+    mpi_tap_info->size = base_size;
 
     if (tree) {
         ti = proto_tree_add_item(tree, proto_mpi, tvb, 0, -1, ENC_NA);
@@ -2214,11 +4454,9 @@ dissect_mpi(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
         if (pref_little_endian) {
             byte_order = ENC_LITTLE_ENDIAN;
             base_count = tvb_get_letohs(tvb, 2);
-            base_size = tvb_get_letohl(tvb, 4);
         } else {
             byte_order = ENC_BIG_ENDIAN;
             base_count = tvb_get_ntohs(tvb, 2);
-            base_size = tvb_get_ntohl(tvb, 4);
         }
 
         /* base header */
@@ -2237,8 +4475,9 @@ dissect_mpi(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
                 offset, 4, byte_order);
         offset += 4;
         proto_item_append_text(ti, "base: %s, type: %s, count: %d, size: %d",
-                val_to_str(base_base, packetbasenames, "Unknown (0x%02x)"),
-                val_to_str(base_type, packettypenames, "Unknown (0x%02x)"),
+                base_name,
+                mpi_val_to_str(base_type, &packettypenames_ext,
+                    "Unknown (0x%02x)", type_buf),
                 base_count, base_size);
 
         /* common header */
@@ -2254,7 +4493,8 @@ dissect_mpi(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
                 common_hdr_flags, byte_order);
         offset +=1;
         proto_item_append_text(ti, "type: %s, flags: 0x%02x",
-                val_to_str(common_type, packetbasenames, "Unknown (0x%02x)"),
+                mpi_val_to_str(common_type, &packetbasenames_ext,
+                    "Unknown (0x%02x)", type_buf),
                 common_flags);
     } else {
         offset = 10;
@@ -2262,25 +4502,32 @@ dissect_mpi(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
 
     switch(base_base) {
         case MPI_PML_OB1_HDR_TYPE_MATCH:
-            offset = dissect_mpi_match(tvb, pinfo, mpi_tree, offset);
+            offset = dissect_mpi_match(tvb, pinfo, mpi_tree, offset,
+                    mpi_tap_info);
             break;
         case MPI_PML_BFO_HDR_TYPE_RNDV:
-            offset = dissect_mpi_rndv(tvb, pinfo, mpi_tree, offset);
+            offset = dissect_mpi_rndv(tvb, pinfo, mpi_tree, offset,
+                    mpi_tap_info);
             break;
         case MPI_PML_OB1_HDR_TYPE_RGET: /* not tested yet !!!*/
-            offset = dissect_mpi_rget(tvb, pinfo, mpi_tree, offset);
+            offset = dissect_mpi_rget(tvb, pinfo, mpi_tree, offset,
+                    mpi_tap_info);
             break;
         case MPI_PML_OB1_HDR_TYPE_FRAG: /* not tested yet !!!*/
-            offset = dissect_mpi_frag(tvb, pinfo, mpi_tree, offset);
+            offset = dissect_mpi_frag(tvb, pinfo, mpi_tree, offset,
+                    mpi_tap_info);
             break;
         case MPI_PML_OB1_HDR_TYPE_ACK: /* not tested yet !!!*/
-            offset = dissect_mpi_ack(tvb, pinfo, mpi_tree, offset);
+            offset = dissect_mpi_ack(tvb, pinfo, mpi_tree, offset,
+                    mpi_tap_info);
             break;
         case MPI_PML_OB1_HDR_TYPE_PUT: /* tested, but with curious extra data.. */
-            offset = dissect_mpi_rdma(tvb, pinfo, mpi_tree, offset);
+            offset = dissect_mpi_rdma(tvb, pinfo, mpi_tree, offset,
+                    mpi_tap_info);
             break;
         case MPI_PML_OB1_HDR_TYPE_FIN:
-            offset = dissect_mpi_fin(tvb, pinfo, mpi_tree, offset);
+            offset = dissect_mpi_fin(tvb, pinfo, mpi_tree, offset,
+                    mpi_tap_info);
             break;
         case MPI_PML_BFO_HDR_TYPE_RNDVRESTARTNOTIFY:
             offset = dissect_mpi_rndvrestartnotify(tvb, pinfo, mpi_tree, offset);
@@ -2299,11 +4546,162 @@ dissect_mpi(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
             col_append_str(pinfo->cinfo, COL_INFO, " something goes wrong!");
     }
 
+    /* the base header (8 bytes) is not a part of the size */
+    if (base_size + 8 > offset) {
+        mpi_tap_info->payload = base_size + 8 - offset;
+    }
+
+    cpdu = mpi_channel_correlate(pinfo, mpi_tap_info);
+    if (cpdu) {
+        proto_item *it;
+        proto_tree *mpi_channel_tree;
+        const mpi_oob_name_t *names = cpdu->channel->names;
+
+        /* \xe2\x86\x94  UTF8_LEFT_RIGHT_ARROW */
+        mpi_channel_tree = proto_tree_add_subtree_format(mpi_tree, tvb, 0, 0,
+                ett_mpi_channel, &it,
+                "Channel %u: %u.%u \xe2\x86\x94 %u.%u, link %u of %u",
+                cpdu->channel->id, names[0].jobid, names[0].vpid,
+                names[1].jobid, names[1].vpid, cpdu->link, cpdu->links);
+        PROTO_ITEM_SET_GENERATED(it);
+        it = proto_tree_add_uint(mpi_channel_tree, hf_mpi_channel, tvb, 0, 0,
+                cpdu->channel->id);
+        PROTO_ITEM_SET_GENERATED(it);
+        it = proto_tree_add_uint(mpi_channel_tree, hf_mpi_channel_link, tvb,
+                0, 0, cpdu->link);
+        PROTO_ITEM_SET_GENERATED(it);
+        it = proto_tree_add_uint(mpi_channel_tree, hf_mpi_channel_links, tvb,
+                0, 0, cpdu->links);
+        PROTO_ITEM_SET_GENERATED(it);
+        if (cpdu->reordered_after) {
+            it = proto_tree_add_uint(mpi_channel_tree,
+                    hf_mpi_channel_reordered, tvb, 0, 0,
+                    cpdu->reordered_after);
+            PROTO_ITEM_SET_GENERATED(it);
+            expert_add_info_format(pinfo, it, &ei_mpi_channel_reordered,
+                    "Sequence %u after %u (link %u)",
+                    mpi_tap_info->match_seq, cpdu->reordered_seq,
+                    cpdu->reordered_link);
+        }
+
+        mpi_tap_info->channel = cpdu->channel->id;
+        mpi_tap_info->channel_link = cpdu->link;
+        mpi_tap_info->channel_reordered = 0 != cpdu->reordered_after;
+        mpi_tap_info->jobid = names[cpdu->sender].jobid;
+        mpi_tap_info->vpid = names[cpdu->sender].vpid;
+        mpi_tap_info->jobid_dst = names[1 - cpdu->sender].jobid;
+        mpi_tap_info->vpid_dst = names[1 - cpdu->sender].vpid;
+    }
+    mpi_index_add(pinfo, mpi_tap_info);
+
+    tcpev = mpi_tcp_scan(pinfo);
+    if (tcpev && MPI_TCP_EVENTS(tcpev)) {
+        mpi_tcp_add_tree(mpi_tree, tvb, tcpev, "since the previous PDU");
+        mpi_tap_info->tcp_retrans = tcpev->retrans;
+        mpi_tap_info->tcp_dupacks = tcpev->dupacks;
+        mpi_tap_info->tcp_zero_windows = tcpev->zero_windows;
+        mpi_tap_info->tcp_delay = tcpev->delay;
+    }
+
+    xframe = mpi_xfer_correlate(pinfo, mpi_tap_info, cpdu, tcpev);
+    if (xframe) {
+        proto_item *it;
+        proto_tree *mpi_xfer_tree;
+
+        xfer = xframe->xfer;
+        mpi_xfer_tree = proto_tree_add_subtree_format(mpi_tree, tvb, 0, 0,
+                ett_mpi_xfer, &it, "Rendezvous transfer of %" G_GINT64_MODIFIER
+                "u bytes", xfer->msg_len);
+        PROTO_ITEM_SET_GENERATED(it);
+
+        if (xfer->rndv_frame != pinfo->fd->num) {
+            it = proto_tree_add_uint(mpi_xfer_tree, hf_mpi_xfer_rndv_in, tvb,
+                    0, 0, xfer->rndv_frame);
+            PROTO_ITEM_SET_GENERATED(it);
+        }
+        if (xfer->ack_frame && xfer->ack_frame != pinfo->fd->num) {
+            it = proto_tree_add_uint(mpi_xfer_tree, hf_mpi_xfer_ack_in, tvb,
+                    0, 0, xfer->ack_frame);
+            PROTO_ITEM_SET_GENERATED(it);
+        }
+        if (xfer->end_frame && xfer->end_frame != pinfo->fd->num) {
+            it = proto_tree_add_uint(mpi_xfer_tree, hf_mpi_xfer_end_in, tvb,
+                    0, 0, xfer->end_frame);
+            PROTO_ITEM_SET_GENERATED(it);
+        }
+        if (xframe->index) {
+            it = proto_tree_add_uint(mpi_xfer_tree, hf_mpi_xfer_index, tvb,
+                    0, 0, xframe->index);
+            PROTO_ITEM_SET_GENERATED(it);
+        }
+        if (xfer->rndv_frame != pinfo->fd->num) {
+            it = proto_tree_add_uint(mpi_xfer_tree, hf_mpi_xfer_depth, tvb,
+                    0, 0, xframe->depth);
+            PROTO_ITEM_SET_GENERATED(it);
+            it = proto_tree_add_time(mpi_xfer_tree, hf_mpi_xfer_gap, tvb,
+                    0, 0, &xframe->gap);
+            PROTO_ITEM_SET_GENERATED(it);
+            if (xframe->stall) {
+                expert_add_info_format(pinfo, it, &ei_mpi_xfer_stall,
+                        "Pipeline stall: %.3f ms since the previous PDU%s",
+                        nstime_to_msec(&xframe->gap),
+                        MPI_PML_OB1_HDR_TYPE_PUT == base_base &&
+                        1 == xframe->depth ? ", no PUT in flight" : "");
+            }
+        }
+        mpi_tap_info->xfer_rndv_in = xfer->rndv_frame;
+        mpi_tap_info->xfer_index = xframe->index;
+        mpi_tap_info->xfer_depth = xframe->depth;
+        mpi_tap_info->xfer_gap = xframe->gap;
+        mpi_tap_info->xfer_stall = xframe->stall;
+        if (xfer->end_frame == pinfo->fd->num) {
+            gdouble secs = nstime_to_sec(&xfer->duration);
+
+            it = proto_tree_add_uint64(mpi_xfer_tree, hf_mpi_xfer_bytes, tvb,
+                    0, 0, xfer->done);
+            PROTO_ITEM_SET_GENERATED(it);
+            it = proto_tree_add_uint(mpi_xfer_tree, hf_mpi_xfer_frags, tvb,
+                    0, 0, xfer->frags);
+            PROTO_ITEM_SET_GENERATED(it);
+            it = proto_tree_add_time(mpi_xfer_tree, hf_mpi_xfer_duration, tvb,
+                    0, 0, &xfer->duration);
+            PROTO_ITEM_SET_GENERATED(it);
+            if (0 < secs) {
+                it = proto_tree_add_double(mpi_xfer_tree,
+                        hf_mpi_xfer_bandwidth, tvb, 0, 0,
+                        xfer->done / secs / 1000000.0);
+                PROTO_ITEM_SET_GENERATED(it);
+                col_append_fstr(pinfo->cinfo, COL_INFO, " [%.1f MB/s]",
+                        xfer->done / secs / 1000000.0);
+            }
+            if (MPI_TCP_EVENTS(&xfer->tcp)) {
+                mpi_tcp_add_tree(mpi_xfer_tree, tvb, &xfer->tcp,
+                        "during the transfer");
+            }
+
+            mpi_tap_info->xfer_done = TRUE;
+            mpi_tap_info->msg_len = xfer->msg_len;
+            mpi_tap_info->xfer_bytes = xfer->done;
+            mpi_tap_info->xfer_frags = xfer->frags;
+            mpi_tap_info->xfer_duration = xfer->duration;
+            mpi_tap_info->xfer_tcp_events = MPI_TCP_EVENTS(&xfer->tcp);
+            mpi_tap_info->xfer_tcp_delay = xfer->tcp.delay;
+
+            /* left the tables, a single pass does not come back */
+            if (pref_single_pass) {
+                wmem_free(wmem_file_scope(), xfer);
+            }
+        }
+    }
+
     if (tvb_captured_length(tvb) > offset) {
         proto_tree_add_item(mpi_tree, hf_mpi_oob_data, tvb,
                 offset, tvb_captured_length(tvb) - offset, ENC_BIG_ENDIAN);
         offset = tvb_captured_length(tvb);
     }
+
+    tap_queue_packet(mpi_tap, pinfo, mpi_tap_info);
+
     /* push the payload to the data section */
     /*if (offset < (guint)tvb_captured_length(tvb)) {
         tvbuff_t *next_tvb;
@@ -2320,6 +4718,69 @@ dissect_mpi(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
     return offset;
 }
 
+static void
+mpi_oob_trans_free(gpointer data)
+{
+    mpi_oob_trans_t *mpi_oob_trans = (mpi_oob_trans_t *)data;
+
+    /* the values are file scoped */
+    g_hash_table_destroy(mpi_oob_trans->old);
+    g_free(mpi_oob_trans);
+}
+
+static void
+mpi_init(void)
+{
+    /* the conversations of the previous file are gone */
+    if (mpi_xcasts) {
+        g_hash_table_destroy(mpi_xcasts);
+        g_hash_table_destroy(mpi_hb_daemons);
+        g_hash_table_destroy(mpi_infos);
+        g_hash_table_destroy(mpi_channels);
+        g_hash_table_destroy(mpi_oob_transs);
+    }
+    mpi_xcasts = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL,
+            mpi_xcast_free);
+    mpi_xcast_count = 0;
+    mpi_hb_daemons = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL,
+            g_free);
+    mpi_infos = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+            mpi_info_free, NULL);
+    mpi_channels = g_hash_table_new_full(mpi_channel_hash, mpi_channel_equal,
+            NULL, mpi_channel_free);
+    mpi_channel_count = 0;
+    mpi_oob_transs = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+            mpi_oob_trans_free, NULL);
+
+    /* keys and values are file scoped */
+    if (mpi_xfer_reqs) {
+        g_hash_table_destroy(mpi_xfer_reqs);
+        g_hash_table_destroy(mpi_xfer_dess);
+    }
+    mpi_xfer_reqs = g_hash_table_new(mpi_xfer_hash, mpi_xfer_equal);
+    mpi_xfer_dess = g_hash_table_new(mpi_xfer_hash, mpi_xfer_equal);
+
+    if (mpi_msg_keys) {
+        g_array_free(mpi_msg_keys, TRUE);
+        g_array_free(mpi_req_keys, TRUE);
+    }
+    mpi_msg_keys = g_array_new(FALSE, FALSE, sizeof(mpi_msg_key_t));
+    mpi_msg_keys_sorted = TRUE;
+    mpi_req_keys = g_array_new(FALSE, FALSE, sizeof(mpi_req_key_t));
+    mpi_req_keys_sorted = TRUE;
+
+    if (mpi_oob_eps) {
+        g_hash_table_destroy(mpi_oob_eps);
+    }
+    mpi_oob_eps = g_hash_table_new_full(mpi_oob_ep_hash, mpi_oob_ep_equal,
+            g_free, NULL);
+    mpi_oob_eps_frame = 0;
+
+    mpi_evict_started = FALSE;
+    mpi_evict_frame = 0;
+    memset(&mpi_evict_stats, 0, sizeof(mpi_evict_stats));
+}
+
 /* Register the protocol with Wireshark.
  *
  * This format is require because a script is used to build the C function that
@@ -2329,6 +4790,7 @@ void
 proto_register_mpi(void)
 {
     module_t        *mpi_module;
+    expert_module_t *expert_mpi;
 
     /* Setup list of header fields  See Section 1.5 of README.dissector for
      * details. */
@@ -2398,11 +4860,11 @@ proto_register_mpi(void)
         },
         { &hf_mpi_base_hdr_base,
             { "Base", "mpi.base",
-                FT_UINT8, BASE_DEC, VALS(packetbasenames), 0x0, NULL, HFILL }
+                FT_UINT8, BASE_DEC|BASE_EXT_STRING, &packetbasenames_ext, 0x0, NULL, HFILL }
         },
         { &hf_mpi_base_hdr_type,
             { "Type", "mpi.hdr_type",
-                FT_UINT8, BASE_DEC, VALS(packettypenames), 0x0, NULL, HFILL }
+                FT_UINT8, BASE_DEC|BASE_EXT_STRING, &packettypenames_ext, 0x0, NULL, HFILL }
         },
         { &hf_mpi_base_hdr_count,
             { "Count", "mpi.count",
@@ -2414,7 +4876,7 @@ proto_register_mpi(void)
         },
         { &hf_mpi_common_hdr_type,
             { "Type", "mpi.type",
-                FT_UINT8, BASE_DEC, VALS(packetbasenames), 0x0, NULL, HFILL }
+                FT_UINT8, BASE_DEC|BASE_EXT_STRING, &packetbasenames_ext, 0x0, NULL, HFILL }
         },
         { &hf_mpi_common_hdr_flags,
             { "Fragment Flags", "mpi.flags",
@@ -2446,7 +4908,7 @@ proto_register_mpi(void)
         },
         { &hf_mpi_match_hdr_ctx,
             { "Communicator Index", "mpi.ctx",
-                FT_UINT16, BASE_DEC, VALS(communicatornames), 0x0, NULL, HFILL }
+                FT_UINT16, BASE_DEC|BASE_EXT_STRING, &communicatornames_ext, 0x0, NULL, HFILL }
         },
         { &hf_mpi_match_hdr_src,
             { "Source Vpid (Rank)", "mpi.src",
@@ -2454,7 +4916,7 @@ proto_register_mpi(void)
         },
         { &hf_mpi_match_hdr_tag,
             { "Message Tag", "mpi.tag",
-                FT_INT32, BASE_DEC, VALS(colltagnames), 0x0, NULL, HFILL }
+                FT_INT32, BASE_DEC|BASE_EXT_STRING, &colltagnames_ext, 0x0, NULL, HFILL }
         },
         { &hf_mpi_match_hdr_seq,
             { "Sequence Number", "mpi.seq",
@@ -2586,7 +5048,7 @@ proto_register_mpi(void)
         },
         { &hf_mpi_oob_hdr_rml_tag,
             { "RML Tag", "mpi.rml_tag",
-                FT_UINT32, BASE_DEC, VALS(rmltagnames), 0x0, NULL, HFILL }
+                FT_UINT32, BASE_DEC|BASE_EXT_STRING, &rmltagnames_ext, 0x0, NULL, HFILL }
         },
         { &hf_mpi_oob_hdr_nbytes,
             { "Message length", "mpi.len",
@@ -2627,6 +5089,169 @@ proto_register_mpi(void)
         { &hf_mpi_time,
             { "Time", "mpi.sync.time",
                 FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0, NULL, HFILL }
+        },
+        { &hf_mpi_xcast_id,
+            { "XCAST", "mpi.xcast.id",
+                FT_UINT32, BASE_DEC, NULL, 0x0,
+                "Running number of the XCAST in the capture", HFILL }
+        },
+        { &hf_mpi_xcast_hop,
+            { "Hop", "mpi.xcast.hop",
+                FT_UINT32, BASE_DEC, NULL, 0x0,
+                "Depth in the routing tree, 1 for the children of the root",
+                HFILL }
+        },
+        { &hf_mpi_xcast_first_in,
+            { "Sent by the root in", "mpi.xcast.first_in",
+                FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+        },
+        { &hf_mpi_xcast_parent_in,
+            { "Received by the relaying daemon in", "mpi.xcast.parent_in",
+                FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+        },
+        { &hf_mpi_xcast_relay_time,
+            { "Relay time", "mpi.xcast.relay_time",
+                FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0,
+                "Time the relaying daemon needed to pass it on", HFILL }
+        },
+        { &hf_mpi_xcast_time,
+            { "Time since the root", "mpi.xcast.time",
+                FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0, NULL, HFILL }
+        },
+        { &hf_mpi_hb_prev_in,
+            { "Previous heartbeat in", "mpi.heartbeat.prev_in",
+                FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+        },
+        { &hf_mpi_hb_interval,
+            { "Interval", "mpi.heartbeat.interval",
+                FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0,
+                "Time since the previous heartbeat of the daemon", HFILL }
+        },
+        { &hf_mpi_hb_expected,
+            { "Expected interval (ms)", "mpi.heartbeat.expected",
+                FT_DOUBLE, BASE_NONE, NULL, 0x0,
+                "Heartbeat rate preference or the learned interval", HFILL }
+        },
+        { &hf_mpi_hb_missed,
+            { "Missed heartbeats", "mpi.heartbeat.missed",
+                FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+        },
+        { &hf_mpi_hb_silent_vpid,
+            { "Longest silent daemon", "mpi.heartbeat.silent_vpid",
+                FT_UINT32, BASE_DEC, NULL, 0x0,
+                "Daemon with the oldest last heartbeat", HFILL }
+        },
+        { &hf_mpi_hb_silent_last_in,
+            { "Its last heartbeat in", "mpi.heartbeat.silent_last_in",
+                FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+        },
+        { &hf_mpi_hb_silence,
+            { "Without heartbeat", "mpi.heartbeat.silence",
+                FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0, NULL, HFILL }
+        },
+        { &hf_mpi_xfer_rndv_in,
+            { "Rendezvous in", "mpi.xfer.rndv_in",
+                FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+        },
+        { &hf_mpi_xfer_ack_in,
+            { "ACK in", "mpi.xfer.ack_in",
+                FT_FRAMENUM, BASE_NONE, NULL, 0x0,
+                "The ACK of the RNDV from the receiver", HFILL }
+        },
+        { &hf_mpi_xfer_end_in,
+            { "Finished in", "mpi.xfer.end_in",
+                FT_FRAMENUM, BASE_NONE, NULL, 0x0,
+                "The FIN or the FRAG finishing the transfer", HFILL }
+        },
+        { &hf_mpi_xfer_bytes,
+            { "Bytes", "mpi.xfer.bytes",
+                FT_UINT64, BASE_DEC, NULL, 0x0,
+                "Eager data, FRAG and finished PUT bytes seen", HFILL }
+        },
+        { &hf_mpi_xfer_frags,
+            { "Fragments", "mpi.xfer.frags",
+                FT_UINT32, BASE_DEC, NULL, 0x0,
+                "FRAG and PUT headers of the transfer", HFILL }
+        },
+        { &hf_mpi_xfer_duration,
+            { "Time on wire", "mpi.xfer.duration",
+                FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0,
+                "Rendezvous until the end of the transfer", HFILL }
+        },
+        { &hf_mpi_xfer_bandwidth,
+            { "Bandwidth (MB/s)", "mpi.xfer.bandwidth",
+                FT_DOUBLE, BASE_NONE, NULL, 0x0,
+                "Bytes seen / time on wire", HFILL }
+        },
+        { &hf_mpi_xfer_index,
+            { "Fragment number", "mpi.xfer.index",
+                FT_UINT32, BASE_DEC, NULL, 0x0,
+                "Number of the FRAG or PUT in the transfer", HFILL }
+        },
+        { &hf_mpi_xfer_depth,
+            { "PUTs in flight", "mpi.xfer.depth",
+                FT_UINT32, BASE_DEC, NULL, 0x0,
+                "PUTs of the transfer without FIN after this PDU", HFILL }
+        },
+        { &hf_mpi_xfer_gap,
+            { "Gap", "mpi.xfer.gap",
+                FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0,
+                "Time since the previous PDU of the transfer", HFILL }
+        },
+        { &hf_mpi_channel,
+            { "Channel", "mpi.channel",
+                FT_UINT32, BASE_DEC, NULL, 0x0,
+                "The BTL connections between one pair of processes", HFILL }
+        },
+        { &hf_mpi_channel_link,
+            { "Link", "mpi.channel.link",
+                FT_UINT32, BASE_DEC, NULL, 0x0,
+                "Number of the connection in the channel", HFILL }
+        },
+        { &hf_mpi_channel_links,
+            { "Links", "mpi.channel.links",
+                FT_UINT32, BASE_DEC, NULL, 0x0,
+                "Connections of the channel when the PDU was first seen", HFILL }
+        },
+        { &hf_mpi_channel_reordered,
+            { "Overtaken in", "mpi.channel.reordered",
+                FT_FRAMENUM, BASE_NONE, NULL, 0x0,
+                "A higher sequence number of the communicator", HFILL }
+        },
+        { &hf_mpi_oob_lost,
+            { "Lost bytes", "mpi.oob.lost",
+                FT_UINT32, BASE_DEC, NULL, 0x0,
+                "OOB stream bytes before this frame missing in the capture "
+                "(TCP sequence gap)", HFILL }
+        },
+        { &hf_mpi_oob_skipped,
+            { "Skipped bytes", "mpi.oob.skipped",
+                FT_UINT32, BASE_DEC, NULL, 0x0,
+                "Bytes searched for the next OOB header", HFILL }
+        },
+        { &hf_mpi_btl_skipped,
+            { "Skipped bytes", "mpi.btl.skipped",
+                FT_UINT32, BASE_DEC, NULL, 0x0,
+                "Bytes before the first plausible BTL header", HFILL }
+        },
+        { &hf_mpi_tcp_retrans,
+            { "Retransmissions", "mpi.tcp.retransmissions",
+                FT_UINT32, BASE_DEC, NULL, 0x0,
+                "TCP retransmissions and fast retransmissions", HFILL }
+        },
+        { &hf_mpi_tcp_dupacks,
+            { "Duplicate ACKs", "mpi.tcp.dup_acks",
+                FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+        },
+        { &hf_mpi_tcp_zero_windows,
+            { "Zero windows", "mpi.tcp.zero_windows",
+                FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+        },
+        { &hf_mpi_tcp_delay,
+            { "Network delay", "mpi.tcp.delay",
+                FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0,
+                "Latency attributed to retransmissions and zero windows",
+                HFILL }
         }
     };
 
@@ -2645,7 +5270,51 @@ proto_register_mpi(void)
         &ett_mpi_ack,
         &ett_mpi_rdma,
         &ett_mpi_fin,
-        &ett_mpi_rndvrestartnotify
+        &ett_mpi_rndvrestartnotify,
+        &ett_mpi_xcast,
+        &ett_mpi_hb,
+        &ett_mpi_xfer,
+        &ett_mpi_channel,
+        &ett_mpi_tcp
+    };
+
+    static ei_register_info ei[] = {
+        { &ei_mpi_xcast_slow_relay,
+            { "mpi.xcast.slow_relay", PI_SEQUENCE, PI_WARN,
+                "Slow XCAST relay", EXPFILL }
+        },
+        { &ei_mpi_hb_late,
+            { "mpi.heartbeat.late", PI_SEQUENCE, PI_NOTE,
+                "Late heartbeat", EXPFILL }
+        },
+        { &ei_mpi_xfer_stall,
+            { "mpi.xfer.stall", PI_SEQUENCE, PI_NOTE,
+                "Rendezvous pipeline stall", EXPFILL }
+        },
+        { &ei_mpi_channel_reordered,
+            { "mpi.channel.reordered", PI_SEQUENCE, PI_NOTE,
+                "Message overtaken on another link", EXPFILL }
+        },
+        { &ei_mpi_hb_missing,
+            { "mpi.heartbeat.missing", PI_SEQUENCE, PI_WARN,
+                "Missing heartbeats", EXPFILL }
+        },
+        { &ei_mpi_hb_failure,
+            { "mpi.heartbeat.failure", PI_SEQUENCE, PI_WARN,
+                "Failure notice or abort", EXPFILL }
+        },
+        { &ei_mpi_oob_lost,
+            { "mpi.oob.lost", PI_SEQUENCE, PI_WARN,
+                "OOB bytes missing in the capture", EXPFILL }
+        },
+        { &ei_mpi_oob_resync,
+            { "mpi.oob.resync", PI_MALFORMED, PI_NOTE,
+                "OOB stream resynchronized", EXPFILL }
+        },
+        { &ei_mpi_btl_resync,
+            { "mpi.btl.resync", PI_MALFORMED, PI_NOTE,
+                "BTL stream resynchronized", EXPFILL }
+        }
     };
 
     if (MPI_DEBUG)
@@ -2661,6 +5330,12 @@ proto_register_mpi(void)
     /* Required function calls to register the header fields and subtrees */
     proto_register_field_array(proto_mpi, hf, array_length(hf));
     proto_register_subtree_array(ett, array_length(ett));
+    expert_mpi = expert_register_protocol(proto_mpi);
+    expert_register_field_array(expert_mpi, ei, array_length(ei));
+
+    register_init_routine(mpi_init);
+
+    mpi_tap = register_tap("mpi");
 
     /* register sub handler */
     /* mpi_sync_handler = new_create_dissector_handle(dissect_mpi_sync, proto_mpi); */
@@ -2691,6 +5366,50 @@ proto_register_mpi(void)
             "TCP ports to be decoded as Message Passing Interface protocol "
             "(default: " DEFAULT_MPI_PORT_RANGE ")",
             &global_mpi_tcp_port_range, MAX_TCP_PORT);
+
+    /* Register the XCAST relay preferences */
+    prefs_register_uint_preference(mpi_module, "xcast_window",
+            "XCAST correlation window (ms)",
+            "A relay later than this after the previous one of the same "
+            "buffer starts a new XCAST.",
+            10, &pref_xcast_window);
+    prefs_register_uint_preference(mpi_module, "xcast_slow_relay",
+            "Slow XCAST relay (ms)",
+            "Flag daemons which need longer to relay a XCAST.",
+            10, &pref_xcast_slow_relay);
+
+    /* Register the heartbeat preferences */
+    prefs_register_uint_preference(mpi_module, "heartbeat_rate",
+            "Heartbeat rate (ms)",
+            "Interval of the daemon heartbeats, 0 learns it from the "
+            "regular intervals of every daemon.",
+            10, &pref_heartbeat_rate);
+    prefs_register_uint_preference(mpi_module, "heartbeat_jitter",
+            "Heartbeat jitter (%)",
+            "A heartbeat later than this percentage above the rate is late.",
+            10, &pref_heartbeat_jitter);
+
+    /* Register the rendezvous pipeline preference */
+    prefs_register_uint_preference(mpi_module, "pipeline_stall",
+            "Rendezvous pipeline stall (ms)",
+            "A longer gap between two FRAGs or PUTs of a transfer is a stall.",
+            10, &pref_pipe_stall);
+
+    /* Register the single pass and the eviction preferences */
+    prefs_register_bool_preference(mpi_module, "single_pass",
+            "Single pass",
+            "Every frame is dissected once (tshark without -2): no per frame "
+            "data is kept and the state horizon applies. Frames dissected "
+            "again, as in the GUI, miss the analysis.",
+            &pref_single_pass);
+    prefs_register_uint_preference(mpi_module, "state_horizon",
+            "State horizon (s)",
+            "Drop the correlation state idle for longer: transfers, "
+            "connections, channels, XCASTs, heartbeat daemons and message "
+            "keys, for long running live captures dissected in a single "
+            "pass (mpi.single_pass). The message key index (-z mpi,find) "
+            "keeps the recent frames only. 0 keeps everything.",
+            10, &pref_state_horizon);
 }
 
 void
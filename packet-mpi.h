@@ -1,3 +1,331 @@
+/* packet-mpi.h
+ * Definitions shared between the MPI dissector and its tap listeners
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PACKET_MPI_H__
+#define __PACKET_MPI_H__
+
+/* rml_types.h */
+#define ORTE_RML_TAG_INVALID                 0
+#define ORTE_RML_TAG_DAEMON                  1
+#define ORTE_RML_TAG_IOF_HNP                 2
+#define ORTE_RML_TAG_IOF_PROXY               3
+#define ORTE_RML_TAG_XCAST_BARRIER           4
+#define ORTE_RML_TAG_PLM                     5
+#define ORTE_RML_TAG_PLM_PROXY               6
+#define ORTE_RML_TAG_ERRMGR                  7
+#define ORTE_RML_TAG_WIREUP                  8
+#define ORTE_RML_TAG_RML_INFO_UPDATE         9
+#define ORTE_RML_TAG_ORTED_CALLBACK         10
+#define ORTE_RML_TAG_ROLLUP                 11
+#define ORTE_RML_TAG_REPORT_REMOTE_LAUNCH   12
+#define ORTE_RML_TAG_CKPT                   13
+#define ORTE_RML_TAG_RML_ROUTE              14
+#define ORTE_RML_TAG_XCAST                  15
+
+#define ORTE_RML_TAG_UPDATE_ROUTE_ACK       19
+#define ORTE_RML_TAG_SYNC                   20
+/* For FileM Base */
+#define ORTE_RML_TAG_FILEM_BASE             21
+#define ORTE_RML_TAG_FILEM_BASE_RESP        22
+/* For FileM RSH Component */
+#define ORTE_RML_TAG_FILEM_RSH              23
+/* For SnapC Framework */
+#define ORTE_RML_TAG_SNAPC                  24
+#define ORTE_RML_TAG_SNAPC_FULL             25
+/* For tools */
+#define ORTE_RML_TAG_TOOL                   26
+/* support data store/lookup */
+#define ORTE_RML_TAG_DATA_SERVER            27
+#define ORTE_RML_TAG_DATA_CLIENT            28
+/* timing related */
+#define ORTE_RML_TAG_COLLECTIVE_TIMER       29
+/* collectives */
+#define ORTE_RML_TAG_COLLECTIVE             30
+#define ORTE_RML_TAG_COLL_ID                31
+#define ORTE_RML_TAG_DAEMON_COLL            32
+#define ORTE_RML_TAG_COLL_ID_REQ            33
+/* show help */
+#define ORTE_RML_TAG_SHOW_HELP              34
+/* debugger release */
+#define ORTE_RML_TAG_DEBUGGER_RELEASE       35
+/* bootstrap */
+#define ORTE_RML_TAG_BOOTSTRAP              36
+/* report a missed msg */
+#define ORTE_RML_TAG_MISSED_MSG             37
+/* tag for receiving ack of abort msg */
+#define ORTE_RML_TAG_ABORT                  38
+/* tag for receiving heartbeats */
+#define ORTE_RML_TAG_HEARTBEAT              39
+/* Process Migration Tool Tag */
+#define ORTE_RML_TAG_MIGRATE                40
+/* For SStore Framework */
+#define ORTE_RML_TAG_SSTORE                 41
+#define ORTE_RML_TAG_SSTORE_INTERNAL        42
+#define ORTE_RML_TAG_SUBSCRIBE              43
+/* Notify of failed processes */
+#define ORTE_RML_TAG_FAILURE_NOTICE         44
+/* distributed file system */
+#define ORTE_RML_TAG_DFS_CMD                45
+#define ORTE_RML_TAG_DFS_DATA               46
+/* sensor data */
+#define ORTE_RML_TAG_SENSOR_DATA            47
+/* direct modex support */
+#define ORTE_RML_TAG_DIRECT_MODEX           48
+#define ORTE_RML_TAG_DIRECT_MODEX_RESP      49
+
+#define ORTE_RML_TAG_MAX                   100
+
+/* iof_types.h */
+#define ORTE_IOF_STDIN      0x01
+#define ORTE_IOF_STDOUT     0x02
+#define ORTE_IOF_STDERR     0x04
+#define ORTE_IOF_STDDIAG    0x08
+#define ORTE_IOF_STDOUTALL  0x0e
+
+/* the daemons of a job family always have the local jobid 0 */
+#define ORTE_LOCAL_JOBID(jobid)             ((jobid) & 0x0000ffff)
+#define ORTE_JOBID_IS_DAEMON(jobid)         (0 == ORTE_LOCAL_JOBID(jobid))
+
+/* odls_types.h */
+#define ORTE_DAEMON_CONTACT_QUERY_CMD     1
+#define ORTE_DAEMON_KILL_LOCAL_PROCS      2
+#define ORTE_DAEMON_SIGNAL_LOCAL_PROCS    3
+#define ORTE_DAEMON_ADD_LOCAL_PROCS       4
+#define ORTE_DAEMON_TREE_SPAWN            5
+#define ORTE_DAEMON_HEARTBEAT_CMD         6
+#define ORTE_DAEMON_EXIT_CMD              7
+#define ORTE_DAEMON_PROCESS_AND_RELAY_CMD 9
+#define ORTE_DAEMON_MESSAGE_LOCAL_PROCS   10
+#define ORTE_DAEMON_NULL_CMD              11
+#define ORTE_DAEMON_SYNC_BY_PROC          12
+#define ORTE_DAEMON_SYNC_WANT_NIDMAP      13
+/* commands for use by tools */
+#define ORTE_DAEMON_REPORT_JOB_INFO_CMD   14
+#define ORTE_DAEMON_REPORT_NODE_INFO_CMD  15
+#define ORTE_DAEMON_REPORT_PROC_INFO_CMD  16
+#define ORTE_DAEMON_SPAWN_JOB_CMD         17
+#define ORTE_DAEMON_TERMINATE_JOB_CMD     18
+#define ORTE_DAEMON_HALT_VM_CMD           19
+/* request proc resource usage */
+#define ORTE_DAEMON_TOP_CMD               22
+/* bootstrap */
+#define ORTE_DAEMON_NAME_REQ_CMD          23
+#define ORTE_DAEMON_CHECKIN_CMD           24
+#define ORTE_TOOL_CHECKIN_CMD             25
+/* process msg command */
+#define ORTE_DAEMON_PROCESS_CMD           26
+/* process called "errmgr.abort_procs" */
+#define ORTE_DAEMON_ABORT_PROCS_CALLED    28
+
+/* pml_ob1_hdr.h pml_bfo_hdr.h */
+#define MPI_PML_OB1_HDR_TYPE_MATCH 65
+#define MPI_PML_BFO_HDR_TYPE_RNDV 66
+#define MPI_PML_OB1_HDR_TYPE_RGET 67
+#define MPI_PML_OB1_HDR_TYPE_ACK 68
+#define MPI_PML_OB1_HDR_TYPE_NACK 69
+#define MPI_PML_OB1_HDR_TYPE_FRAG 70
+#define MPI_PML_OB1_HDR_TYPE_GET 71
+#define MPI_PML_OB1_HDR_TYPE_PUT 72
+#define MPI_PML_OB1_HDR_TYPE_FIN 73
+#define MPI_PML_BFO_HDR_TYPE_RNDVRESTARTNOTIFY 74
+#define MPI_PML_BFO_HDR_TYPE_RNDVRESTARTACK 75
+#define MPI_PML_BFO_HDR_TYPE_RNDVRESTARTNACK 76
+#define MPI_PML_BFO_HDR_TYPE_RECVERRNOTIFY 77
+
+/* coll_base_tags.h, the tags of the synchronizing collectives */
+#define MPI_COLL_BASE_TAG_ALLGATHER     -10
+#define MPI_COLL_BASE_TAG_ALLGATHERV    -11
+#define MPI_COLL_BASE_TAG_ALLREDUCE     -12
+#define MPI_COLL_BASE_TAG_ALLTOALL      -13
+#define MPI_COLL_BASE_TAG_ALLTOALLV     -14
+#define MPI_COLL_BASE_TAG_ALLTOALLW     -15
+#define MPI_COLL_BASE_TAG_BARRIER       -16
+
+/* what kind of PDU a tap record describes */
+typedef enum {
+    MPI_PDU_SYNC,   /* 8 byte (jobid, vpid) BTL synchronization */
+    MPI_PDU_OOB,    /* OOB header or message */
+    MPI_PDU_BTL     /* BTL fragment, see "base" */
+} mpi_pdu_kind_t;
+
+/* The "mpi" tap: one record is queued for every dissected PDU.
+ * Only the members belonging to "kind" are valid.
+ */
+typedef struct _mpi_tap_info_t {
+    mpi_pdu_kind_t kind;
+    guint32 stream;         /* tcp.stream of the carrying connection */
+
+    /* MPI_PDU_SYNC */
+    guint32 jobid;
+    guint32 vpid;
+    gboolean is_request;
+    guint32 req_frame;      /* the request of a response (0 if unknown) */
+    nstime_t req_time;
+    nstime_t conn_start;    /* first segment of the tcp connection */
+
+    /* MPI_PDU_OOB */
+    gboolean oob_header;    /* OOB header, else (a part of) the message */
+    gboolean msg_start;     /* message: this part begins it */
+    guint32 jobid_origin;
+    guint32 vpid_origin;
+    guint32 jobid_dst;
+    guint32 vpid_dst;
+    guint32 msg_type;       /* header only */
+    guint32 rml_tag;
+    guint32 nbytes;         /* header: message length, else bytes in this frame */
+    guint8 daemon_cmd;      /* ORTE_DAEMON_* of a XCAST, 0 if not decoded */
+    guint8 iof_type;        /* ORTE_IOF_* of an IOF message start, else 0 */
+    guint32 iof_jobid;      /* the rank the forwarded output belongs to */
+    guint32 iof_vpid;
+    const guint8 *nodename; /* ORTED callback: node of the daemon (origin) */
+    const guint8 *uri;      /* ORTED callback: RML contact URI of the daemon */
+    const guint8 *data;     /* undecoded message bytes in this frame */
+    guint32 data_len;
+    guint32 xcast_id;       /* beginning of a XCAST relay, else 0 */
+    guint32 xcast_hop;
+    guint32 xcast_parent_in;
+    nstime_t xcast_relay_time;
+    nstime_t xcast_time;    /* since the root sent it */
+    guint32 hb_prev_in;     /* heartbeat: previous one of the daemon, 0 if none */
+    nstime_t hb_interval;
+    gdouble hb_expected;    /* ms, 0 while unknown (failure notice too) */
+    guint32 hb_missed;
+    gboolean hb_late;
+    guint32 hb_silent_jobid;    /* failure notice, abort: longest silent daemon */
+    guint32 hb_silent_vpid;
+    nstime_t hb_silence;        /* zero if no heartbeat was seen */
+
+    /* MPI_PDU_BTL, also jobid, vpid (sender), jobid_dst, vpid_dst if the
+     * channel is known */
+    guint8 base;            /* MPI_PML_*_HDR_TYPE_* */
+    guint32 channel;        /* rank pair channel, 0 if unknown */
+    guint32 channel_link;
+    gboolean channel_reordered;
+    gboolean matched;       /* MATCH, RNDV, RGET */
+    guint16 match_ctx;
+    guint16 match_seq;
+    gint32 match_src;       /* rank of the sender in the communicator */
+    gint32 match_tag;       /* MPI_COLL_BASE_TAG_* for collectives */
+    guint32 tcp_retrans;    /* TCP events on the connection since the */
+    guint32 tcp_dupacks;    /* previous BTL PDU */
+    guint32 tcp_zero_windows;
+    nstime_t tcp_delay;
+    guint32 size;           /* base header size: PML header and data */
+    guint32 payload;        /* data bytes of the fragment (all segments) */
+    guint64 msg_len;        /* RNDV, RGET */
+    guint64 src_req;        /* RNDV, RGET, FRAG, ACK: send request, 0 if unset */
+    guint64 dst_req;        /* FRAG, ACK: receive request, PUT: send request */
+    guint64 des;            /* RGET, PUT, FIN: descriptor, 0 if unset */
+    guint32 des_owner;      /* RGET, PUT, FIN: hash of the process name or
+                             * TCP endpoint that registered the descriptor */
+    guint64 frag_offset;    /* FRAG, PUT: message offset, ACK: send offset */
+    guint64 seg_len;        /* PUT */
+    guint32 xfer_rndv_in;   /* PDU of a rendezvous transfer, else 0 */
+    guint32 xfer_index;     /* FRAG, PUT: number in the transfer */
+    guint32 xfer_depth;     /* PUTs in flight after this PDU */
+    nstime_t xfer_gap;      /* since the previous PDU of the transfer */
+    gboolean xfer_stall;
+    gboolean xfer_done;     /* the last PDU of the transfer */
+    guint64 xfer_bytes;     /* message bytes seen */
+    guint32 xfer_frags;     /* FRAG and PUT PDUs */
+    nstime_t xfer_duration; /* RNDV until the end of the transfer */
+    guint32 xfer_tcp_events;    /* TCP events during the transfer */
+    nstime_t xfer_tcp_delay;
+} mpi_tap_info_t;
 
 void proto_register_mpi(void);
 void proto_reg_handoff_mpi(void);
+
+/* names of the MPI_COLL_BASE_TAG_* (coll_tags.h) */
+extern value_string_ext colltagnames_ext;
+
+/* a frame found in the message key index: the job of the sender and the
+ * receiver (message key) or the owner (send request), 0 and -1 if the
+ * channel of the PDU is unknown */
+typedef struct _mpi_find_hit_t {
+    guint32 frame;
+    guint32 jobid;
+    gint32 vpid;
+} mpi_find_hit_t;
+
+/* Message key index of the capture, complete after the first pass, built
+ * while a tap listener is registered.
+ * Appends the MATCH, RNDV or RGET headers with the key (seq < 0: any seq)
+ * or the RNDV, RGET, FRAG and ACK headers with the send request to "hits"
+ * (mpi_find_hit_t, may be NULL), returns their number. jobid 0 and
+ * dst, vpid < 0: any process.
+ */
+guint mpi_find_msg(guint32 jobid, guint16 ctx, gint32 src, gint32 dst, gint32 tag,
+        gint32 seq, GArray *hits);
+guint mpi_find_req(guint32 jobid, gint32 vpid, guint64 req, GArray *hits);
+
+/* Size of the first pass lookup state and the items evicted after the
+ * state horizon preference (seconds, 0: off), in a single pass only */
+typedef struct _mpi_state_stats_t {
+    guint horizon;
+    gboolean one_pass;      /* the mpi.single_pass preference */
+    guint sweeps;
+    guint xfers;            /* open rendezvous transfers */
+    guint xfers_evicted;
+    guint dess;             /* descriptors of transfers */
+    guint dess_evicted;
+    guint conns;            /* BTL connections */
+    guint conns_evicted;
+    guint channels;         /* rank pair channels */
+    guint channels_evicted;
+    guint oob_conns;        /* OOB connections */
+    guint oob_conns_evicted;
+    guint xcasts;
+    guint xcasts_evicted;
+    guint hb_daemons;       /* daemons with heartbeats */
+    guint hb_daemons_evicted;
+    guint oob_frames;       /* OOB message states of frames, two passes */
+    guint keys;             /* message and send request keys */
+    guint keys_evicted;
+} mpi_state_stats_t;
+
+void mpi_state_stats(mpi_state_stats_t *stats);
+
+/* tap listeners (tap-mpi-*.c) */
+void proto_register_mpi_connsetup(void);
+void proto_register_mpi_launch(void);
+void proto_register_mpi_xcast(void);
+void proto_register_mpi_heartbeat(void);
+void proto_register_mpi_iof(void);
+void proto_register_mpi_bandwidth(void);
+void proto_register_mpi_pipeline(void);
+void proto_register_mpi_channel(void);
+void proto_register_mpi_netdelay(void);
+void proto_register_mpi_barrier(void);
+void proto_register_mpi_critpath(void);
+void proto_register_mpi_pattern(void);
+void proto_register_mpi_trace(void);
+void proto_register_mpi_otf2(void);
+void proto_register_mpi_columns(void);
+void proto_register_mpi_find(void);
+void proto_register_mpi_resolve(void);
+void proto_register_mpi_state(void);
+void proto_register_mpi_monitor(void);
+void proto_register_mpi_bpf(void);
+
+#endif /* __PACKET_MPI_H__ */
@@ -0,0 +1,241 @@
+/* tap-mpi-bandwidth.c
+ * Time on wire and achieved bandwidth of rendezvous transfers for tshark
+ * (-z mpi,bandwidth)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Uses the rendezvous transfers correlated by the dissector (mpi.xfer.*)
+ * to show per message size (power of two buckets) the number of finished
+ * transfers, their time on wire and their bandwidth (bytes seen / time on
+ * wire). With the link rate given the average bandwidth is shown as a
+ * share of it too.
+ *
+ * The time on wire runs from the RNDV (or RGET) to the FIN or FRAG with
+ * which the eager data, the FRAGs and the finished PUTs add up to the
+ * message length.
+ * Transfers without an end in the capture are counted as unfinished.
+ *
+ * Usage: -z mpi,bandwidth[,link_mbps[,filter]]   (link rate in Mbit/s)
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+/* 2^0 .. 2^63 bytes */
+#define BANDWIDTH_BUCKETS 64
+
+typedef struct _bandwidth_bucket_t {
+    guint count;
+    guint64 bytes;
+    guint frags;
+    gdouble dur_min;        /* ms */
+    gdouble dur_max;
+    gdouble dur_sum;
+    gdouble bw_min;         /* MB/s */
+    gdouble bw_max;
+    gdouble secs;           /* sum of the durations for the average bandwidth */
+} bandwidth_bucket_t;
+
+typedef struct _bandwidth_t {
+    char *filter;
+    gdouble link_mbps;      /* 0 if unknown */
+    guint started;
+    guint finished;
+    bandwidth_bucket_t buckets[BANDWIDTH_BUCKETS];
+} bandwidth_t;
+
+static void
+bandwidth_reset(void *tapdata)
+{
+    bandwidth_t *bs = (bandwidth_t *)tapdata;
+
+    bs->started = 0;
+    bs->finished = 0;
+    memset(bs->buckets, 0, sizeof(bs->buckets));
+}
+
+/* bucket i holds the lengths 2^i .. 2^(i+1) - 1 */
+static guint
+bandwidth_bucket(guint64 len)
+{
+    guint i = 0;
+
+    while (len > 1) {
+        len >>= 1;
+        i++;
+    }
+    return i;
+}
+
+static int
+bandwidth_packet(void *tapdata, packet_info *pinfo _U_, epan_dissect_t *edt _U_, const void *data)
+{
+    bandwidth_t *bs = (bandwidth_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    bandwidth_bucket_t *bucket;
+    gdouble dur;
+    gdouble secs;
+    gdouble bw;
+
+    if (MPI_PDU_BTL != mpi_tap_info->kind) {
+        return 0;
+    }
+    if ((MPI_PML_BFO_HDR_TYPE_RNDV == mpi_tap_info->base ||
+                MPI_PML_OB1_HDR_TYPE_RGET == mpi_tap_info->base) &&
+            mpi_tap_info->msg_len) {
+        bs->started++;
+    }
+    if (!mpi_tap_info->xfer_done) {
+        return 0;
+    }
+    bs->finished++;
+
+    bucket = &bs->buckets[bandwidth_bucket(mpi_tap_info->msg_len)];
+    dur = nstime_to_msec(&mpi_tap_info->xfer_duration);
+    secs = nstime_to_sec(&mpi_tap_info->xfer_duration);
+    bw = 0 < secs ? mpi_tap_info->xfer_bytes / secs / 1000000.0 : 0;
+
+    if (0 == bucket->count || dur < bucket->dur_min) {
+        bucket->dur_min = dur;
+    }
+    if (0 == bucket->count || dur > bucket->dur_max) {
+        bucket->dur_max = dur;
+    }
+    if (0 < secs && (0 == bucket->bw_max || bw < bucket->bw_min)) {
+        bucket->bw_min = bw;
+    }
+    if (bw > bucket->bw_max) {
+        bucket->bw_max = bw;
+    }
+    bucket->count++;
+    bucket->bytes += mpi_tap_info->xfer_bytes;
+    bucket->frags += mpi_tap_info->xfer_frags;
+    bucket->dur_sum += dur;
+    bucket->secs += secs;
+    return 1;
+}
+
+static void
+bandwidth_draw(void *tapdata)
+{
+    bandwidth_t *bs = (bandwidth_t *)tapdata;
+    bandwidth_bucket_t *bucket;
+    gdouble avg;
+    guint i;
+
+    printf("\n");
+    printf("=============================================================================================================\n");
+    printf("MPI Rendezvous Bandwidth:\n");
+    printf("Filter: %s\n", bs->filter ? bs->filter : "");
+    printf("Transfers: %u started, %u finished\n", bs->started, bs->finished);
+    if (0 < bs->link_mbps) {
+        printf("Link rate: %.1f Mbit/s\n", bs->link_mbps);
+    }
+    printf("Time on wire in milliseconds, bandwidth in MB/s\n");
+    printf("-------------------------------------------------------------------------------------------------------------\n");
+    printf("%-22s %7s %7s %10s %10s %10s %10s %10s %10s %7s\n", "Message size",
+            "Count", "Frags", "Min", "Avg", "Max", "BW min", "BW avg",
+            "BW max", "% link");
+    for (i = 0; i < BANDWIDTH_BUCKETS; i++) {
+        bucket = &bs->buckets[i];
+        if (0 == bucket->count) {
+            continue;
+        }
+        avg = 0 < bucket->secs ? bucket->bytes / bucket->secs / 1000000.0 : 0;
+        printf("%10" G_GINT64_MODIFIER "u-%-11" G_GINT64_MODIFIER "u"
+                " %7u %7.1f %10.3f %10.3f %10.3f %10.1f %10.1f %10.1f",
+                (guint64)1 << i, ((guint64)2 << i) - 1, bucket->count,
+                (gdouble)bucket->frags / bucket->count, bucket->dur_min,
+                bucket->dur_sum / bucket->count, bucket->dur_max,
+                bucket->bw_min, avg, bucket->bw_max);
+        if (0 < bs->link_mbps) {
+            /* MB/s -> Mbit/s */
+            printf(" %7.1f\n", 100.0 * avg * 8 / bs->link_mbps);
+        } else {
+            printf(" %7s\n", "-");
+        }
+    }
+    printf("=============================================================================================================\n");
+}
+
+static void
+bandwidth_init(const char *opt_arg, void *userdata _U_)
+{
+    bandwidth_t *bs;
+    const char *filter = NULL;
+    gdouble link_mbps = 0;
+    GString *error_string;
+    int pos = 0;
+
+    if (sscanf(opt_arg, "mpi,bandwidth,%lf%n", &link_mbps, &pos) == 1) {
+        if (',' == opt_arg[pos]) {
+            filter = opt_arg + pos + 1;
+        }
+    }
+    if (0 > link_mbps) {
+        fprintf(stderr, "tshark: invalid \"-z mpi,bandwidth,<link_mbps>[,<filter>]\" link_mbps\n");
+        exit(1);
+    }
+
+    bs = g_new0(bandwidth_t, 1);
+    bs->filter = filter ? g_strdup(filter) : NULL;
+    bs->link_mbps = link_mbps;
+
+    error_string = register_tap_listener("mpi", bs, bs->filter, 0,
+            bandwidth_reset, bandwidth_packet, bandwidth_draw);
+    if (error_string) {
+        g_free(bs->filter);
+        g_free(bs);
+        fprintf(stderr, "tshark: Couldn't register mpi,bandwidth tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_bandwidth(void)
+{
+    register_stat_cmd_arg("mpi,bandwidth", bandwidth_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,436 @@
+/* tap-mpi-barrier.c
+ * Arrival skew and wait time at barriers and synchronizing collectives
+ * for tshark (-z mpi,barrier)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Estimates from the wire when every rank entered a barrier and how long
+ * it waited for the last one:
+ *
+ *   every instance with its ranks, the spread of the arrivals and the
+ *   rank arriving last, printed when it is finished
+ *   per rank of a communicator the instances, its arrival skew (since the
+ *   first rank) and its idle time (until the last rank), average and
+ *   maximum, and how often all others waited for it
+ *
+ * The arrival of a rank is its first message of the instance. The barrier
+ * algorithms (linear, recursive doubling, Bruck, tree) send one message
+ * per pair of ranks and instance at most, so the n-th message from one
+ * rank to another (with the barrier tag on one communicator) belongs to
+ * the n-th instance. The double ring sends two and shows every barrier as
+ * two instances. Ring and pipelined algorithms of the other collectives
+ * send many, they are not counted. A rank can enter instance n only after
+ * all ranks entered instance n - 1, so instance n - 2 is finished then:
+ * only the open instances are kept.
+ *
+ * Only the ranks sending a message are seen, the arrival is the capture
+ * time of that message.
+ *
+ * Usage: -z mpi,barrier[,filter]
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+/* open instances per collective and communicator at most */
+#define BARRIER_MAX_OPEN 8
+
+typedef struct _barrier_inst_t {
+    guint32 n;              /* instance number */
+    guint32 first_frame;
+    guint msgs;
+    GHashTable *arrivals;   /* rank -> gdouble arrival (ms) */
+} barrier_inst_t;
+
+/* one collective on one communicator */
+typedef struct _barrier_coll_t {
+    guint64 key;            /* ctx << 32 | tag */
+    guint16 ctx;
+    gint32 tag;
+    GHashTable *pairs;      /* src rank << 32 | destination -> count */
+    GQueue *open;           /* barrier_inst_t by number */
+    guint32 finished;       /* instances up to this are finished */
+} barrier_coll_t;
+
+typedef struct _barrier_rank_t {
+    guint64 key;            /* ctx << 32 | rank */
+    guint16 ctx;
+    gint32 rank;
+    guint insts;
+    gdouble skew_sum;       /* ms */
+    gdouble skew_max;
+    gdouble idle_sum;
+    gdouble idle_max;
+    guint last;             /* arrived last */
+} barrier_rank_t;
+
+typedef struct _barrier_t {
+    char *filter;
+    nstime_t t0;
+    GHashTable *colls;      /* key -> barrier_coll_t */
+    GHashTable *ranks;      /* key -> barrier_rank_t */
+    guint insts;            /* finished instances, printed */
+} barrier_t;
+
+static void
+barrier_free_inst(gpointer data)
+{
+    barrier_inst_t *inst = (barrier_inst_t *)data;
+
+    g_hash_table_destroy(inst->arrivals);
+    g_free(inst);
+}
+
+static void
+barrier_free_open(gpointer data, gpointer user_data _U_)
+{
+    barrier_free_inst(data);
+}
+
+static void
+barrier_free_coll(gpointer data)
+{
+    barrier_coll_t *coll = (barrier_coll_t *)data;
+
+    g_queue_foreach(coll->open, barrier_free_open, NULL);
+    g_queue_free(coll->open);
+    g_hash_table_destroy(coll->pairs);
+    g_free(coll);
+}
+
+static void
+barrier_reset(void *tapdata)
+{
+    barrier_t *bs = (barrier_t *)tapdata;
+
+    g_hash_table_remove_all(bs->colls);
+    g_hash_table_remove_all(bs->ranks);
+    bs->insts = 0;
+    nstime_set_unset(&bs->t0);
+}
+
+static void
+barrier_print_head(barrier_t *bs)
+{
+    printf("\n");
+    printf("===================================================================================\n");
+    printf("MPI Barrier Imbalance:\n");
+    printf("Filter: %s\n", bs->filter ? bs->filter : "");
+    printf("Times in milliseconds since the first BTL PDU\n");
+    printf("-----------------------------------------------------------------------------------\n");
+    printf("%-11s %5s %6s %8s %6s %6s %12s %10s %6s\n", "Collective",
+            "Ctx", "Inst", "Frame", "Ranks", "Msgs", "First", "Spread",
+            "Last");
+}
+
+static barrier_rank_t *
+barrier_get_rank(barrier_t *bs, guint16 ctx, gint32 rank)
+{
+    barrier_rank_t *br;
+    guint64 key;
+
+    key = ((guint64)ctx << 32) | (guint32)rank;
+    br = (barrier_rank_t *)g_hash_table_lookup(bs->ranks, &key);
+    if (!br) {
+        br = g_new0(barrier_rank_t, 1);
+        br->key = key;
+        br->ctx = ctx;
+        br->rank = rank;
+        g_hash_table_insert(bs->ranks, &br->key, br);
+    }
+    return br;
+}
+
+/* the skew and idle time of every rank of a finished instance, its line */
+static void
+barrier_finish(barrier_t *bs, barrier_coll_t *coll, barrier_inst_t *inst)
+{
+    barrier_rank_t *br;
+    GHashTableIter iter;
+    gpointer key, value;
+    gdouble first = 0;
+    gdouble last = 0;
+    gdouble arrival;
+    gint32 last_rank = -1;
+
+    g_hash_table_iter_init(&iter, inst->arrivals);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        arrival = *(gdouble *)value;
+        if (-1 == last_rank || arrival < first) {
+            first = arrival;
+        }
+        if (-1 == last_rank || arrival > last) {
+            last = arrival;
+            last_rank = GPOINTER_TO_INT(key);
+        }
+    }
+
+    g_hash_table_iter_init(&iter, inst->arrivals);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        arrival = *(gdouble *)value;
+        br = barrier_get_rank(bs, coll->ctx, GPOINTER_TO_INT(key));
+        br->insts++;
+        br->skew_sum += arrival - first;
+        br->skew_max = MAX(br->skew_max, arrival - first);
+        br->idle_sum += last - arrival;
+        br->idle_max = MAX(br->idle_max, last - arrival);
+        if (GPOINTER_TO_INT(key) == last_rank &&
+                1 < g_hash_table_size(inst->arrivals)) {
+            br->last++;
+        }
+    }
+
+    if (0 == bs->insts++) {
+        barrier_print_head(bs);
+    }
+    printf("%-11s %5u %6u %8u %6u %6u %12.3f %10.3f %6d\n",
+            val_to_str_ext(coll->tag, &colltagnames_ext, "%d"), coll->ctx,
+            inst->n, inst->first_frame, g_hash_table_size(inst->arrivals),
+            inst->msgs, first, last - first, last_rank);
+
+    barrier_free_inst(inst);
+}
+
+static int
+barrier_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt _U_, const void *data)
+{
+    barrier_t *bs = (barrier_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    barrier_coll_t *coll;
+    barrier_inst_t *inst;
+    GList *link;
+    guint64 key;
+    guint32 dst;
+    guint32 *count;
+    gdouble *arrival;
+
+    if (MPI_PDU_BTL != mpi_tap_info->kind) {
+        return 0;
+    }
+    if (nstime_is_unset(&bs->t0)) {
+        bs->t0 = pinfo->fd->abs_ts;
+    }
+    if (!mpi_tap_info->matched ||
+            MPI_COLL_BASE_TAG_BARRIER != mpi_tap_info->match_tag) {
+        return 0;
+    }
+
+    key = ((guint64)mpi_tap_info->match_ctx << 32) |
+        (guint32)mpi_tap_info->match_tag;
+    coll = (barrier_coll_t *)g_hash_table_lookup(bs->colls, &key);
+    if (!coll) {
+        coll = g_new0(barrier_coll_t, 1);
+        coll->key = key;
+        coll->ctx = mpi_tap_info->match_ctx;
+        coll->tag = mpi_tap_info->match_tag;
+        coll->pairs = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+                g_free, g_free);
+        coll->open = g_queue_new();
+        g_hash_table_insert(bs->colls, &coll->key, coll);
+    }
+
+    /* the destination process, or the direction of the connection while
+     * its channel is unknown */
+    if (mpi_tap_info->channel) {
+        dst = mpi_tap_info->vpid_dst;
+    } else {
+        dst = 0x80000000 | (mpi_tap_info->stream << 1) |
+            (pinfo->srcport < pinfo->destport);
+    }
+    key = ((guint64)(guint32)mpi_tap_info->match_src << 32) | dst;
+    count = (guint32 *)g_hash_table_lookup(coll->pairs, &key);
+    if (!count) {
+        guint64 *pair_key = g_new(guint64, 1);
+
+        *pair_key = key;
+        count = g_new0(guint32, 1);
+        g_hash_table_insert(coll->pairs, pair_key, count);
+    }
+    (*count)++;
+
+    /* instances older than the previous one are finished */
+    while (!g_queue_is_empty(coll->open)) {
+        inst = (barrier_inst_t *)g_queue_peek_head(coll->open);
+        if (inst->n + 2 > *count &&
+                g_queue_get_length(coll->open) < BARRIER_MAX_OPEN) {
+            break;
+        }
+        coll->finished = inst->n;
+        barrier_finish(bs, coll, (barrier_inst_t *)g_queue_pop_head(coll->open));
+    }
+    if (*count <= coll->finished) {
+        /* a late message of a finished instance */
+        return 0;
+    }
+
+    for (link = coll->open->head; link; link = link->next) {
+        if (((barrier_inst_t *)link->data)->n >= *count) {
+            break;
+        }
+    }
+    if (link && ((barrier_inst_t *)link->data)->n == *count) {
+        inst = (barrier_inst_t *)link->data;
+    } else {
+        inst = g_new0(barrier_inst_t, 1);
+        inst->n = *count;
+        inst->first_frame = pinfo->fd->num;
+        inst->arrivals = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                NULL, g_free);
+        if (link) {
+            g_queue_insert_before(coll->open, link, inst);
+        } else {
+            g_queue_push_tail(coll->open, inst);
+        }
+    }
+
+    inst->msgs++;
+    if (!g_hash_table_lookup(inst->arrivals,
+                GINT_TO_POINTER(mpi_tap_info->match_src))) {
+        nstime_t delta;
+
+        nstime_delta(&delta, &pinfo->fd->abs_ts, &bs->t0);
+        arrival = g_new(gdouble, 1);
+        *arrival = nstime_to_msec(&delta);
+        g_hash_table_insert(inst->arrivals,
+                GINT_TO_POINTER(mpi_tap_info->match_src), arrival);
+    }
+    return 1;
+}
+
+static gint
+barrier_rank_cmp(gconstpointer a, gconstpointer b)
+{
+    const barrier_rank_t *ra = *(const barrier_rank_t * const *)a;
+    const barrier_rank_t *rb = *(const barrier_rank_t * const *)b;
+
+    if (ra->ctx != rb->ctx) {
+        return ra->ctx < rb->ctx ? -1 : 1;
+    }
+    return ra->rank < rb->rank ? -1 : (ra->rank > rb->rank);
+}
+
+static void
+barrier_draw(void *tapdata)
+{
+    barrier_t *bs = (barrier_t *)tapdata;
+    GPtrArray *ranks;
+    GHashTableIter iter;
+    gpointer value;
+    barrier_coll_t *coll;
+    barrier_rank_t *br;
+    guint i;
+
+    /* the instances still open are finished with the capture */
+    g_hash_table_iter_init(&iter, bs->colls);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        coll = (barrier_coll_t *)value;
+        while (!g_queue_is_empty(coll->open)) {
+            barrier_finish(bs, coll,
+                    (barrier_inst_t *)g_queue_pop_head(coll->open));
+        }
+    }
+    if (0 == bs->insts) {
+        barrier_print_head(bs);
+    }
+    printf("Instances: %u\n", bs->insts);
+
+    ranks = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, bs->ranks);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(ranks, value);
+    }
+    g_ptr_array_sort(ranks, barrier_rank_cmp);
+
+    printf("-----------------------------------------------------------------------------------\n");
+    printf("Per rank: skew since the first arrival, idle until the last arrival\n");
+    printf("%5s %6s %6s %10s %10s %10s %10s %6s\n", "Ctx", "Rank", "Inst",
+            "Skew avg", "Skew max", "Idle avg", "Idle max", "Last");
+    for (i = 0; i < ranks->len; i++) {
+        br = (barrier_rank_t *)g_ptr_array_index(ranks, i);
+        printf("%5u %6d %6u %10.3f %10.3f %10.3f %10.3f %6u\n", br->ctx,
+                br->rank, br->insts, br->skew_sum / br->insts, br->skew_max,
+                br->idle_sum / br->insts, br->idle_max, br->last);
+    }
+    g_ptr_array_free(ranks, TRUE);
+    printf("===================================================================================\n");
+}
+
+static void
+barrier_init(const char *opt_arg, void *userdata _U_)
+{
+    barrier_t *bs;
+    const char *filter = NULL;
+    GString *error_string;
+
+    if (!strncmp(opt_arg, "mpi,barrier,", 12)) {
+        filter = opt_arg + 12;
+    }
+
+    bs = g_new0(barrier_t, 1);
+    bs->filter = filter ? g_strdup(filter) : NULL;
+    bs->colls = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            NULL, barrier_free_coll);
+    bs->ranks = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            NULL, g_free);
+    nstime_set_unset(&bs->t0);
+
+    error_string = register_tap_listener("mpi", bs, bs->filter, 0,
+            barrier_reset, barrier_packet, barrier_draw);
+    if (error_string) {
+        g_hash_table_destroy(bs->ranks);
+        g_hash_table_destroy(bs->colls);
+        g_free(bs->filter);
+        g_free(bs);
+        fprintf(stderr, "tshark: Couldn't register mpi,barrier tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_barrier(void)
+{
+    register_stat_cmd_arg("mpi,barrier", barrier_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,422 @@
+/* tap-mpi-bpf.c
+ * Capture filter for the MPI and OOB connections of a job for tshark
+ * (-z mpi,bpf)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Builds a BPF capture filter from the endpoints seen in the capture, for
+ * the next capture of the same job:
+ *
+ *   - the listening BTL endpoints: the receivers of the sync requests
+ *   - the listening OOB endpoints of the daemons: the tcp:// and tcp6://
+ *     addresses of their RML URIs (ORTED callback)
+ *   - connections of the job without a known listener (the handshake or
+ *     the callback was not captured) with both of their endpoints
+ *
+ * The listeners of a port are merged into one term. With a jobid only the
+ * BTL connections of the job and the OOB connections of its daemons (same
+ * job family, the upper 16 bits) are kept.
+ *
+ * The header-only variant adds a snaplen (BPF_SNAPLEN) large enough for
+ * the link, IP and TCP headers with options and the largest BTL header.
+ * Such a capture keeps the MPI headers and the sync handshakes, but the
+ * OOB message bodies and the BTL data are cut.
+ *
+ * Usage: -z mpi,bpf[,jobid]
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+/* Ethernet, IPv4 and TCP with options, BTL header with RDMA segments */
+#define BPF_SNAPLEN (14 + 60 + 60 + 128)
+
+typedef struct _bpf_listener_t {
+    gchar *host;
+    guint16 port;
+    gboolean oob;
+    guint32 jobid;          /* of the process or the daemon */
+} bpf_listener_t;
+
+/* a connection without a known listener */
+typedef struct _bpf_conn_t {
+    gchar *hosts[2];
+    guint16 ports[2];
+    gboolean oob;
+    guint32 jobids[2];      /* BTL: the sender of a PDU (twice) */
+} bpf_conn_t;
+
+typedef struct _bpf_t {
+    gboolean by_job;
+    guint32 jobid;
+    GHashTable *listeners;  /* "host port" -> bpf_listener_t */
+    GHashTable *conns;      /* tcp.stream -> bpf_conn_t */
+} bpf_t;
+
+static void
+bpf_free_listener(gpointer data)
+{
+    bpf_listener_t *listener = (bpf_listener_t *)data;
+
+    g_free(listener->host);
+    g_free(listener);
+}
+
+static void
+bpf_free_conn(gpointer data)
+{
+    bpf_conn_t *conn = (bpf_conn_t *)data;
+
+    g_free(conn->hosts[0]);
+    g_free(conn->hosts[1]);
+    g_free(conn);
+}
+
+static void
+bpf_add_listener(bpf_t *bs, const gchar *host, guint16 port, gboolean oob, guint32 jobid)
+{
+    bpf_listener_t *listener;
+    gchar *key;
+
+    key = g_strdup_printf("%s %u", host, port);
+    if (g_hash_table_lookup(bs->listeners, key)) {
+        g_free(key);
+        return;
+    }
+    listener = g_new0(bpf_listener_t, 1);
+    listener->host = g_strdup(host);
+    listener->port = port;
+    listener->oob = oob;
+    listener->jobid = jobid;
+    g_hash_table_insert(bs->listeners, key, listener);
+}
+
+/* "jobid.vpid;tcp://addr,addr:port;tcp6://[addr]:port" */
+static void
+bpf_add_uri(bpf_t *bs, const gchar *uri, guint32 jobid)
+{
+    gchar **parts;
+    gchar **addrs;
+    gchar *contact;
+    gchar *colon;
+    gchar *host;
+    guint port;
+    guint i;
+    guint j;
+
+    parts = g_strsplit(uri, ";", 0);
+    for (i = 0; parts[i]; i++) {
+        if (g_str_has_prefix(parts[i], "tcp://")) {
+            contact = parts[i] + 6;
+        } else if (g_str_has_prefix(parts[i], "tcp6://")) {
+            contact = parts[i] + 7;
+        } else {
+            continue;
+        }
+        colon = strrchr(contact, ':');
+        if (!colon || 1 != sscanf(colon + 1, "%u", &port) || 0xffff < port) {
+            continue;
+        }
+        *colon = '\0';
+        addrs = g_strsplit(contact, ",", 0);
+        for (j = 0; addrs[j]; j++) {
+            host = g_strstrip(addrs[j]);
+            if ('[' == host[0]) {
+                host++;
+                if (strchr(host, ']')) {
+                    *strchr(host, ']') = '\0';
+                }
+            }
+            if (*host) {
+                bpf_add_listener(bs, host, (guint16)port, TRUE, jobid);
+            }
+        }
+        g_strfreev(addrs);
+    }
+    g_strfreev(parts);
+}
+
+static void
+bpf_add_conn(bpf_t *bs, packet_info *pinfo, guint32 stream, gboolean oob,
+        guint32 jobid, guint32 jobid_dst)
+{
+    bpf_conn_t *conn;
+
+    if (g_hash_table_lookup(bs->conns, GUINT_TO_POINTER(stream))) {
+        return;
+    }
+    conn = g_new0(bpf_conn_t, 1);
+    conn->hosts[0] = address_to_str(NULL, &pinfo->src);
+    conn->hosts[1] = address_to_str(NULL, &pinfo->dst);
+    conn->ports[0] = (guint16)pinfo->srcport;
+    conn->ports[1] = (guint16)pinfo->destport;
+    conn->oob = oob;
+    conn->jobids[0] = jobid;
+    conn->jobids[1] = jobid_dst;
+    g_hash_table_insert(bs->conns, GUINT_TO_POINTER(stream), conn);
+}
+
+static gboolean
+bpf_wanted(const bpf_t *bs, gboolean oob, guint32 jobid)
+{
+    if (!bs->by_job) {
+        return TRUE;
+    }
+    if (oob) {
+        return (jobid >> 16) == (bs->jobid >> 16);
+    }
+    return jobid == bs->jobid;
+}
+
+static void
+bpf_reset(void *tapdata)
+{
+    bpf_t *bs = (bpf_t *)tapdata;
+
+    g_hash_table_remove_all(bs->listeners);
+    g_hash_table_remove_all(bs->conns);
+}
+
+static int
+bpf_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt _U_, const void *data)
+{
+    bpf_t *bs = (bpf_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    gchar *host;
+
+    switch (mpi_tap_info->kind) {
+        case MPI_PDU_SYNC:
+            if (mpi_tap_info->is_request) {
+                host = address_to_str(NULL, &pinfo->dst);
+                bpf_add_listener(bs, host, (guint16)pinfo->destport, FALSE,
+                        mpi_tap_info->jobid);
+                g_free(host);
+            }
+            break;
+        case MPI_PDU_OOB:
+            if (mpi_tap_info->uri) {
+                bpf_add_uri(bs, (const gchar *)mpi_tap_info->uri,
+                        mpi_tap_info->jobid_origin);
+            }
+            if (mpi_tap_info->oob_header) {
+                bpf_add_conn(bs, pinfo, mpi_tap_info->stream, TRUE,
+                        mpi_tap_info->jobid_origin, mpi_tap_info->jobid_dst);
+            }
+            break;
+        case MPI_PDU_BTL:
+            if (mpi_tap_info->channel) {
+                bpf_add_conn(bs, pinfo, mpi_tap_info->stream, FALSE,
+                        mpi_tap_info->jobid, mpi_tap_info->jobid);
+            }
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+static gint
+bpf_listener_cmp(gconstpointer a, gconstpointer b)
+{
+    const bpf_listener_t *la = *(const bpf_listener_t * const *)a;
+    const bpf_listener_t *lb = *(const bpf_listener_t * const *)b;
+
+    if (la->port != lb->port) {
+        return la->port < lb->port ? -1 : 1;
+    }
+    return strcmp(la->host, lb->host);
+}
+
+static gboolean
+bpf_is_listener(const bpf_t *bs, const gchar *host, guint16 port)
+{
+    gchar *key;
+    gboolean found;
+
+    key = g_strdup_printf("%s %u", host, port);
+    found = NULL != g_hash_table_lookup(bs->listeners, key);
+    g_free(key);
+    return found;
+}
+
+static void
+bpf_draw(void *tapdata)
+{
+    bpf_t *bs = (bpf_t *)tapdata;
+    GHashTableIter iter;
+    gpointer value;
+    GPtrArray *listeners;
+    GString *expr;
+    const bpf_listener_t *listener;
+    const bpf_conn_t *conn;
+    guint terms = 0;
+    guint btl = 0;
+    guint oob = 0;
+    guint others = 0;
+    guint i;
+    guint j;
+    guint k;
+
+    listeners = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, bs->listeners);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        listener = (const bpf_listener_t *)value;
+        if (bpf_wanted(bs, listener->oob, listener->jobid)) {
+            g_ptr_array_add(listeners, value);
+        }
+    }
+    g_ptr_array_sort(listeners, bpf_listener_cmp);
+
+    /* one term per port */
+    expr = g_string_new("");
+    for (i = 0; i < listeners->len; i = j) {
+        listener = (const bpf_listener_t *)g_ptr_array_index(listeners, i);
+        for (j = i + 1; j < listeners->len; j++) {
+            if (((const bpf_listener_t *)g_ptr_array_index(listeners, j))->port !=
+                    listener->port) {
+                break;
+            }
+        }
+        g_string_append_printf(expr, "%s(tcp port %u and %s",
+                terms++ ? " or " : "", listener->port, 1 < j - i ? "(" : "");
+        for (k = i; k < j; k++) {
+            listener = (const bpf_listener_t *)g_ptr_array_index(listeners, k);
+            g_string_append_printf(expr, "%shost %s", k > i ? " or " : "",
+                    listener->host);
+            if (listener->oob) {
+                oob++;
+            } else {
+                btl++;
+            }
+        }
+        g_string_append(expr, 1 < j - i ? "))" : ")");
+    }
+
+    g_hash_table_iter_init(&iter, bs->conns);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        conn = (const bpf_conn_t *)value;
+        if (!bpf_wanted(bs, conn->oob, conn->jobids[0]) &&
+                !bpf_wanted(bs, conn->oob, conn->jobids[1])) {
+            continue;
+        }
+        if (bpf_is_listener(bs, conn->hosts[0], conn->ports[0]) ||
+                bpf_is_listener(bs, conn->hosts[1], conn->ports[1])) {
+            continue;
+        }
+        g_string_append_printf(expr,
+                "%s(host %s and port %u and host %s and port %u)",
+                terms++ ? " or " : "", conn->hosts[0], conn->ports[0],
+                conn->hosts[1], conn->ports[1]);
+        others++;
+    }
+
+    printf("\n");
+    printf("=============================================================================================================\n");
+    printf("MPI Capture Filter:\n");
+    if (bs->by_job) {
+        printf("Job: %u (OOB of the job family %u)\n", bs->jobid, bs->jobid >> 16);
+    } else {
+        printf("Job: all\n");
+    }
+    printf("BTL listeners: %u, OOB listeners: %u, connections without a listener: %u\n",
+            btl, oob, others);
+    printf("-------------------------------------------------------------------------------------------------------------\n");
+    if (terms) {
+        printf("tcp and (%s)\n", expr->str);
+        printf("-------------------------------------------------------------------------------------------------------------\n");
+        printf("Header-only (OOB message bodies and BTL data are cut):\n");
+        printf("dumpcap -s %u -f 'tcp and (%s)'\n", BPF_SNAPLEN, expr->str);
+    } else {
+        printf("No MPI endpoints seen\n");
+    }
+    printf("=============================================================================================================\n");
+
+    g_string_free(expr, TRUE);
+    g_ptr_array_free(listeners, TRUE);
+}
+
+static void
+bpf_init(const char *opt_arg, void *userdata _U_)
+{
+    bpf_t *bs;
+    GString *error_string;
+    guint jobid = 0;
+    gboolean by_job = FALSE;
+    int pos = 0;
+
+    if (0 != strcmp(opt_arg, "mpi,bpf")) {
+        if (sscanf(opt_arg, "mpi,bpf,%u%n", &jobid, &pos) != 1 ||
+                '\0' != opt_arg[pos]) {
+            fprintf(stderr, "tshark: invalid \"-z mpi,bpf[,<jobid>]\" argument\n");
+            exit(1);
+        }
+        by_job = TRUE;
+    }
+
+    bs = g_new0(bpf_t, 1);
+    bs->by_job = by_job;
+    bs->jobid = jobid;
+    bs->listeners = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            bpf_free_listener);
+    bs->conns = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+            bpf_free_conn);
+
+    error_string = register_tap_listener("mpi", bs, NULL, TL_REQUIRES_NOTHING,
+            bpf_reset, bpf_packet, bpf_draw);
+    if (error_string) {
+        g_hash_table_destroy(bs->conns);
+        g_hash_table_destroy(bs->listeners);
+        g_free(bs);
+        fprintf(stderr, "tshark: Couldn't register mpi,bpf tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_bpf(void)
+{
+    register_stat_cmd_arg("mpi,bpf", bpf_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,256 @@
+/* tap-mpi-channel.c
+ * Load balance over the links of the rank pair channels for tshark
+ * (-z mpi,channel)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Uses the rank pair channels of the dissector (mpi.channel.*), i.e. the
+ * BTL connections between one pair of processes (btl_tcp_links), to show
+ * per channel and link the BTL PDUs and bytes, the share of every link and
+ * the balance of the channel (bytes of the busiest link / average bytes per
+ * link, 1.00 is perfectly striped) and the messages overtaken on another
+ * link.
+ *
+ * The channel of a connection is only known if its sync handshake was
+ * captured, PDUs of other connections are counted as unknown.
+ *
+ * Usage: -z mpi,channel[,filter]
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+typedef struct _channel_link_t {
+    guint pdus;
+    guint64 bytes;
+    guint32 stream;
+} channel_link_t;
+
+typedef struct _channel_chan_t {
+    guint32 id;
+    guint32 jobid[2];       /* the lower name first */
+    guint32 vpid[2];
+    guint pdus;
+    guint64 bytes;
+    guint reordered;
+    GArray *links;          /* channel_link_t, index link - 1 */
+} channel_chan_t;
+
+typedef struct _channel_t {
+    char *filter;
+    GHashTable *chans;      /* id -> channel_chan_t */
+    guint unknown_pdus;
+    guint64 unknown_bytes;
+} channel_t;
+
+static void
+channel_free_chan(gpointer data)
+{
+    channel_chan_t *chan = (channel_chan_t *)data;
+
+    g_array_free(chan->links, TRUE);
+    g_free(chan);
+}
+
+static void
+channel_reset(void *tapdata)
+{
+    channel_t *cs = (channel_t *)tapdata;
+
+    g_hash_table_remove_all(cs->chans);
+    cs->unknown_pdus = 0;
+    cs->unknown_bytes = 0;
+}
+
+static int
+channel_packet(void *tapdata, packet_info *pinfo _U_, epan_dissect_t *edt _U_, const void *data)
+{
+    channel_t *cs = (channel_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    channel_chan_t *chan;
+    channel_link_t *link;
+    guint64 bytes;
+    guint i;
+
+    if (MPI_PDU_BTL != mpi_tap_info->kind) {
+        return 0;
+    }
+    /* the base header is not a part of the size */
+    bytes = (guint64)mpi_tap_info->size + 8;
+    if (0 == mpi_tap_info->channel) {
+        cs->unknown_pdus++;
+        cs->unknown_bytes += bytes;
+        return 1;
+    }
+
+    chan = (channel_chan_t *)g_hash_table_lookup(cs->chans,
+            GUINT_TO_POINTER(mpi_tap_info->channel));
+    if (!chan) {
+        chan = g_new0(channel_chan_t, 1);
+        chan->id = mpi_tap_info->channel;
+        i = (mpi_tap_info->jobid < mpi_tap_info->jobid_dst ||
+                (mpi_tap_info->jobid == mpi_tap_info->jobid_dst &&
+                 mpi_tap_info->vpid < mpi_tap_info->vpid_dst)) ? 0 : 1;
+        chan->jobid[i] = mpi_tap_info->jobid;
+        chan->vpid[i] = mpi_tap_info->vpid;
+        chan->jobid[1 - i] = mpi_tap_info->jobid_dst;
+        chan->vpid[1 - i] = mpi_tap_info->vpid_dst;
+        chan->links = g_array_new(FALSE, TRUE, sizeof(channel_link_t));
+        g_hash_table_insert(cs->chans, GUINT_TO_POINTER(chan->id), chan);
+    }
+    if (chan->links->len < mpi_tap_info->channel_link) {
+        g_array_set_size(chan->links, mpi_tap_info->channel_link);
+    }
+    link = &g_array_index(chan->links, channel_link_t,
+            mpi_tap_info->channel_link - 1);
+    link->pdus++;
+    link->bytes += bytes;
+    link->stream = mpi_tap_info->stream;
+    chan->pdus++;
+    chan->bytes += bytes;
+    if (mpi_tap_info->channel_reordered) {
+        chan->reordered++;
+    }
+    return 1;
+}
+
+static gint
+channel_chan_cmp(gconstpointer a, gconstpointer b)
+{
+    const channel_chan_t *ca = *(const channel_chan_t * const *)a;
+    const channel_chan_t *cb = *(const channel_chan_t * const *)b;
+
+    return ca->id < cb->id ? -1 : (ca->id > cb->id);
+}
+
+static void
+channel_draw(void *tapdata)
+{
+    channel_t *cs = (channel_t *)tapdata;
+    GPtrArray *chans;
+    GHashTableIter iter;
+    gpointer value;
+    channel_chan_t *chan;
+    channel_link_t *link;
+    guint64 max;
+    guint i, j;
+
+    chans = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, cs->chans);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(chans, value);
+    }
+    g_ptr_array_sort(chans, channel_chan_cmp);
+
+    printf("\n");
+    printf("===================================================================================\n");
+    printf("MPI Rank Pair Channels:\n");
+    printf("Filter: %s\n", cs->filter ? cs->filter : "");
+    printf("Channels: %u, PDUs of unknown channels: %u (%" G_GINT64_MODIFIER "u bytes)\n",
+            chans->len, cs->unknown_pdus, cs->unknown_bytes);
+    printf("-----------------------------------------------------------------------------------\n");
+    printf("%7s %-30s %5s %9s %14s %7s %9s\n", "Channel", "Processes",
+            "Links", "PDUs", "Bytes", "Balance", "Overtaken");
+    printf("%7s %-30s %5s %9s %14s %7s\n", "", "", "Link", "PDUs", "Bytes",
+            "Share");
+    for (i = 0; i < chans->len; i++) {
+        chan = (channel_chan_t *)g_ptr_array_index(chans, i);
+        max = 0;
+        for (j = 0; j < chan->links->len; j++) {
+            link = &g_array_index(chan->links, channel_link_t, j);
+            max = MAX(max, link->bytes);
+        }
+        printf("%7u %10u.%-5u - %5u.%-5u %5u %9u %14" G_GINT64_MODIFIER "u"
+                " %7.2f %9u\n", chan->id, chan->jobid[0], chan->vpid[0],
+                chan->jobid[1], chan->vpid[1], chan->links->len, chan->pdus,
+                chan->bytes,
+                chan->bytes ? (gdouble)max * chan->links->len / chan->bytes : 0,
+                chan->reordered);
+        for (j = 0; j < chan->links->len; j++) {
+            link = &g_array_index(chan->links, channel_link_t, j);
+            printf("%7s %-30s %5u %9u %14" G_GINT64_MODIFIER "u %6.1f%%"
+                    "   tcp.stream %u\n", "", "", j + 1, link->pdus,
+                    link->bytes,
+                    chan->bytes ? 100.0 * link->bytes / chan->bytes : 0,
+                    link->stream);
+        }
+    }
+    g_ptr_array_free(chans, TRUE);
+    printf("===================================================================================\n");
+}
+
+static void
+channel_init(const char *opt_arg, void *userdata _U_)
+{
+    channel_t *cs;
+    const char *filter = NULL;
+    GString *error_string;
+
+    if (!strncmp(opt_arg, "mpi,channel,", 12)) {
+        filter = opt_arg + 12;
+    }
+
+    cs = g_new0(channel_t, 1);
+    cs->filter = filter ? g_strdup(filter) : NULL;
+    cs->chans = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+            NULL, channel_free_chan);
+
+    error_string = register_tap_listener("mpi", cs, cs->filter, 0,
+            channel_reset, channel_packet, channel_draw);
+    if (error_string) {
+        g_hash_table_destroy(cs->chans);
+        g_free(cs->filter);
+        g_free(cs);
+        fprintf(stderr, "tshark: Couldn't register mpi,channel tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_channel(void)
+{
+    register_stat_cmd_arg("mpi,channel", channel_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,522 @@
+/* tap-mpi-columns.c
+ * Columnar binary export of the MPI messages for tshark (-z mpi,columns)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Writes one record per message (MATCH, RNDV, RGET) into a columnar
+ * binary file, read by tools/mpi-columns.py. A record is written when the
+ * message is complete: an eager message at once, a rendezvous at the end
+ * of its transfer (or at the end of the capture, with end 0).
+ *
+ * File format, all integers little endian:
+ *
+ *   header   "MPICOLS\0", u16 version (1), u16 number of columns, then
+ *            for every column: u8 type, u8 name length, name
+ *            type is a Python struct code: q (i64), I (u32), i (i32),
+ *            H (u16), B (u8)
+ *   blocks   u32 rows (0 ends the file), then for every column:
+ *            u8 encoding, u32 length of the data, data
+ *
+ * Encodings of a column in a block:
+ *
+ *   0 plain  rows values of the type
+ *   1 dict   u32 n, n values of the type, rows indexes into them
+ *            (u8 if n <= 256, else u16)
+ *   2 delta  rows zigzag LEB128 varints of the difference to the
+ *            previous value (the first to 0)
+ *
+ * The times are deltas, the other columns a dictionary if it is smaller.
+ * Only the current block and the unfinished rendezvous are kept.
+ *
+ * Columns: time and end (ns since the epoch, end of the transfer), frame,
+ * src_job, src, dst_job, dst (jobid and vpid, 0xffffffff if the channel
+ * is unknown), ctx, tag, seq, bytes, protocol (0 eager, 1 rendezvous,
+ * 2 RDMA get).
+ *
+ * Usage: -z mpi,columns,<file>[,filter]
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <glib/gstdio.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+#define COLUMNS_VERSION 1
+/* records per block */
+#define COLUMNS_BLOCK_ROWS 65536
+/* unfinished rendezvous transfers kept at most */
+#define COLUMNS_MAX_PENDING 65536
+/* dictionary entries at most */
+#define COLUMNS_MAX_DICT 65536
+
+#define COLUMNS_ENC_PLAIN 0
+#define COLUMNS_ENC_DICT 1
+#define COLUMNS_ENC_DELTA 2
+
+#define COLUMNS_UNKNOWN 0xffffffff
+
+typedef enum {
+    COLUMNS_TIME,
+    COLUMNS_END,
+    COLUMNS_FRAME,
+    COLUMNS_SRC_JOB,
+    COLUMNS_SRC,
+    COLUMNS_DST_JOB,
+    COLUMNS_DST,
+    COLUMNS_CTX,
+    COLUMNS_TAG,
+    COLUMNS_SEQ,
+    COLUMNS_BYTES,
+    COLUMNS_PROTOCOL,
+    COLUMNS_COUNT
+} columns_col_t;
+
+typedef struct _columns_desc_t {
+    const char *name;
+    char type;              /* struct code */
+    guint8 width;
+    gboolean delta;
+} columns_desc_t;
+
+static const columns_desc_t columns_descs[COLUMNS_COUNT] = {
+    { "time", 'q', 8, TRUE },
+    { "end", 'q', 8, TRUE },
+    { "frame", 'I', 4, TRUE },
+    { "src_job", 'I', 4, FALSE },
+    { "src", 'I', 4, FALSE },
+    { "dst_job", 'I', 4, FALSE },
+    { "dst", 'I', 4, FALSE },
+    { "ctx", 'H', 2, FALSE },
+    { "tag", 'i', 4, FALSE },
+    { "seq", 'H', 2, FALSE },
+    { "bytes", 'q', 8, FALSE },
+    { "protocol", 'B', 1, FALSE }
+};
+
+typedef struct _columns_t {
+    char *filter;
+    char *path;
+    FILE *fp;
+    gboolean write_error;
+    guint64 *values[COLUMNS_COUNT]; /* the current block */
+    guint rows;
+    GHashTable *pending;    /* RNDV frame -> guint64 values[COLUMNS_COUNT] */
+    GByteArray *buf;
+    GHashTable *dict;       /* value -> index + 1 */
+    guint64 records;
+    guint64 bytes;          /* written */
+    guint blocks;
+    guint untracked;
+} columns_t;
+
+static void
+columns_write(columns_t *cs, const void *data, size_t len)
+{
+    if (cs->fp && fwrite(data, 1, len, cs->fp) != len) {
+        cs->write_error = TRUE;
+    }
+    cs->bytes += len;
+}
+
+/* append the "width" low bytes of "value", little endian */
+static void
+columns_put(GByteArray *buf, guint64 value, guint8 width)
+{
+    guint8 bytes[8];
+    guint8 i;
+
+    for (i = 0; i < width; i++) {
+        bytes[i] = (guint8)(value >> (8 * i));
+    }
+    g_byte_array_append(buf, bytes, width);
+}
+
+static void
+columns_put_varint(GByteArray *buf, guint64 value)
+{
+    guint8 byte;
+
+    do {
+        byte = value & 0x7f;
+        value >>= 7;
+        if (value) {
+            byte |= 0x80;
+        }
+        g_byte_array_append(buf, &byte, 1);
+    } while (value);
+}
+
+/* encode column "col" of the current block into cs->buf */
+static guint8
+columns_encode(columns_t *cs, columns_col_t col)
+{
+    const columns_desc_t *desc = &columns_descs[col];
+    const guint64 *values = cs->values[col];
+    guint64 prev = 0;
+    gint64 diff;
+    guint64 *keys;
+    guint32 n;
+    guint8 index_width;
+    guint i;
+
+    g_byte_array_set_size(cs->buf, 0);
+
+    if (desc->delta) {
+        for (i = 0; i < cs->rows; i++) {
+            diff = (gint64)(values[i] - prev);
+            columns_put_varint(cs->buf,
+                    ((guint64)diff << 1) ^ (guint64)(diff >> 63));
+            prev = values[i];
+        }
+        return COLUMNS_ENC_DELTA;
+    }
+
+    /* a dictionary if it is smaller than the plain values */
+    g_hash_table_remove_all(cs->dict);
+    for (i = 0; i < cs->rows &&
+            COLUMNS_MAX_DICT >= g_hash_table_size(cs->dict); i++) {
+        if (!g_hash_table_lookup(cs->dict, &values[i])) {
+            g_hash_table_insert(cs->dict, (gpointer)&values[i],
+                    GUINT_TO_POINTER(g_hash_table_size(cs->dict) + 1));
+        }
+    }
+    n = g_hash_table_size(cs->dict);
+    index_width = 256 >= n ? 1 : 2;
+    if (COLUMNS_MAX_DICT < n ||
+            4 + n * desc->width + cs->rows * index_width >=
+            cs->rows * desc->width) {
+        for (i = 0; i < cs->rows; i++) {
+            columns_put(cs->buf, values[i], desc->width);
+        }
+        return COLUMNS_ENC_PLAIN;
+    }
+
+    keys = g_new(guint64, n);
+    for (i = 0; i < cs->rows; i++) {
+        keys[GPOINTER_TO_UINT(g_hash_table_lookup(cs->dict, &values[i])) - 1] =
+            values[i];
+    }
+    columns_put(cs->buf, n, 4);
+    for (i = 0; i < n; i++) {
+        columns_put(cs->buf, keys[i], desc->width);
+    }
+    for (i = 0; i < cs->rows; i++) {
+        columns_put(cs->buf, GPOINTER_TO_UINT(g_hash_table_lookup(cs->dict,
+                        &values[i])) - 1, index_width);
+    }
+    g_free(keys);
+    return COLUMNS_ENC_DICT;
+}
+
+static void
+columns_flush(columns_t *cs)
+{
+    guint8 head[5];
+    guint8 encoding;
+    guint col;
+
+    if (0 == cs->rows) {
+        return;
+    }
+    head[0] = (guint8)cs->rows;
+    head[1] = (guint8)(cs->rows >> 8);
+    head[2] = (guint8)(cs->rows >> 16);
+    head[3] = (guint8)(cs->rows >> 24);
+    columns_write(cs, head, 4);
+    for (col = 0; col < COLUMNS_COUNT; col++) {
+        encoding = columns_encode(cs, (columns_col_t)col);
+        head[0] = encoding;
+        head[1] = (guint8)cs->buf->len;
+        head[2] = (guint8)(cs->buf->len >> 8);
+        head[3] = (guint8)(cs->buf->len >> 16);
+        head[4] = (guint8)(cs->buf->len >> 24);
+        columns_write(cs, head, 5);
+        columns_write(cs, cs->buf->data, cs->buf->len);
+    }
+    cs->blocks++;
+    cs->rows = 0;
+}
+
+static void
+columns_add(columns_t *cs, const guint64 *record)
+{
+    guint col;
+
+    for (col = 0; col < COLUMNS_COUNT; col++) {
+        cs->values[col][cs->rows] = record[col];
+    }
+    cs->records++;
+    if (COLUMNS_BLOCK_ROWS == ++cs->rows) {
+        columns_flush(cs);
+    }
+}
+
+static gboolean
+columns_open(columns_t *cs)
+{
+    guint8 head[4];
+    guint8 len;
+    guint col;
+
+    cs->fp = g_fopen(cs->path, "wb");
+    if (!cs->fp) {
+        return FALSE;
+    }
+    cs->bytes = 0;
+    columns_write(cs, "MPICOLS", 8);
+    head[0] = COLUMNS_VERSION;
+    head[1] = 0;
+    head[2] = COLUMNS_COUNT;
+    head[3] = 0;
+    columns_write(cs, head, 4);
+    for (col = 0; col < COLUMNS_COUNT; col++) {
+        len = (guint8)strlen(columns_descs[col].name);
+        head[0] = columns_descs[col].type;
+        head[1] = len;
+        columns_write(cs, head, 2);
+        columns_write(cs, columns_descs[col].name, len);
+    }
+    return TRUE;
+}
+
+static void
+columns_reset(void *tapdata)
+{
+    columns_t *cs = (columns_t *)tapdata;
+
+    g_hash_table_remove_all(cs->pending);
+    if (cs->fp) {
+        fclose(cs->fp);
+        cs->fp = NULL;
+    }
+    cs->rows = 0;
+    cs->records = 0;
+    cs->blocks = 0;
+    cs->untracked = 0;
+    cs->write_error = !columns_open(cs);
+}
+
+static int
+columns_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt _U_, const void *data)
+{
+    columns_t *cs = (columns_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    guint64 record[COLUMNS_COUNT];
+    guint64 *pending;
+    guint64 now;
+
+    if (MPI_PDU_BTL != mpi_tap_info->kind) {
+        return 0;
+    }
+    now = (guint64)pinfo->fd->abs_ts.secs * 1000000000 +
+        pinfo->fd->abs_ts.nsecs;
+
+    if (mpi_tap_info->matched) {
+        record[COLUMNS_TIME] = now;
+        record[COLUMNS_END] = now;
+        record[COLUMNS_FRAME] = pinfo->fd->num;
+        if (mpi_tap_info->channel) {
+            record[COLUMNS_SRC_JOB] = mpi_tap_info->jobid;
+            record[COLUMNS_SRC] = mpi_tap_info->vpid;
+            record[COLUMNS_DST_JOB] = mpi_tap_info->jobid_dst;
+            record[COLUMNS_DST] = mpi_tap_info->vpid_dst;
+        } else {
+            record[COLUMNS_SRC_JOB] = COLUMNS_UNKNOWN;
+            record[COLUMNS_SRC] = COLUMNS_UNKNOWN;
+            record[COLUMNS_DST_JOB] = COLUMNS_UNKNOWN;
+            record[COLUMNS_DST] = COLUMNS_UNKNOWN;
+        }
+        record[COLUMNS_CTX] = mpi_tap_info->match_ctx;
+        record[COLUMNS_TAG] = (guint32)mpi_tap_info->match_tag;
+        record[COLUMNS_SEQ] = mpi_tap_info->match_seq;
+        switch (mpi_tap_info->base) {
+            case MPI_PML_OB1_HDR_TYPE_MATCH:
+                record[COLUMNS_BYTES] = mpi_tap_info->payload;
+                record[COLUMNS_PROTOCOL] = 0;
+                break;
+            case MPI_PML_BFO_HDR_TYPE_RNDV:
+                record[COLUMNS_BYTES] = mpi_tap_info->msg_len;
+                record[COLUMNS_PROTOCOL] = 1;
+                break;
+            default:
+                record[COLUMNS_BYTES] = mpi_tap_info->msg_len;
+                record[COLUMNS_PROTOCOL] = 2;
+                break;
+        }
+        if (0 == record[COLUMNS_PROTOCOL]) {
+            columns_add(cs, record);
+        } else if (COLUMNS_MAX_PENDING > g_hash_table_size(cs->pending)) {
+            record[COLUMNS_END] = 0;
+            g_hash_table_insert(cs->pending, GUINT_TO_POINTER(pinfo->fd->num),
+                    g_memdup(record, sizeof(record)));
+        } else {
+            /* without its end */
+            record[COLUMNS_END] = 0;
+            columns_add(cs, record);
+            cs->untracked++;
+        }
+    }
+
+    if (mpi_tap_info->xfer_done) {
+        pending = (guint64 *)g_hash_table_lookup(cs->pending,
+                GUINT_TO_POINTER(mpi_tap_info->xfer_rndv_in));
+        if (pending) {
+            pending[COLUMNS_END] = now;
+            columns_add(cs, pending);
+            g_hash_table_remove(cs->pending,
+                    GUINT_TO_POINTER(mpi_tap_info->xfer_rndv_in));
+        }
+    }
+
+    return 1;
+}
+
+static void
+columns_draw(void *tapdata)
+{
+    columns_t *cs = (columns_t *)tapdata;
+    GHashTableIter iter;
+    gpointer value;
+    guint unfinished;
+    guint8 end[4] = { 0, 0, 0, 0 };
+
+    unfinished = g_hash_table_size(cs->pending);
+    g_hash_table_iter_init(&iter, cs->pending);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        columns_add(cs, (const guint64 *)value);
+    }
+    g_hash_table_remove_all(cs->pending);
+    columns_flush(cs);
+    columns_write(cs, end, 4);
+    if (cs->fp) {
+        if (0 != fclose(cs->fp)) {
+            cs->write_error = TRUE;
+        }
+        cs->fp = NULL;
+    }
+
+    printf("\n");
+    printf("=============================================================================================================\n");
+    printf("MPI Columns Export:\n");
+    printf("Filter: %s\n", cs->filter ? cs->filter : "");
+    printf("Exported to: %s%s\n", cs->path,
+            cs->write_error ? " (with write errors)" : "");
+    printf("Records: %" G_GINT64_MODIFIER "u in %u blocks, %" G_GINT64_MODIFIER
+            "u bytes (%.1f per record)\n", cs->records, cs->blocks, cs->bytes,
+            cs->records ? (gdouble)cs->bytes / cs->records : 0.0);
+    printf("Rendezvous without end: %u unfinished, %u beyond %u in flight\n",
+            unfinished, cs->untracked, COLUMNS_MAX_PENDING);
+    printf("=============================================================================================================\n");
+}
+
+static gboolean
+columns_equal(gconstpointer a, gconstpointer b)
+{
+    return *(const guint64 *)a == *(const guint64 *)b;
+}
+
+static void
+columns_init(const char *opt_arg, void *userdata _U_)
+{
+    columns_t *cs;
+    const char *filter = NULL;
+    const char *path = NULL;
+    const char *end = NULL;
+    GString *error_string;
+    guint col;
+
+    if (!strncmp(opt_arg, "mpi,columns,", 12)) {
+        path = opt_arg + 12;
+        end = strchr(path, ',');
+        if (end) {
+            filter = end + 1;
+        }
+    }
+    if (!path || path == end || '\0' == *path) {
+        fprintf(stderr, "tshark: invalid \"-z mpi,columns,<file>[,<filter>]\" argument\n");
+        exit(1);
+    }
+
+    cs = g_new0(columns_t, 1);
+    cs->path = end ? g_strndup(path, end - path) : g_strdup(path);
+    if (!columns_open(cs)) {
+        fprintf(stderr, "tshark: mpi,columns: can't open %s: %s\n",
+                cs->path, g_strerror(errno));
+        exit(1);
+    }
+    cs->filter = filter ? g_strdup(filter) : NULL;
+    for (col = 0; col < COLUMNS_COUNT; col++) {
+        cs->values[col] = g_new(guint64, COLUMNS_BLOCK_ROWS);
+    }
+    cs->pending = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+            NULL, g_free);
+    cs->buf = g_byte_array_new();
+    cs->dict = g_hash_table_new(g_int64_hash, columns_equal);
+
+    error_string = register_tap_listener("mpi", cs, cs->filter, 0,
+            columns_reset, columns_packet, columns_draw);
+    if (error_string) {
+        g_hash_table_destroy(cs->dict);
+        g_byte_array_free(cs->buf, TRUE);
+        g_hash_table_destroy(cs->pending);
+        for (col = 0; col < COLUMNS_COUNT; col++) {
+            g_free(cs->values[col]);
+        }
+        fclose(cs->fp);
+        g_free(cs->filter);
+        g_free(cs->path);
+        g_free(cs);
+        fprintf(stderr, "tshark: Couldn't register mpi,columns tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_columns(void)
+{
+    register_stat_cmd_arg("mpi,columns", columns_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,392 @@
+/* tap-mpi-connsetup.c
+ * MPI BTL connection setup statistics for tshark (-z mpi,connsetup)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * With lazy connection setup every rank pair opens its BTL connection on
+ * the first message and exchanges the 8 byte (jobid, vpid) synchronization.
+ * This statistic reconstructs every handshake:
+ *
+ *   first tcp segment (SYN) -> sync request -> sync response -> first MATCH
+ *
+ * and prints the phase durations per rank pair, a summary over all pairs
+ * and a time bucketed series of the handshakes in flight (from the SYN up
+ * to the sync response).
+ *
+ * Usage: -z mpi,connsetup[,bucket[,filter]]   (bucket in seconds)
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+#define CONNSETUP_DEFAULT_BUCKET 0.1
+#define CONNSETUP_MAX_BUCKETS 10000
+
+/* one BTL connection */
+typedef struct _connsetup_conn_t {
+    guint32 stream;
+    guint32 jobid;
+    guint32 req_vpid;
+    guint32 rep_vpid;
+    guint32 req_frame;
+    guint32 rep_frame;
+    guint32 match_frame;
+    nstime_t conn_start;
+    nstime_t req_time;
+    nstime_t rep_time;
+    nstime_t match_time;
+} connsetup_conn_t;
+
+typedef struct _connsetup_t {
+    char *filter;
+    gdouble bucket;
+    GHashTable *conns;      /* tcp.stream -> connsetup_conn_t */
+    nstime_t last_time;     /* last tapped packet, closes open handshakes */
+} connsetup_t;
+
+/* a start (+1) or end (-1) of a handshake for the in flight series */
+typedef struct _connsetup_event_t {
+    gdouble time;
+    gint delta;
+} connsetup_event_t;
+
+static void
+connsetup_reset(void *tapdata)
+{
+    connsetup_t *cs = (connsetup_t *)tapdata;
+
+    g_hash_table_remove_all(cs->conns);
+    nstime_set_zero(&cs->last_time);
+}
+
+static int
+connsetup_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt _U_, const void *data)
+{
+    connsetup_t *cs = (connsetup_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    connsetup_conn_t *conn;
+
+    cs->last_time = pinfo->fd->abs_ts;
+
+    conn = (connsetup_conn_t *)g_hash_table_lookup(cs->conns,
+            GUINT_TO_POINTER(mpi_tap_info->stream));
+
+    switch (mpi_tap_info->kind) {
+        case MPI_PDU_SYNC:
+            if (!conn) {
+                conn = g_new0(connsetup_conn_t, 1);
+                conn->stream = mpi_tap_info->stream;
+                conn->jobid = mpi_tap_info->jobid;
+                conn->conn_start = mpi_tap_info->conn_start;
+                g_hash_table_insert(cs->conns,
+                        GUINT_TO_POINTER(conn->stream), conn);
+            }
+            if (mpi_tap_info->is_request) {
+                if (!conn->req_frame) {
+                    conn->req_vpid = mpi_tap_info->vpid;
+                    conn->req_frame = pinfo->fd->num;
+                    conn->req_time = pinfo->fd->abs_ts;
+                }
+            } else if (!conn->rep_frame) {
+                conn->rep_vpid = mpi_tap_info->vpid;
+                conn->rep_frame = pinfo->fd->num;
+                conn->rep_time = pinfo->fd->abs_ts;
+            }
+            break;
+        case MPI_PDU_BTL:
+            if (conn && conn->rep_frame && !conn->match_frame &&
+                    MPI_PML_OB1_HDR_TYPE_MATCH == mpi_tap_info->base) {
+                conn->match_frame = pinfo->fd->num;
+                conn->match_time = pinfo->fd->abs_ts;
+            }
+            break;
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+static gdouble
+connsetup_delta(const nstime_t *to, const nstime_t *from)
+{
+    nstime_t delta;
+
+    nstime_delta(&delta, to, from);
+    return nstime_to_sec(&delta);
+}
+
+static gint
+connsetup_conn_cmp(gconstpointer a, gconstpointer b)
+{
+    const connsetup_conn_t *ca = *(const connsetup_conn_t * const *)a;
+    const connsetup_conn_t *cb = *(const connsetup_conn_t * const *)b;
+
+    return nstime_cmp(&ca->conn_start, &cb->conn_start);
+}
+
+static gint
+connsetup_double_cmp(gconstpointer a, gconstpointer b)
+{
+    gdouble da = *(const gdouble *)a;
+    gdouble db = *(const gdouble *)b;
+
+    return (da > db) - (da < db);
+}
+
+static gint
+connsetup_event_cmp(gconstpointer a, gconstpointer b)
+{
+    const connsetup_event_t *ea = (const connsetup_event_t *)a;
+    const connsetup_event_t *eb = (const connsetup_event_t *)b;
+
+    if (ea->time != eb->time) {
+        return (ea->time > eb->time) - (ea->time < eb->time);
+    }
+    /* a handshake ending at the same instant is no longer in flight */
+    return ea->delta - eb->delta;
+}
+
+static void
+connsetup_print_phase(const char *name, GArray *values)
+{
+    gdouble sum = 0;
+    guint i;
+
+    if (0 == values->len) {
+        printf("%-22s %8u\n", name, 0);
+        return;
+    }
+    g_array_sort(values, connsetup_double_cmp);
+    for (i = 0; i < values->len; i++) {
+        sum += g_array_index(values, gdouble, i);
+    }
+    printf("%-22s %8u %12.6f %12.6f %12.6f %12.6f %12.6f\n", name, values->len,
+            g_array_index(values, gdouble, 0),
+            sum / values->len,
+            g_array_index(values, gdouble, values->len / 2),
+            g_array_index(values, gdouble, (values->len * 99) / 100),
+            g_array_index(values, gdouble, values->len - 1));
+}
+
+static void
+connsetup_draw(void *tapdata)
+{
+    connsetup_t *cs = (connsetup_t *)tapdata;
+    GPtrArray *conns;
+    GArray *syn_req, *req_rep, *rep_match;
+    GArray *events;
+    connsetup_conn_t *conn;
+    connsetup_event_t ev;
+    GHashTableIter iter;
+    gpointer value;
+    nstime_t t0;
+    gdouble bucket, end;
+    guint nbuckets, b, i, e;
+    gint level, peak;
+
+    conns = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, cs->conns);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(conns, value);
+    }
+    g_ptr_array_sort(conns, connsetup_conn_cmp);
+
+    printf("\n");
+    printf("===================================================================================\n");
+    printf("MPI BTL Connection Setup Statistics:\n");
+    printf("Filter: %s\n", cs->filter ? cs->filter : "");
+    printf("Connections: %u\n", conns->len);
+
+    if (0 == conns->len) {
+        printf("===================================================================================\n");
+        g_ptr_array_free(conns, TRUE);
+        return;
+    }
+
+    t0 = ((connsetup_conn_t *)g_ptr_array_index(conns, 0))->conn_start;
+
+    syn_req = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    req_rep = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    rep_match = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    events = g_array_new(FALSE, FALSE, sizeof(connsetup_event_t));
+
+    printf("-----------------------------------------------------------------------------------\n");
+    printf("Stream   Jobid      Vpid -> Vpid        Start    SYN->Req   Req->Resp Resp->MATCH\n");
+    for (i = 0; i < conns->len; i++) {
+        gdouble d;
+
+        conn = (connsetup_conn_t *)g_ptr_array_index(conns, i);
+        printf("%6u %7u %9u -> %-9u %8.6f", conn->stream, conn->jobid,
+                conn->req_vpid, conn->rep_vpid,
+                connsetup_delta(&conn->conn_start, &t0));
+        if (conn->req_frame) {
+            d = connsetup_delta(&conn->req_time, &conn->conn_start);
+            g_array_append_val(syn_req, d);
+            printf(" %11.6f", d);
+        } else {
+            printf(" %11s", "-");
+        }
+        if (conn->req_frame && conn->rep_frame) {
+            d = connsetup_delta(&conn->rep_time, &conn->req_time);
+            g_array_append_val(req_rep, d);
+            printf(" %11.6f", d);
+        } else {
+            printf(" %11s", "-");
+        }
+        if (conn->rep_frame && conn->match_frame) {
+            d = connsetup_delta(&conn->match_time, &conn->rep_time);
+            g_array_append_val(rep_match, d);
+            printf(" %11.6f", d);
+        } else {
+            printf(" %11s", "-");
+        }
+        printf("\n");
+
+        /* the handshake is in flight from the SYN up to the response */
+        ev.time = connsetup_delta(&conn->conn_start, &t0);
+        ev.delta = 1;
+        g_array_append_val(events, ev);
+        ev.time = connsetup_delta(conn->rep_frame ? &conn->rep_time : &cs->last_time, &t0);
+        ev.delta = -1;
+        g_array_append_val(events, ev);
+    }
+
+    printf("-----------------------------------------------------------------------------------\n");
+    printf("Phase (seconds)           Count          Min          Avg          p50"
+            "          p99          Max\n");
+    connsetup_print_phase("SYN -> sync request", syn_req);
+    connsetup_print_phase("request -> response", req_rep);
+    connsetup_print_phase("response -> MATCH", rep_match);
+
+    /* handshakes in flight per bucket */
+    g_array_sort(events, connsetup_event_cmp);
+    end = g_array_index(events, connsetup_event_t, events->len - 1).time;
+    bucket = cs->bucket;
+    if (end / bucket >= CONNSETUP_MAX_BUCKETS) {
+        bucket = end / (CONNSETUP_MAX_BUCKETS - 1);
+    }
+    nbuckets = (guint)floor(end / bucket) + 1;
+
+    printf("-----------------------------------------------------------------------------------\n");
+    printf("Handshakes in flight (bucket %.6f s, empty buckets omitted)\n", bucket);
+    printf("    Start   Started Completed      Peak  At end\n");
+    level = 0;
+    e = 0;
+    for (b = 0; b < nbuckets; b++) {
+        guint started = 0;
+        guint completed = 0;
+        gdouble bend = (b + 1) * bucket;
+
+        peak = level;
+        while (e < events->len &&
+                g_array_index(events, connsetup_event_t, e).time < bend) {
+            level += g_array_index(events, connsetup_event_t, e).delta;
+            if (0 < g_array_index(events, connsetup_event_t, e).delta) {
+                started++;
+            } else {
+                completed++;
+            }
+            peak = MAX(peak, level);
+            e++;
+        }
+        if (0 == peak) {
+            continue;
+        }
+        printf("%9.3f %9u %9u %9d %7d\n", b * bucket, started, completed,
+                peak, level);
+    }
+    printf("===================================================================================\n");
+
+    g_array_free(syn_req, TRUE);
+    g_array_free(req_rep, TRUE);
+    g_array_free(rep_match, TRUE);
+    g_array_free(events, TRUE);
+    g_ptr_array_free(conns, TRUE);
+}
+
+static void
+connsetup_init(const char *opt_arg, void *userdata _U_)
+{
+    connsetup_t *cs;
+    const char *filter = NULL;
+    gdouble bucket = CONNSETUP_DEFAULT_BUCKET;
+    GString *error_string;
+    int pos = 0;
+
+    if (sscanf(opt_arg, "mpi,connsetup,%lf%n", &bucket, &pos) == 1) {
+        if (',' == opt_arg[pos]) {
+            filter = opt_arg + pos + 1;
+        }
+    }
+    if (0 >= bucket) {
+        fprintf(stderr, "tshark: invalid \"-z mpi,connsetup,<bucket>[,<filter>]\" bucket\n");
+        exit(1);
+    }
+
+    cs = g_new0(connsetup_t, 1);
+    cs->filter = filter ? g_strdup(filter) : NULL;
+    cs->bucket = bucket;
+    cs->conns = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+            NULL, g_free);
+
+    error_string = register_tap_listener("mpi", cs, cs->filter, 0,
+            connsetup_reset, connsetup_packet, connsetup_draw);
+    if (error_string) {
+        g_hash_table_destroy(cs->conns);
+        g_free(cs->filter);
+        g_free(cs);
+        fprintf(stderr, "tshark: Couldn't register mpi,connsetup tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_connsetup(void)
+{
+    register_stat_cmd_arg("mpi,connsetup", connsetup_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
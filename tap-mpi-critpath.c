@@ -0,0 +1,433 @@
+/* tap-mpi-critpath.c
+ * Critical path through the happens-before graph of the ranks for tshark
+ * (-z mpi,critpath)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Every message (eager MATCH or rendezvous transfer) is an edge of the
+ * happens-before graph from its sender at the send time to its receiver
+ * at the arrival: the MATCH itself, or the end of the transfer. The edges
+ * are collected per receiver while dissecting.
+ *
+ * The critical path is walked backwards from the last arrival in the
+ * window: a rank waiting for a message continues right after it arrived,
+ * so the latest message arriving at the current rank before the current
+ * time is taken. The time from its arrival to the current time is spent
+ * on the rank (computing or waiting for something not on the wire), then
+ * the path follows the message back to its sender. The walk stops at the
+ * beginning of the window.
+ *
+ * Shown are the time on the path per rank, per rank pair (messages) and
+ * the messages on the path. The ranks are the process names of the rank
+ * pair channels (mpi.channel.*), messages of connections without a
+ * captured sync handshake are unknown.
+ *
+ * Usage: -z mpi,critpath[,start,end[,filter]]
+ *        (window in seconds since the first BTL PDU, default: everything)
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+/* messages of the path listed at most (the latest ones) */
+#define CRITPATH_MAX_LIST 100
+
+#define CRITPATH_NAME(jobid, vpid) (((guint64)(jobid) << 32) | (vpid))
+
+/* an edge into a rank */
+typedef struct _critpath_msg_t {
+    guint64 src;
+    guint32 frame;          /* MATCH or RNDV */
+    gdouble sent;           /* ms since the first BTL PDU */
+    gdouble arrived;
+    guint64 bytes;
+    gboolean rndv;
+} critpath_msg_t;
+
+typedef struct _critpath_rank_t {
+    guint64 name;
+    GArray *msgs;           /* critpath_msg_t by arrival */
+    gdouble local;          /* ms on the path */
+} critpath_rank_t;
+
+/* a started rendezvous transfer */
+typedef struct _critpath_rndv_t {
+    guint64 src;
+    guint64 dst;
+    gdouble sent;
+    guint64 bytes;
+} critpath_rndv_t;
+
+typedef struct _critpath_pair_t {
+    guint64 src;
+    guint64 dst;
+    guint msgs;
+    gdouble time;
+} critpath_pair_t;
+
+typedef struct _critpath_t {
+    char *filter;
+    gdouble start;          /* ms, window */
+    gdouble end;            /* negative: open */
+    nstime_t t0;
+    guint unknown;          /* messages of unknown channels */
+    GHashTable *ranks;      /* name -> critpath_rank_t */
+    GHashTable *rndvs;      /* RNDV frame -> critpath_rndv_t */
+} critpath_t;
+
+static void
+critpath_free_rank(gpointer data)
+{
+    critpath_rank_t *rank = (critpath_rank_t *)data;
+
+    g_array_free(rank->msgs, TRUE);
+    g_free(rank);
+}
+
+static void
+critpath_reset(void *tapdata)
+{
+    critpath_t *cs = (critpath_t *)tapdata;
+
+    g_hash_table_remove_all(cs->ranks);
+    g_hash_table_remove_all(cs->rndvs);
+    cs->unknown = 0;
+    nstime_set_unset(&cs->t0);
+}
+
+static critpath_rank_t *
+critpath_get_rank(critpath_t *cs, guint64 name)
+{
+    critpath_rank_t *rank;
+
+    rank = (critpath_rank_t *)g_hash_table_lookup(cs->ranks, &name);
+    if (!rank) {
+        rank = g_new0(critpath_rank_t, 1);
+        rank->name = name;
+        rank->msgs = g_array_new(FALSE, FALSE, sizeof(critpath_msg_t));
+        g_hash_table_insert(cs->ranks, &rank->name, rank);
+    }
+    return rank;
+}
+
+static int
+critpath_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt _U_, const void *data)
+{
+    critpath_t *cs = (critpath_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    critpath_rndv_t *rndv;
+    critpath_msg_t msg;
+    nstime_t delta;
+    gdouble now;
+
+    if (MPI_PDU_BTL != mpi_tap_info->kind) {
+        return 0;
+    }
+    if (nstime_is_unset(&cs->t0)) {
+        cs->t0 = pinfo->fd->abs_ts;
+    }
+    nstime_delta(&delta, &pinfo->fd->abs_ts, &cs->t0);
+    now = nstime_to_msec(&delta);
+
+    switch (mpi_tap_info->base) {
+        case MPI_PML_OB1_HDR_TYPE_MATCH:
+            if (0 == mpi_tap_info->channel) {
+                cs->unknown++;
+                break;
+            }
+            msg.src = CRITPATH_NAME(mpi_tap_info->jobid, mpi_tap_info->vpid);
+            msg.frame = pinfo->fd->num;
+            msg.sent = now;
+            msg.arrived = now;
+            msg.bytes = mpi_tap_info->payload;
+            msg.rndv = FALSE;
+            g_array_append_val(critpath_get_rank(cs, CRITPATH_NAME(
+                            mpi_tap_info->jobid_dst,
+                            mpi_tap_info->vpid_dst))->msgs, msg);
+            break;
+        case MPI_PML_BFO_HDR_TYPE_RNDV:
+        case MPI_PML_OB1_HDR_TYPE_RGET:
+            if (0 == mpi_tap_info->channel) {
+                cs->unknown++;
+                break;
+            }
+            rndv = g_new(critpath_rndv_t, 1);
+            rndv->src = CRITPATH_NAME(mpi_tap_info->jobid, mpi_tap_info->vpid);
+            rndv->dst = CRITPATH_NAME(mpi_tap_info->jobid_dst,
+                    mpi_tap_info->vpid_dst);
+            rndv->sent = now;
+            rndv->bytes = mpi_tap_info->msg_len;
+            g_hash_table_insert(cs->rndvs, GUINT_TO_POINTER(pinfo->fd->num),
+                    rndv);
+            break;
+        default:
+            break;
+    }
+
+    /* the end of a transfer may be sent either way (FIN) */
+    if (mpi_tap_info->xfer_done) {
+        rndv = (critpath_rndv_t *)g_hash_table_lookup(cs->rndvs,
+                GUINT_TO_POINTER(mpi_tap_info->xfer_rndv_in));
+        if (rndv) {
+            msg.src = rndv->src;
+            msg.frame = mpi_tap_info->xfer_rndv_in;
+            msg.sent = rndv->sent;
+            msg.arrived = now;
+            msg.bytes = rndv->bytes;
+            msg.rndv = TRUE;
+            g_array_append_val(critpath_get_rank(cs, rndv->dst)->msgs, msg);
+            g_hash_table_remove(cs->rndvs,
+                    GUINT_TO_POINTER(mpi_tap_info->xfer_rndv_in));
+        }
+    }
+    return 1;
+}
+
+/* the latest message arriving before "before", NULL if none */
+static critpath_msg_t *
+critpath_latest(critpath_rank_t *rank, gdouble before)
+{
+    critpath_msg_t *msg;
+    guint lo = 0;
+    guint hi = rank->msgs->len;
+    guint mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        msg = &g_array_index(rank->msgs, critpath_msg_t, mid);
+        if (msg->arrived < before) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo ? &g_array_index(rank->msgs, critpath_msg_t, lo - 1) : NULL;
+}
+
+static const gchar *
+critpath_name(gchar *buf, gulong len, guint64 name)
+{
+    g_snprintf(buf, len, "%u.%u", (guint32)(name >> 32), (guint32)name);
+    return buf;
+}
+
+static void
+critpath_draw(void *tapdata)
+{
+    critpath_t *cs = (critpath_t *)tapdata;
+    GHashTableIter iter;
+    gpointer value;
+    critpath_rank_t *rank;
+    critpath_rank_t *last_rank = NULL;
+    critpath_msg_t *msg;
+    critpath_msg_t *last = NULL;
+    critpath_pair_t *pair;
+    GPtrArray *path;
+    GArray *pairs;
+    gdouble t;
+    gdouble end;
+    gdouble total;
+    gchar src[24];
+    gchar dst[24];
+    guint i, j;
+
+    path = g_ptr_array_new();
+    pairs = g_array_new(FALSE, FALSE, sizeof(critpath_pair_t));
+
+    /* the path ends with the last arrival in the window */
+    g_hash_table_iter_init(&iter, cs->ranks);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        rank = (critpath_rank_t *)value;
+        rank->local = 0;
+        msg = critpath_latest(rank, 0 > cs->end ? G_MAXDOUBLE : cs->end);
+        if (msg && msg->arrived >= cs->start &&
+                (!last || msg->arrived > last->arrived)) {
+            last = msg;
+            last_rank = rank;
+        }
+    }
+
+    end = last ? last->arrived : cs->start;
+    total = end - cs->start;
+    t = end;
+    rank = last_rank;
+    msg = last;
+    while (msg && msg->arrived >= cs->start) {
+        rank->local += t - msg->arrived;
+        g_ptr_array_add(path, msg);
+
+        for (j = 0; j < pairs->len; j++) {
+            pair = &g_array_index(pairs, critpath_pair_t, j);
+            if (pair->src == msg->src && pair->dst == rank->name) {
+                break;
+            }
+        }
+        if (j == pairs->len) {
+            critpath_pair_t new_pair;
+
+            new_pair.src = msg->src;
+            new_pair.dst = rank->name;
+            new_pair.msgs = 0;
+            new_pair.time = 0;
+            g_array_append_val(pairs, new_pair);
+        }
+        pair = &g_array_index(pairs, critpath_pair_t, j);
+        pair->msgs++;
+        /* a message sent before the window counts from its beginning */
+        pair->time += msg->arrived - MAX(msg->sent, cs->start);
+
+        t = msg->sent;
+        rank = critpath_get_rank(cs, msg->src);
+        if (t <= cs->start) {
+            msg = NULL;
+            break;
+        }
+        msg = critpath_latest(rank, t);
+    }
+    if (rank && t > cs->start) {
+        rank->local += t - cs->start;
+    }
+
+    printf("\n");
+    printf("===================================================================================\n");
+    printf("MPI Critical Path:\n");
+    printf("Filter: %s\n", cs->filter ? cs->filter : "");
+    if (0 > cs->end) {
+        printf("Window: %.3f - end ms, ", cs->start);
+    } else {
+        printf("Window: %.3f - %.3f ms, ", cs->start, cs->end);
+    }
+    printf("path: %.3f - %.3f ms (%.3f ms), messages: %u, of unknown channels: %u\n",
+            cs->start, end, total, path->len, cs->unknown);
+    printf("Times in milliseconds since the first BTL PDU\n");
+    printf("-----------------------------------------------------------------------------------\n");
+    printf("Ranks: time on the path\n");
+    g_hash_table_iter_init(&iter, cs->ranks);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        rank = (critpath_rank_t *)value;
+        if (0 < rank->local) {
+            printf("  %-22s %12.3f %6.1f%%\n",
+                    critpath_name(src, sizeof(src), rank->name), rank->local,
+                    0 < total ? 100.0 * rank->local / total : 0);
+        }
+    }
+    printf("-----------------------------------------------------------------------------------\n");
+    printf("Rank pairs: messages and their time on the path\n");
+    for (j = 0; j < pairs->len; j++) {
+        pair = &g_array_index(pairs, critpath_pair_t, j);
+        printf("  %s -> %s: %u messages, %.3f ms, %.1f%%\n",
+                critpath_name(src, sizeof(src), pair->src),
+                critpath_name(dst, sizeof(dst), pair->dst), pair->msgs,
+                pair->time, 0 < total ? 100.0 * pair->time / total : 0);
+    }
+    printf("-----------------------------------------------------------------------------------\n");
+    printf("Messages on the path (the latest %u at most)\n", CRITPATH_MAX_LIST);
+    printf("%8s %-5s %12s %12s %12s  %s\n", "Frame", "Kind", "Bytes", "Sent",
+            "Arrived", "Sender");
+    i = MIN(path->len, CRITPATH_MAX_LIST);
+    while (i-- > 0) {
+        msg = (critpath_msg_t *)g_ptr_array_index(path, i);
+        printf("%8u %-5s %12" G_GINT64_MODIFIER "u %12.3f %12.3f  %s\n",
+                msg->frame, msg->rndv ? "RNDV" : "MATCH", msg->bytes,
+                msg->sent, msg->arrived,
+                critpath_name(src, sizeof(src), msg->src));
+    }
+    printf("===================================================================================\n");
+
+    g_array_free(pairs, TRUE);
+    g_ptr_array_free(path, TRUE);
+}
+
+static void
+critpath_init(const char *opt_arg, void *userdata _U_)
+{
+    critpath_t *cs;
+    const char *filter = NULL;
+    gdouble start = 0;
+    gdouble end = -1;
+    GString *error_string;
+    int pos = 0;
+
+    if (sscanf(opt_arg, "mpi,critpath,%lf,%lf%n", &start, &end, &pos) == 2) {
+        if (',' == opt_arg[pos]) {
+            filter = opt_arg + pos + 1;
+        }
+        if (0 > start || end < start) {
+            fprintf(stderr, "tshark: invalid \"-z mpi,critpath[,<start>,<end>[,<filter>]]\" window\n");
+            exit(1);
+        }
+    } else {
+        start = 0;
+        end = -1;
+    }
+
+    cs = g_new0(critpath_t, 1);
+    cs->filter = filter ? g_strdup(filter) : NULL;
+    cs->start = start * 1000.0;
+    cs->end = 0 > end ? -1 : end * 1000.0;
+    cs->ranks = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            NULL, critpath_free_rank);
+    cs->rndvs = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+            NULL, g_free);
+    nstime_set_unset(&cs->t0);
+
+    error_string = register_tap_listener("mpi", cs, cs->filter, 0,
+            critpath_reset, critpath_packet, critpath_draw);
+    if (error_string) {
+        g_hash_table_destroy(cs->rndvs);
+        g_hash_table_destroy(cs->ranks);
+        g_free(cs->filter);
+        g_free(cs);
+        fprintf(stderr, "tshark: Couldn't register mpi,critpath tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_critpath(void)
+{
+    register_stat_cmd_arg("mpi,critpath", critpath_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
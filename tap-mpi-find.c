@@ -0,0 +1,204 @@
+/* tap-mpi-find.c
+ * Frames of an MPI message by its key for tshark (-z mpi,find)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Looks the frames of a message up in the message key index built by the
+ * dissector in the first pass (mpi_find_msg(), mpi_find_req()):
+ *
+ *   ctx,src,tag[,seq[,jobid,dst]]
+ *                      MATCH, RNDV or RGET headers of the communicator
+ *                      (mpi.match.ctx), its rank src and the tag, all
+ *                      sequence numbers if seq is left out, sent to the
+ *                      process jobid.dst (vpid) only if given
+ *   req,<send request>[,jobid,vpid]
+ *                      RNDV, RGET, FRAG and ACK headers of the send
+ *                      request (hex with 0x) of the process jobid.vpid
+ *                      only if given
+ *
+ * Every frame is listed with the job of the sender and the receiver, or
+ * the owner of the send request: the same key or request address is used
+ * by many processes. They are known with the channel of the connection
+ * (mpi.channel), "-" otherwise. The sequence numbers are 16 bit: in a
+ * long capture a message can be found more than once.
+ *
+ * Usage: -z mpi,find,<ctx>,<src>,<tag>[,<seq>[,<jobid>,<dst>]]
+ *        -z mpi,find,req,<send request>[,<jobid>,<vpid>]
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+typedef struct _find_t {
+    gboolean by_req;
+    guint64 req;
+    guint ctx;
+    gint src;
+    gint tag;
+    gint seq;               /* < 0: any */
+    guint jobid;            /* 0: any */
+    gint vpid;              /* destination or owner, < 0: any */
+} find_t;
+
+static int
+find_packet(void *tapdata _U_, packet_info *pinfo _U_, epan_dissect_t *edt _U_, const void *data _U_)
+{
+    /* the dissector builds the index */
+    return 0;
+}
+
+static void
+find_draw(void *tapdata)
+{
+    find_t *fs = (find_t *)tapdata;
+    GArray *hits;
+    const mpi_find_hit_t *hit;
+    gchar jobid[12];
+    gchar vpid[12];
+    guint i;
+
+    hits = g_array_new(FALSE, FALSE, sizeof(mpi_find_hit_t));
+    if (fs->by_req) {
+        mpi_find_req(fs->jobid, fs->vpid, fs->req, hits);
+    } else {
+        mpi_find_msg(fs->jobid, (guint16)fs->ctx, fs->src, fs->vpid, fs->tag,
+                fs->seq, hits);
+    }
+
+    printf("\n");
+    printf("=============================================================================================================\n");
+    printf("MPI Message Frames:\n");
+    if (fs->by_req) {
+        printf("Send request: 0x%016" G_GINT64_MODIFIER "x\n", fs->req);
+    } else if (0 > fs->seq) {
+        printf("Ctx: %u, src: %d, tag: %d, any seq\n", fs->ctx, fs->src,
+                fs->tag);
+    } else {
+        printf("Ctx: %u, src: %d, tag: %d, seq: %d\n", fs->ctx, fs->src,
+                fs->tag, fs->seq);
+    }
+    if (fs->jobid) {
+        printf("Process: %u.%d\n", fs->jobid, fs->vpid);
+    }
+    printf("Frames: %u\n", hits->len);
+    printf("-------------------------------------------------------------------------------------------------------------\n");
+    printf("%12s %10s %10s\n", "Frame", "Jobid", fs->by_req ? "Owner" : "Dst");
+    for (i = 0; i < hits->len; i++) {
+        hit = &g_array_index(hits, mpi_find_hit_t, i);
+        if (hit->jobid) {
+            g_snprintf(jobid, sizeof(jobid), "%u", hit->jobid);
+            g_snprintf(vpid, sizeof(vpid), "%d", hit->vpid);
+        } else {
+            g_strlcpy(jobid, "-", sizeof(jobid));
+            g_strlcpy(vpid, "-", sizeof(vpid));
+        }
+        printf("%12u %10s %10s\n", hit->frame, jobid, vpid);
+    }
+    printf("=============================================================================================================\n");
+
+    g_array_free(hits, TRUE);
+}
+
+/* the whole argument, nothing may follow the last number */
+static gboolean
+find_parse(const char *opt_arg, find_t *fs)
+{
+    int pos = 0;
+    int len = 0;
+
+    if (sscanf(opt_arg, "mpi,find,req,%" G_GINT64_MODIFIER "x%n",
+                &fs->req, &pos) == 1) {
+        fs->by_req = TRUE;
+    } else if (sscanf(opt_arg, "mpi,find,%u,%d,%d%n", &fs->ctx, &fs->src,
+                &fs->tag, &pos) != 3 || 0xffff < fs->ctx) {
+        return FALSE;
+    } else if (',' == opt_arg[pos]) {
+        if (sscanf(opt_arg + pos, ",%d%n", &fs->seq, &len) != 1 ||
+                0 > fs->seq || 0xffff < fs->seq) {
+            return FALSE;
+        }
+        pos += len;
+    }
+    if (',' == opt_arg[pos]) {
+        if (sscanf(opt_arg + pos, ",%u,%d%n", &fs->jobid, &fs->vpid,
+                    &len) != 2 || 0 == fs->jobid || 0 > fs->vpid) {
+            return FALSE;
+        }
+        pos += len;
+    }
+    return '\0' == opt_arg[pos];
+}
+
+static void
+find_init(const char *opt_arg, void *userdata _U_)
+{
+    find_t *fs;
+    GString *error_string;
+
+    fs = g_new0(find_t, 1);
+    fs->seq = -1;
+    fs->vpid = -1;
+    if (!find_parse(opt_arg, fs)) {
+        g_free(fs);
+        fprintf(stderr, "tshark: invalid \"-z mpi,find,<ctx>,<src>,<tag>[,<seq>[,<jobid>,<dst>]]\" "
+                "or \"-z mpi,find,req,<send request>[,<jobid>,<vpid>]\" argument\n");
+        exit(1);
+    }
+
+    error_string = register_tap_listener("mpi", fs, NULL, TL_REQUIRES_NOTHING,
+            NULL, find_packet, find_draw);
+    if (error_string) {
+        g_free(fs);
+        fprintf(stderr, "tshark: Couldn't register mpi,find tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_find(void)
+{
+    register_stat_cmd_arg("mpi,find", find_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
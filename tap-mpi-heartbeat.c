@@ -0,0 +1,379 @@
+/* tap-mpi-heartbeat.c
+ * ORTE daemon heartbeat intervals for tshark (-z mpi,heartbeat)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Uses the heartbeat analysis of the dissector (mpi.heartbeat.*) to show
+ *
+ *   the heartbeat intervals per daemon with their jitter (standard
+ *   deviation), late and missing beats and the longest gap
+ *   whether a late beat came alone or together with late beats of other
+ *   daemons within one interval: late together points to the network or
+ *   the receiving HNP, late alone to the sending daemon
+ *   every failure notice and abort with the daemon silent for the longest
+ *   time then
+ *
+ * Usage: -z mpi,heartbeat[,filter]
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+/* window to group late beats if the rate is unknown (ms) */
+#define HEARTBEAT_DEFAULT_WINDOW 1000.0
+
+typedef struct _heartbeat_daemon_t {
+    guint64 name;           /* jobid << 32 | vpid, hash key */
+    guint32 jobid;
+    guint32 vpid;
+    guint beats;
+    guint intervals;
+    gdouble min;
+    gdouble max;
+    gdouble sum;
+    gdouble sum2;
+    guint late;
+    guint missed;
+    guint late_alone;
+} heartbeat_daemon_t;
+
+/* a late or missing beat */
+typedef struct _heartbeat_late_t {
+    gdouble time;           /* ms since the first OOB message */
+    gdouble window;
+    heartbeat_daemon_t *daemon;
+} heartbeat_late_t;
+
+typedef struct _heartbeat_failure_t {
+    guint32 frame;
+    gdouble time;
+    guint32 rml_tag;
+    guint32 jobid_origin;
+    guint32 vpid_origin;
+    guint32 silent_jobid;
+    guint32 silent_vpid;
+    gdouble silence;        /* ms, negative without any heartbeat */
+    gdouble expected;
+} heartbeat_failure_t;
+
+typedef struct _heartbeat_t {
+    char *filter;
+    nstime_t t0;
+    GHashTable *daemons;    /* name -> heartbeat_daemon_t */
+    GArray *lates;          /* heartbeat_late_t in capture order */
+    GArray *failures;       /* heartbeat_failure_t */
+} heartbeat_t;
+
+static void
+heartbeat_reset(void *tapdata)
+{
+    heartbeat_t *hs = (heartbeat_t *)tapdata;
+
+    g_hash_table_remove_all(hs->daemons);
+    g_array_set_size(hs->lates, 0);
+    g_array_set_size(hs->failures, 0);
+    nstime_set_unset(&hs->t0);
+}
+
+static gdouble
+heartbeat_rel(const heartbeat_t *hs, const nstime_t *ts)
+{
+    nstime_t delta;
+
+    nstime_delta(&delta, ts, &hs->t0);
+    return nstime_to_msec(&delta);
+}
+
+static heartbeat_daemon_t *
+heartbeat_get_daemon(heartbeat_t *hs, guint32 jobid, guint32 vpid)
+{
+    heartbeat_daemon_t *daemon;
+    guint64 name;
+
+    name = ((guint64)jobid << 32) | vpid;
+    daemon = (heartbeat_daemon_t *)g_hash_table_lookup(hs->daemons, &name);
+    if (!daemon) {
+        daemon = g_new0(heartbeat_daemon_t, 1);
+        daemon->name = name;
+        daemon->jobid = jobid;
+        daemon->vpid = vpid;
+        g_hash_table_insert(hs->daemons, &daemon->name, daemon);
+    }
+    return daemon;
+}
+
+static int
+heartbeat_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt _U_, const void *data)
+{
+    heartbeat_t *hs = (heartbeat_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    heartbeat_daemon_t *daemon;
+    heartbeat_late_t late;
+    heartbeat_failure_t failure;
+    gdouble interval;
+
+    /* the analysis is done once at the beginning of a message */
+    if (MPI_PDU_OOB != mpi_tap_info->kind || !mpi_tap_info->msg_start) {
+        return 0;
+    }
+    if (nstime_is_unset(&hs->t0)) {
+        hs->t0 = pinfo->fd->abs_ts;
+    }
+
+    switch (mpi_tap_info->rml_tag) {
+        case ORTE_RML_TAG_HEARTBEAT:
+            daemon = heartbeat_get_daemon(hs, mpi_tap_info->jobid_origin,
+                    mpi_tap_info->vpid_origin);
+            daemon->beats++;
+            if (0 == mpi_tap_info->hb_prev_in) {
+                break;
+            }
+            interval = nstime_to_msec(&mpi_tap_info->hb_interval);
+            if (0 == daemon->intervals || interval < daemon->min) {
+                daemon->min = interval;
+            }
+            if (0 == daemon->intervals || interval > daemon->max) {
+                daemon->max = interval;
+            }
+            daemon->sum += interval;
+            daemon->sum2 += interval * interval;
+            daemon->intervals++;
+
+            if (mpi_tap_info->hb_late || mpi_tap_info->hb_missed) {
+                daemon->late += mpi_tap_info->hb_late ? 1 : 0;
+                daemon->missed += mpi_tap_info->hb_missed;
+                late.time = heartbeat_rel(hs, &pinfo->fd->abs_ts);
+                late.window = 0 < mpi_tap_info->hb_expected ?
+                    mpi_tap_info->hb_expected : HEARTBEAT_DEFAULT_WINDOW;
+                late.daemon = daemon;
+                g_array_append_val(hs->lates, late);
+            }
+            break;
+        case ORTE_RML_TAG_FAILURE_NOTICE:
+        case ORTE_RML_TAG_ABORT:
+            failure.frame = pinfo->fd->num;
+            failure.time = heartbeat_rel(hs, &pinfo->fd->abs_ts);
+            failure.rml_tag = mpi_tap_info->rml_tag;
+            failure.jobid_origin = mpi_tap_info->jobid_origin;
+            failure.vpid_origin = mpi_tap_info->vpid_origin;
+            failure.silent_jobid = mpi_tap_info->hb_silent_jobid;
+            failure.silent_vpid = mpi_tap_info->hb_silent_vpid;
+            failure.silence = nstime_is_zero(&mpi_tap_info->hb_silence) ?
+                -1 : nstime_to_msec(&mpi_tap_info->hb_silence);
+            failure.expected = mpi_tap_info->hb_expected;
+            g_array_append_val(hs->failures, failure);
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+static gint
+heartbeat_daemon_cmp(gconstpointer a, gconstpointer b)
+{
+    const heartbeat_daemon_t *da = *(const heartbeat_daemon_t * const *)a;
+    const heartbeat_daemon_t *db = *(const heartbeat_daemon_t * const *)b;
+
+    if (da->jobid != db->jobid) {
+        return da->jobid < db->jobid ? -1 : 1;
+    }
+    return da->vpid < db->vpid ? -1 : (da->vpid > db->vpid);
+}
+
+/* a late beat is alone if no other daemon was late within its window,
+ * counted from scratch since draw may run more than once */
+static guint
+heartbeat_count_alone(heartbeat_t *hs)
+{
+    heartbeat_late_t *late, *other;
+    GHashTableIter iter;
+    gpointer value;
+    guint alone = 0;
+    guint i, j;
+    gboolean together;
+
+    g_hash_table_iter_init(&iter, hs->daemons);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        ((heartbeat_daemon_t *)value)->late_alone = 0;
+    }
+
+    for (i = 0; i < hs->lates->len; i++) {
+        late = &g_array_index(hs->lates, heartbeat_late_t, i);
+        together = FALSE;
+        for (j = i; j > 0 && !together; j--) {
+            other = &g_array_index(hs->lates, heartbeat_late_t, j - 1);
+            if (late->time - other->time > late->window) {
+                break;
+            }
+            together = other->daemon != late->daemon;
+        }
+        for (j = i + 1; j < hs->lates->len && !together; j++) {
+            other = &g_array_index(hs->lates, heartbeat_late_t, j);
+            if (other->time - late->time > late->window) {
+                break;
+            }
+            together = other->daemon != late->daemon;
+        }
+        if (!together) {
+            late->daemon->late_alone++;
+            alone++;
+        }
+    }
+    return alone;
+}
+
+static void
+heartbeat_draw(void *tapdata)
+{
+    heartbeat_t *hs = (heartbeat_t *)tapdata;
+    GPtrArray *daemons;
+    GHashTableIter iter;
+    gpointer value;
+    heartbeat_daemon_t *daemon;
+    heartbeat_failure_t *failure;
+    guint alone;
+    guint i;
+    gdouble avg;
+
+    alone = heartbeat_count_alone(hs);
+
+    daemons = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, hs->daemons);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(daemons, value);
+    }
+    g_ptr_array_sort(daemons, heartbeat_daemon_cmp);
+
+    printf("\n");
+    printf("===================================================================================================\n");
+    printf("MPI Daemon Heartbeats:\n");
+    printf("Filter: %s\n", hs->filter ? hs->filter : "");
+    printf("Daemons: %u, late or missing beats: %u (alone: %u, with other daemons: %u)\n",
+            daemons->len, hs->lates->len, alone, hs->lates->len - alone);
+    printf("Times in milliseconds\n");
+    printf("---------------------------------------------------------------------------------------------------\n");
+    printf("%-14s %7s %10s %10s %10s %10s %6s %7s %6s\n", "Daemon", "Beats",
+            "Min", "Avg", "Max", "Jitter", "Late", "Missed", "Alone");
+    for (i = 0; i < daemons->len; i++) {
+        daemon = (heartbeat_daemon_t *)g_ptr_array_index(daemons, i);
+        printf("%8u.%-5u %7u", daemon->jobid, daemon->vpid, daemon->beats);
+        if (0 == daemon->intervals) {
+            printf(" %10s %10s %10s %10s", "-", "-", "-", "-");
+        } else {
+            avg = daemon->sum / daemon->intervals;
+            printf(" %10.3f %10.3f %10.3f %10.3f", daemon->min, avg,
+                    daemon->max,
+                    sqrt(MAX(0, daemon->sum2 / daemon->intervals - avg * avg)));
+        }
+        printf(" %6u %7u %6u\n", daemon->late, daemon->missed,
+                daemon->late_alone);
+    }
+    g_ptr_array_free(daemons, TRUE);
+
+    printf("---------------------------------------------------------------------------------------------------\n");
+    printf("Failure notices and aborts (time since the first OOB message)\n");
+    printf("%8s %12s %-16s %-14s %-14s %12s %10s\n", "Frame", "Time", "Tag",
+            "From", "Silent", "Silence", "Intervals");
+    for (i = 0; i < hs->failures->len; i++) {
+        failure = &g_array_index(hs->failures, heartbeat_failure_t, i);
+        printf("%8u %12.3f %-16s %8u.%-5u", failure->frame, failure->time,
+                ORTE_RML_TAG_ABORT == failure->rml_tag ?
+                "Abort" : "Failure notice",
+                failure->jobid_origin, failure->vpid_origin);
+        if (0 > failure->silence) {
+            printf(" %-14s %12s %10s\n", "-", "-", "-");
+        } else {
+            printf(" %8u.%-5u %12.3f", failure->silent_jobid,
+                    failure->silent_vpid, failure->silence);
+            if (0 < failure->expected) {
+                printf(" %10.1f\n", failure->silence / failure->expected);
+            } else {
+                printf(" %10s\n", "-");
+            }
+        }
+    }
+    printf("===================================================================================================\n");
+}
+
+static void
+heartbeat_init(const char *opt_arg, void *userdata _U_)
+{
+    heartbeat_t *hs;
+    const char *filter = NULL;
+    GString *error_string;
+
+    if (!strncmp(opt_arg, "mpi,heartbeat,", 14)) {
+        filter = opt_arg + 14;
+    }
+
+    hs = g_new0(heartbeat_t, 1);
+    hs->filter = filter ? g_strdup(filter) : NULL;
+    hs->daemons = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            NULL, g_free);
+    hs->lates = g_array_new(FALSE, FALSE, sizeof(heartbeat_late_t));
+    hs->failures = g_array_new(FALSE, FALSE, sizeof(heartbeat_failure_t));
+    nstime_set_unset(&hs->t0);
+
+    error_string = register_tap_listener("mpi", hs, hs->filter, 0,
+            heartbeat_reset, heartbeat_packet, heartbeat_draw);
+    if (error_string) {
+        g_array_free(hs->failures, TRUE);
+        g_array_free(hs->lates, TRUE);
+        g_hash_table_destroy(hs->daemons);
+        g_free(hs->filter);
+        g_free(hs);
+        fprintf(stderr, "tshark: Couldn't register mpi,heartbeat tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_heartbeat(void)
+{
+    register_stat_cmd_arg("mpi,heartbeat", heartbeat_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,423 @@
+/* tap-mpi-iof.c
+ * ORTE IOF (stdin/stdout/stderr forwarding) accounting for tshark (-z mpi,iof)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Accounts the ORTE_RML_TAG_IOF_HNP/IOF_PROXY messages per rank and stream
+ * (stdin, stdout, ...): messages, forwarded bytes, OOB bytes including the
+ * headers, their share of the OOB connection and the rates while the rank
+ * was forwarding. The busiest streams are listed first.
+ *
+ * With a directory the forwarded bytes of every stream are appended to
+ * <directory>/<jobid>.<vpid>.<stream> while reading the capture, existing
+ * files are overwritten.
+ *
+ * Usage: -z mpi,iof[,directory[,filter]]
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <glib/gstdio.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+/* OOB header length */
+#define IOF_OOB_HDR_LEN 28
+
+/* export files kept open at the same time */
+#define IOF_MAX_OPEN 64
+
+typedef struct _iof_stream_t {
+    guint32 jobid;
+    guint32 vpid;
+    guint8 type;            /* ORTE_IOF_* */
+    guint32 conn;           /* tcp.stream of the latest message */
+    guint messages;
+    guint64 bytes;          /* forwarded bytes */
+    guint64 oob_bytes;      /* message bytes plus OOB headers */
+    nstime_t first;
+    nstime_t last;
+    gchar *path;            /* export file, NULL without export */
+    FILE *fp;
+} iof_stream_t;
+
+typedef struct _iof_t {
+    char *filter;
+    char *dir;
+    GHashTable *streams;    /* iof_stream_t -> iof_stream_t */
+    GHashTable *current;    /* tcp.stream << 32 | srcport -> iof_stream_t */
+    GHashTable *conns;      /* tcp.stream -> OOB bytes (guint64) */
+    guint open;             /* open export files */
+    guint write_errors;
+} iof_t;
+
+static guint
+iof_stream_hash(gconstpointer v)
+{
+    const iof_stream_t *stream = (const iof_stream_t *)v;
+
+    return (stream->jobid * 31 + stream->vpid) * 31 + stream->type;
+}
+
+static gboolean
+iof_stream_equal(gconstpointer v, gconstpointer v2)
+{
+    const iof_stream_t *a = (const iof_stream_t *)v;
+    const iof_stream_t *b = (const iof_stream_t *)v2;
+
+    return a->jobid == b->jobid && a->vpid == b->vpid && a->type == b->type;
+}
+
+static const char *
+iof_type_name(guint8 type)
+{
+    switch (type) {
+        case ORTE_IOF_STDIN:
+            return "stdin";
+        case ORTE_IOF_STDOUT:
+            return "stdout";
+        case ORTE_IOF_STDERR:
+            return "stderr";
+        case ORTE_IOF_STDDIAG:
+            return "stddiag";
+        case ORTE_IOF_STDOUTALL:
+            return "stdoutall";
+        default:
+            return "unknown";
+    }
+}
+
+static void
+iof_stream_free(gpointer data)
+{
+    iof_stream_t *stream = (iof_stream_t *)data;
+
+    if (stream->fp) {
+        fclose(stream->fp);
+    }
+    g_free(stream->path);
+    g_free(stream);
+}
+
+static void
+iof_close_all(iof_t *is)
+{
+    GHashTableIter iter;
+    gpointer value;
+    iof_stream_t *stream;
+
+    g_hash_table_iter_init(&iter, is->streams);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        stream = (iof_stream_t *)value;
+        if (stream->fp) {
+            fclose(stream->fp);
+            stream->fp = NULL;
+        }
+    }
+    is->open = 0;
+}
+
+static void
+iof_reset(void *tapdata)
+{
+    iof_t *is = (iof_t *)tapdata;
+
+    g_hash_table_remove_all(is->current);
+    g_hash_table_remove_all(is->conns);
+    g_hash_table_remove_all(is->streams);
+    is->open = 0;
+    is->write_errors = 0;
+}
+
+/* append the forwarded bytes to the export file of the stream */
+static void
+iof_export(iof_t *is, iof_stream_t *stream, const guint8 *data, guint32 len)
+{
+    if (!is->dir || !data || 0 == len) {
+        return;
+    }
+    if (!stream->fp) {
+        if (IOF_MAX_OPEN <= is->open) {
+            iof_close_all(is);
+        }
+        if (!stream->path) {
+            /* first data of the stream, start a new file */
+            stream->path = g_strdup_printf("%s%c%u.%u.%s", is->dir,
+                    G_DIR_SEPARATOR, stream->jobid, stream->vpid,
+                    iof_type_name(stream->type));
+            stream->fp = g_fopen(stream->path, "wb");
+        } else {
+            stream->fp = g_fopen(stream->path, "ab");
+        }
+        if (!stream->fp) {
+            if (0 == is->write_errors++) {
+                fprintf(stderr, "tshark: mpi,iof: can't open %s: %s\n",
+                        stream->path, g_strerror(errno));
+            }
+            return;
+        }
+        is->open++;
+    }
+    if (fwrite(data, 1, len, stream->fp) != len) {
+        is->write_errors++;
+    }
+}
+
+static void
+iof_add(iof_t *is, iof_stream_t *stream, packet_info *pinfo, const mpi_tap_info_t *mpi_tap_info)
+{
+    stream->conn = mpi_tap_info->stream;
+    stream->oob_bytes += mpi_tap_info->nbytes;
+    stream->bytes += mpi_tap_info->data_len;
+    stream->last = pinfo->fd->abs_ts;
+    iof_export(is, stream, mpi_tap_info->data, mpi_tap_info->data_len);
+}
+
+static int
+iof_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt _U_, const void *data)
+{
+    iof_t *is = (iof_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    iof_stream_t key;
+    iof_stream_t *stream;
+    guint64 dir;
+    guint64 *conn_bytes;
+
+    if (MPI_PDU_OOB != mpi_tap_info->kind) {
+        return 0;
+    }
+
+    conn_bytes = (guint64 *)g_hash_table_lookup(is->conns,
+            GUINT_TO_POINTER(mpi_tap_info->stream));
+    if (!conn_bytes) {
+        conn_bytes = g_new0(guint64, 1);
+        g_hash_table_insert(is->conns, GUINT_TO_POINTER(mpi_tap_info->stream),
+                conn_bytes);
+    }
+    *conn_bytes += mpi_tap_info->oob_header ?
+        IOF_OOB_HDR_LEN : mpi_tap_info->nbytes;
+
+    if (mpi_tap_info->oob_header ||
+            (ORTE_RML_TAG_IOF_HNP != mpi_tap_info->rml_tag &&
+             ORTE_RML_TAG_IOF_PROXY != mpi_tap_info->rml_tag)) {
+        return 0;
+    }
+
+    /* the rank is only known at the beginning of a message */
+    dir = ((guint64)mpi_tap_info->stream << 32) | pinfo->srcport;
+    if (!mpi_tap_info->msg_start) {
+        stream = (iof_stream_t *)g_hash_table_lookup(is->current, &dir);
+        if (stream) {
+            iof_add(is, stream, pinfo, mpi_tap_info);
+        }
+        return 0;
+    }
+    if (0 == mpi_tap_info->iof_type) {
+        g_hash_table_remove(is->current, &dir);
+        return 0;
+    }
+
+    key.jobid = mpi_tap_info->iof_jobid;
+    key.vpid = mpi_tap_info->iof_vpid;
+    key.type = mpi_tap_info->iof_type;
+    stream = (iof_stream_t *)g_hash_table_lookup(is->streams, &key);
+    if (!stream) {
+        stream = g_new0(iof_stream_t, 1);
+        stream->jobid = key.jobid;
+        stream->vpid = key.vpid;
+        stream->type = key.type;
+        stream->first = pinfo->fd->abs_ts;
+        g_hash_table_insert(is->streams, stream, stream);
+    }
+    stream->messages++;
+    stream->oob_bytes += IOF_OOB_HDR_LEN;
+    iof_add(is, stream, pinfo, mpi_tap_info);
+    g_hash_table_insert(is->current, g_memdup(&dir, sizeof(dir)), stream);
+
+    return 0;
+}
+
+/* busiest stream first */
+static gint
+iof_stream_cmp(gconstpointer a, gconstpointer b)
+{
+    const iof_stream_t *sa = *(const iof_stream_t * const *)a;
+    const iof_stream_t *sb = *(const iof_stream_t * const *)b;
+
+    if (sa->oob_bytes != sb->oob_bytes) {
+        return sa->oob_bytes > sb->oob_bytes ? -1 : 1;
+    }
+    if (sa->jobid != sb->jobid) {
+        return sa->jobid < sb->jobid ? -1 : 1;
+    }
+    if (sa->vpid != sb->vpid) {
+        return sa->vpid < sb->vpid ? -1 : 1;
+    }
+    return sa->type < sb->type ? -1 : (sa->type > sb->type);
+}
+
+static void
+iof_draw(void *tapdata)
+{
+    iof_t *is = (iof_t *)tapdata;
+    GPtrArray *streams;
+    GHashTableIter iter;
+    gpointer value;
+    iof_stream_t *stream;
+    guint64 *conn_bytes;
+    guint64 bytes = 0;
+    guint messages = 0;
+    nstime_t delta;
+    gdouble span;
+    guint i;
+
+    iof_close_all(is);
+
+    streams = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, is->streams);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        stream = (iof_stream_t *)value;
+        bytes += stream->bytes;
+        messages += stream->messages;
+        g_ptr_array_add(streams, stream);
+    }
+    g_ptr_array_sort(streams, iof_stream_cmp);
+
+    printf("\n");
+    printf("=============================================================================================================\n");
+    printf("MPI IOF Forwarding:\n");
+    printf("Filter: %s\n", is->filter ? is->filter : "");
+    printf("Streams: %u, messages: %u, forwarded bytes: %" G_GINT64_MODIFIER "u\n",
+            streams->len, messages, bytes);
+    if (is->dir) {
+        printf("Exported to: %s%s\n", is->dir,
+                is->write_errors ? " (with write errors)" : "");
+    }
+    printf("Share: OOB bytes of the stream / all OOB bytes of its (latest) connection\n");
+    printf("Rates while forwarding, from the first to the last message of the stream\n");
+    printf("-------------------------------------------------------------------------------------------------------------\n");
+    printf("%-14s %-9s %9s %14s %14s %7s %8s %10s %12s\n", "Rank", "Stream",
+            "Messages", "Bytes", "OOB bytes", "Share", "Conn", "Msg/s",
+            "Bytes/s");
+    for (i = 0; i < streams->len; i++) {
+        stream = (iof_stream_t *)g_ptr_array_index(streams, i);
+        conn_bytes = (guint64 *)g_hash_table_lookup(is->conns,
+                GUINT_TO_POINTER(stream->conn));
+        nstime_delta(&delta, &stream->last, &stream->first);
+        span = nstime_to_sec(&delta);
+
+        printf("%8u.%-5u %-9s %9u %14" G_GINT64_MODIFIER "u %14"
+                G_GINT64_MODIFIER "u %6.1f%% %8u",
+                stream->jobid, stream->vpid, iof_type_name(stream->type),
+                stream->messages, stream->bytes, stream->oob_bytes,
+                conn_bytes && *conn_bytes ?
+                100.0 * stream->oob_bytes / *conn_bytes : 0.0,
+                stream->conn);
+        if (0 < span) {
+            printf(" %10.1f %12.1f\n", stream->messages / span,
+                    stream->bytes / span);
+        } else {
+            printf(" %10s %12s\n", "-", "-");
+        }
+    }
+    printf("=============================================================================================================\n");
+
+    g_ptr_array_free(streams, TRUE);
+}
+
+static void
+iof_init(const char *opt_arg, void *userdata _U_)
+{
+    iof_t *is;
+    const char *filter = NULL;
+    const char *dir = NULL;
+    const char *end = NULL;
+    GString *error_string;
+
+    if (!strncmp(opt_arg, "mpi,iof,", 8)) {
+        dir = opt_arg + 8;
+        end = strchr(dir, ',');
+        if (end) {
+            filter = end + 1;
+        }
+    }
+
+    is = g_new0(iof_t, 1);
+    if (dir && dir != end) {
+        is->dir = end ? g_strndup(dir, end - dir) : g_strdup(dir);
+        if (!g_file_test(is->dir, G_FILE_TEST_IS_DIR)) {
+            fprintf(stderr, "tshark: invalid \"-z mpi,iof,<directory>[,<filter>]\" "
+                    "directory %s\n", is->dir);
+            exit(1);
+        }
+    }
+    is->filter = filter ? g_strdup(filter) : NULL;
+    is->streams = g_hash_table_new_full(iof_stream_hash, iof_stream_equal,
+            NULL, iof_stream_free);
+    is->current = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            g_free, NULL);
+    is->conns = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+            NULL, g_free);
+
+    error_string = register_tap_listener("mpi", is, is->filter, 0,
+            iof_reset, iof_packet, iof_draw);
+    if (error_string) {
+        g_hash_table_destroy(is->conns);
+        g_hash_table_destroy(is->current);
+        g_hash_table_destroy(is->streams);
+        g_free(is->filter);
+        g_free(is->dir);
+        g_free(is);
+        fprintf(stderr, "tshark: Couldn't register mpi,iof tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_iof(void)
+{
+    register_stat_cmd_arg("mpi,iof", iof_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
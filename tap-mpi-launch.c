@@ -0,0 +1,588 @@
+/* tap-mpi-launch.c
+ * ORTE job launch timeline for tshark (-z mpi,launch)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Orders the OOB daemon traffic of a job start into a timeline per daemon:
+ *
+ *   callback  the daemon reports back with ORTE_RML_TAG_ORTED_CALLBACK
+ *   spawn     the XCAST with ORTE_DAEMON_ADD_LOCAL_PROCS reaches the daemon
+ *   modex     first grpcomm collective (or direct modex) of the daemon
+ *             until the XCAST releasing it
+ *   barrier   second grpcomm collective (the MPI_Init barrier) until the
+ *             XCAST releasing it
+ *   first MPI first BTL traffic from or to a host of the daemon
+ *
+ * The hosts of a daemon are the address literals of the contact URI in its
+ * callback, else the source of its IDENT, the header a daemon sends first on
+ * a connection it opened itself. Other OOB headers may have been relayed by
+ * another daemon and do not tell the host. Several daemons may share a host,
+ * its first MPI traffic ends the last phase of all of them.
+ *
+ * All times are relative to the first OOB message of the capture.
+ *
+ * Usage: -z mpi,launch[,filter]
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifdef HAVE_ARPA_INET_H
+#include <arpa/inet.h>
+#endif
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+#include <wsutil/inet_v6defs.h>
+
+#include "packet-mpi.h"
+
+typedef enum {
+    LAUNCH_PHASE_CALLBACK,
+    LAUNCH_PHASE_SPAWN,
+    LAUNCH_PHASE_MODEX,
+    LAUNCH_PHASE_BARRIER,
+    LAUNCH_PHASE_FIRST_MPI,
+    LAUNCH_PHASE_NUM
+} launch_phase_t;
+
+static const char *launch_phase_names[LAUNCH_PHASE_NUM] = {
+    "Callback",
+    "Spawn XCAST",
+    "Modex",
+    "Init barrier",
+    "First MPI"
+};
+
+typedef struct _launch_daemon_t {
+    guint64 name;           /* jobid << 32 | vpid, hash key */
+    guint32 jobid;
+    guint32 vpid;
+    gchar *addr;            /* first host, NULL if none is known */
+    guint coll_round;       /* grpcomm collectives started */
+    gboolean coll_open;     /* waiting for the releasing XCAST */
+    nstime_t modex_start;
+    nstime_t barrier_start;
+    /* end of every phase, unset if not seen */
+    nstime_t done[LAUNCH_PHASE_NUM];
+} launch_daemon_t;
+
+typedef struct _launch_t {
+    char *filter;
+    nstime_t t0;            /* first OOB message */
+    GHashTable *daemons;    /* name -> launch_daemon_t */
+    GHashTable *hosts;      /* address string -> GPtrArray of launch_daemon_t */
+    guint pending_mpi;      /* daemons with a host but without MPI traffic */
+} launch_t;
+
+static void
+launch_daemon_free(gpointer data)
+{
+    launch_daemon_t *daemon = (launch_daemon_t *)data;
+
+    g_free(daemon->addr);
+    g_free(daemon);
+}
+
+static void
+launch_reset(void *tapdata)
+{
+    launch_t *ls = (launch_t *)tapdata;
+
+    g_hash_table_remove_all(ls->hosts);
+    g_hash_table_remove_all(ls->daemons);
+    nstime_set_unset(&ls->t0);
+    ls->pending_mpi = 0;
+}
+
+static launch_daemon_t *
+launch_get_daemon(launch_t *ls, guint32 jobid, guint32 vpid)
+{
+    launch_daemon_t *daemon;
+    guint64 name;
+    int i;
+
+    name = ((guint64)jobid << 32) | vpid;
+    daemon = (launch_daemon_t *)g_hash_table_lookup(ls->daemons, &name);
+    if (!daemon) {
+        daemon = g_new0(launch_daemon_t, 1);
+        daemon->name = name;
+        daemon->jobid = jobid;
+        daemon->vpid = vpid;
+        nstime_set_unset(&daemon->modex_start);
+        nstime_set_unset(&daemon->barrier_start);
+        for (i = 0; i < LAUNCH_PHASE_NUM; i++) {
+            nstime_set_unset(&daemon->done[i]);
+        }
+        g_hash_table_insert(ls->daemons, &daemon->name, daemon);
+    }
+    return daemon;
+}
+
+static void
+launch_set_done(launch_daemon_t *daemon, launch_phase_t phase, const nstime_t *ts)
+{
+    if (nstime_is_unset(&daemon->done[phase])) {
+        daemon->done[phase] = *ts;
+    }
+}
+
+static void
+launch_host_free(gpointer data)
+{
+    g_ptr_array_free((GPtrArray *)data, TRUE);
+}
+
+static void
+launch_add_host(launch_t *ls, launch_daemon_t *daemon, const address *addr)
+{
+    GPtrArray *daemons;
+    gchar *host;
+    guint i;
+
+    host = address_to_str(NULL, addr);
+    daemons = (GPtrArray *)g_hash_table_lookup(ls->hosts, host);
+    if (!daemons) {
+        daemons = g_ptr_array_new();
+        g_hash_table_insert(ls->hosts, g_strdup(host), daemons);
+    }
+    for (i = 0; i < daemons->len; i++) {
+        if (g_ptr_array_index(daemons, i) == daemon) {
+            g_free(host);
+            return;
+        }
+    }
+    g_ptr_array_add(daemons, daemon);
+    if (!daemon->addr) {
+        daemon->addr = host;
+        ls->pending_mpi++;
+    } else {
+        g_free(host);
+    }
+}
+
+/* the address literals of "jobid.vpid;tcp://a,b:port;tcp6://[a]:port",
+ * written the same way as the addresses of the packets */
+static void
+launch_add_uri(launch_t *ls, launch_daemon_t *daemon, const gchar *uri)
+{
+    address addr;
+    guint8 buf[16];
+    gchar **parts;
+    gchar **hosts;
+    gchar *contact;
+    gchar *colon;
+    gchar *host;
+    guint i;
+    guint j;
+
+    parts = g_strsplit(uri, ";", 0);
+    for (i = 0; parts[i]; i++) {
+        if (g_str_has_prefix(parts[i], "tcp://")) {
+            contact = parts[i] + 6;
+        } else if (g_str_has_prefix(parts[i], "tcp6://")) {
+            contact = parts[i] + 7;
+        } else {
+            continue;
+        }
+        colon = strrchr(contact, ':');
+        if (!colon) {
+            continue;
+        }
+        *colon = '\0';
+        hosts = g_strsplit(contact, ",", 0);
+        for (j = 0; hosts[j]; j++) {
+            host = g_strstrip(hosts[j]);
+            if ('[' == host[0]) {
+                host++;
+                if (strchr(host, ']')) {
+                    *strchr(host, ']') = '\0';
+                }
+            }
+            /* the loopback contact is on every host */
+            if (strchr(host, ':')) {
+                if (1 != inet_pton(AF_INET6, host, buf) ||
+                        !strcmp(host, "::1")) {
+                    continue;
+                }
+                SET_ADDRESS(&addr, AT_IPv6, 16, buf);
+            } else {
+                if (1 != inet_pton(AF_INET, host, buf) || 127 == buf[0]) {
+                    continue;
+                }
+                SET_ADDRESS(&addr, AT_IPv4, 4, buf);
+            }
+            launch_add_host(ls, daemon, &addr);
+        }
+        g_strfreev(hosts);
+    }
+    g_strfreev(parts);
+}
+
+static gboolean
+launch_is_grpcomm_tag(guint32 rml_tag)
+{
+    switch (rml_tag) {
+        case ORTE_RML_TAG_COLLECTIVE:
+        case ORTE_RML_TAG_DAEMON_COLL:
+        case ORTE_RML_TAG_COLL_ID:
+        case ORTE_RML_TAG_COLL_ID_REQ:
+        case ORTE_RML_TAG_ROLLUP:
+        case ORTE_RML_TAG_XCAST_BARRIER:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+static void
+launch_oob(launch_t *ls, packet_info *pinfo, const mpi_tap_info_t *mpi_tap_info)
+{
+    const nstime_t *ts = &pinfo->fd->abs_ts;
+    launch_daemon_t *from = NULL;
+    launch_daemon_t *to = NULL;
+
+    if (ORTE_JOBID_IS_DAEMON(mpi_tap_info->jobid_origin)) {
+        from = launch_get_daemon(ls, mpi_tap_info->jobid_origin,
+                mpi_tap_info->vpid_origin);
+        /* the hosts of the daemon, needed to find its first MPI traffic */
+        if (mpi_tap_info->uri) {
+            launch_add_uri(ls, from, (const gchar *)mpi_tap_info->uri);
+        } else if (!from->addr && mpi_tap_info->oob_header &&
+                0 == mpi_tap_info->msg_type /* IDENT */ &&
+                (AT_IPv4 == pinfo->src.type || AT_IPv6 == pinfo->src.type)) {
+            launch_add_host(ls, from, &pinfo->src);
+        }
+    }
+    if (ORTE_JOBID_IS_DAEMON(mpi_tap_info->jobid_dst)) {
+        to = launch_get_daemon(ls, mpi_tap_info->jobid_dst,
+                mpi_tap_info->vpid_dst);
+    }
+
+    /* the daemon command of a XCAST is only known in the message */
+    if (!mpi_tap_info->oob_header) {
+        if (to && ORTE_RML_TAG_XCAST == mpi_tap_info->rml_tag &&
+                ORTE_DAEMON_ADD_LOCAL_PROCS == mpi_tap_info->daemon_cmd) {
+            launch_set_done(to, LAUNCH_PHASE_SPAWN, ts);
+        }
+        return;
+    }
+
+    switch (mpi_tap_info->rml_tag) {
+        case ORTE_RML_TAG_ORTED_CALLBACK:
+            if (from) {
+                launch_set_done(from, LAUNCH_PHASE_CALLBACK, ts);
+            }
+            break;
+        case ORTE_RML_TAG_DIRECT_MODEX:
+        case ORTE_RML_TAG_DIRECT_MODEX_RESP:
+            if (from && 1 >= from->coll_round) {
+                if (nstime_is_unset(&from->modex_start)) {
+                    from->modex_start = *ts;
+                }
+                from->done[LAUNCH_PHASE_MODEX] = *ts;
+            }
+            if (to && 1 >= to->coll_round) {
+                if (nstime_is_unset(&to->modex_start)) {
+                    to->modex_start = *ts;
+                }
+                to->done[LAUNCH_PHASE_MODEX] = *ts;
+            }
+            break;
+        case ORTE_RML_TAG_XCAST:
+            /* a XCAST after a contribution releases the collective */
+            if (to && to->coll_open) {
+                to->coll_open = FALSE;
+                if (1 == to->coll_round) {
+                    to->done[LAUNCH_PHASE_MODEX] = *ts;
+                } else if (2 == to->coll_round) {
+                    launch_set_done(to, LAUNCH_PHASE_BARRIER, ts);
+                }
+            }
+            break;
+        default:
+            if (from && !from->coll_open &&
+                    !nstime_is_unset(&from->done[LAUNCH_PHASE_SPAWN]) &&
+                    launch_is_grpcomm_tag(mpi_tap_info->rml_tag)) {
+                from->coll_open = TRUE;
+                from->coll_round++;
+                if (1 == from->coll_round &&
+                        nstime_is_unset(&from->modex_start)) {
+                    from->modex_start = *ts;
+                } else if (2 == from->coll_round) {
+                    from->barrier_start = *ts;
+                }
+            }
+            break;
+    }
+}
+
+static void
+launch_mpi(launch_t *ls, packet_info *pinfo)
+{
+    launch_daemon_t *daemon;
+    GPtrArray *daemons;
+    const address *addrs[2];
+    guint j;
+    int i;
+
+    addrs[0] = &pinfo->src;
+    addrs[1] = &pinfo->dst;
+    for (i = 0; i < 2; i++) {
+        daemons = (GPtrArray *)g_hash_table_lookup(ls->hosts,
+                address_to_str(wmem_packet_scope(), addrs[i]));
+        for (j = 0; daemons && j < daemons->len; j++) {
+            daemon = (launch_daemon_t *)g_ptr_array_index(daemons, j);
+            if (nstime_is_unset(&daemon->done[LAUNCH_PHASE_FIRST_MPI])) {
+                daemon->done[LAUNCH_PHASE_FIRST_MPI] = pinfo->fd->abs_ts;
+                ls->pending_mpi--;
+            }
+        }
+    }
+}
+
+static int
+launch_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt _U_, const void *data)
+{
+    launch_t *ls = (launch_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+
+    switch (mpi_tap_info->kind) {
+        case MPI_PDU_OOB:
+            if (nstime_is_unset(&ls->t0)) {
+                ls->t0 = pinfo->fd->abs_ts;
+            }
+            launch_oob(ls, pinfo, mpi_tap_info);
+            break;
+        case MPI_PDU_SYNC:
+        case MPI_PDU_BTL:
+            if (0 < ls->pending_mpi) {
+                launch_mpi(ls, pinfo);
+            }
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+static gint
+launch_daemon_cmp(gconstpointer a, gconstpointer b)
+{
+    const launch_daemon_t *da = *(const launch_daemon_t * const *)a;
+    const launch_daemon_t *db = *(const launch_daemon_t * const *)b;
+
+    if (da->jobid != db->jobid) {
+        return da->jobid < db->jobid ? -1 : 1;
+    }
+    return da->vpid < db->vpid ? -1 : (da->vpid > db->vpid);
+}
+
+static gdouble
+launch_rel(const launch_t *ls, const nstime_t *ts)
+{
+    nstime_t delta;
+
+    nstime_delta(&delta, ts, &ls->t0);
+    return nstime_to_sec(&delta);
+}
+
+/* duration of a phase: from the end of the previous phase (or the start of
+ * the collective) up to its end, negative if unknown */
+static gdouble
+launch_duration(const launch_t *ls, const launch_daemon_t *daemon, launch_phase_t phase)
+{
+    const nstime_t *from;
+
+    if (nstime_is_unset(&daemon->done[phase])) {
+        return -1;
+    }
+    switch (phase) {
+        case LAUNCH_PHASE_CALLBACK:
+            from = &ls->t0;
+            break;
+        case LAUNCH_PHASE_MODEX:
+            from = nstime_is_unset(&daemon->modex_start) ?
+                &daemon->done[LAUNCH_PHASE_SPAWN] : &daemon->modex_start;
+            break;
+        case LAUNCH_PHASE_BARRIER:
+            from = nstime_is_unset(&daemon->barrier_start) ?
+                &daemon->done[LAUNCH_PHASE_MODEX] : &daemon->barrier_start;
+            break;
+        default:
+            from = &daemon->done[phase - 1];
+            break;
+    }
+    if (nstime_is_unset(from)) {
+        return -1;
+    }
+    return launch_rel(ls, &daemon->done[phase]) - launch_rel(ls, from);
+}
+
+static void
+launch_draw(void *tapdata)
+{
+    launch_t *ls = (launch_t *)tapdata;
+    GPtrArray *daemons;
+    GHashTableIter iter;
+    gpointer value;
+    launch_daemon_t *daemon;
+    guint i;
+    int p;
+
+    daemons = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, ls->daemons);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(daemons, value);
+    }
+    g_ptr_array_sort(daemons, launch_daemon_cmp);
+
+    printf("\n");
+    printf("=================================================================================================\n");
+    printf("MPI Job Launch Timeline:\n");
+    printf("Filter: %s\n", ls->filter ? ls->filter : "");
+    printf("Daemons: %u\n", daemons->len);
+    printf("Times in seconds since the first OOB message\n");
+    printf("-------------------------------------------------------------------------------------------------\n");
+    printf("%-14s %-20s", "Daemon", "Address");
+    for (p = 0; p < LAUNCH_PHASE_NUM; p++) {
+        printf(" %12s", launch_phase_names[p]);
+    }
+    printf("\n");
+    for (i = 0; i < daemons->len; i++) {
+        daemon = (launch_daemon_t *)g_ptr_array_index(daemons, i);
+        printf("%8u.%-5u %-20s", daemon->jobid, daemon->vpid,
+                daemon->addr ? daemon->addr : "-");
+        for (p = 0; p < LAUNCH_PHASE_NUM; p++) {
+            if (nstime_is_unset(&daemon->done[p])) {
+                printf(" %12s", "-");
+            } else {
+                printf(" %12.6f", launch_rel(ls, &daemon->done[p]));
+            }
+        }
+        printf("\n");
+    }
+
+    printf("-------------------------------------------------------------------------------------------------\n");
+    printf("Phase durations (seconds)\n");
+    printf("%-14s %8s %12s %12s %12s %14s %12s\n", "Phase", "Daemons",
+            "Min", "Avg", "Max", "Slowest", "Job done");
+    for (p = 0; p < LAUNCH_PHASE_NUM; p++) {
+        gdouble min = 0, max = -1, sum = 0, last = -1, d;
+        launch_daemon_t *slowest = NULL;
+        guint n = 0;
+
+        for (i = 0; i < daemons->len; i++) {
+            daemon = (launch_daemon_t *)g_ptr_array_index(daemons, i);
+            if (!nstime_is_unset(&daemon->done[p])) {
+                last = MAX(last, launch_rel(ls, &daemon->done[p]));
+            }
+            d = launch_duration(ls, daemon, (launch_phase_t)p);
+            if (0 > d) {
+                continue;
+            }
+            if (0 == n || d < min) {
+                min = d;
+            }
+            if (d > max) {
+                max = d;
+                slowest = daemon;
+            }
+            sum += d;
+            n++;
+        }
+        if (0 == n) {
+            printf("%-14s %8u %12s %12s %12s %14s", launch_phase_names[p], 0,
+                    "-", "-", "-", "-");
+        } else {
+            printf("%-14s %8u %12.6f %12.6f %12.6f %8u.%-5u", launch_phase_names[p],
+                    n, min, sum / n, max, slowest->jobid, slowest->vpid);
+        }
+        if (0 > last) {
+            printf(" %12s\n", "-");
+        } else {
+            printf(" %12.6f\n", last);
+        }
+    }
+    printf("=================================================================================================\n");
+
+    g_ptr_array_free(daemons, TRUE);
+}
+
+static void
+launch_init(const char *opt_arg, void *userdata _U_)
+{
+    launch_t *ls;
+    const char *filter = NULL;
+    GString *error_string;
+
+    if (!strncmp(opt_arg, "mpi,launch,", 11)) {
+        filter = opt_arg + 11;
+    }
+
+    ls = g_new0(launch_t, 1);
+    ls->filter = filter ? g_strdup(filter) : NULL;
+    ls->daemons = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            NULL, launch_daemon_free);
+    ls->hosts = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, launch_host_free);
+    nstime_set_unset(&ls->t0);
+
+    error_string = register_tap_listener("mpi", ls, ls->filter, 0,
+            launch_reset, launch_packet, launch_draw);
+    if (error_string) {
+        g_hash_table_destroy(ls->hosts);
+        g_hash_table_destroy(ls->daemons);
+        g_free(ls->filter);
+        g_free(ls);
+        fprintf(stderr, "tshark: Couldn't register mpi,launch tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_launch(void)
+{
+    register_stat_cmd_arg("mpi,launch", launch_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,401 @@
+/* tap-mpi-monitor.c
+ * Rolling per interval MPI metrics for live captures with tshark
+ * (-z mpi,monitor)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Prints the metrics of every interval (capture time) as soon as a frame
+ * of the next one arrives, one line per metric with key=value fields for
+ * a monitoring system:
+ *
+ *   mpi.job   messages/s (MATCH, RNDV, RGET) and BTL data bytes/s of a
+ *             job (the sending process, "-" while its channel is unknown)
+ *   mpi.pair  the top talkers by bytes among the sending/receiving
+ *             process pairs
+ *   mpi.rndv  finished rendezvous transfers, their time on wire p50/p99
+ *   mpi.oob   OOB messages/s and message bytes/s of the daemons
+ *
+ * The memory is fixed: at most MONITOR_MAX_JOBS jobs (the rest is counted
+ * as job "other"), MONITOR_PAIRS pairs with the Space-Saving algorithm
+ * (the bytes of a pair are an upper bound, err is their possible excess)
+ * and a logarithmic histogram of the transfer times (4 buckets per power
+ * of two microseconds, the percentiles are bucket upper bounds). Use it
+ * with -q and without a display filter to stay on the fast path.
+ *
+ * Usage: -z mpi,monitor[,interval[,filter]]   (interval in s, default 1)
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+#define MONITOR_DEFAULT_INTERVAL 1.0
+#define MONITOR_MAX_JOBS 64
+/* pairs tracked and printed */
+#define MONITOR_PAIRS 32
+#define MONITOR_TOP 5
+/* 2^0 .. 2^40 us, 4 buckets per power of two */
+#define MONITOR_OCTAVES 40
+#define MONITOR_BUCKETS (MONITOR_OCTAVES * 4)
+
+typedef struct _monitor_job_t {
+    guint32 jobid;
+    gboolean known;
+    guint msgs;
+    guint64 bytes;
+} monitor_job_t;
+
+typedef struct _monitor_pair_t {
+    guint32 names[4];       /* jobid, vpid of the sender and receiver */
+    guint msgs;
+    guint64 bytes;
+    guint64 err;            /* bytes of the pair it replaced */
+} monitor_pair_t;
+
+typedef struct _monitor_t {
+    char *filter;
+    gdouble interval;       /* s */
+    gboolean started;
+    gdouble start;          /* of the current interval (s since the epoch) */
+    monitor_job_t jobs[MONITOR_MAX_JOBS + 1];   /* the last one: "other" */
+    guint njobs;
+    monitor_pair_t pairs[MONITOR_PAIRS];
+    guint npairs;
+    guint rndv_buckets[MONITOR_BUCKETS];
+    guint rndvs;
+    guint oob_msgs;
+    guint64 oob_bytes;
+} monitor_t;
+
+static void
+monitor_clear(monitor_t *ms)
+{
+    memset(ms->jobs, 0, sizeof(ms->jobs));
+    ms->njobs = 0;
+    memset(ms->pairs, 0, sizeof(ms->pairs));
+    ms->npairs = 0;
+    memset(ms->rndv_buckets, 0, sizeof(ms->rndv_buckets));
+    ms->rndvs = 0;
+    ms->oob_msgs = 0;
+    ms->oob_bytes = 0;
+}
+
+static monitor_job_t *
+monitor_job(monitor_t *ms, const mpi_tap_info_t *mpi_tap_info)
+{
+    monitor_job_t *job;
+    gboolean known = 0 != mpi_tap_info->channel;
+    guint i;
+
+    for (i = 0; i < ms->njobs; i++) {
+        job = &ms->jobs[i];
+        if (job->known == known && (!known || job->jobid == mpi_tap_info->jobid)) {
+            return job;
+        }
+    }
+    if (MONITOR_MAX_JOBS == ms->njobs) {
+        return &ms->jobs[MONITOR_MAX_JOBS];
+    }
+    job = &ms->jobs[ms->njobs++];
+    job->known = known;
+    job->jobid = known ? mpi_tap_info->jobid : 0;
+    return job;
+}
+
+/* Space-Saving: a new pair replaces the one with the fewest bytes */
+static void
+monitor_pair(monitor_t *ms, const mpi_tap_info_t *mpi_tap_info, guint64 bytes)
+{
+    monitor_pair_t *pair;
+    monitor_pair_t *min = NULL;
+    guint32 names[4];
+    guint i;
+
+    names[0] = mpi_tap_info->jobid;
+    names[1] = mpi_tap_info->vpid;
+    names[2] = mpi_tap_info->jobid_dst;
+    names[3] = mpi_tap_info->vpid_dst;
+    for (i = 0; i < ms->npairs; i++) {
+        pair = &ms->pairs[i];
+        if (0 == memcmp(pair->names, names, sizeof(names))) {
+            pair->msgs++;
+            pair->bytes += bytes;
+            return;
+        }
+        if (!min || pair->bytes < min->bytes) {
+            min = pair;
+        }
+    }
+    if (MONITOR_PAIRS > ms->npairs) {
+        pair = &ms->pairs[ms->npairs++];
+        memset(pair, 0, sizeof(*pair));
+    } else {
+        pair = min;
+        pair->err = pair->bytes;
+        pair->msgs = 0;
+    }
+    memcpy(pair->names, names, sizeof(names));
+    pair->msgs++;
+    pair->bytes += bytes;
+}
+
+static guint
+monitor_bucket(const nstime_t *duration)
+{
+    guint64 us;
+    guint octave = 0;
+
+    if (0 > duration->secs) {
+        return 0;
+    }
+    us = (guint64)duration->secs * 1000000 + duration->nsecs / 1000;
+    while (us >> (octave + 1)) {
+        octave++;
+    }
+    if (MONITOR_OCTAVES <= octave) {
+        return MONITOR_BUCKETS - 1;
+    }
+    /* the two bits below the highest one */
+    if (2 <= octave) {
+        return octave * 4 + (guint)((us >> (octave - 2)) & 3);
+    }
+    return octave * 4 + (guint)((us << (2 - octave)) & 3);
+}
+
+/* upper bound of a bucket in ms */
+static gdouble
+monitor_bucket_ms(guint bucket)
+{
+    return (gdouble)((G_GUINT64_CONSTANT(1) << (bucket / 4)) *
+            (4 + bucket % 4 + 1)) / 4.0 / 1000.0;
+}
+
+static gdouble
+monitor_percentile(const monitor_t *ms, guint percent)
+{
+    guint want;
+    guint seen = 0;
+    guint i;
+
+    want = (ms->rndvs * percent + 99) / 100;
+    for (i = 0; i < MONITOR_BUCKETS; i++) {
+        seen += ms->rndv_buckets[i];
+        if (seen >= want && seen) {
+            return monitor_bucket_ms(i);
+        }
+    }
+    return 0;
+}
+
+static gint
+monitor_pair_cmp(gconstpointer a, gconstpointer b)
+{
+    const monitor_pair_t *pa = (const monitor_pair_t *)a;
+    const monitor_pair_t *pb = (const monitor_pair_t *)b;
+
+    if (pa->bytes != pb->bytes) {
+        return pa->bytes > pb->bytes ? -1 : 1;
+    }
+    return 0;
+}
+
+/* print the current interval, "secs" of it passed */
+static void
+monitor_flush(monitor_t *ms, gdouble secs)
+{
+    const monitor_job_t *job;
+    const monitor_pair_t *pair;
+    guint i;
+
+    if (0 >= secs) {
+        return;
+    }
+    for (i = 0; i < ms->njobs; i++) {
+        job = &ms->jobs[i];
+        if (job->known) {
+            printf("mpi.job t=%.3f interval=%.3f job=%u", ms->start, secs,
+                    job->jobid);
+        } else {
+            printf("mpi.job t=%.3f interval=%.3f job=-", ms->start, secs);
+        }
+        printf(" msgs_s=%.1f bytes_s=%.1f\n", job->msgs / secs,
+                job->bytes / secs);
+    }
+    job = &ms->jobs[MONITOR_MAX_JOBS];
+    if (job->msgs || job->bytes) {
+        printf("mpi.job t=%.3f interval=%.3f job=other msgs_s=%.1f "
+                "bytes_s=%.1f\n", ms->start, secs, job->msgs / secs,
+                job->bytes / secs);
+    }
+
+    qsort(ms->pairs, ms->npairs, sizeof(monitor_pair_t), monitor_pair_cmp);
+    for (i = 0; i < ms->npairs && i < MONITOR_TOP; i++) {
+        pair = &ms->pairs[i];
+        printf("mpi.pair t=%.3f interval=%.3f rank=%d src=%u.%u dst=%u.%u "
+                "msgs_s=%.1f bytes_s=%.1f err_bytes=%" G_GINT64_MODIFIER "u\n",
+                ms->start, secs, i + 1, pair->names[0], pair->names[1],
+                pair->names[2], pair->names[3], pair->msgs / secs,
+                pair->bytes / secs, pair->err);
+    }
+
+    if (ms->rndvs) {
+        printf("mpi.rndv t=%.3f interval=%.3f done=%u p50_ms=%.3f "
+                "p99_ms=%.3f\n", ms->start, secs, ms->rndvs,
+                monitor_percentile(ms, 50), monitor_percentile(ms, 99));
+    }
+    if (ms->oob_msgs || ms->oob_bytes) {
+        printf("mpi.oob t=%.3f interval=%.3f msgs_s=%.1f bytes_s=%.1f\n",
+                ms->start, secs, ms->oob_msgs / secs, ms->oob_bytes / secs);
+    }
+    /* for a pipe into the monitoring */
+    fflush(stdout);
+    monitor_clear(ms);
+}
+
+static void
+monitor_reset(void *tapdata)
+{
+    monitor_t *ms = (monitor_t *)tapdata;
+
+    monitor_clear(ms);
+    ms->started = FALSE;
+    ms->start = 0;
+}
+
+static int
+monitor_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt _U_, const void *data)
+{
+    monitor_t *ms = (monitor_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    monitor_job_t *job;
+    gdouble now;
+
+    now = nstime_to_sec(&pinfo->fd->abs_ts);
+    if (!ms->started) {
+        ms->started = TRUE;
+        ms->start = (gint64)(now / ms->interval) * ms->interval;
+    } else if (now >= ms->start + ms->interval) {
+        monitor_flush(ms, ms->interval);
+        /* empty intervals are left out */
+        ms->start = (gint64)(now / ms->interval) * ms->interval;
+    }
+
+    switch (mpi_tap_info->kind) {
+        case MPI_PDU_OOB:
+            if (mpi_tap_info->oob_header) {
+                ms->oob_msgs++;
+                ms->oob_bytes += mpi_tap_info->nbytes;
+            }
+            break;
+        case MPI_PDU_BTL:
+            job = monitor_job(ms, mpi_tap_info);
+            if (mpi_tap_info->matched) {
+                job->msgs++;
+            }
+            job->bytes += mpi_tap_info->payload;
+            if (mpi_tap_info->channel &&
+                    (mpi_tap_info->matched || mpi_tap_info->payload)) {
+                monitor_pair(ms, mpi_tap_info, mpi_tap_info->payload);
+            }
+            if (mpi_tap_info->xfer_done) {
+                ms->rndv_buckets[monitor_bucket(&mpi_tap_info->xfer_duration)]++;
+                ms->rndvs++;
+            }
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+static void
+monitor_draw(void *tapdata)
+{
+    monitor_t *ms = (monitor_t *)tapdata;
+
+    /* the last interval, rates over its full length */
+    if (ms->started) {
+        monitor_flush(ms, ms->interval);
+    }
+}
+
+static void
+monitor_init(const char *opt_arg, void *userdata _U_)
+{
+    monitor_t *ms;
+    const char *filter = NULL;
+    gdouble interval = MONITOR_DEFAULT_INTERVAL;
+    GString *error_string;
+    int pos = 0;
+
+    if (sscanf(opt_arg, "mpi,monitor,%lf%n", &interval, &pos) == 1) {
+        if (',' == opt_arg[pos]) {
+            filter = opt_arg + pos + 1;
+        }
+    }
+    if (0 >= interval) {
+        fprintf(stderr, "tshark: invalid \"-z mpi,monitor,<interval>[,<filter>]\" interval\n");
+        exit(1);
+    }
+
+    ms = g_new0(monitor_t, 1);
+    ms->filter = filter ? g_strdup(filter) : NULL;
+    ms->interval = interval;
+
+    error_string = register_tap_listener("mpi", ms, ms->filter,
+            TL_REQUIRES_NOTHING, monitor_reset, monitor_packet, monitor_draw);
+    if (error_string) {
+        g_free(ms->filter);
+        g_free(ms);
+        fprintf(stderr, "tshark: Couldn't register mpi,monitor tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_monitor(void)
+{
+    register_stat_cmd_arg("mpi,monitor", monitor_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,268 @@
+/* tap-mpi-netdelay.c
+ * Network induced delay of MPI messages per rank pair for tshark
+ * (-z mpi,netdelay)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Uses the TCP events the dissector relates to the BTL PDUs (mpi.tcp.*)
+ * to show per rank pair (channel, or tcp stream if the sync handshake was
+ * not captured)
+ *
+ *   the messages (MATCH, RNDV, RGET) and how many of them were hit by TCP
+ *   retransmissions, duplicate ACKs or zero windows
+ *   these TCP events and the delay attributed to them
+ *   the average time on wire of the rendezvous transfers with and without
+ *   TCP events: a big difference points to the network, slow transfers
+ *   without events to the application
+ *
+ * The TCP analysis of the TCP dissector (tcp.analyze_sequence_numbers)
+ * has to be enabled.
+ *
+ * Usage: -z mpi,netdelay[,filter]
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+typedef struct _netdelay_pair_t {
+    guint64 key;            /* channel, or 1 << 32 | tcp.stream */
+    guint32 jobid[2];
+    guint32 vpid[2];
+    guint msgs;
+    guint hit;              /* messages with TCP events */
+    guint retrans;
+    guint dupacks;
+    guint zero_windows;
+    gdouble delay;          /* ms */
+    guint xfers_clean;
+    gdouble dur_clean;      /* ms */
+    guint xfers_hit;
+    gdouble dur_hit;
+} netdelay_pair_t;
+
+typedef struct _netdelay_t {
+    char *filter;
+    GHashTable *pairs;      /* key -> netdelay_pair_t */
+} netdelay_t;
+
+static void
+netdelay_reset(void *tapdata)
+{
+    netdelay_t *ns = (netdelay_t *)tapdata;
+
+    g_hash_table_remove_all(ns->pairs);
+}
+
+static int
+netdelay_packet(void *tapdata, packet_info *pinfo _U_, epan_dissect_t *edt _U_, const void *data)
+{
+    netdelay_t *ns = (netdelay_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    netdelay_pair_t *pair;
+    guint64 key;
+    guint events;
+    guint i;
+
+    if (MPI_PDU_BTL != mpi_tap_info->kind) {
+        return 0;
+    }
+
+    key = mpi_tap_info->channel ? mpi_tap_info->channel :
+        (G_GUINT64_CONSTANT(1) << 32) | mpi_tap_info->stream;
+    pair = (netdelay_pair_t *)g_hash_table_lookup(ns->pairs, &key);
+    if (!pair) {
+        pair = g_new0(netdelay_pair_t, 1);
+        pair->key = key;
+        if (mpi_tap_info->channel) {
+            i = (mpi_tap_info->jobid < mpi_tap_info->jobid_dst ||
+                    (mpi_tap_info->jobid == mpi_tap_info->jobid_dst &&
+                     mpi_tap_info->vpid < mpi_tap_info->vpid_dst)) ? 0 : 1;
+            pair->jobid[i] = mpi_tap_info->jobid;
+            pair->vpid[i] = mpi_tap_info->vpid;
+            pair->jobid[1 - i] = mpi_tap_info->jobid_dst;
+            pair->vpid[1 - i] = mpi_tap_info->vpid_dst;
+        }
+        g_hash_table_insert(ns->pairs, &pair->key, pair);
+    }
+
+    events = mpi_tap_info->tcp_retrans + mpi_tap_info->tcp_dupacks +
+        mpi_tap_info->tcp_zero_windows;
+    pair->retrans += mpi_tap_info->tcp_retrans;
+    pair->dupacks += mpi_tap_info->tcp_dupacks;
+    pair->zero_windows += mpi_tap_info->tcp_zero_windows;
+    pair->delay += nstime_to_msec(&mpi_tap_info->tcp_delay);
+
+    switch (mpi_tap_info->base) {
+        case MPI_PML_OB1_HDR_TYPE_MATCH:
+            pair->msgs++;
+            if (events) {
+                pair->hit++;
+            }
+            break;
+        case MPI_PML_BFO_HDR_TYPE_RNDV:
+        case MPI_PML_OB1_HDR_TYPE_RGET:
+            pair->msgs++;
+            break;
+        default:
+            break;
+    }
+
+    /* a transfer is hit by the events on all of its PDUs */
+    if (mpi_tap_info->xfer_done) {
+        if (mpi_tap_info->xfer_tcp_events) {
+            pair->hit++;
+            pair->xfers_hit++;
+            pair->dur_hit += nstime_to_msec(&mpi_tap_info->xfer_duration);
+        } else {
+            pair->xfers_clean++;
+            pair->dur_clean += nstime_to_msec(&mpi_tap_info->xfer_duration);
+        }
+    }
+    return 1;
+}
+
+static gint
+netdelay_pair_cmp(gconstpointer a, gconstpointer b)
+{
+    const netdelay_pair_t *pa = *(const netdelay_pair_t * const *)a;
+    const netdelay_pair_t *pb = *(const netdelay_pair_t * const *)b;
+
+    /* most delayed first */
+    if (pa->delay != pb->delay) {
+        return pa->delay > pb->delay ? -1 : 1;
+    }
+    return pa->key < pb->key ? -1 : (pa->key > pb->key);
+}
+
+static void
+netdelay_draw(void *tapdata)
+{
+    netdelay_t *ns = (netdelay_t *)tapdata;
+    GPtrArray *pairs;
+    GHashTableIter iter;
+    gpointer value;
+    netdelay_pair_t *pair;
+    gchar label[32];
+    guint i;
+
+    pairs = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, ns->pairs);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(pairs, value);
+    }
+    g_ptr_array_sort(pairs, netdelay_pair_cmp);
+
+    printf("\n");
+    printf("=============================================================================================================\n");
+    printf("MPI Network Induced Delay:\n");
+    printf("Filter: %s\n", ns->filter ? ns->filter : "");
+    printf("Rank pairs: %u\n", pairs->len);
+    printf("Times in milliseconds, rendezvous: average time on wire without / with TCP events\n");
+    printf("-------------------------------------------------------------------------------------------------------------\n");
+    printf("%-25s %8s %8s %8s %8s %8s %12s %8s %10s %8s %10s\n", "Rank pair",
+            "Msgs", "Hit", "Retrans", "DupACKs", "ZeroWin", "Delay",
+            "Clean", "Avg", "Hit", "Avg");
+    for (i = 0; i < pairs->len; i++) {
+        pair = (netdelay_pair_t *)g_ptr_array_index(pairs, i);
+        if (pair->key >> 32) {
+            g_snprintf(label, sizeof(label), "tcp.stream %u",
+                    (guint32)pair->key);
+        } else {
+            g_snprintf(label, sizeof(label), "%u.%u - %u.%u",
+                    pair->jobid[0], pair->vpid[0],
+                    pair->jobid[1], pair->vpid[1]);
+        }
+        printf("%-25s %8u %8u %8u %8u %8u %12.3f %8u", label, pair->msgs,
+                pair->hit, pair->retrans, pair->dupacks, pair->zero_windows,
+                pair->delay, pair->xfers_clean);
+        if (pair->xfers_clean) {
+            printf(" %10.3f", pair->dur_clean / pair->xfers_clean);
+        } else {
+            printf(" %10s", "-");
+        }
+        printf(" %8u", pair->xfers_hit);
+        if (pair->xfers_hit) {
+            printf(" %10.3f\n", pair->dur_hit / pair->xfers_hit);
+        } else {
+            printf(" %10s\n", "-");
+        }
+    }
+    g_ptr_array_free(pairs, TRUE);
+    printf("=============================================================================================================\n");
+}
+
+static void
+netdelay_init(const char *opt_arg, void *userdata _U_)
+{
+    netdelay_t *ns;
+    const char *filter = NULL;
+    GString *error_string;
+
+    if (!strncmp(opt_arg, "mpi,netdelay,", 13)) {
+        filter = opt_arg + 13;
+    }
+
+    ns = g_new0(netdelay_t, 1);
+    ns->filter = filter ? g_strdup(filter) : NULL;
+    ns->pairs = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            NULL, g_free);
+
+    error_string = register_tap_listener("mpi", ns, ns->filter, 0,
+            netdelay_reset, netdelay_packet, netdelay_draw);
+    if (error_string) {
+        g_hash_table_destroy(ns->pairs);
+        g_free(ns->filter);
+        g_free(ns);
+        fprintf(stderr, "tshark: Couldn't register mpi,netdelay tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_netdelay(void)
+{
+    register_stat_cmd_arg("mpi,netdelay", netdelay_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,733 @@
+/* tap-mpi-otf2.c
+ * OTF2 trace export of MPI messages and collectives for tshark
+ * (-z mpi,otf2)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Writes the BTL messages as an OTF2 archive (<dir>/traces.otf2), as read
+ * by Vampir, Scalasca and the other OTF2 tools:
+ *
+ *   every rank (vpid) of the application job is a process with one
+ *   location, below the node of its daemon (ORTED callback nodename,
+ *   matched by the address of the rank) in the system tree
+ *   every communicator (mpi.match.ctx) is defined over all ranks: only
+ *   MPI_COMM_WORLD is known from the wire
+ *   MATCH is a MpiSend and a MpiRecv at its capture time, a rendezvous
+ *   (RNDV, RGET) a MpiSend at its RNDV and a MpiRecv at the end of the
+ *   transfer
+ *   the messages of a rank with the tag of one blocking collective form a
+ *   MpiCollectiveBegin/End pair with the bytes sent and received (see
+ *   -z mpi,trace for the spans)
+ *
+ * The events are written through the buffered event writer of every
+ * location while the capture is read, the definitions at the end.
+ * Timestamps are the capture times in nanoseconds.
+ *
+ * Needs the OTF2 library: build with HAVE_OTF2, see README.md.
+ *
+ * Usage: -z mpi,otf2,<dir>[,filter]
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+#ifdef HAVE_OTF2
+
+#include <otf2/otf2.h>
+
+/* unfinished rendezvous transfers kept at most */
+#define OTF2_MAX_PENDING 65536
+/* OTF2 chunk sizes: events, definitions */
+#define OTF2_EVT_CHUNK (1024 * 1024)
+#define OTF2_DEF_CHUNK (4 * 1024 * 1024)
+/* the collective tags with an OTF2 operation: ALLGATHER down to this */
+#define OTF2_COLL_TAG_SCATTERV -25
+
+typedef struct _otf2_rank_t {
+    guint32 vpid;
+    gchar *addr;            /* of its BTL sync, NULL if unknown */
+    OTF2_EvtWriter *writer; /* NULL until the first event */
+    guint64 events;
+    guint64 last;           /* ns of the latest event */
+    /* the open collective */
+    gboolean open;
+    guint16 ctx;
+    gint32 tag;
+    guint64 end;
+    guint64 sent;
+    guint64 received;
+    GHashTable *peers;      /* synchronizing collectives: sent to */
+} otf2_rank_t;
+
+/* a rendezvous transfer until its end */
+typedef struct _otf2_pending_t {
+    otf2_rank_t *src;
+    otf2_rank_t *dst;
+    guint16 ctx;
+    gint32 tag;
+    guint64 msg_len;
+} otf2_pending_t;
+
+typedef struct _otf2_t {
+    char *filter;
+    char *dir;
+    OTF2_Archive *archive;
+    guint errors;
+    OTF2_ErrorCode error;   /* the first one */
+    gboolean have_job;
+    guint32 jobid;          /* the application */
+    guint64 first;          /* ns */
+    guint64 latest;
+    GHashTable *ranks;      /* vpid -> otf2_rank_t */
+    GHashTable *comms;      /* ctx */
+    GHashTable *nodes;      /* address string -> nodename */
+    GHashTable *pending;    /* RNDV frame -> otf2_pending_t */
+    guint messages;
+    guint collectives;
+    guint unknown;          /* without ranks, of another job or collective */
+    guint untracked;        /* rendezvous beyond OTF2_MAX_PENDING */
+} otf2_t;
+
+static OTF2_FlushType
+otf2_pre_flush(void *user_data _U_, OTF2_FileType file_type _U_, OTF2_LocationRef location _U_, void *caller_data _U_, bool final _U_)
+{
+    return OTF2_FLUSH;
+}
+
+static OTF2_TimeStamp
+otf2_post_flush(void *user_data _U_, OTF2_FileType file_type _U_, OTF2_LocationRef location _U_)
+{
+    return 0;
+}
+
+static OTF2_FlushCallbacks otf2_flush_callbacks = {
+    otf2_pre_flush,
+    otf2_post_flush
+};
+
+static void
+otf2_check(otf2_t *os, OTF2_ErrorCode error)
+{
+    if (OTF2_SUCCESS != error && 0 == os->errors++) {
+        os->error = error;
+    }
+}
+
+static OTF2_CollectiveOp
+otf2_coll_op(gint32 tag)
+{
+    switch (tag) {
+        case MPI_COLL_BASE_TAG_ALLGATHER:
+            return OTF2_COLLECTIVE_OP_ALLGATHER;
+        case MPI_COLL_BASE_TAG_ALLGATHERV:
+            return OTF2_COLLECTIVE_OP_ALLGATHERV;
+        case MPI_COLL_BASE_TAG_ALLREDUCE:
+            return OTF2_COLLECTIVE_OP_ALLREDUCE;
+        case MPI_COLL_BASE_TAG_ALLTOALL:
+            return OTF2_COLLECTIVE_OP_ALLTOALL;
+        case MPI_COLL_BASE_TAG_ALLTOALLV:
+            return OTF2_COLLECTIVE_OP_ALLTOALLV;
+        case MPI_COLL_BASE_TAG_ALLTOALLW:
+            return OTF2_COLLECTIVE_OP_ALLTOALLW;
+        case MPI_COLL_BASE_TAG_BARRIER:
+            return OTF2_COLLECTIVE_OP_BARRIER;
+        case -17:
+            return OTF2_COLLECTIVE_OP_BCAST;
+        case -18:
+            return OTF2_COLLECTIVE_OP_EXSCAN;
+        case -19:
+            return OTF2_COLLECTIVE_OP_GATHER;
+        case -20:
+            return OTF2_COLLECTIVE_OP_GATHERV;
+        case -21:
+            return OTF2_COLLECTIVE_OP_REDUCE;
+        case -22:
+            return OTF2_COLLECTIVE_OP_REDUCE_SCATTER;
+        case -23:
+            return OTF2_COLLECTIVE_OP_SCAN;
+        case -24:
+            return OTF2_COLLECTIVE_OP_SCATTER;
+        default:
+            return OTF2_COLLECTIVE_OP_SCATTERV;
+    }
+}
+
+static void
+otf2_free_rank(gpointer data)
+{
+    otf2_rank_t *rank = (otf2_rank_t *)data;
+
+    if (rank->peers) {
+        g_hash_table_destroy(rank->peers);
+    }
+    g_free(rank->addr);
+    g_free(rank);
+}
+
+static otf2_rank_t *
+otf2_rank(otf2_t *os, guint32 vpid)
+{
+    otf2_rank_t *rank;
+
+    rank = (otf2_rank_t *)g_hash_table_lookup(os->ranks,
+            GUINT_TO_POINTER(vpid));
+    if (!rank) {
+        rank = g_new0(otf2_rank_t, 1);
+        rank->vpid = vpid;
+        g_hash_table_insert(os->ranks, GUINT_TO_POINTER(vpid), rank);
+    }
+    return rank;
+}
+
+/* the event writer of the rank and the timestamp of its next event, the
+ * events of a location must not go back in time */
+static OTF2_EvtWriter *
+otf2_writer(otf2_t *os, otf2_rank_t *rank, guint64 *now)
+{
+    if (!rank->writer) {
+        rank->writer = OTF2_Archive_GetEvtWriter(os->archive, rank->vpid);
+        if (!rank->writer) {
+            return NULL;
+        }
+    }
+    *now = MAX(*now, rank->last);
+    rank->last = *now;
+    rank->events++;
+    return rank->writer;
+}
+
+static void
+otf2_close_coll(otf2_t *os, otf2_rank_t *rank)
+{
+    OTF2_EvtWriter *writer;
+    guint64 end = rank->end;
+
+    if (!rank->open) {
+        return;
+    }
+    rank->open = FALSE;
+    if (rank->peers) {
+        g_hash_table_remove_all(rank->peers);
+    }
+    writer = otf2_writer(os, rank, &end);
+    if (writer) {
+        otf2_check(os, OTF2_EvtWriter_MpiCollectiveEnd(writer, NULL, end,
+                    otf2_coll_op(rank->tag), rank->ctx, OTF2_UNDEFINED_UINT32,
+                    rank->sent, rank->received));
+    }
+}
+
+/* add a collective message to the open collective of one of its ranks */
+static void
+otf2_coll(otf2_t *os, otf2_rank_t *rank, otf2_rank_t *peer, gboolean sender, const mpi_tap_info_t *mpi_tap_info, guint64 now, guint64 bytes)
+{
+    OTF2_EvtWriter *writer;
+    gint32 tag = mpi_tap_info->match_tag;
+    gboolean sync = MPI_COLL_BASE_TAG_BARRIER <= tag &&
+        MPI_COLL_BASE_TAG_ALLGATHER >= tag;
+
+    if (rank->open && (rank->ctx != mpi_tap_info->match_ctx ||
+                rank->tag != tag || (sync && sender &&
+                    g_hash_table_lookup(rank->peers, peer)))) {
+        otf2_close_coll(os, rank);
+    }
+    if (!rank->open) {
+        writer = otf2_writer(os, rank, &now);
+        if (!writer) {
+            return;
+        }
+        otf2_check(os, OTF2_EvtWriter_MpiCollectiveBegin(writer, NULL, now));
+        os->collectives++;
+        rank->open = TRUE;
+        rank->ctx = mpi_tap_info->match_ctx;
+        rank->tag = tag;
+        rank->sent = 0;
+        rank->received = 0;
+    }
+    if (sync && sender) {
+        if (!rank->peers) {
+            rank->peers = g_hash_table_new(g_direct_hash, g_direct_equal);
+        }
+        g_hash_table_insert(rank->peers, peer, peer);
+    }
+    rank->end = MAX(now, rank->end);
+    if (sender) {
+        rank->sent += bytes;
+    } else {
+        rank->received += bytes;
+    }
+}
+
+static void
+otf2_send(otf2_t *os, otf2_rank_t *src, otf2_rank_t *dst, guint64 now, guint16 ctx, gint32 tag, guint64 bytes)
+{
+    OTF2_EvtWriter *writer;
+
+    /* a point-to-point message ends the collective */
+    otf2_close_coll(os, src);
+    writer = otf2_writer(os, src, &now);
+    if (writer) {
+        otf2_check(os, OTF2_EvtWriter_MpiSend(writer, NULL, now, dst->vpid,
+                    ctx, (guint32)tag, bytes));
+    }
+}
+
+static void
+otf2_recv(otf2_t *os, otf2_rank_t *src, otf2_rank_t *dst, guint64 now, guint16 ctx, gint32 tag, guint64 bytes)
+{
+    OTF2_EvtWriter *writer;
+
+    otf2_close_coll(os, dst);
+    writer = otf2_writer(os, dst, &now);
+    if (writer) {
+        otf2_check(os, OTF2_EvtWriter_MpiRecv(writer, NULL, now, src->vpid,
+                    ctx, (guint32)tag, bytes));
+    }
+}
+
+static void
+otf2_reset(void *tapdata)
+{
+    otf2_t *os = (otf2_t *)tapdata;
+
+    /* the events written can't be taken back: only the state is reset,
+     * the archive stays */
+    g_hash_table_remove_all(os->pending);
+    os->first = 0;
+    os->latest = 0;
+}
+
+static int
+otf2_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt _U_, const void *data)
+{
+    otf2_t *os = (otf2_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    otf2_rank_t *src;
+    otf2_rank_t *dst;
+    otf2_pending_t *pending;
+    guint64 now;
+    guint64 bytes;
+    gchar *addr;
+
+    now = (guint64)pinfo->fd->abs_ts.secs * 1000000000 +
+        pinfo->fd->abs_ts.nsecs;
+
+    switch (mpi_tap_info->kind) {
+        case MPI_PDU_SYNC:
+            if (!os->have_job) {
+                os->have_job = TRUE;
+                os->jobid = mpi_tap_info->jobid;
+            }
+            if (os->jobid == mpi_tap_info->jobid) {
+                src = otf2_rank(os, mpi_tap_info->vpid);
+                if (!src->addr) {
+                    src->addr = address_to_str(NULL, &pinfo->src);
+                }
+            }
+            return 0;
+        case MPI_PDU_OOB:
+            if (mpi_tap_info->nodename) {
+                addr = address_to_str(NULL, &pinfo->src);
+                g_hash_table_replace(os->nodes, addr,
+                        g_strdup((const gchar *)mpi_tap_info->nodename));
+            }
+            return 0;
+        default:
+            break;
+    }
+
+    if (0 == os->first) {
+        os->first = now;
+    }
+    os->latest = MAX(os->latest, now);
+
+    if (mpi_tap_info->matched) {
+        if (0 == mpi_tap_info->channel || !os->have_job ||
+                os->jobid != mpi_tap_info->jobid ||
+                os->jobid != mpi_tap_info->jobid_dst ||
+                OTF2_COLL_TAG_SCATTERV > mpi_tap_info->match_tag) {
+            os->unknown++;
+        } else {
+            src = otf2_rank(os, mpi_tap_info->vpid);
+            dst = otf2_rank(os, mpi_tap_info->vpid_dst);
+            bytes = MPI_PML_OB1_HDR_TYPE_MATCH == mpi_tap_info->base ?
+                mpi_tap_info->payload : mpi_tap_info->msg_len;
+            os->messages++;
+            if (0 > mpi_tap_info->match_tag) {
+                otf2_coll(os, src, dst, TRUE, mpi_tap_info, now, bytes);
+                otf2_coll(os, dst, src, FALSE, mpi_tap_info, now, bytes);
+            } else {
+                otf2_send(os, src, dst, now, mpi_tap_info->match_ctx,
+                        mpi_tap_info->match_tag, bytes);
+                if (MPI_PML_OB1_HDR_TYPE_MATCH == mpi_tap_info->base) {
+                    otf2_recv(os, src, dst, now, mpi_tap_info->match_ctx,
+                            mpi_tap_info->match_tag, bytes);
+                }
+            }
+            g_hash_table_insert(os->comms,
+                    GUINT_TO_POINTER(mpi_tap_info->match_ctx),
+                    GUINT_TO_POINTER(mpi_tap_info->match_ctx));
+            if (MPI_PML_OB1_HDR_TYPE_MATCH == mpi_tap_info->base) {
+                /* eager, received */
+            } else if (OTF2_MAX_PENDING > g_hash_table_size(os->pending)) {
+                pending = g_new(otf2_pending_t, 1);
+                pending->src = src;
+                pending->dst = dst;
+                pending->ctx = mpi_tap_info->match_ctx;
+                pending->tag = mpi_tap_info->match_tag;
+                pending->msg_len = bytes;
+                g_hash_table_insert(os->pending,
+                        GUINT_TO_POINTER(pinfo->fd->num), pending);
+            } else {
+                os->untracked++;
+            }
+        }
+    }
+
+    if (mpi_tap_info->xfer_done) {
+        pending = (otf2_pending_t *)g_hash_table_lookup(os->pending,
+                GUINT_TO_POINTER(mpi_tap_info->xfer_rndv_in));
+        if (pending) {
+            if (0 > pending->tag) {
+                /* the collectives last until the end of the transfer */
+                if (pending->src->open) {
+                    pending->src->end = MAX(pending->src->end, now);
+                }
+                if (pending->dst->open) {
+                    pending->dst->end = MAX(pending->dst->end, now);
+                }
+            } else {
+                otf2_recv(os, pending->src, pending->dst, now, pending->ctx,
+                        pending->tag, pending->msg_len);
+            }
+            g_hash_table_remove(os->pending,
+                    GUINT_TO_POINTER(mpi_tap_info->xfer_rndv_in));
+        }
+    }
+
+    return 1;
+}
+
+static gint
+otf2_vpid_cmp(gconstpointer a, gconstpointer b)
+{
+    guint32 va = (*(otf2_rank_t * const *)a)->vpid;
+    guint32 vb = (*(otf2_rank_t * const *)b)->vpid;
+
+    return va < vb ? -1 : (va > vb ? 1 : 0);
+}
+
+/* the global definitions, the archive is closed after */
+static void
+otf2_write_defs(otf2_t *os, GPtrArray *ranks)
+{
+    OTF2_GlobalDefWriter *defs;
+    OTF2_DefWriter *local;
+    OTF2_StringRef string = 0;
+    GHashTable *node_refs;      /* nodename -> system tree node + 1 */
+    GHashTableIter iter;
+    gpointer key;
+    otf2_rank_t *rank;
+    const gchar *nodename;
+    gchar *name;
+    guint64 *members;
+    guint32 nodes = 1;
+    guint32 node;
+    guint32 ctx;
+    guint i;
+
+    /* every location needs its (empty) local definitions */
+    otf2_check(os, OTF2_Archive_OpenDefFiles(os->archive));
+    for (i = 0; i < ranks->len; i++) {
+        rank = (otf2_rank_t *)g_ptr_array_index(ranks, i);
+        local = OTF2_Archive_GetDefWriter(os->archive, rank->vpid);
+        if (local) {
+            otf2_check(os, OTF2_Archive_CloseDefWriter(os->archive, local));
+        }
+    }
+    otf2_check(os, OTF2_Archive_CloseDefFiles(os->archive));
+
+    defs = OTF2_Archive_GetGlobalDefWriter(os->archive);
+    if (!defs) {
+        os->errors++;
+        return;
+    }
+#if OTF2_VERSION_MAJOR >= 3
+    otf2_check(os, OTF2_GlobalDefWriter_WriteClockProperties(defs,
+                1000000000, os->first, os->latest - os->first,
+                OTF2_UNDEFINED_TIMESTAMP));
+#else
+    otf2_check(os, OTF2_GlobalDefWriter_WriteClockProperties(defs,
+                1000000000, os->first, os->latest - os->first));
+#endif
+
+    /* system tree: the capture, the nodes of the ranks */
+    otf2_check(os, OTF2_GlobalDefWriter_WriteString(defs, string++,
+                "capture"));
+    otf2_check(os, OTF2_GlobalDefWriter_WriteString(defs, string++,
+                "machine"));
+    otf2_check(os, OTF2_GlobalDefWriter_WriteString(defs, string++, "node"));
+    otf2_check(os, OTF2_GlobalDefWriter_WriteSystemTreeNode(defs, 0, 0, 1,
+                OTF2_UNDEFINED_SYSTEM_TREE_NODE));
+    node_refs = g_hash_table_new(g_str_hash, g_str_equal);
+    for (i = 0; i < ranks->len; i++) {
+        rank = (otf2_rank_t *)g_ptr_array_index(ranks, i);
+        nodename = rank->addr ? (const gchar *)g_hash_table_lookup(os->nodes,
+                rank->addr) : NULL;
+        node = 0;
+        if (nodename) {
+            node = GPOINTER_TO_UINT(g_hash_table_lookup(node_refs, nodename));
+            if (0 == node) {
+                node = nodes++;
+                g_hash_table_insert(node_refs, (gpointer)nodename,
+                        GUINT_TO_POINTER(node));
+                otf2_check(os, OTF2_GlobalDefWriter_WriteString(defs, string,
+                            nodename));
+                otf2_check(os, OTF2_GlobalDefWriter_WriteSystemTreeNode(defs,
+                            node, string++, 2, 0));
+            }
+        }
+
+        name = g_strdup_printf("rank %u", rank->vpid);
+        otf2_check(os, OTF2_GlobalDefWriter_WriteString(defs, string, name));
+        g_free(name);
+#if OTF2_VERSION_MAJOR >= 3
+        otf2_check(os, OTF2_GlobalDefWriter_WriteLocationGroup(defs,
+                    rank->vpid, string, OTF2_LOCATION_GROUP_TYPE_PROCESS, node,
+                    OTF2_UNDEFINED_LOCATION_GROUP));
+#else
+        otf2_check(os, OTF2_GlobalDefWriter_WriteLocationGroup(defs,
+                    rank->vpid, string, OTF2_LOCATION_GROUP_TYPE_PROCESS,
+                    node));
+#endif
+        otf2_check(os, OTF2_GlobalDefWriter_WriteLocation(defs, rank->vpid,
+                    string++, OTF2_LOCATION_TYPE_CPU_THREAD, rank->events,
+                    rank->vpid));
+    }
+    g_hash_table_destroy(node_refs);
+
+    /* the ranks 0 .. n - 1 are the locations 0 .. n - 1 */
+    members = g_new(guint64, ranks->len);
+    for (i = 0; i < ranks->len; i++) {
+        members[i] = i;
+    }
+    otf2_check(os, OTF2_GlobalDefWriter_WriteString(defs, string, ""));
+    otf2_check(os, OTF2_GlobalDefWriter_WriteGroup(defs, 0, string,
+                OTF2_GROUP_TYPE_COMM_LOCATIONS, OTF2_PARADIGM_MPI,
+                OTF2_GROUP_FLAG_NONE, ranks->len, members));
+    otf2_check(os, OTF2_GlobalDefWriter_WriteGroup(defs, 1, string++,
+                OTF2_GROUP_TYPE_COMM_GROUP, OTF2_PARADIGM_MPI,
+                OTF2_GROUP_FLAG_NONE, ranks->len, members));
+    g_free(members);
+
+    g_hash_table_iter_init(&iter, os->comms);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        ctx = GPOINTER_TO_UINT(key);
+        if (0 == ctx) {
+            name = g_strdup("MPI_COMM_WORLD");
+        } else {
+            name = g_strdup_printf("Comm %u", ctx);
+        }
+        otf2_check(os, OTF2_GlobalDefWriter_WriteString(defs, string, name));
+        g_free(name);
+#if OTF2_VERSION_MAJOR >= 3
+        otf2_check(os, OTF2_GlobalDefWriter_WriteComm(defs, ctx, string++, 1,
+                    OTF2_UNDEFINED_COMM, OTF2_COMM_FLAG_NONE));
+#else
+        otf2_check(os, OTF2_GlobalDefWriter_WriteComm(defs, ctx, string++, 1,
+                    OTF2_UNDEFINED_COMM));
+#endif
+    }
+}
+
+static void
+otf2_draw(void *tapdata)
+{
+    otf2_t *os = (otf2_t *)tapdata;
+    GPtrArray *ranks;
+    GHashTableIter iter;
+    gpointer value;
+    otf2_rank_t *rank;
+    guint32 vpid;
+    guint32 max_vpid = 0;
+    guint unfinished;
+    guint i;
+
+    /* the ranks from 0 on, with the ones never seen */
+    g_hash_table_iter_init(&iter, os->ranks);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        max_vpid = MAX(max_vpid, ((otf2_rank_t *)value)->vpid);
+    }
+    for (vpid = 0; g_hash_table_size(os->ranks) && vpid < max_vpid; vpid++) {
+        otf2_rank(os, vpid);
+    }
+    ranks = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, os->ranks);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(ranks, value);
+    }
+    g_ptr_array_sort(ranks, otf2_vpid_cmp);
+
+    unfinished = g_hash_table_size(os->pending);
+    g_hash_table_remove_all(os->pending);
+    for (i = 0; i < ranks->len; i++) {
+        rank = (otf2_rank_t *)g_ptr_array_index(ranks, i);
+        otf2_close_coll(os, rank);
+        if (rank->writer) {
+            otf2_check(os, OTF2_Archive_CloseEvtWriter(os->archive,
+                        rank->writer));
+            rank->writer = NULL;
+        }
+    }
+    otf2_check(os, OTF2_Archive_CloseEvtFiles(os->archive));
+    otf2_write_defs(os, ranks);
+    otf2_check(os, OTF2_Archive_Close(os->archive));
+    os->archive = NULL;
+
+    printf("\n");
+    printf("=============================================================================================================\n");
+    printf("MPI OTF2 Export:\n");
+    printf("Filter: %s\n", os->filter ? os->filter : "");
+    printf("Exported to: %s%ctraces.otf2\n", os->dir, G_DIR_SEPARATOR);
+    if (os->errors) {
+        printf("OTF2 errors: %u, first: %s\n", os->errors,
+                os->error ? OTF2_Error_GetName(os->error) : "-");
+    }
+    printf("Job: %u, ranks: %u, nodes known: %u, communicators: %u\n",
+            os->jobid, ranks->len, g_hash_table_size(os->nodes),
+            g_hash_table_size(os->comms));
+    printf("Messages: %u, collectives (per rank): %u, rendezvous without end: %u\n",
+            os->messages, os->collectives, unfinished);
+    printf("Not exported: %u messages of unknown channels, other jobs or nonblocking collectives, %u rendezvous beyond %u in flight\n",
+            os->unknown, os->untracked, OTF2_MAX_PENDING);
+    printf("=============================================================================================================\n");
+
+    g_ptr_array_free(ranks, TRUE);
+}
+
+static void
+otf2_init(const char *opt_arg, void *userdata _U_)
+{
+    otf2_t *os;
+    const char *filter = NULL;
+    const char *dir = NULL;
+    const char *end = NULL;
+    GString *error_string;
+
+    if (!strncmp(opt_arg, "mpi,otf2,", 9)) {
+        dir = opt_arg + 9;
+        end = strchr(dir, ',');
+        if (end) {
+            filter = end + 1;
+        }
+    }
+    if (!dir || dir == end || '\0' == *dir) {
+        fprintf(stderr, "tshark: invalid \"-z mpi,otf2,<dir>[,<filter>]\" argument\n");
+        exit(1);
+    }
+
+    os = g_new0(otf2_t, 1);
+    os->dir = end ? g_strndup(dir, end - dir) : g_strdup(dir);
+    os->archive = OTF2_Archive_Open(os->dir, "traces", OTF2_FILEMODE_WRITE,
+            OTF2_EVT_CHUNK, OTF2_DEF_CHUNK, OTF2_SUBSTRATE_POSIX,
+            OTF2_COMPRESSION_NONE);
+    if (!os->archive) {
+        fprintf(stderr, "tshark: mpi,otf2: can't create the archive in %s\n",
+                os->dir);
+        exit(1);
+    }
+    otf2_check(os, OTF2_Archive_SetFlushCallbacks(os->archive,
+                &otf2_flush_callbacks, NULL));
+    otf2_check(os, OTF2_Archive_SetSerialCollectiveCallbacks(os->archive));
+    otf2_check(os, OTF2_Archive_SetCreator(os->archive, "tshark -z mpi,otf2"));
+    otf2_check(os, OTF2_Archive_OpenEvtFiles(os->archive));
+    if (os->errors) {
+        fprintf(stderr, "tshark: mpi,otf2: can't write the archive in %s: %s\n",
+                os->dir, OTF2_Error_GetName(os->error));
+        exit(1);
+    }
+
+    os->filter = filter ? g_strdup(filter) : NULL;
+    os->ranks = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+            NULL, otf2_free_rank);
+    os->comms = g_hash_table_new(g_direct_hash, g_direct_equal);
+    os->nodes = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, g_free);
+    os->pending = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+            NULL, g_free);
+
+    error_string = register_tap_listener("mpi", os, os->filter, 0,
+            otf2_reset, otf2_packet, otf2_draw);
+    if (error_string) {
+        OTF2_Archive_Close(os->archive);
+        g_hash_table_destroy(os->pending);
+        g_hash_table_destroy(os->nodes);
+        g_hash_table_destroy(os->comms);
+        g_hash_table_destroy(os->ranks);
+        g_free(os->filter);
+        g_free(os->dir);
+        g_free(os);
+        fprintf(stderr, "tshark: Couldn't register mpi,otf2 tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+#else /* HAVE_OTF2 */
+
+static void
+otf2_init(const char *opt_arg _U_, void *userdata _U_)
+{
+    fprintf(stderr, "tshark: mpi,otf2: the MPI plugin was built without OTF2\n");
+    exit(1);
+}
+
+#endif /* HAVE_OTF2 */
+
+void
+proto_register_mpi_otf2(void)
+{
+    register_stat_cmd_arg("mpi,otf2", otf2_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,464 @@
+/* tap-mpi-pattern.c
+ * Point-to-point communication patterns per phase for tshark
+ * (-z mpi,pattern)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Classifies the point-to-point messages (MATCH, RNDV, RGET with a tag
+ * >= 0) of every time window by the graph of the communicating ranks:
+ *
+ *   all-to-all     (almost) every rank sends to every other rank
+ *   master-worker  one rank takes part in (almost) every message
+ *   halo exchange  symmetric messages to a few neighbours; the rank
+ *                  offsets of the neighbours give the stencil, e.g.
+ *                  "+-1 +-8" is a 2D 5-point stencil on 8 columns
+ *   pairwise       symmetric messages to exactly one peer per rank
+ *   irregular      anything else
+ *
+ * Consecutive windows of the same pattern form a phase, every phase is
+ * shown with its messages, bytes and the time on wire of its rendezvous
+ * transfers. Only the edges of the current window are kept.
+ *
+ * The rank is the vpid of the process, i.e. the rank in MPI_COMM_WORLD of
+ * a single job. It is known from the rank pair channels (mpi.channel.*),
+ * messages of connections without a captured sync handshake are only
+ * counted.
+ *
+ * Usage: -z mpi,pattern[,window[,filter]]   (window in ms, default 100)
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+#define PATTERN_DEFAULT_WINDOW 100.0
+/* rank offsets shown for a halo exchange */
+#define PATTERN_MAX_OFFSETS 8
+/* a halo exchange has this many neighbours per rank at most (3D 27-point) */
+#define PATTERN_MAX_NEIGHBOURS 26
+
+typedef enum {
+    PATTERN_NONE,
+    PATTERN_ALLTOALL,
+    PATTERN_MASTER_WORKER,
+    PATTERN_HALO,
+    PATTERN_PAIRWISE,
+    PATTERN_IRREGULAR
+} pattern_kind_t;
+
+static const char *pattern_names[] = {
+    "none",
+    "all-to-all",
+    "master-worker",
+    "halo exchange",
+    "pairwise",
+    "irregular"
+};
+
+typedef struct _pattern_phase_t {
+    pattern_kind_t kind;
+    gchar detail[64];       /* hub or stencil */
+    gdouble start;          /* ms */
+    gdouble end;
+    guint windows;
+    guint32 next;           /* the window after the phase */
+    guint ranks;            /* maximum of the windows */
+    guint edges;
+    guint msgs;
+    guint64 bytes;
+    gdouble wire;           /* ms of the rendezvous transfers */
+} pattern_phase_t;
+
+typedef struct _pattern_t {
+    char *filter;
+    gdouble window;         /* ms */
+    nstime_t t0;
+    guint unknown;
+    /* the current window */
+    guint32 index;
+    GHashTable *edges;      /* src << 32 | dst -> guint msgs */
+    guint msgs;
+    guint64 bytes;
+    gdouble wire;
+    GArray *phases;         /* pattern_phase_t */
+} pattern_t;
+
+static void
+pattern_reset(void *tapdata)
+{
+    pattern_t *ps = (pattern_t *)tapdata;
+
+    g_hash_table_remove_all(ps->edges);
+    g_array_set_size(ps->phases, 0);
+    ps->unknown = 0;
+    ps->index = 0;
+    ps->msgs = 0;
+    ps->bytes = 0;
+    ps->wire = 0;
+    nstime_set_unset(&ps->t0);
+}
+
+typedef struct _pattern_rank_t {
+    guint peers;            /* in or out */
+    guint msgs;
+} pattern_rank_t;
+
+static gint
+pattern_offset_cmp(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    GHashTable *offsets = (GHashTable *)user_data;
+    guint ca = GPOINTER_TO_UINT(g_hash_table_lookup(offsets, a));
+    guint cb = GPOINTER_TO_UINT(g_hash_table_lookup(offsets, b));
+
+    if (ca != cb) {
+        return ca > cb ? -1 : 1;
+    }
+    return GPOINTER_TO_UINT(a) < GPOINTER_TO_UINT(b) ? -1 : 1;
+}
+
+/* classify the edges of the current window */
+static pattern_kind_t
+pattern_classify(pattern_t *ps, gchar *detail, gulong len, guint *nranks)
+{
+    GHashTable *ranks;
+    GHashTable *offsets;
+    GHashTableIter iter;
+    gpointer key, value;
+    GList *list, *l;
+    pattern_rank_t *rank;
+    guint64 edge;
+    guint64 reverse;
+    guint32 src, dst, offset, hub = 0;
+    guint n, e, symmetric = 0, hub_peers = 0, hub_msgs = 0, max_peers = 0;
+    guint one_peer = 0, covered = 0, shown = 0;
+    gulong pos;
+    pattern_kind_t kind;
+
+    detail[0] = '\0';
+    e = g_hash_table_size(ps->edges);
+    if (0 == e) {
+        *nranks = 0;
+        return PATTERN_NONE;
+    }
+
+    ranks = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    offsets = g_hash_table_new(g_direct_hash, g_direct_equal);
+    g_hash_table_iter_init(&iter, ps->edges);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        edge = *(guint64 *)key;
+        src = (guint32)(edge >> 32);
+        dst = (guint32)edge;
+        reverse = ((guint64)dst << 32) | src;
+        if (g_hash_table_lookup(ps->edges, &reverse)) {
+            symmetric++;
+        }
+        rank = (pattern_rank_t *)g_hash_table_lookup(ranks, GUINT_TO_POINTER(src));
+        if (!rank) {
+            rank = g_new0(pattern_rank_t, 1);
+            g_hash_table_insert(ranks, GUINT_TO_POINTER(src), rank);
+        }
+        rank->peers++;
+        rank->msgs += GPOINTER_TO_UINT(value);
+        rank = (pattern_rank_t *)g_hash_table_lookup(ranks, GUINT_TO_POINTER(dst));
+        if (!rank) {
+            rank = g_new0(pattern_rank_t, 1);
+            g_hash_table_insert(ranks, GUINT_TO_POINTER(dst), rank);
+        }
+        rank->peers++;
+        rank->msgs += GPOINTER_TO_UINT(value);
+    }
+    n = g_hash_table_size(ranks);
+    *nranks = n;
+
+    g_hash_table_iter_init(&iter, ranks);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        rank = (pattern_rank_t *)value;
+        if (rank->msgs > hub_msgs) {
+            hub = GPOINTER_TO_UINT(key);
+            hub_msgs = rank->msgs;
+            hub_peers = rank->peers;
+        }
+        max_peers = MAX(max_peers, rank->peers);
+        /* a symmetric peer counts twice */
+        if (2 >= rank->peers) {
+            one_peer++;
+        }
+    }
+
+    if (3 <= n && 10 * e >= 8 * n * (n - 1)) {
+        kind = PATTERN_ALLTOALL;
+    } else if (3 <= n && 10 * hub_msgs >= 9 * ps->msgs &&
+            4 * hub_peers >= 3 * (n - 1)) {
+        kind = PATTERN_MASTER_WORKER;
+        g_snprintf(detail, len, "hub rank %u", hub);
+    } else if (10 * symmetric >= 8 * e && one_peer == n) {
+        kind = PATTERN_PAIRWISE;
+    } else if (10 * symmetric >= 8 * e &&
+            max_peers <= 2 * PATTERN_MAX_NEIGHBOURS) {
+        kind = PATTERN_HALO;
+    } else {
+        kind = PATTERN_IRREGULAR;
+    }
+
+    if (PATTERN_HALO == kind) {
+        /* the offsets of the neighbours, wrapping around for periodic
+         * boundaries, until 90% of the edges are covered */
+        g_hash_table_iter_init(&iter, ps->edges);
+        while (g_hash_table_iter_next(&iter, &key, NULL)) {
+            edge = *(guint64 *)key;
+            src = (guint32)(edge >> 32);
+            dst = (guint32)edge;
+            offset = src > dst ? src - dst : dst - src;
+            if (offset > n / 2 && n > offset) {
+                offset = n - offset;
+            }
+            g_hash_table_insert(offsets, GUINT_TO_POINTER(offset),
+                    GUINT_TO_POINTER(GPOINTER_TO_UINT(
+                            g_hash_table_lookup(offsets,
+                                GUINT_TO_POINTER(offset))) + 1));
+        }
+        list = g_hash_table_get_keys(offsets);
+        list = g_list_sort_with_data(list, pattern_offset_cmp, offsets);
+        pos = 0;
+        for (l = list; l && 10 * covered < 9 * e &&
+                shown < PATTERN_MAX_OFFSETS; l = l->next) {
+            covered += GPOINTER_TO_UINT(g_hash_table_lookup(offsets, l->data));
+            pos += g_snprintf(detail + pos, len - pos, "%s+-%u",
+                    shown ? " " : "", GPOINTER_TO_UINT(l->data));
+            if (pos >= len) {
+                break;
+            }
+            shown++;
+        }
+        g_list_free(list);
+        if (pos < len) {
+            switch (shown) {
+                case 1:
+                    g_snprintf(detail + pos, len - pos, " (1D 3-point)");
+                    break;
+                case 2:
+                    g_snprintf(detail + pos, len - pos, " (2D 5-point)");
+                    break;
+                case 3:
+                    g_snprintf(detail + pos, len - pos, " (3D 7-point)");
+                    break;
+                case 4:
+                    g_snprintf(detail + pos, len - pos, " (2D 9-point)");
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    g_hash_table_destroy(offsets);
+    g_hash_table_destroy(ranks);
+    return kind;
+}
+
+/* add the current window to the phases */
+static void
+pattern_close_window(pattern_t *ps)
+{
+    pattern_phase_t phase;
+    pattern_phase_t *last;
+    pattern_kind_t kind;
+    gchar detail[64];
+    guint n;
+
+    kind = pattern_classify(ps, detail, sizeof(detail), &n);
+    last = ps->phases->len ? &g_array_index(ps->phases, pattern_phase_t,
+            ps->phases->len - 1) : NULL;
+    if (last && last->kind == kind && !strcmp(last->detail, detail) &&
+            last->next == ps->index) {
+        last->end += ps->window;
+        last->windows++;
+        last->next++;
+        last->ranks = MAX(last->ranks, n);
+        last->edges = MAX(last->edges, g_hash_table_size(ps->edges));
+        last->msgs += ps->msgs;
+        last->bytes += ps->bytes;
+        last->wire += ps->wire;
+    } else if (PATTERN_NONE != kind || 0 < ps->wire) {
+        memset(&phase, 0, sizeof(phase));
+        phase.kind = kind;
+        g_strlcpy(phase.detail, detail, sizeof(phase.detail));
+        phase.start = ps->index * ps->window;
+        phase.end = phase.start + ps->window;
+        phase.windows = 1;
+        phase.next = ps->index + 1;
+        phase.ranks = n;
+        phase.edges = g_hash_table_size(ps->edges);
+        phase.msgs = ps->msgs;
+        phase.bytes = ps->bytes;
+        phase.wire = ps->wire;
+        g_array_append_val(ps->phases, phase);
+    }
+
+    g_hash_table_remove_all(ps->edges);
+    ps->msgs = 0;
+    ps->bytes = 0;
+    ps->wire = 0;
+}
+
+static int
+pattern_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt _U_, const void *data)
+{
+    pattern_t *ps = (pattern_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    nstime_t delta;
+    guint32 index;
+    guint64 edge;
+    guint msgs;
+
+    if (MPI_PDU_BTL != mpi_tap_info->kind) {
+        return 0;
+    }
+    if (nstime_is_unset(&ps->t0)) {
+        ps->t0 = pinfo->fd->abs_ts;
+    }
+    nstime_delta(&delta, &pinfo->fd->abs_ts, &ps->t0);
+    index = (guint32)(nstime_to_msec(&delta) / ps->window);
+    if (index != ps->index) {
+        pattern_close_window(ps);
+        ps->index = index;
+    }
+
+    if (mpi_tap_info->xfer_done) {
+        ps->wire += nstime_to_msec(&mpi_tap_info->xfer_duration);
+    }
+    if (!mpi_tap_info->matched || 0 > mpi_tap_info->match_tag) {
+        return 0;
+    }
+    if (0 == mpi_tap_info->channel) {
+        ps->unknown++;
+        return 0;
+    }
+
+    edge = ((guint64)mpi_tap_info->vpid << 32) | mpi_tap_info->vpid_dst;
+    msgs = GPOINTER_TO_UINT(g_hash_table_lookup(ps->edges, &edge));
+    g_hash_table_insert(ps->edges, g_memdup(&edge, sizeof(edge)),
+            GUINT_TO_POINTER(msgs + 1));
+    ps->msgs++;
+    ps->bytes += MPI_PML_OB1_HDR_TYPE_MATCH == mpi_tap_info->base ?
+        mpi_tap_info->payload : mpi_tap_info->msg_len;
+    return 1;
+}
+
+static void
+pattern_draw(void *tapdata)
+{
+    pattern_t *ps = (pattern_t *)tapdata;
+    pattern_phase_t *phase;
+    guint i;
+
+    if (g_hash_table_size(ps->edges) || 0 < ps->wire) {
+        pattern_close_window(ps);
+    }
+
+    printf("\n");
+    printf("=============================================================================================================\n");
+    printf("MPI Communication Patterns:\n");
+    printf("Filter: %s\n", ps->filter ? ps->filter : "");
+    printf("Window: %.3f ms, phases: %u, messages of unknown channels: %u\n",
+            ps->window, ps->phases->len, ps->unknown);
+    printf("Times in milliseconds since the first BTL PDU, wire: time on wire of the rendezvous transfers\n");
+    printf("-------------------------------------------------------------------------------------------------------------\n");
+    printf("%12s %12s %-14s %6s %6s %8s %14s %10s  %s\n", "Start", "End",
+            "Pattern", "Ranks", "Edges", "Msgs", "Bytes", "Wire", "Detail");
+    for (i = 0; i < ps->phases->len; i++) {
+        phase = &g_array_index(ps->phases, pattern_phase_t, i);
+        printf("%12.3f %12.3f %-14s %6u %6u %8u %14" G_GINT64_MODIFIER "u"
+                " %10.3f  %s\n", phase->start, phase->end,
+                pattern_names[phase->kind], phase->ranks, phase->edges,
+                phase->msgs, phase->bytes, phase->wire, phase->detail);
+    }
+    printf("=============================================================================================================\n");
+}
+
+static void
+pattern_init(const char *opt_arg, void *userdata _U_)
+{
+    pattern_t *ps;
+    const char *filter = NULL;
+    gdouble window = PATTERN_DEFAULT_WINDOW;
+    GString *error_string;
+    int pos = 0;
+
+    if (sscanf(opt_arg, "mpi,pattern,%lf%n", &window, &pos) == 1) {
+        if (',' == opt_arg[pos]) {
+            filter = opt_arg + pos + 1;
+        }
+    }
+    if (0 >= window) {
+        fprintf(stderr, "tshark: invalid \"-z mpi,pattern,<window>[,<filter>]\" window\n");
+        exit(1);
+    }
+
+    ps = g_new0(pattern_t, 1);
+    ps->filter = filter ? g_strdup(filter) : NULL;
+    ps->window = window;
+    ps->edges = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            g_free, NULL);
+    ps->phases = g_array_new(FALSE, FALSE, sizeof(pattern_phase_t));
+    nstime_set_unset(&ps->t0);
+
+    error_string = register_tap_listener("mpi", ps, ps->filter, 0,
+            pattern_reset, pattern_packet, pattern_draw);
+    if (error_string) {
+        g_array_free(ps->phases, TRUE);
+        g_hash_table_destroy(ps->edges);
+        g_free(ps->filter);
+        g_free(ps);
+        fprintf(stderr, "tshark: Couldn't register mpi,pattern tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_pattern(void)
+{
+    register_stat_cmd_arg("mpi,pattern", pattern_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,324 @@
+/* tap-mpi-pipeline.c
+ * Rendezvous pipeline depth, fragment sizes and stalls for tshark
+ * (-z mpi,pipeline)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Uses the rendezvous transfers correlated by the dissector (mpi.xfer.*)
+ * to show
+ *
+ *   every transfer with its FRAGs or PUTs, the maximum and average number
+ *   of PUTs in flight, the fragment size schedule (run length encoded, e.g.
+ *   "65536x4 131072x12") and its stalls with the time lost in them
+ *   how often a PUT was issued at a depth, over all transfers
+ *   the fragment sizes over all transfers
+ *
+ * The depth is only known for PUTs, which are finished by a FIN. FRAGs are
+ * not acknowledged by the PML, for them only the gaps are shown. A stall
+ * is a gap longer than the "pipeline_stall" preference of the dissector or
+ * a PUT issued while no other one was in flight.
+ *
+ * Usage: -z mpi,pipeline[,filter]
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+/* depths from this on are counted together */
+#define PIPELINE_MAX_DEPTH 16
+/* schedule runs shown per transfer */
+#define PIPELINE_MAX_RUNS 4
+
+typedef struct _pipeline_run_t {
+    guint64 size;
+    guint count;
+} pipeline_run_t;
+
+typedef struct _pipeline_xfer_t {
+    guint32 rndv_frame;
+    guint64 msg_len;        /* 0 until the end is seen */
+    guint8 base;            /* FRAG or PUT */
+    guint frags;
+    guint max_depth;
+    guint depth_sum;        /* at the PUTs */
+    guint stalls;
+    gdouble stall_time;     /* ms */
+    gdouble duration;       /* ms, negative while not finished */
+    GArray *runs;           /* pipeline_run_t */
+} pipeline_xfer_t;
+
+typedef struct _pipeline_t {
+    char *filter;
+    GHashTable *xfers;      /* rndv frame -> pipeline_xfer_t */
+    GPtrArray *order;       /* pipeline_xfer_t in capture order */
+    guint depths[PIPELINE_MAX_DEPTH + 1];
+    GHashTable *sizes;      /* fragment size -> count */
+} pipeline_t;
+
+static void
+pipeline_free_xfer(gpointer data)
+{
+    pipeline_xfer_t *xfer = (pipeline_xfer_t *)data;
+
+    g_array_free(xfer->runs, TRUE);
+    g_free(xfer);
+}
+
+static void
+pipeline_reset(void *tapdata)
+{
+    pipeline_t *ps = (pipeline_t *)tapdata;
+
+    g_ptr_array_set_size(ps->order, 0);
+    g_hash_table_remove_all(ps->xfers);
+    g_hash_table_remove_all(ps->sizes);
+    memset(ps->depths, 0, sizeof(ps->depths));
+}
+
+static int
+pipeline_packet(void *tapdata, packet_info *pinfo _U_, epan_dissect_t *edt _U_, const void *data)
+{
+    pipeline_t *ps = (pipeline_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    pipeline_xfer_t *xfer;
+    pipeline_run_t run;
+    pipeline_run_t *last;
+    guint64 size;
+    guint64 *key;
+    guint *count;
+
+    if (MPI_PDU_BTL != mpi_tap_info->kind || 0 == mpi_tap_info->xfer_rndv_in) {
+        return 0;
+    }
+
+    xfer = (pipeline_xfer_t *)g_hash_table_lookup(ps->xfers,
+            GUINT_TO_POINTER(mpi_tap_info->xfer_rndv_in));
+    if (!xfer) {
+        xfer = g_new0(pipeline_xfer_t, 1);
+        xfer->rndv_frame = mpi_tap_info->xfer_rndv_in;
+        xfer->duration = -1;
+        xfer->runs = g_array_new(FALSE, FALSE, sizeof(pipeline_run_t));
+        g_hash_table_insert(ps->xfers,
+                GUINT_TO_POINTER(xfer->rndv_frame), xfer);
+        g_ptr_array_add(ps->order, xfer);
+    }
+
+    if (mpi_tap_info->xfer_stall) {
+        xfer->stalls++;
+        xfer->stall_time += nstime_to_msec(&mpi_tap_info->xfer_gap);
+    }
+    if (mpi_tap_info->xfer_done) {
+        xfer->msg_len = mpi_tap_info->msg_len;
+        xfer->duration = nstime_to_msec(&mpi_tap_info->xfer_duration);
+    }
+    if (0 == mpi_tap_info->xfer_index) {
+        return 1;
+    }
+
+    xfer->base = mpi_tap_info->base;
+    xfer->frags++;
+    if (MPI_PML_OB1_HDR_TYPE_PUT == mpi_tap_info->base) {
+        size = mpi_tap_info->seg_len;
+        xfer->max_depth = MAX(xfer->max_depth, mpi_tap_info->xfer_depth);
+        xfer->depth_sum += mpi_tap_info->xfer_depth;
+        ps->depths[MIN(mpi_tap_info->xfer_depth, PIPELINE_MAX_DEPTH)]++;
+    } else {
+        size = mpi_tap_info->payload;
+    }
+
+    last = xfer->runs->len ? &g_array_index(xfer->runs, pipeline_run_t,
+            xfer->runs->len - 1) : NULL;
+    if (last && last->size == size) {
+        last->count++;
+    } else {
+        run.size = size;
+        run.count = 1;
+        g_array_append_val(xfer->runs, run);
+    }
+
+    count = (guint *)g_hash_table_lookup(ps->sizes, &size);
+    if (!count) {
+        key = g_new(guint64, 1);
+        *key = size;
+        count = g_new0(guint, 1);
+        g_hash_table_insert(ps->sizes, key, count);
+    }
+    (*count)++;
+    return 1;
+}
+
+static gint
+pipeline_size_cmp(gconstpointer a, gconstpointer b)
+{
+    guint64 sa = **(const guint64 * const *)a;
+    guint64 sb = **(const guint64 * const *)b;
+
+    return sa < sb ? -1 : (sa > sb);
+}
+
+static void
+pipeline_draw(void *tapdata)
+{
+    pipeline_t *ps = (pipeline_t *)tapdata;
+    pipeline_xfer_t *xfer;
+    pipeline_run_t *run;
+    GPtrArray *sizes;
+    GHashTableIter iter;
+    gpointer key;
+    guint stalls = 0;
+    gdouble stall_time = 0;
+    guint i, j;
+
+    for (i = 0; i < ps->order->len; i++) {
+        xfer = (pipeline_xfer_t *)g_ptr_array_index(ps->order, i);
+        stalls += xfer->stalls;
+        stall_time += xfer->stall_time;
+    }
+
+    printf("\n");
+    printf("=============================================================================================================\n");
+    printf("MPI Rendezvous Pipeline:\n");
+    printf("Filter: %s\n", ps->filter ? ps->filter : "");
+    printf("Transfers: %u, stalls: %u (%.3f ms)\n", ps->order->len, stalls,
+            stall_time);
+    printf("Times in milliseconds, depth: PUTs in flight\n");
+    printf("-------------------------------------------------------------------------------------------------------------\n");
+    printf("%8s %12s %-5s %6s %5s %6s %6s %10s %10s  %s\n", "RNDV in",
+            "Length", "Via", "Frags", "Max", "Avg", "Stalls", "Stalled",
+            "Duration", "Schedule");
+    for (i = 0; i < ps->order->len; i++) {
+        xfer = (pipeline_xfer_t *)g_ptr_array_index(ps->order, i);
+        printf("%8u", xfer->rndv_frame);
+        if (xfer->msg_len) {
+            printf(" %12" G_GINT64_MODIFIER "u", xfer->msg_len);
+        } else {
+            printf(" %12s", "-");
+        }
+        printf(" %-5s %6u", 0 == xfer->frags ? "-" :
+                MPI_PML_OB1_HDR_TYPE_PUT == xfer->base ? "PUT" : "FRAG",
+                xfer->frags);
+        if (MPI_PML_OB1_HDR_TYPE_PUT == xfer->base) {
+            printf(" %5u %6.1f", xfer->max_depth,
+                    (gdouble)xfer->depth_sum / xfer->frags);
+        } else {
+            printf(" %5s %6s", "-", "-");
+        }
+        printf(" %6u %10.3f", xfer->stalls, xfer->stall_time);
+        if (0 <= xfer->duration) {
+            printf(" %10.3f ", xfer->duration);
+        } else {
+            printf(" %10s ", "-");
+        }
+        for (j = 0; j < xfer->runs->len && j < PIPELINE_MAX_RUNS; j++) {
+            run = &g_array_index(xfer->runs, pipeline_run_t, j);
+            printf(" %" G_GINT64_MODIFIER "ux%u", run->size, run->count);
+        }
+        printf("%s\n", xfer->runs->len > PIPELINE_MAX_RUNS ? " ..." : "");
+    }
+
+    printf("-------------------------------------------------------------------------------------------------------------\n");
+    printf("PUTs issued per depth (including the new PUT)\n");
+    for (i = 0; i <= PIPELINE_MAX_DEPTH; i++) {
+        if (ps->depths[i]) {
+            printf("%5u%s %10u\n", i, PIPELINE_MAX_DEPTH == i ? "+" : " ",
+                    ps->depths[i]);
+        }
+    }
+
+    printf("-------------------------------------------------------------------------------------------------------------\n");
+    printf("Fragment sizes\n");
+    sizes = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, ps->sizes);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        g_ptr_array_add(sizes, key);
+    }
+    g_ptr_array_sort(sizes, pipeline_size_cmp);
+    for (i = 0; i < sizes->len; i++) {
+        key = g_ptr_array_index(sizes, i);
+        printf("%12" G_GINT64_MODIFIER "u %10u\n", *(guint64 *)key,
+                *(guint *)g_hash_table_lookup(ps->sizes, key));
+    }
+    g_ptr_array_free(sizes, TRUE);
+    printf("=============================================================================================================\n");
+}
+
+static void
+pipeline_init(const char *opt_arg, void *userdata _U_)
+{
+    pipeline_t *ps;
+    const char *filter = NULL;
+    GString *error_string;
+
+    if (!strncmp(opt_arg, "mpi,pipeline,", 13)) {
+        filter = opt_arg + 13;
+    }
+
+    ps = g_new0(pipeline_t, 1);
+    ps->filter = filter ? g_strdup(filter) : NULL;
+    ps->xfers = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+            NULL, pipeline_free_xfer);
+    ps->order = g_ptr_array_new();
+    ps->sizes = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            g_free, g_free);
+
+    error_string = register_tap_listener("mpi", ps, ps->filter, 0,
+            pipeline_reset, pipeline_packet, pipeline_draw);
+    if (error_string) {
+        g_hash_table_destroy(ps->sizes);
+        g_ptr_array_free(ps->order, TRUE);
+        g_hash_table_destroy(ps->xfers);
+        g_free(ps->filter);
+        g_free(ps);
+        fprintf(stderr, "tshark: Couldn't register mpi,pipeline tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_pipeline(void)
+{
+    register_stat_cmd_arg("mpi,pipeline", pipeline_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
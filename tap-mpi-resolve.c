@@ -0,0 +1,400 @@
+/* tap-mpi-resolve.c
+ * Single pass resolution of the MPI request/response links for tshark
+ * (-z mpi,resolve)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The forward references of the dissector (mpi.response_in, the end of a
+ * transfer) are only known in the second pass (tshark -2). This report
+ * prints them while the capture is read in a single pass, one line per
+ * frame waiting for its partner:
+ *
+ *   sync  response-in  the sync response of a sync request
+ *   rndv  ack-in       the ACK of a RNDV, or its first PUT: the receiver
+ *                      answers with PUTs when it writes the data itself
+ *   rget  fin-in       the FIN of a RGET
+ *   put   fin-in       the FIN of a PUT
+ *
+ * A descriptor is a pointer of the process that registered it, so the
+ * PUTs and RGETs wait by the descriptor and its owner (mpi.xfer.*).
+ *
+ * The waiting frames are kept in frame order and printed as soon as the
+ * first one is resolved, or without partner once it waited longer than
+ * the window (or more than RESOLVE_MAX_OPEN frames wait). Use it with -q
+ * to keep the lines apart from the packet list.
+ *
+ * Usage: -z mpi,resolve[,window[,filter]]   (window in ms, default 1000)
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+#define RESOLVE_DEFAULT_WINDOW 1000.0
+/* waiting frames at most */
+#define RESOLVE_MAX_OPEN 65536
+
+typedef enum {
+    RESOLVE_SYNC,
+    RESOLVE_RNDV,
+    RESOLVE_RGET,
+    RESOLVE_PUT,
+    RESOLVE_KINDS
+} resolve_kind_t;
+
+static const char *resolve_names[RESOLVE_KINDS][2] = {
+    { "sync", "response-in" },
+    { "rndv", "ack-in" },
+    { "rget", "fin-in" },
+    { "put", "fin-in" }
+};
+
+typedef struct _resolve_des_t {
+    guint64 des;
+    guint32 owner;          /* des_owner of the tap data */
+} resolve_des_t;
+
+typedef struct _resolve_wait_t {
+    resolve_kind_t kind;
+    guint32 frame;
+    nstime_t time;
+    resolve_des_t des;      /* RGET, PUT */
+    guint32 partner;        /* 0 while waiting */
+    nstime_t delta;
+} resolve_wait_t;
+
+typedef struct _resolve_t {
+    char *filter;
+    gdouble window;         /* ms */
+    GQueue *waiting;        /* resolve_wait_t by frame */
+    GHashTable *frames;     /* request or RNDV frame -> resolve_wait_t */
+    GHashTable *dess;       /* resolve_des_t -> resolve_wait_t */
+    gboolean header;
+    guint resolved[RESOLVE_KINDS];
+    guint expired[RESOLVE_KINDS];
+    guint overflow;
+} resolve_t;
+
+static guint
+resolve_des_hash(gconstpointer v)
+{
+    const resolve_des_t *key = (const resolve_des_t *)v;
+
+    return g_int64_hash(&key->des) ^ key->owner;
+}
+
+static gboolean
+resolve_des_equal(gconstpointer v, gconstpointer v2)
+{
+    const resolve_des_t *key1 = (const resolve_des_t *)v;
+    const resolve_des_t *key2 = (const resolve_des_t *)v2;
+
+    return key1->des == key2->des && key1->owner == key2->owner;
+}
+
+static void
+resolve_free_wait(gpointer data, gpointer user_data _U_)
+{
+    g_free(data);
+}
+
+static void
+resolve_print(resolve_t *rs, resolve_wait_t *wait, const char *why)
+{
+    if (!rs->header) {
+        rs->header = TRUE;
+        printf("\n");
+        printf("MPI Forward References (window %.3f ms):\n", rs->window);
+        printf("%10s %-5s %-12s %10s %12s\n", "Frame", "Kind", "Link",
+                "Partner", "Delta (ms)");
+    }
+    if (wait->partner) {
+        printf("%10u %-5s %-12s %10u %12.3f\n", wait->frame,
+                resolve_names[wait->kind][0], resolve_names[wait->kind][1],
+                wait->partner, nstime_to_msec(&wait->delta));
+    } else {
+        printf("%10u %-5s %-12s %10s %12s  (%s)\n", wait->frame,
+                resolve_names[wait->kind][0], resolve_names[wait->kind][1],
+                "-", "-", why);
+    }
+}
+
+/* forget a frame without its partner */
+static void
+resolve_forget(resolve_t *rs, resolve_wait_t *wait)
+{
+    if (RESOLVE_RGET == wait->kind || RESOLVE_PUT == wait->kind) {
+        if (g_hash_table_lookup(rs->dess, &wait->des) == wait) {
+            g_hash_table_remove(rs->dess, &wait->des);
+        }
+    } else if (g_hash_table_lookup(rs->frames,
+                GUINT_TO_POINTER(wait->frame)) == wait) {
+        g_hash_table_remove(rs->frames, GUINT_TO_POINTER(wait->frame));
+    }
+}
+
+/* print the resolved and expired frames from the head of the queue, all
+ * of them if "now" is NULL */
+static void
+resolve_emit(resolve_t *rs, const nstime_t *now)
+{
+    resolve_wait_t *wait;
+    nstime_t delta;
+    gboolean full;
+
+    while ((wait = (resolve_wait_t *)g_queue_peek_head(rs->waiting))) {
+        full = RESOLVE_MAX_OPEN < g_queue_get_length(rs->waiting);
+        if (!wait->partner) {
+            if (now) {
+                nstime_delta(&delta, now, &wait->time);
+                if (nstime_to_msec(&delta) <= rs->window && !full) {
+                    break;
+                }
+            }
+            resolve_forget(rs, wait);
+            rs->expired[wait->kind]++;
+            if (full) {
+                rs->overflow++;
+            }
+            resolve_print(rs, wait, !now ? "end of capture" :
+                    (full ? "too many waiting" : "none within the window"));
+        } else {
+            resolve_print(rs, wait, NULL);
+        }
+        g_queue_pop_head(rs->waiting);
+        g_free(wait);
+    }
+}
+
+static void
+resolve_wait(resolve_t *rs, packet_info *pinfo, resolve_kind_t kind, guint64 des, guint32 owner)
+{
+    resolve_wait_t *wait;
+
+    wait = g_new0(resolve_wait_t, 1);
+    wait->kind = kind;
+    wait->frame = pinfo->fd->num;
+    wait->time = pinfo->fd->abs_ts;
+    wait->des.des = des;
+    wait->des.owner = owner;
+    g_queue_push_tail(rs->waiting, wait);
+    if (RESOLVE_RGET == kind || RESOLVE_PUT == kind) {
+        g_hash_table_replace(rs->dess, &wait->des, wait);
+    } else {
+        g_hash_table_replace(rs->frames, GUINT_TO_POINTER(wait->frame), wait);
+    }
+}
+
+static void
+resolve_found(resolve_t *rs, packet_info *pinfo, resolve_wait_t *wait)
+{
+    resolve_forget(rs, wait);
+    wait->partner = pinfo->fd->num;
+    nstime_delta(&wait->delta, &pinfo->fd->abs_ts, &wait->time);
+    rs->resolved[wait->kind]++;
+}
+
+/* the ACK or the first PUT of a RNDV, the later ones find none waiting */
+static void
+resolve_rndv(resolve_t *rs, packet_info *pinfo, const mpi_tap_info_t *mpi_tap_info)
+{
+    resolve_wait_t *wait;
+
+    if (!mpi_tap_info->xfer_rndv_in) {
+        return;
+    }
+    wait = (resolve_wait_t *)g_hash_table_lookup(rs->frames,
+            GUINT_TO_POINTER(mpi_tap_info->xfer_rndv_in));
+    if (wait && RESOLVE_RNDV == wait->kind) {
+        resolve_found(rs, pinfo, wait);
+    }
+}
+
+static void
+resolve_reset(void *tapdata)
+{
+    resolve_t *rs = (resolve_t *)tapdata;
+
+    g_hash_table_remove_all(rs->frames);
+    g_hash_table_remove_all(rs->dess);
+    g_queue_foreach(rs->waiting, resolve_free_wait, NULL);
+    g_queue_clear(rs->waiting);
+    memset(rs->resolved, 0, sizeof(rs->resolved));
+    memset(rs->expired, 0, sizeof(rs->expired));
+    rs->overflow = 0;
+    rs->header = FALSE;
+}
+
+static int
+resolve_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt _U_, const void *data)
+{
+    resolve_t *rs = (resolve_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    resolve_wait_t *wait;
+    resolve_des_t des;
+
+    switch (mpi_tap_info->kind) {
+        case MPI_PDU_SYNC:
+            if (mpi_tap_info->is_request) {
+                resolve_wait(rs, pinfo, RESOLVE_SYNC, 0, 0);
+            } else if (mpi_tap_info->req_frame) {
+                wait = (resolve_wait_t *)g_hash_table_lookup(rs->frames,
+                        GUINT_TO_POINTER(mpi_tap_info->req_frame));
+                if (wait && RESOLVE_SYNC == wait->kind) {
+                    resolve_found(rs, pinfo, wait);
+                }
+            }
+            break;
+        case MPI_PDU_BTL:
+            switch (mpi_tap_info->base) {
+                case MPI_PML_BFO_HDR_TYPE_RNDV:
+                    resolve_wait(rs, pinfo, RESOLVE_RNDV, 0, 0);
+                    break;
+                case MPI_PML_OB1_HDR_TYPE_RGET:
+                case MPI_PML_OB1_HDR_TYPE_PUT:
+                    if (MPI_PML_OB1_HDR_TYPE_PUT == mpi_tap_info->base) {
+                        resolve_rndv(rs, pinfo, mpi_tap_info);
+                    }
+                    if (mpi_tap_info->des) {
+                        resolve_wait(rs, pinfo,
+                                MPI_PML_OB1_HDR_TYPE_PUT == mpi_tap_info->base ?
+                                RESOLVE_PUT : RESOLVE_RGET, mpi_tap_info->des,
+                                mpi_tap_info->des_owner);
+                    }
+                    break;
+                case MPI_PML_OB1_HDR_TYPE_ACK:
+                    resolve_rndv(rs, pinfo, mpi_tap_info);
+                    break;
+                case MPI_PML_OB1_HDR_TYPE_FIN:
+                    if (!mpi_tap_info->des) {
+                        break;
+                    }
+                    des.des = mpi_tap_info->des;
+                    des.owner = mpi_tap_info->des_owner;
+                    wait = (resolve_wait_t *)g_hash_table_lookup(rs->dess,
+                            &des);
+                    if (wait) {
+                        resolve_found(rs, pinfo, wait);
+                    }
+                    break;
+                default:
+                    break;
+            }
+            break;
+        default:
+            return 0;
+    }
+
+    resolve_emit(rs, &pinfo->fd->abs_ts);
+    return 0;
+}
+
+static void
+resolve_draw(void *tapdata)
+{
+    resolve_t *rs = (resolve_t *)tapdata;
+    guint i;
+
+    resolve_emit(rs, NULL);
+
+    printf("\n");
+    printf("=============================================================================================================\n");
+    printf("MPI Forward References:\n");
+    printf("Filter: %s\n", rs->filter ? rs->filter : "");
+    printf("Window: %.3f ms, frames dropped beyond %u waiting: %u\n",
+            rs->window, RESOLVE_MAX_OPEN, rs->overflow);
+    printf("-------------------------------------------------------------------------------------------------------------\n");
+    printf("%-5s %-12s %10s %10s\n", "Kind", "Link", "Resolved", "Without");
+    for (i = 0; i < RESOLVE_KINDS; i++) {
+        printf("%-5s %-12s %10u %10u\n", resolve_names[i][0],
+                resolve_names[i][1], rs->resolved[i], rs->expired[i]);
+    }
+    printf("=============================================================================================================\n");
+}
+
+static void
+resolve_init(const char *opt_arg, void *userdata _U_)
+{
+    resolve_t *rs;
+    const char *filter = NULL;
+    gdouble window = RESOLVE_DEFAULT_WINDOW;
+    GString *error_string;
+    int pos = 0;
+
+    if (sscanf(opt_arg, "mpi,resolve,%lf%n", &window, &pos) == 1) {
+        if (',' == opt_arg[pos]) {
+            filter = opt_arg + pos + 1;
+        }
+    }
+    if (0 >= window) {
+        fprintf(stderr, "tshark: invalid \"-z mpi,resolve,<window>[,<filter>]\" window\n");
+        exit(1);
+    }
+
+    rs = g_new0(resolve_t, 1);
+    rs->filter = filter ? g_strdup(filter) : NULL;
+    rs->window = window;
+    rs->waiting = g_queue_new();
+    rs->frames = g_hash_table_new(g_direct_hash, g_direct_equal);
+    rs->dess = g_hash_table_new(resolve_des_hash, resolve_des_equal);
+
+    error_string = register_tap_listener("mpi", rs, rs->filter, 0,
+            resolve_reset, resolve_packet, resolve_draw);
+    if (error_string) {
+        g_hash_table_destroy(rs->dess);
+        g_hash_table_destroy(rs->frames);
+        g_queue_free(rs->waiting);
+        g_free(rs->filter);
+        g_free(rs);
+        fprintf(stderr, "tshark: Couldn't register mpi,resolve tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_resolve(void)
+{
+    register_stat_cmd_arg("mpi,resolve", resolve_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,131 @@
+/* tap-mpi-state.c
+ * Size of the first pass state of the MPI dissector for tshark
+ * (-z mpi,state)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The lookup state the dissector keeps for the first pass (open rendezvous
+ * transfers and their descriptors, BTL and OOB connections, channels,
+ * XCASTs, heartbeat daemons, OOB message states, message keys) and the
+ * items dropped after the mpi.state_horizon preference in a single pass
+ * (mpi.single_pass, mpi_state_stats()).
+ *
+ * Usage: -z mpi,state
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+static int
+state_packet(void *tapdata _U_, packet_info *pinfo _U_, epan_dissect_t *edt _U_, const void *data _U_)
+{
+    /* the dissector keeps the counters */
+    return 0;
+}
+
+static void
+state_draw(void *tapdata _U_)
+{
+    mpi_state_stats_t stats;
+
+    mpi_state_stats(&stats);
+
+    printf("\n");
+    printf("=============================================================================================================\n");
+    printf("MPI Dissector State:\n");
+    printf("Passes: %s (mpi.single_pass)\n", stats.one_pass ? "one" : "two");
+    if (!stats.one_pass) {
+        printf("Horizon: off (frames are dissected again)\n");
+    } else if (stats.horizon) {
+        printf("Horizon: %u s, sweeps: %u\n", stats.horizon, stats.sweeps);
+    } else {
+        printf("Horizon: off (everything is kept)\n");
+    }
+    printf("-------------------------------------------------------------------------------------------------------------\n");
+    printf("%-28s %12s %12s\n", "", "Kept", "Evicted");
+    printf("%-28s %12u %12u\n", "Rendezvous transfers", stats.xfers,
+            stats.xfers_evicted);
+    printf("%-28s %12u %12u\n", "Transfer descriptors", stats.dess,
+            stats.dess_evicted);
+    printf("%-28s %12u %12u\n", "BTL connections", stats.conns,
+            stats.conns_evicted);
+    printf("%-28s %12u %12u\n", "Channels", stats.channels,
+            stats.channels_evicted);
+    printf("%-28s %12u %12u\n", "OOB connections", stats.oob_conns,
+            stats.oob_conns_evicted);
+    printf("%-28s %12u %12u\n", "XCASTs", stats.xcasts,
+            stats.xcasts_evicted);
+    printf("%-28s %12u %12u\n", "Heartbeat daemons", stats.hb_daemons,
+            stats.hb_daemons_evicted);
+    printf("%-28s %12u %12s\n", "OOB frame states", stats.oob_frames, "-");
+    printf("%-28s %12u %12u\n", "Message keys", stats.keys,
+            stats.keys_evicted);
+    printf("=============================================================================================================\n");
+}
+
+static void
+state_init(const char *opt_arg, void *userdata _U_)
+{
+    GString *error_string;
+
+    if (0 != strcmp(opt_arg, "mpi,state")) {
+        fprintf(stderr, "tshark: invalid \"-z mpi,state\" argument\n");
+        exit(1);
+    }
+
+    error_string = register_tap_listener("mpi", NULL, NULL, TL_REQUIRES_NOTHING,
+            NULL, state_packet, state_draw);
+    if (error_string) {
+        fprintf(stderr, "tshark: Couldn't register mpi,state tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_state(void)
+{
+    register_stat_cmd_arg("mpi,state", state_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
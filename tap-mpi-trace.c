@@ -0,0 +1,537 @@
+/* tap-mpi-trace.c
+ * Trace Event JSON export of MPI messages and collectives for tshark
+ * (-z mpi,trace)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Writes the BTL messages as a timeline in the Trace Event JSON format
+ * opened by Perfetto (ui.perfetto.dev) and chrome://tracing:
+ *
+ *   every job is a process, every rank (vpid) a thread of it
+ *   every message is a "send" slice on the sender and a "recv" slice on
+ *   the receiver, joined by a flow arrow. Both are at the capture time of
+ *   an eager message (MATCH); a rendezvous (RNDV, RGET) is received at
+ *   the end of its transfer, which is also shown as an async slice.
+ *   consecutive messages of a rank with the tag of one collective on one
+ *   communicator form a span of the collective. For Barrier, Allgather(v),
+ *   Allreduce and Alltoall(v,w) a second message to the same peer begins
+ *   the next instance.
+ *
+ * The events are written while the capture is read, only the open spans
+ * and the unfinished rendezvous transfers are kept. Times are in
+ * microseconds since the first BTL PDU.
+ *
+ * The ranks are known from the sync handshake of the connection
+ * (mpi.channel.*), messages of connections without it are only counted.
+ *
+ * Usage: -z mpi,trace,<file>[,filter]
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <glib/gstdio.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+/* unfinished rendezvous transfers kept at most */
+#define TRACE_MAX_PENDING 65536
+
+typedef struct _trace_rank_t {
+    guint32 jobid;
+    guint32 vpid;
+    /* the open collective span */
+    gboolean open;
+    guint32 span;           /* number of the span */
+    guint16 ctx;
+    gint32 tag;
+    gdouble start;          /* us */
+    gdouble end;
+    guint msgs;
+    guint64 bytes;
+    GHashTable *peers;      /* synchronizing collectives: sent to */
+} trace_rank_t;
+
+/* a rendezvous transfer until its end */
+typedef struct _trace_pending_t {
+    trace_rank_t *src;
+    trace_rank_t *dst;
+    guint32 src_span;       /* collective span of both, 0 if none */
+    guint32 dst_span;
+    guint32 flow;
+    guint32 frame;
+    gint32 tag;
+    guint16 ctx;
+    guint64 msg_len;
+} trace_pending_t;
+
+typedef struct _trace_t {
+    char *filter;
+    char *path;
+    FILE *fp;
+    gboolean write_error;
+    nstime_t t0;
+    gdouble last;           /* us */
+    GHashTable *ranks;      /* jobid << 32 | vpid -> trace_rank_t */
+    GHashTable *pending;    /* RNDV frame -> trace_pending_t */
+    guint32 spans;
+    guint32 flows;
+    guint events;
+    guint messages;
+    guint rndvs;
+    guint unknown;
+    guint untracked;        /* rendezvous beyond TRACE_MAX_PENDING */
+} trace_t;
+
+static const char *
+trace_coll_name(gint32 tag)
+{
+    switch (tag) {
+        case MPI_COLL_BASE_TAG_ALLGATHER:
+            return "Allgather";
+        case MPI_COLL_BASE_TAG_ALLGATHERV:
+            return "Allgatherv";
+        case MPI_COLL_BASE_TAG_ALLREDUCE:
+            return "Allreduce";
+        case MPI_COLL_BASE_TAG_ALLTOALL:
+            return "Alltoall";
+        case MPI_COLL_BASE_TAG_ALLTOALLV:
+            return "Alltoallv";
+        case MPI_COLL_BASE_TAG_ALLTOALLW:
+            return "Alltoallw";
+        case MPI_COLL_BASE_TAG_BARRIER:
+            return "Barrier";
+        case -17:
+            return "Bcast";
+        case -18:
+            return "Exscan";
+        case -19:
+            return "Gather";
+        case -20:
+            return "Gatherv";
+        case -21:
+            return "Reduce";
+        case -22:
+            return "Reduce_scatter";
+        case -23:
+            return "Scan";
+        case -24:
+            return "Scatter";
+        case -25:
+            return "Scatterv";
+        default:
+            return "Collective";
+    }
+}
+
+static void trace_event(trace_t *ts, const char *fmt, ...) G_GNUC_PRINTF(2, 3);
+
+/* one event of the traceEvents array */
+static void
+trace_event(trace_t *ts, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (!ts->fp) {
+        return;
+    }
+    va_start(ap, fmt);
+    if (0 > fprintf(ts->fp, "%s\n", ts->events ? "," : "") ||
+            0 > vfprintf(ts->fp, fmt, ap)) {
+        ts->write_error = TRUE;
+    }
+    va_end(ap);
+    ts->events++;
+}
+
+static gboolean
+trace_open(trace_t *ts)
+{
+    ts->fp = g_fopen(ts->path, "w");
+    if (!ts->fp) {
+        return FALSE;
+    }
+    fprintf(ts->fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    return TRUE;
+}
+
+static void
+trace_close_span(trace_t *ts, trace_rank_t *rank)
+{
+    if (!rank->open) {
+        return;
+    }
+    trace_event(ts, "{\"name\":\"%s\",\"cat\":\"collective\",\"ph\":\"X\","
+            "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,\"tid\":%u,\"args\":{"
+            "\"ctx\":%u,\"messages\":%u,\"bytes\":%" G_GINT64_MODIFIER "u}}",
+            trace_coll_name(rank->tag), rank->start, rank->end - rank->start,
+            rank->jobid, rank->vpid, rank->ctx, rank->msgs, rank->bytes);
+    rank->open = FALSE;
+    if (rank->peers) {
+        g_hash_table_remove_all(rank->peers);
+    }
+}
+
+static void
+trace_free_rank(gpointer data)
+{
+    trace_rank_t *rank = (trace_rank_t *)data;
+
+    if (rank->peers) {
+        g_hash_table_destroy(rank->peers);
+    }
+    g_free(rank);
+}
+
+static trace_rank_t *
+trace_rank(trace_t *ts, guint32 jobid, guint32 vpid)
+{
+    guint64 key = ((guint64)jobid << 32) | vpid;
+    trace_rank_t *rank;
+    gboolean new_job = TRUE;
+    GHashTableIter iter;
+    gpointer value;
+
+    rank = (trace_rank_t *)g_hash_table_lookup(ts->ranks, &key);
+    if (rank) {
+        return rank;
+    }
+
+    g_hash_table_iter_init(&iter, ts->ranks);
+    while (new_job && g_hash_table_iter_next(&iter, NULL, &value)) {
+        new_job = ((trace_rank_t *)value)->jobid != jobid;
+    }
+    if (new_job) {
+        trace_event(ts, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,"
+                "\"args\":{\"name\":\"job %u\"}}", jobid, jobid);
+    }
+    trace_event(ts, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,"
+            "\"tid\":%u,\"args\":{\"name\":\"rank %u\"}}", jobid, vpid, vpid);
+    trace_event(ts, "{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":%u,"
+            "\"tid\":%u,\"args\":{\"sort_index\":%u}}", jobid, vpid, vpid);
+
+    rank = g_new0(trace_rank_t, 1);
+    rank->jobid = jobid;
+    rank->vpid = vpid;
+    g_hash_table_insert(ts->ranks, g_memdup(&key, sizeof(key)), rank);
+    return rank;
+}
+
+/* add a collective message to the span of one of its ranks */
+static void
+trace_span(trace_t *ts, trace_rank_t *rank, trace_rank_t *peer, gboolean sender, const mpi_tap_info_t *mpi_tap_info, gdouble now, guint64 bytes)
+{
+    gint32 tag = mpi_tap_info->match_tag;
+    gboolean sync = MPI_COLL_BASE_TAG_BARRIER <= tag &&
+        MPI_COLL_BASE_TAG_ALLGATHER >= tag;
+
+    if (rank->open && (rank->ctx != mpi_tap_info->match_ctx ||
+                rank->tag != tag || (sync && sender &&
+                    g_hash_table_lookup(rank->peers, peer)))) {
+        trace_close_span(ts, rank);
+    }
+    if (!rank->open) {
+        rank->open = TRUE;
+        rank->span = ++ts->spans;
+        rank->ctx = mpi_tap_info->match_ctx;
+        rank->tag = tag;
+        rank->start = now;
+        rank->msgs = 0;
+        rank->bytes = 0;
+    }
+    if (sync && sender) {
+        if (!rank->peers) {
+            rank->peers = g_hash_table_new(g_direct_hash, g_direct_equal);
+        }
+        g_hash_table_insert(rank->peers, peer, peer);
+    }
+    rank->end = now;
+    rank->msgs++;
+    rank->bytes += bytes;
+}
+
+/* the "send" and "recv" slices of a message, joined by flow "id" */
+static void
+trace_message(trace_t *ts, trace_rank_t *src, trace_rank_t *dst, guint32 id, guint32 frame, gdouble sent, gdouble received, guint16 ctx, gint32 tag, guint64 bytes, gboolean rndv)
+{
+    const char *cat = 0 > tag ? "collective" : "p2p";
+
+    trace_event(ts, "{\"name\":\"send\",\"cat\":\"%s\",\"ph\":\"X\","
+            "\"ts\":%.3f,\"dur\":0,\"pid\":%u,\"tid\":%u,\"bind_id\":%u,"
+            "\"flow_out\":true,\"args\":{\"to\":\"%u.%u\",\"ctx\":%u,"
+            "\"tag\":%d,\"bytes\":%" G_GINT64_MODIFIER "u,\"frame\":%u,"
+            "\"protocol\":\"%s\"}}",
+            cat, sent, src->jobid, src->vpid, id, dst->jobid, dst->vpid,
+            ctx, tag, bytes, frame, rndv ? "rendezvous" : "eager");
+    trace_event(ts, "{\"name\":\"recv\",\"cat\":\"%s\",\"ph\":\"X\","
+            "\"ts\":%.3f,\"dur\":0,\"pid\":%u,\"tid\":%u,\"bind_id\":%u,"
+            "\"flow_in\":true,\"args\":{\"from\":\"%u.%u\",\"ctx\":%u,"
+            "\"tag\":%d,\"bytes\":%" G_GINT64_MODIFIER "u,\"frame\":%u}}",
+            cat, received, dst->jobid, dst->vpid, id, src->jobid, src->vpid,
+            ctx, tag, bytes, frame);
+}
+
+static void
+trace_reset(void *tapdata)
+{
+    trace_t *ts = (trace_t *)tapdata;
+
+    g_hash_table_remove_all(ts->pending);
+    g_hash_table_remove_all(ts->ranks);
+    if (ts->fp) {
+        fclose(ts->fp);
+        ts->fp = NULL;
+    }
+    ts->events = 0;
+    ts->write_error = !trace_open(ts);
+    nstime_set_unset(&ts->t0);
+    ts->last = 0;
+    ts->spans = 0;
+    ts->flows = 0;
+    ts->messages = 0;
+    ts->rndvs = 0;
+    ts->unknown = 0;
+    ts->untracked = 0;
+}
+
+static int
+trace_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt _U_, const void *data)
+{
+    trace_t *ts = (trace_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    trace_rank_t *src;
+    trace_rank_t *dst;
+    trace_pending_t *pending;
+    nstime_t delta;
+    gdouble now;
+    guint64 bytes;
+    gboolean rndv;
+
+    if (MPI_PDU_BTL != mpi_tap_info->kind) {
+        return 0;
+    }
+    if (nstime_is_unset(&ts->t0)) {
+        ts->t0 = pinfo->fd->abs_ts;
+    }
+    nstime_delta(&delta, &pinfo->fd->abs_ts, &ts->t0);
+    now = nstime_to_msec(&delta) * 1000.0;
+    ts->last = now;
+
+    if (mpi_tap_info->matched) {
+        if (0 == mpi_tap_info->channel) {
+            ts->unknown++;
+        } else {
+            src = trace_rank(ts, mpi_tap_info->jobid, mpi_tap_info->vpid);
+            dst = trace_rank(ts, mpi_tap_info->jobid_dst,
+                    mpi_tap_info->vpid_dst);
+            rndv = MPI_PML_OB1_HDR_TYPE_MATCH != mpi_tap_info->base;
+            bytes = rndv ? mpi_tap_info->msg_len : mpi_tap_info->payload;
+            ts->messages++;
+            if (0 > mpi_tap_info->match_tag) {
+                trace_span(ts, src, dst, TRUE, mpi_tap_info, now, bytes);
+                trace_span(ts, dst, src, FALSE, mpi_tap_info, now, bytes);
+            }
+            if (!rndv) {
+                trace_message(ts, src, dst, ++ts->flows, pinfo->fd->num,
+                        now, now,
+                        mpi_tap_info->match_ctx, mpi_tap_info->match_tag,
+                        bytes, FALSE);
+            } else if (TRACE_MAX_PENDING > g_hash_table_size(ts->pending)) {
+                ts->rndvs++;
+                pending = g_new(trace_pending_t, 1);
+                pending->src = src;
+                pending->dst = dst;
+                pending->src_span = src->open ? src->span : 0;
+                pending->dst_span = dst->open ? dst->span : 0;
+                pending->flow = ++ts->flows;
+                pending->frame = pinfo->fd->num;
+                pending->tag = mpi_tap_info->match_tag;
+                pending->ctx = mpi_tap_info->match_ctx;
+                pending->msg_len = bytes;
+                g_hash_table_insert(ts->pending,
+                        GUINT_TO_POINTER(pinfo->fd->num), pending);
+                trace_event(ts, "{\"name\":\"rendezvous\",\"cat\":\"rndv\","
+                        "\"ph\":\"b\",\"id\":%u,\"ts\":%.3f,\"pid\":%u,"
+                        "\"tid\":%u,\"args\":{\"bytes\":%"
+                        G_GINT64_MODIFIER "u}}", pending->flow, now,
+                        src->jobid, src->vpid, bytes);
+            } else {
+                ts->untracked++;
+            }
+        }
+    }
+
+    if (mpi_tap_info->xfer_done) {
+        pending = (trace_pending_t *)g_hash_table_lookup(ts->pending,
+                GUINT_TO_POINTER(mpi_tap_info->xfer_rndv_in));
+        if (pending) {
+            /* the collective spans last until the end of the transfer */
+            if (pending->src_span && pending->src->open &&
+                    pending->src->span == pending->src_span) {
+                pending->src->end = now;
+            }
+            if (pending->dst_span && pending->dst->open &&
+                    pending->dst->span == pending->dst_span) {
+                pending->dst->end = now;
+            }
+            trace_message(ts, pending->src, pending->dst, pending->flow,
+                    pending->frame,
+                    now - nstime_to_msec(&mpi_tap_info->xfer_duration) * 1000.0,
+                    now, pending->ctx, pending->tag, pending->msg_len, TRUE);
+            trace_event(ts, "{\"name\":\"rendezvous\",\"cat\":\"rndv\","
+                    "\"ph\":\"e\",\"id\":%u,\"ts\":%.3f,\"pid\":%u,"
+                    "\"tid\":%u,\"args\":{\"frags\":%u,\"tcp_events\":%u}}",
+                    pending->flow, now, pending->src->jobid,
+                    pending->src->vpid, mpi_tap_info->xfer_frags,
+                    mpi_tap_info->xfer_tcp_events);
+            g_hash_table_remove(ts->pending,
+                    GUINT_TO_POINTER(mpi_tap_info->xfer_rndv_in));
+        }
+    }
+
+    return 1;
+}
+
+static void
+trace_draw(void *tapdata)
+{
+    trace_t *ts = (trace_t *)tapdata;
+    GHashTableIter iter;
+    gpointer value;
+    trace_pending_t *pending;
+    guint unfinished;
+
+    g_hash_table_iter_init(&iter, ts->ranks);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        trace_close_span(ts, (trace_rank_t *)value);
+    }
+    /* the unfinished transfers end with the capture */
+    unfinished = g_hash_table_size(ts->pending);
+    g_hash_table_iter_init(&iter, ts->pending);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        pending = (trace_pending_t *)value;
+        trace_event(ts, "{\"name\":\"rendezvous\",\"cat\":\"rndv\","
+                "\"ph\":\"e\",\"id\":%u,\"ts\":%.3f,\"pid\":%u,"
+                "\"tid\":%u,\"args\":{\"unfinished\":true}}",
+                pending->flow, ts->last, pending->src->jobid,
+                pending->src->vpid);
+    }
+    g_hash_table_remove_all(ts->pending);
+    if (ts->fp) {
+        fprintf(ts->fp, "\n]}\n");
+        if (0 != fclose(ts->fp)) {
+            ts->write_error = TRUE;
+        }
+        ts->fp = NULL;
+    }
+
+    printf("\n");
+    printf("=============================================================================================================\n");
+    printf("MPI Trace Export:\n");
+    printf("Filter: %s\n", ts->filter ? ts->filter : "");
+    printf("Exported to: %s%s\n", ts->path,
+            ts->write_error ? " (with write errors)" : "");
+    printf("Events: %u, ranks: %u, messages: %u (rendezvous: %u, unfinished: %u), collective spans: %u\n",
+            ts->events, g_hash_table_size(ts->ranks), ts->messages,
+            ts->rndvs, unfinished, ts->spans);
+    printf("Not exported: %u messages of unknown channels, %u rendezvous beyond %u in flight\n",
+            ts->unknown, ts->untracked, TRACE_MAX_PENDING);
+    printf("=============================================================================================================\n");
+}
+
+static void
+trace_init(const char *opt_arg, void *userdata _U_)
+{
+    trace_t *ts;
+    const char *filter = NULL;
+    const char *path = NULL;
+    const char *end = NULL;
+    GString *error_string;
+
+    if (!strncmp(opt_arg, "mpi,trace,", 10)) {
+        path = opt_arg + 10;
+        end = strchr(path, ',');
+        if (end) {
+            filter = end + 1;
+        }
+    }
+    if (!path || path == end || '\0' == *path) {
+        fprintf(stderr, "tshark: invalid \"-z mpi,trace,<file>[,<filter>]\" argument\n");
+        exit(1);
+    }
+
+    ts = g_new0(trace_t, 1);
+    ts->path = end ? g_strndup(path, end - path) : g_strdup(path);
+    if (!trace_open(ts)) {
+        fprintf(stderr, "tshark: mpi,trace: can't open %s: %s\n",
+                ts->path, g_strerror(errno));
+        exit(1);
+    }
+    ts->filter = filter ? g_strdup(filter) : NULL;
+    ts->ranks = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            g_free, trace_free_rank);
+    ts->pending = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+            NULL, g_free);
+    nstime_set_unset(&ts->t0);
+
+    error_string = register_tap_listener("mpi", ts, ts->filter, 0,
+            trace_reset, trace_packet, trace_draw);
+    if (error_string) {
+        g_hash_table_destroy(ts->pending);
+        g_hash_table_destroy(ts->ranks);
+        fclose(ts->fp);
+        g_free(ts->filter);
+        g_free(ts->path);
+        g_free(ts);
+        fprintf(stderr, "tshark: Couldn't register mpi,trace tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_trace(void)
+{
+    register_stat_cmd_arg("mpi,trace", trace_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
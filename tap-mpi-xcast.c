@@ -0,0 +1,408 @@
+/* tap-mpi-xcast.c
+ * ORTE XCAST fan-out latency for tshark (-z mpi,xcast)
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Uses the XCAST relays correlated by the dissector (mpi.xcast.*) to show
+ *
+ *   every XCAST with its daemon command (ORTE_DAEMON_*), deliveries, depth
+ *   and the time from the root until the last daemon got it (fan-out)
+ *   the arrival time and relay time per depth of the routing tree
+ *   the relay time per relaying daemon, counting relays slower than "slow"
+ *   the routing tree, i.e. the union of all seen parent -> child relays
+ *
+ * Only deliveries seen in the capture are known, a relay whose incoming
+ * message was not captured starts a new XCAST.
+ *
+ * Usage: -z mpi,xcast[,slow[,filter]]   (slow in milliseconds, default 10)
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epan/packet.h>
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+#include "packet-mpi.h"
+
+#define XCAST_DEFAULT_SLOW 10.0
+
+typedef struct _xcast_stat_t {
+    guint count;
+    gdouble min;
+    gdouble max;
+    gdouble sum;
+} xcast_stat_t;
+
+typedef struct _xcast_inst_t {
+    guint32 id;
+    guint32 first_frame;
+    guint32 root;           /* vpid of the root */
+    guint8 daemon_cmd;
+    guint deliveries;
+    guint32 depth;
+    gdouble fanout;         /* root until the last delivery (ms) */
+    gdouble slowest;        /* slowest relay (ms), negative if none */
+    guint32 slowest_vpid;
+} xcast_inst_t;
+
+typedef struct _xcast_relay_t {
+    guint32 vpid;
+    xcast_stat_t relay;
+    guint slow;
+} xcast_relay_t;
+
+typedef struct _xcast_edge_t {
+    guint64 edge;           /* parent << 32 | child, hash key */
+    guint count;
+} xcast_edge_t;
+
+typedef struct _xcast_t {
+    char *filter;
+    gdouble slow;           /* ms */
+    GHashTable *insts;      /* id -> xcast_inst_t */
+    GHashTable *relays;     /* relaying vpid -> xcast_relay_t */
+    GHashTable *edges;      /* parent << 32 | child -> xcast_edge_t */
+    GArray *arrival;        /* per hop: root until the delivery */
+    GArray *relay;          /* per hop: relay time */
+    guint slow_relays;
+} xcast_t;
+
+static void
+xcast_stat_add(xcast_stat_t *stat, gdouble value)
+{
+    if (0 == stat->count || value < stat->min) {
+        stat->min = value;
+    }
+    if (0 == stat->count || value > stat->max) {
+        stat->max = value;
+    }
+    stat->sum += value;
+    stat->count++;
+}
+
+static xcast_stat_t *
+xcast_hop_stat(GArray *array, guint32 hop)
+{
+    if (array->len <= hop) {
+        g_array_set_size(array, hop + 1);
+    }
+    return &g_array_index(array, xcast_stat_t, hop);
+}
+
+static void
+xcast_reset(void *tapdata)
+{
+    xcast_t *xs = (xcast_t *)tapdata;
+
+    g_hash_table_remove_all(xs->insts);
+    g_hash_table_remove_all(xs->relays);
+    g_hash_table_remove_all(xs->edges);
+    g_array_set_size(xs->arrival, 0);
+    g_array_set_size(xs->relay, 0);
+    xs->slow_relays = 0;
+}
+
+static int
+xcast_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt _U_, const void *data)
+{
+    xcast_t *xs = (xcast_t *)tapdata;
+    const mpi_tap_info_t *mpi_tap_info = (const mpi_tap_info_t *)data;
+    xcast_inst_t *inst;
+    xcast_relay_t *relay;
+    xcast_edge_t *edge;
+    guint64 name;
+    gdouble arrival, relay_time;
+
+    if (MPI_PDU_OOB != mpi_tap_info->kind || 0 == mpi_tap_info->xcast_id) {
+        return 0;
+    }
+
+    inst = (xcast_inst_t *)g_hash_table_lookup(xs->insts,
+            GUINT_TO_POINTER(mpi_tap_info->xcast_id));
+    if (!inst) {
+        inst = g_new0(xcast_inst_t, 1);
+        inst->id = mpi_tap_info->xcast_id;
+        inst->first_frame = pinfo->fd->num;
+        inst->root = mpi_tap_info->vpid_origin;
+        inst->slowest = -1;
+        g_hash_table_insert(xs->insts, GUINT_TO_POINTER(inst->id), inst);
+    }
+    if (0 == inst->daemon_cmd) {
+        inst->daemon_cmd = mpi_tap_info->daemon_cmd;
+    }
+
+    arrival = nstime_to_msec(&mpi_tap_info->xcast_time);
+    inst->deliveries++;
+    inst->depth = MAX(inst->depth, mpi_tap_info->xcast_hop);
+    inst->fanout = MAX(inst->fanout, arrival);
+    xcast_stat_add(xcast_hop_stat(xs->arrival, mpi_tap_info->xcast_hop),
+            arrival);
+
+    name = ((guint64)mpi_tap_info->vpid_origin << 32) | mpi_tap_info->vpid_dst;
+    edge = (xcast_edge_t *)g_hash_table_lookup(xs->edges, &name);
+    if (!edge) {
+        edge = g_new0(xcast_edge_t, 1);
+        edge->edge = name;
+        g_hash_table_insert(xs->edges, &edge->edge, edge);
+    }
+    edge->count++;
+
+    /* the root sends, all others relay */
+    if (0 == mpi_tap_info->xcast_parent_in) {
+        return 0;
+    }
+    relay_time = nstime_to_msec(&mpi_tap_info->xcast_relay_time);
+    xcast_stat_add(xcast_hop_stat(xs->relay, mpi_tap_info->xcast_hop),
+            relay_time);
+
+    relay = (xcast_relay_t *)g_hash_table_lookup(xs->relays,
+            GUINT_TO_POINTER(mpi_tap_info->vpid_origin));
+    if (!relay) {
+        relay = g_new0(xcast_relay_t, 1);
+        relay->vpid = mpi_tap_info->vpid_origin;
+        g_hash_table_insert(xs->relays, GUINT_TO_POINTER(relay->vpid), relay);
+    }
+    xcast_stat_add(&relay->relay, relay_time);
+    if (relay_time > xs->slow) {
+        relay->slow++;
+        xs->slow_relays++;
+    }
+    if (relay_time > inst->slowest) {
+        inst->slowest = relay_time;
+        inst->slowest_vpid = mpi_tap_info->vpid_origin;
+    }
+
+    return 0;
+}
+
+static gint
+xcast_inst_cmp(gconstpointer a, gconstpointer b)
+{
+    const xcast_inst_t *ia = *(const xcast_inst_t * const *)a;
+    const xcast_inst_t *ib = *(const xcast_inst_t * const *)b;
+
+    return ia->id < ib->id ? -1 : (ia->id > ib->id);
+}
+
+/* slowest relaying daemon first */
+static gint
+xcast_relay_cmp(gconstpointer a, gconstpointer b)
+{
+    const xcast_relay_t *ra = *(const xcast_relay_t * const *)a;
+    const xcast_relay_t *rb = *(const xcast_relay_t * const *)b;
+
+    if (ra->relay.max != rb->relay.max) {
+        return ra->relay.max > rb->relay.max ? -1 : 1;
+    }
+    return ra->vpid < rb->vpid ? -1 : (ra->vpid > rb->vpid);
+}
+
+static gint
+xcast_edge_cmp(gconstpointer a, gconstpointer b)
+{
+    const xcast_edge_t *ea = *(const xcast_edge_t * const *)a;
+    const xcast_edge_t *eb = *(const xcast_edge_t * const *)b;
+
+    return ea->edge < eb->edge ? -1 : (ea->edge > eb->edge);
+}
+
+static GPtrArray *
+xcast_sorted_values(GHashTable *table, GCompareFunc cmp)
+{
+    GPtrArray *array;
+    GHashTableIter iter;
+    gpointer value;
+
+    array = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, table);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(array, value);
+    }
+    g_ptr_array_sort(array, cmp);
+    return array;
+}
+
+static void
+xcast_print_stat(const xcast_stat_t *stat)
+{
+    if (0 == stat->count) {
+        printf(" %8u %10s %10s %10s", 0, "-", "-", "-");
+    } else {
+        printf(" %8u %10.3f %10.3f %10.3f", stat->count, stat->min,
+                stat->sum / stat->count, stat->max);
+    }
+}
+
+static void
+xcast_draw(void *tapdata)
+{
+    xcast_t *xs = (xcast_t *)tapdata;
+    GPtrArray *array;
+    xcast_inst_t *inst;
+    xcast_relay_t *relay;
+    xcast_edge_t *edge;
+    guint32 parent = 0;
+    guint i;
+
+    printf("\n");
+    printf("===================================================================================\n");
+    printf("MPI XCAST Fan-out:\n");
+    printf("Filter: %s\n", xs->filter ? xs->filter : "");
+    printf("XCASTs: %u, slow relays (> %.3f ms): %u\n",
+            g_hash_table_size(xs->insts), xs->slow, xs->slow_relays);
+    printf("Times in milliseconds\n");
+
+    printf("-----------------------------------------------------------------------------------\n");
+    printf("%6s %8s %6s %6s %10s %6s %10s %10s %8s\n", "XCAST", "Frame",
+            "CMD", "Root", "Deliveries", "Depth", "Fan-out",
+            "Slowest", "by");
+    array = xcast_sorted_values(xs->insts, xcast_inst_cmp);
+    for (i = 0; i < array->len; i++) {
+        inst = (xcast_inst_t *)g_ptr_array_index(array, i);
+        printf("%6u %8u %6u %6u %10u %6u %10.3f", inst->id,
+                inst->first_frame, inst->daemon_cmd, inst->root,
+                inst->deliveries, inst->depth, inst->fanout);
+        if (0 > inst->slowest) {
+            printf(" %10s %8s\n", "-", "-");
+        } else {
+            printf(" %10.3f %8u\n", inst->slowest, inst->slowest_vpid);
+        }
+    }
+    g_ptr_array_free(array, TRUE);
+
+    printf("-----------------------------------------------------------------------------------\n");
+    printf("Per hop of the routing tree\n");
+    printf("%4s %8s %10s %10s %10s %8s %10s %10s %10s\n", "Hop",
+            "Arrived", "Min", "Avg", "Max", "Relayed", "Min", "Avg", "Max");
+    for (i = 1; i < xs->arrival->len; i++) {
+        printf("%4u", i);
+        xcast_print_stat(&g_array_index(xs->arrival, xcast_stat_t, i));
+        if (i < xs->relay->len) {
+            xcast_print_stat(&g_array_index(xs->relay, xcast_stat_t, i));
+        } else {
+            printf(" %8u %10s %10s %10s", 0, "-", "-", "-");
+        }
+        printf("\n");
+    }
+
+    printf("-----------------------------------------------------------------------------------\n");
+    printf("Relaying daemons, slowest first\n");
+    printf("%8s %8s %10s %10s %10s %8s\n", "Vpid", "Relays", "Min", "Avg",
+            "Max", "Slow");
+    array = xcast_sorted_values(xs->relays, xcast_relay_cmp);
+    for (i = 0; i < array->len; i++) {
+        relay = (xcast_relay_t *)g_ptr_array_index(array, i);
+        printf("%8u", relay->vpid);
+        xcast_print_stat(&relay->relay);
+        printf(" %8u\n", relay->slow);
+    }
+    g_ptr_array_free(array, TRUE);
+
+    printf("-----------------------------------------------------------------------------------\n");
+    printf("Routing tree (parent -> children (relays))\n");
+    array = xcast_sorted_values(xs->edges, xcast_edge_cmp);
+    for (i = 0; i < array->len; i++) {
+        edge = (xcast_edge_t *)g_ptr_array_index(array, i);
+        if (0 == i || parent != (guint32)(edge->edge >> 32)) {
+            parent = (guint32)(edge->edge >> 32);
+            printf("%s%8u ->", i ? "\n" : "", parent);
+        }
+        printf(" %u(%u)", (guint32)edge->edge, edge->count);
+    }
+    if (array->len) {
+        printf("\n");
+    }
+    g_ptr_array_free(array, TRUE);
+    printf("===================================================================================\n");
+}
+
+static void
+xcast_init(const char *opt_arg, void *userdata _U_)
+{
+    xcast_t *xs;
+    const char *filter = NULL;
+    gdouble slow = XCAST_DEFAULT_SLOW;
+    GString *error_string;
+    int pos = 0;
+
+    if (sscanf(opt_arg, "mpi,xcast,%lf%n", &slow, &pos) == 1) {
+        if (',' == opt_arg[pos]) {
+            filter = opt_arg + pos + 1;
+        }
+    }
+    if (0 > slow) {
+        fprintf(stderr, "tshark: invalid \"-z mpi,xcast,<slow>[,<filter>]\" slow\n");
+        exit(1);
+    }
+
+    xs = g_new0(xcast_t, 1);
+    xs->filter = filter ? g_strdup(filter) : NULL;
+    xs->slow = slow;
+    xs->insts = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+            NULL, g_free);
+    xs->relays = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+            NULL, g_free);
+    xs->edges = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            NULL, g_free);
+    xs->arrival = g_array_new(FALSE, TRUE, sizeof(xcast_stat_t));
+    xs->relay = g_array_new(FALSE, TRUE, sizeof(xcast_stat_t));
+
+    error_string = register_tap_listener("mpi", xs, xs->filter, 0,
+            xcast_reset, xcast_packet, xcast_draw);
+    if (error_string) {
+        g_array_free(xs->relay, TRUE);
+        g_array_free(xs->arrival, TRUE);
+        g_hash_table_destroy(xs->edges);
+        g_hash_table_destroy(xs->relays);
+        g_hash_table_destroy(xs->insts);
+        g_free(xs->filter);
+        g_free(xs);
+        fprintf(stderr, "tshark: Couldn't register mpi,xcast tap: %s\n",
+                error_string->str);
+        g_string_free(error_string, TRUE);
+        exit(1);
+    }
+}
+
+void
+proto_register_mpi_xcast(void)
+{
+    register_stat_cmd_arg("mpi,xcast", xcast_init, NULL);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
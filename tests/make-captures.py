@@ -0,0 +1,318 @@
+#!/usr/bin/env python
+#
+# make-captures.py
+# Writes the synthetic captures of the tshark tests (run-tests.sh)
+# Copyright 2015, Julian Rilli julian@rilli.eu
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+"""Write the synthetic captures of the tshark tests.
+
+The bundled captures (sniffs/) have no complete rendezvous transfer and
+no capture loss, these are built here: Ethernet, IPv4 and TCP segments
+with one BTL PDU or a piece of the OOB stream each, little endian BTL
+headers as in the bundled captures. The output is the same on every
+run, the captures are checked in next to the script.
+
+    python make-captures.py [directory]
+"""
+
+import os
+import struct
+import sys
+
+BTL_MATCH = 65
+BTL_RNDV = 66
+BTL_ACK = 68
+BTL_FRAG = 70
+BTL_PUT = 72
+BTL_FIN = 73
+
+DAEMON_JOBID = 0x5ff50000
+OOB_IDENT = 0
+OOB_USER = 3
+ORTE_RML_TAG_ORTED_CALLBACK = 10
+
+
+class Capture(object):
+    """A libpcap file of Ethernet frames, one TCP segment each."""
+
+    def __init__(self):
+        self.frames = []
+        self.seqs = {}
+
+    def segment(self, usecs, src, dst, payload, skip=0):
+        """A segment from src to dst (address, port) at usecs, "skip"
+        bytes of the stream before it are not captured."""
+        seq = self.seqs.get((src, dst), 1000) + skip
+        self.seqs[(src, dst)] = seq + len(payload)
+        ack = self.seqs.get((dst, src), 1000)
+        tcp = struct.pack(">HHIIBBHHH", src[1], dst[1], seq, ack, 5 << 4,
+                          0x18, 65535, 0, 0)
+        ip = struct.pack(">BBHHHBBH4s4s", 0x45, 0, 20 + len(tcp) +
+                         len(payload), 0, 0x4000, 64, 6, 0, _addr(src[0]),
+                         _addr(dst[0]))
+        eth = b"\x00\x00\x00\x00\x00\x02\x00\x00\x00\x00\x00\x01\x08\x00"
+        self.frames.append((usecs, eth + ip + tcp + payload))
+
+    def write(self, path):
+        with open(path, "wb") as f:
+            f.write(struct.pack("<IHHiIII", 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1))
+            for usecs, frame in self.frames:
+                f.write(struct.pack("<IIII", 1420070400 + usecs // 1000000,
+                                    usecs % 1000000, len(frame), len(frame)))
+                f.write(frame)
+
+
+def _addr(text):
+    return bytes(bytearray(int(x) for x in text.split(".")))
+
+
+def btl(base, body, payload=b""):
+    """A BTL PDU: base and common header, the PML header and its data."""
+    size = 2 + len(body) + len(payload)
+    return struct.pack("<BBHIBB", base, 1, 0, size, base, 0) + body + payload
+
+
+def match(ctx=0, src=0, tag=0, seq=0):
+    return struct.pack("<HiiHH", ctx, src, tag, seq, 0)
+
+
+def rndv(src_req, msg_len, src=0, tag=0, seq=0):
+    return btl(BTL_RNDV, match(0, src, tag, seq) +
+               struct.pack("<QQ", msg_len, src_req))
+
+
+def frag(src_req, offset, data):
+    return btl(BTL_FRAG, b"\x00" * 6 + struct.pack("<QQQ", offset, src_req, 0),
+               data)
+
+
+def ack(src_req, dst_req):
+    """The ACK of the receiver, "dst_req" is its receive request."""
+    return btl(BTL_ACK, b"\x00" * 6 + struct.pack("<QQQ", src_req, dst_req, 0))
+
+
+def put(dst_req, des, offset, seg_len):
+    """A PUT of the receiver, "des" is its descriptor of the segment."""
+    return btl(BTL_PUT, b"\x00" * 2 + struct.pack("<IQQQQQQ", 1, dst_req, des,
+                                                   0, offset, 0x7f0000000000,
+                                                   seg_len))
+
+
+def fin(des):
+    return btl(BTL_FIN, b"\x00" * 2 + struct.pack("<IQ", 0, des))
+
+
+def oob(nbytes, tag=100, origin=0, dst=1, msg_type=OOB_USER):
+    """An OOB header (big endian) of a message from daemon "origin" to
+    daemon "dst", a USER message from daemon 0 to 1 by default."""
+    return struct.pack(">7I", DAEMON_JOBID, origin, DAEMON_JOBID, dst,
+                       msg_type, tag, nbytes)
+
+
+def ident(origin, dst):
+    """The IDENT a daemon sends first on a connection it opened."""
+    return oob(8, tag=0, origin=origin, dst=dst, msg_type=OOB_IDENT) + \
+        b"\x00" * 8
+
+
+def callback(origin, uri, nodename, dst=0):
+    """An ORTED callback of daemon "origin" without debug information."""
+    def string(text):
+        return struct.pack(">II", 1, len(text) + 1) + text.encode() + b"\x00"
+    body = struct.pack(">III", 1, DAEMON_JOBID, origin) + string(uri) + \
+        string(nodename) + struct.pack(">III", 1, 1, 0)
+    return oob(len(body), tag=ORTE_RML_TAG_ORTED_CALLBACK, origin=origin,
+               dst=dst) + body
+
+
+CAPTURES = {}
+
+
+def capture(function):
+    CAPTURES[function.__name__.replace("_", "-")] = function
+    return function
+
+
+@capture
+def xfer_endpoints():
+    """Two processes of one host send a RNDV with the same send request
+    (-z mpi,bandwidth: two transfers, both finished by their FRAGs)."""
+    cap = Capture()
+    recv = ("10.0.0.2", 1024)
+    p1 = ("10.0.0.1", 40001)
+    p2 = ("10.0.0.1", 40002)
+    cap.segment(0, p1, recv, rndv(0x1000, 2048))
+    cap.segment(500, p2, recv, rndv(0x1000, 2048, src=1))
+    cap.segment(1000, p1, recv, frag(0x1000, 0, b"\x11" * 1024))
+    cap.segment(1500, p2, recv, frag(0x1000, 0, b"\x22" * 1024))
+    cap.segment(2000, p1, recv, frag(0x1000, 1024, b"\x11" * 1024))
+    cap.segment(3000, p2, recv, frag(0x1000, 1024, b"\x22" * 1024))
+    return cap
+
+
+@capture
+def xfer_mixed():
+    """A pml_ob1 pipeline of a FRAG and a PUT finished by a FIN
+    (-z mpi,bandwidth: the FRAG bytes count, the transfer finishes)."""
+    cap = Capture()
+    recv = ("10.0.0.2", 1024)
+    p1 = ("10.0.0.1", 40001)
+    cap.segment(0, p1, recv, rndv(0x3000, 2048))
+    cap.segment(1000, p1, recv, frag(0x3000, 0, b"\x33" * 1024))
+    cap.segment(2000, recv, p1, put(0x3000, 0x5000, 1024, 1024))
+    cap.segment(3000, p1, recv, fin(0x5000))
+    return cap
+
+
+@capture
+def rndv_ack():
+    """A RNDV answered by an ACK (-z mpi,resolve: ack-in of the RNDV)."""
+    cap = Capture()
+    recv = ("10.0.0.2", 1024)
+    p1 = ("10.0.0.1", 40001)
+    cap.segment(0, p1, recv, rndv(0x2000, 4096))
+    cap.segment(250, recv, p1, ack(0x2000, 0x9000))
+    return cap
+
+
+@capture
+def put_same_des():
+    """Two receiving processes of one host answer a RNDV with a PUT of the
+    same descriptor (-z mpi,resolve: each FIN resolves the PUT it answers,
+    the descriptor is keyed by its owner)."""
+    cap = Capture()
+    r1 = ("10.0.0.2", 1024)
+    r2 = ("10.0.0.2", 1025)
+    p1 = ("10.0.0.1", 40001)
+    p2 = ("10.0.0.3", 40001)
+    cap.segment(0, p1, r1, rndv(0x1000, 2048))
+    cap.segment(100, p2, r2, rndv(0x1000, 2048))
+    cap.segment(200, r1, p1, put(0x1000, 0x5000, 0, 2048))
+    cap.segment(300, r2, p2, put(0x1000, 0x5000, 0, 2048))
+    cap.segment(400, p1, r1, fin(0x5000))
+    cap.segment(500, p2, r2, fin(0x5000))
+    return cap
+
+
+@capture
+def oob_loss():
+    """OOB segments lost inside a message and across a header (-z expert:
+    the lost bytes, the message shortened, then the header searched)."""
+    cap = Capture()
+    hnp = ("10.0.1.1", 40100)
+    orted = ("10.0.1.2", 40200)
+    cap.segment(0, hnp, orted, oob(100) + b"\x00" * 100)
+    cap.segment(1000, hnp, orted, oob(200) + b"\x00" * 50)
+    # 100 message bytes lost, 50 left
+    cap.segment(2000, hnp, orted, b"\x00" * 50 + oob(20) + b"\x00" * 20,
+                skip=100)
+    cap.segment(3000, hnp, orted, oob(300) + b"\x00" * 10)
+    # the rest of the message and the next header (40 bytes) lost
+    cap.segment(4000, hnp, orted, b"\x00" * 40 + oob(8) + b"\x00" * 8,
+                skip=290 + 28)
+    return cap
+
+
+@capture
+def btl_resync():
+    """A connection with a sync handshake continues a PDU over segments
+    and loses one, a connection without resyncs in the middle (-z expert:
+    no search in the continuation, the lost one searches a single header,
+    the other one a header followed by another)."""
+    cap = Capture()
+    recv = ("10.0.0.2", 1024)
+    p1 = ("10.0.0.1", 40010)
+    p2 = ("10.0.0.3", 40020)
+    # sync request and response, big endian
+    cap.segment(0, p1, recv, struct.pack(">II", 0x5ff50001, 0))
+    cap.segment(100, recv, p1, struct.pack(">II", 0x5ff50001, 1))
+    # a PDU of 108 bytes in two segments, a header-like run in the second
+    fake = struct.pack("<BBHIBB", BTL_MATCH, 1, 0, 0x100000, BTL_MATCH, 0)
+    data = b"\x00" * 36 + fake + b"\x00" * 38
+    pdu = btl(BTL_MATCH, match(src=1, tag=5, seq=1), data)
+    cap.segment(1000, p1, recv, pdu[:40])
+    cap.segment(1100, p1, recv, pdu[40:])
+    # a PDU of 40 bytes lost, the next segment starts 16 bytes early
+    cap.segment(2000, p1, recv, b"\x00" * 16 +
+                btl(BTL_MATCH, match(src=1, tag=5, seq=3)), skip=40)
+    # no sync: a header without a plausible successor is passed over
+    cap.segment(3000, p2, recv, btl(BTL_MATCH, match(src=1, tag=5, seq=1)))
+    cap.segment(4000, p2, recv, b"\x00" * 4 + fake + b"\x00" * 16 +
+                btl(BTL_MATCH, match(src=1, tag=5, seq=2)) +
+                btl(BTL_MATCH, match(src=1, tag=5, seq=3)))
+    return cap
+
+
+@capture
+def launch_hosts():
+    """Two daemons of one host call back on their own connections, a third
+    one on another host through the first one (-z mpi,launch: the hosts
+    from the IDENT and the callback URIs, the first MPI traffic of a host
+    for all of its daemons)."""
+    cap = Capture()
+    hnp = ("10.0.1.1", 40100)
+    d1 = ("10.0.1.2", 40201)
+    d2 = ("10.0.1.2", 40202)
+    cap.segment(0, d1, hnp, ident(1, 0))
+    cap.segment(1000, d1, hnp, callback(1, "1609891840.1;tcp://10.0.1.2,"
+                                        "127.0.0.1:40201", "node2"))
+    cap.segment(2000, d2, hnp, ident(2, 0) +
+                callback(2, "1609891840.2;tcp://10.0.1.2:40202", "node2"))
+    # relayed by daemon 1
+    cap.segment(3000, d1, hnp, callback(3, "1609891840.3;tcp://10.0.1.3:"
+                                        "40203", "node3"))
+    cap.segment(10000, ("10.0.1.2", 1024), ("10.0.1.4", 1024),
+                btl(BTL_MATCH, match(src=1, tag=5, seq=1)))
+    cap.segment(20000, ("10.0.1.3", 1024), ("10.0.1.4", 1024),
+                btl(BTL_MATCH, match(src=2, tag=5, seq=1)))
+    return cap
+
+
+@capture
+def oob_static_ports():
+    """OOB listeners on a static port below 32768, a connection to one
+    opened before the URI with it (-z mpi,launch: the connections are OOB
+    from their IDENT, the HNP gets its host from the one it opened)."""
+    cap = Capture()
+    hnp = ("10.0.2.1", 5000)
+    d1 = ("10.0.2.2", 45001)
+    d2 = ("10.0.2.3", 45003)
+    cap.segment(0, d1, hnp, ident(1, 0))
+    cap.segment(1000, d1, hnp, callback(1, "1609891840.1;tcp://10.0.2.2:5000",
+                                        "node2"))
+    # to the listener of daemon 2 before its callback
+    cap.segment(1500, ("10.0.2.1", 45002), ("10.0.2.3", 5000), ident(0, 2))
+    cap.segment(1600, ("10.0.2.1", 45002), ("10.0.2.3", 5000),
+                oob(8, origin=0, dst=2) + b"\x00" * 8)
+    cap.segment(2000, d2, hnp, ident(2, 0) +
+                callback(2, "1609891840.2;tcp://10.0.2.3:5000", "node3"))
+    cap.segment(10000, ("10.0.2.3", 1024), ("10.0.2.2", 1024),
+                btl(BTL_MATCH, match(src=1, tag=5, seq=1)))
+    return cap
+
+
+def main():
+    directory = sys.argv[1] if 1 < len(sys.argv) else os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "captures")
+    if not os.path.isdir(directory):
+        os.makedirs(directory)
+    for name in sorted(CAPTURES):
+        CAPTURES[name]().write(os.path.join(directory, name + ".pcap"))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,236 @@
+/* mpi-scan-test.c
+ * The SSE2 and the scalar BTL header search give the same offsets
+ * Copyright 2015, Julian Rilli julian@rilli.eu
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Random buffers with planted headers, damaged headers and runs of
+ * header-like bytes are searched from every start offset by both paths.
+ *
+ * Usage: mpi-scan-test          compare, exit 1 on a difference
+ *        mpi-scan-test bench    scan speed of both paths on zeros
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "mpi-scan.h"
+
+#define TEST_BUFS 2000
+#define TEST_LEN_MAX 600
+#define BENCH_LEN (64 * 1024 * 1024)
+#define BENCH_ROUNDS 16
+
+static guint32 test_seed = 2463534242U;
+
+/* xorshift32, the same buffers on every run */
+static guint32
+test_random(void)
+{
+    test_seed ^= test_seed << 13;
+    test_seed ^= test_seed >> 17;
+    test_seed ^= test_seed << 5;
+    return test_seed;
+}
+
+static void
+test_put_size(guint8 *p, guint32 size, gboolean little_endian)
+{
+    if (little_endian) {
+        p[4] = (guint8)size;
+        p[5] = (guint8)(size >> 8);
+        p[6] = (guint8)(size >> 16);
+        p[7] = (guint8)(size >> 24);
+    } else {
+        p[4] = (guint8)(size >> 24);
+        p[5] = (guint8)(size >> 16);
+        p[6] = (guint8)(size >> 8);
+        p[7] = (guint8)size;
+    }
+}
+
+/* a header at "p", damaged in one byte now and then */
+static void
+test_plant(guint8 *p, gsize room, gboolean little_endian)
+{
+    guint32 size;
+
+    if (MPI_SCAN_HDR_LEN > room) {
+        return;
+    }
+    p[0] = (guint8)(65 + test_random() % 13);
+    p[1] = (guint8)(1 + test_random() % 3);
+    p[8] = p[0];
+    p[9] = (guint8)(test_random() & 0x3f);
+    size = 2 + test_random() % 64;
+    test_put_size(p, size, little_endian);
+
+    switch (test_random() % 8) {
+        case 0:
+            p[8]++;
+            break;
+        case 1:
+            p[9] |= 0x40;
+            break;
+        case 2:
+            test_put_size(p, MPI_SCAN_MAX_SIZE + 1, little_endian);
+            break;
+        case 3:
+            p[1] = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+static void
+test_fill(guint8 *buf, gsize len, gboolean little_endian)
+{
+    gsize i;
+    guint8 like;
+
+    switch (test_random() % 3) {
+        case 0:
+            /* random bytes only */
+            for (i = 0; i < len; i++) {
+                buf[i] = (guint8)test_random();
+            }
+            break;
+        case 1:
+            /* header-like bytes, many SSE2 candidates */
+            like = (guint8)(65 + test_random() % 13);
+            for (i = 0; i < len; i++) {
+                buf[i] = test_random() % 4 ? like : (guint8)(test_random() % 4);
+            }
+            break;
+        default:
+            memset(buf, 0, len);
+            break;
+    }
+    for (i = 0; i < len; i += 1 + test_random() % 48) {
+        test_plant(buf + i, len - i, little_endian);
+    }
+}
+
+static int
+test_compare(void)
+{
+    guint8 buf[TEST_LEN_MAX];
+    gsize len;
+    gsize from;
+    gsize sse2;
+    gsize scalar;
+    guint n;
+    guint found = 0;
+    guint flags;
+    gboolean little_endian;
+    gboolean chained;
+
+    for (n = 0; n < TEST_BUFS; n++) {
+        len = test_random() % TEST_LEN_MAX;
+        little_endian = test_random() & 1;
+        test_fill(buf, len, little_endian);
+        for (flags = 0; flags < 4; flags++) {
+            little_endian = flags & 1;
+            chained = (flags & 2) != 0;
+            for (from = 0; from <= len; from++) {
+                sse2 = mpi_scan_btl(buf, len, from, little_endian, chained);
+                scalar = mpi_scan_btl_scalar(buf, len, from, little_endian,
+                        chained);
+                if (sse2 != scalar) {
+                    fprintf(stderr, "buffer %u (%lu bytes) from %lu, "
+                            "little endian %d, chained %d: SSE2 %lu, "
+                            "scalar %lu\n", n, (unsigned long)len,
+                            (unsigned long)from, little_endian, chained,
+                            (unsigned long)sse2, (unsigned long)scalar);
+                    return 1;
+                }
+                if (sse2 < len) {
+                    found++;
+                }
+            }
+        }
+    }
+    printf("%u buffers, %u headers found, SSE2 and scalar agree\n",
+            TEST_BUFS, found);
+    return 0;
+}
+
+static gdouble
+bench_run(gsize (*scan)(const guint8 *, gsize, gsize, gboolean, gboolean),
+        const guint8 *buf)
+{
+    GTimer *timer;
+    gdouble secs;
+    guint i;
+
+    timer = g_timer_new();
+    for (i = 0; i < BENCH_ROUNDS; i++) {
+        if (scan(buf, BENCH_LEN, 0, FALSE, TRUE) != BENCH_LEN) {
+            fprintf(stderr, "a header in zeros\n");
+        }
+    }
+    secs = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+    return (gdouble)BENCH_LEN * BENCH_ROUNDS / secs / 1e9;
+}
+
+static int
+test_bench(void)
+{
+    guint8 *buf;
+
+    buf = (guint8 *)g_malloc0(BENCH_LEN);
+#ifdef __SSE2__
+    printf("SSE2:   %.2f GB/s\n", bench_run(mpi_scan_btl, buf));
+#else
+    printf("SSE2:   not compiled in\n");
+#endif
+    printf("scalar: %.2f GB/s\n", bench_run(mpi_scan_btl_scalar, buf));
+    g_free(buf);
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    if (2 == argc && 0 == strcmp(argv[1], "bench")) {
+        return test_bench();
+    }
+    return test_compare();
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,94 @@
+#!/bin/sh
+#
+# run-tests.sh
+# Checks the -z output of tshark with the MPI plugin on the bundled and
+# the synthetic captures (make-captures.py)
+#
+# Wireshark - Network traffic analyzer
+# By Gerald Combs <gerald@wireshark.org>
+# Copyright 1998 Gerald Combs
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+# Usage: TSHARK=/path/to/tshark ./run-tests.sh
+#
+# Every line of expected/<test>.txt has to be in the output:
+#   "text"    an output line is equal to it
+#   "~ text"  an output line contains it
+#   "! text"  no output line contains it
+# Lines starting with "#" are comments.
+
+TSHARK=${TSHARK:-tshark}
+TESTS_DIR=`dirname "$0"`
+SNIFFS="$TESTS_DIR/../sniffs"
+CAPTURES="$TESTS_DIR/captures"
+OUTPUT=${TMPDIR:-/tmp}/mpi-test-$$.txt
+FAILED=0
+PASSED=0
+
+trap 'rm -f "$OUTPUT"' 0
+
+# run_test <test> <capture> <-z argument>
+run_test() {
+    if ! "$TSHARK" -q -r "$2" -z "$3" > "$OUTPUT" 2>&1; then
+        echo "FAIL $1: tshark -r $2 -z $3"
+        cat "$OUTPUT"
+        FAILED=`expr $FAILED + 1`
+        return
+    fi
+    missing=0
+    while IFS= read -r line; do
+        case "$line" in
+            "#"*|"")
+                continue
+                ;;
+            "~ "*)
+                grep -qF -- "${line#\~ }" "$OUTPUT"
+                ;;
+            "! "*)
+                ! grep -qF -- "${line#! }" "$OUTPUT"
+                ;;
+            *)
+                grep -qxF -- "$line" "$OUTPUT"
+                ;;
+        esac
+        if [ $? -ne 0 ]; then
+            [ $missing -eq 0 ] && echo "FAIL $1: tshark -r $2 -z $3"
+            echo "    $line"
+            missing=1
+        fi
+    done < "$TESTS_DIR/expected/$1.txt"
+    if [ $missing -ne 0 ]; then
+        echo "  output:"
+        sed 's/^/    /' "$OUTPUT"
+        FAILED=`expr $FAILED + 1`
+    else
+        echo "ok   $1"
+        PASSED=`expr $PASSED + 1`
+    fi
+}
+
+run_test xfer-endpoints "$CAPTURES/xfer-endpoints.pcap" mpi,bandwidth
+run_test xfer-mixed "$CAPTURES/xfer-mixed.pcap" mpi,bandwidth
+run_test rndv-ack "$CAPTURES/rndv-ack.pcap" mpi,resolve
+run_test rndv-put "$SNIFFS/rndv_put.pcapng" mpi,resolve
+run_test put-same-des "$CAPTURES/put-same-des.pcap" mpi,resolve
+run_test oob-loss "$CAPTURES/oob-loss.pcap" expert
+run_test btl-resync "$CAPTURES/btl-resync.pcap" expert
+run_test launch-hosts "$CAPTURES/launch-hosts.pcap" mpi,launch
+run_test oob-static-ports "$CAPTURES/oob-static-ports.pcap" mpi,launch
+
+echo "$PASSED passed, $FAILED failed"
+[ $FAILED -eq 0 ]
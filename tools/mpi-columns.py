@@ -0,0 +1,124 @@
+#!/usr/bin/env python
+#
+# mpi-columns.py
+# Reader of the columnar message export of the MPI plugin
+# (tshark -z mpi,columns,<file>)
+# Copyright 2015, Julian Rilli julian@rilli.eu
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+"""Read a -z mpi,columns export into one list per column.
+
+The format is described in tap-mpi-columns.c. As a module:
+
+    columns = read_columns("messages.mpicol")
+    columns["bytes"][0], columns["time"][0], ...
+
+With numpy installed, as_numpy=True gives arrays instead of lists. As a
+script it prints the records as CSV.
+"""
+
+import struct
+import sys
+from collections import OrderedDict
+
+ENC_PLAIN = 0
+ENC_DICT = 1
+ENC_DELTA = 2
+
+MASK64 = (1 << 64) - 1
+
+
+def _varints(data, rows):
+    values = []
+    shift = value = 0
+    for byte in bytearray(data):
+        value |= (byte & 0x7f) << shift
+        shift += 7
+        if not byte & 0x80:
+            values.append(value)
+            shift = value = 0
+    if len(values) != rows:
+        raise ValueError("bad delta column")
+    return values
+
+
+def _decode(encoding, data, rows, code):
+    width = struct.calcsize("<" + code)
+    if ENC_PLAIN == encoding:
+        return list(struct.unpack("<%d%s" % (rows, code), data))
+    if ENC_DICT == encoding:
+        n, = struct.unpack_from("<I", data)
+        keys = struct.unpack_from("<%d%s" % (n, code), data, 4)
+        index = "B" if n <= 256 else "H"
+        indexes = struct.unpack_from("<%d%s" % (rows, index), data,
+                                     4 + n * width)
+        return [keys[i] for i in indexes]
+    if ENC_DELTA == encoding:
+        values = []
+        prev = 0
+        for zigzag in _varints(data, rows):
+            prev = (prev + ((zigzag >> 1) ^ -(zigzag & 1))) & MASK64
+            values.append(prev)
+        if code.islower():
+            bits = 8 * width
+            values = [v - (1 << bits) if v >> (bits - 1) else v
+                      for v in values]
+        return values
+    raise ValueError("unknown encoding %d" % encoding)
+
+
+def read_columns(path, as_numpy=False):
+    """Return {column name: values} of all records, in the file order."""
+    with open(path, "rb") as f:
+        if f.read(8) != b"MPICOLS\0":
+            raise ValueError("not a -z mpi,columns file")
+        version, count = struct.unpack("<HH", f.read(4))
+        if version != 1:
+            raise ValueError("unsupported version %d" % version)
+        names = []
+        codes = []
+        for _ in range(count):
+            code, length = struct.unpack("<cB", f.read(2))
+            codes.append(code.decode())
+            names.append(f.read(length).decode())
+        columns = OrderedDict((name, []) for name in names)
+        while True:
+            head = f.read(4)
+            if len(head) < 4:
+                raise ValueError("truncated file")
+            rows, = struct.unpack("<I", head)
+            if 0 == rows:
+                break
+            for name, code in zip(names, codes):
+                encoding, length = struct.unpack("<BI", f.read(5))
+                columns[name].extend(_decode(encoding, f.read(length), rows,
+                                             code))
+    if as_numpy:
+        import numpy
+        columns = OrderedDict(
+            (name, numpy.array(columns[name], dtype="<" + code))
+            for name, code in zip(names, codes))
+    return columns
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        sys.exit("usage: %s <file>" % sys.argv[0])
+    cols = read_columns(sys.argv[1])
+    names = list(cols)
+    print(",".join(names))
+    for row in zip(*(cols[name] for name in names)):
+        print(",".join(str(v) for v in row))